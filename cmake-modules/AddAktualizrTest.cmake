@@ -31,3 +31,24 @@ function(add_aktualizr_test)
     add_dependencies(build_tests ${TEST_TARGET})
     set(TEST_SOURCES ${TEST_SOURCES} ${AKTUALIZR_TEST_SOURCES} PARENT_SCOPE)
 endfunction(add_aktualizr_test)
+
+# Run the DISABLED_Benchmark* cases of a test added with add_aktualizr_test()
+# as a test of their own with the "benchmark" label. `make check` only runs
+# them if TESTSUITE_ONLY includes "benchmark".
+function(add_aktualizr_benchmark)
+    set(options PROJECT_WORKING_DIRECTORY)
+    set(oneValueArgs NAME)
+    set(multiValueArgs ARGS)
+    cmake_parse_arguments(AKTUALIZR_BENCHMARK "${options}" "${oneValueArgs}" "${multiValueArgs}" ${ARGN})
+
+    if(AKTUALIZR_BENCHMARK_PROJECT_WORKING_DIRECTORY)
+        set(WD WORKING_DIRECTORY ${PROJECT_SOURCE_DIR})
+    else()
+        set(WD )
+    endif()
+
+    add_test(NAME test_${AKTUALIZR_BENCHMARK_NAME}_benchmark
+             COMMAND $<TARGET_FILE:t_${AKTUALIZR_BENCHMARK_NAME}> --gtest_also_run_disabled_tests
+                     --gtest_filter=*.DISABLED_Benchmark* ${AKTUALIZR_BENCHMARK_ARGS} ${WD})
+    set_tests_properties(test_${AKTUALIZR_BENCHMARK_NAME}_benchmark PROPERTIES LABELS "benchmark")
+endfunction(add_aktualizr_benchmark)
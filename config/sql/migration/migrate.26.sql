@@ -0,0 +1,10 @@
+-- Don't modify this! Create a new migration instead--see docs/ota-client-guide/modules/ROOT/pages/schema-migrations.adoc
+SAVEPOINT MIGRATION;
+
+CREATE TABLE target_hasher_checkpoints(targetname TEXT PRIMARY KEY, hash_type TEXT NOT NULL, hashed_size INTEGER NOT NULL, state BLOB NOT NULL);
+CREATE TABLE verified_target_files(targetname TEXT PRIMARY KEY, size INTEGER NOT NULL, mtime_ns INTEGER NOT NULL, inode INTEGER NOT NULL, hash_type TEXT NOT NULL, hash TEXT NOT NULL);
+
+DELETE FROM version;
+INSERT INTO version VALUES(26);
+
+RELEASE MIGRATION;
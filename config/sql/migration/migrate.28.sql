@@ -0,0 +1,9 @@
+-- Don't modify this! Create a new migration instead--see docs/ota-client-guide/modules/ROOT/pages/schema-migrations.adoc
+SAVEPOINT MIGRATION;
+
+CREATE TABLE cached_meta(repo INTEGER NOT NULL, meta_type INTEGER NOT NULL, meta BLOB NOT NULL, etag TEXT NOT NULL DEFAULT '', last_modified TEXT NOT NULL DEFAULT '', UNIQUE(repo, meta_type));
+
+DELETE FROM version;
+INSERT INTO version VALUES(28);
+
+RELEASE MIGRATION;
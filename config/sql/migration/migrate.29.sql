@@ -0,0 +1,9 @@
+-- Don't modify this! Create a new migration instead--see docs/ota-client-guide/modules/ROOT/pages/schema-migrations.adoc
+SAVEPOINT MIGRATION;
+
+CREATE TABLE target_file_prefixes(targetname TEXT PRIMARY KEY, size INTEGER NOT NULL);
+
+DELETE FROM version;
+INSERT INTO version VALUES(29);
+
+RELEASE MIGRATION;
@@ -0,0 +1,10 @@
+-- Don't modify this! Create a new migration instead--see docs/ota-client-guide/modules/ROOT/pages/schema-migrations.adoc
+SAVEPOINT ROLLBACK_MIGRATION;
+
+DROP TABLE target_hasher_checkpoints;
+DROP TABLE verified_target_files;
+
+DELETE FROM version;
+INSERT INTO version VALUES(25);
+
+RELEASE ROLLBACK_MIGRATION;
@@ -1,5 +1,5 @@
 CREATE TABLE version(version INTEGER);
-INSERT INTO version(rowid,version) VALUES(1,25);
+INSERT INTO version(rowid,version) VALUES(1,29);
 CREATE TABLE device_info(unique_mark INTEGER PRIMARY KEY CHECK (unique_mark = 0), device_id TEXT, is_registered INTEGER NOT NULL DEFAULT 0 CHECK (is_registered IN (0,1)));
 CREATE TABLE ecus(id INTEGER PRIMARY KEY, serial TEXT UNIQUE, hardware_id TEXT NOT NULL, is_primary INTEGER NOT NULL DEFAULT 0 CHECK (is_primary IN (0,1)));
 CREATE TABLE secondary_ecus(serial TEXT PRIMARY KEY, sec_type TEXT, public_key_type TEXT, public_key TEXT, extra TEXT, manifest TEXT);
@@ -10,7 +10,7 @@ CREATE TABLE tls_creds(ca_cert BLOB, ca_cert_format TEXT,
                        client_cert BLOB, client_cert_format TEXT,
                        client_pkey BLOB, client_pkey_format TEXT);
 CREATE TABLE meta(meta BLOB NOT NULL, repo INTEGER NOT NULL, meta_type INTEGER NOT NULL, version INTEGER NOT NULL, UNIQUE(repo, meta_type, version));
-CREATE TABLE target_images(targetname TEXT PRIMARY KEY, real_size INTEGER NOT NULL DEFAULT 0, sha256 TEXT NOT NULL DEFAULT "", sha512 TEXT NOT NULL DEFAULT "", filename TEXT NOT NULL);
+CREATE TABLE target_images(targetname TEXT PRIMARY KEY, real_size INTEGER NOT NULL DEFAULT 0, sha256 TEXT NOT NULL DEFAULT "", sha512 TEXT NOT NULL DEFAULT "", filename TEXT NOT NULL, last_used INTEGER NOT NULL DEFAULT 0);
 CREATE TABLE repo_types(repo INTEGER NOT NULL, repo_string TEXT NOT NULL);
 CREATE TABLE meta_types(meta INTEGER NOT NULL, meta_string TEXT NOT NULL);
 INSERT INTO meta_types(rowid,meta,meta_string) VALUES(1,0,'root');
@@ -27,3 +27,7 @@ CREATE TABLE delegations(meta BLOB NOT NULL, role_name TEXT NOT NULL, UNIQUE(rol
 CREATE TABLE ecu_report_counter(ecu_serial TEXT NOT NULL PRIMARY KEY, counter INTEGER NOT NULL DEFAULT 0);
 CREATE TABLE report_events(id INTEGER PRIMARY KEY, json_string TEXT NOT NULL);
 CREATE TABLE device_data(data_type TEXT PRIMARY KEY, hash TEXT NOT NULL);
+CREATE TABLE target_hasher_checkpoints(targetname TEXT PRIMARY KEY, hash_type TEXT NOT NULL, hashed_size INTEGER NOT NULL, state BLOB NOT NULL);
+CREATE TABLE verified_target_files(targetname TEXT PRIMARY KEY, size INTEGER NOT NULL, mtime_ns INTEGER NOT NULL, inode INTEGER NOT NULL, hash_type TEXT NOT NULL, hash TEXT NOT NULL);
+CREATE TABLE cached_meta(repo INTEGER NOT NULL, meta_type INTEGER NOT NULL, meta BLOB NOT NULL, etag TEXT NOT NULL DEFAULT '', last_modified TEXT NOT NULL DEFAULT '', UNIQUE(repo, meta_type));
+CREATE TABLE target_file_prefixes(targetname TEXT PRIMARY KEY, size INTEGER NOT NULL);
@@ -1,6 +1,7 @@
 #ifndef AKTUALIZR_H_
 #define AKTUALIZR_H_
 
+#include <atomic>
 #include <future>
 #include <memory>
 
@@ -12,6 +13,7 @@
 
 class SotaUptaneClient;
 class INvStorage;
+class PollScheduler;
 
 namespace api {
 class CommandQueue;
@@ -63,6 +65,8 @@ class Aktualizr {
 
   /**
    * Asynchronously run aktualizr indefinitely until Shutdown is called.
+   * The interval between update checks adapts to the circumstances, see the
+   * `polling_*` options in the `uptane` section of the configuration.
    * @return Empty std::future object
    *
    * @throw SQLException
@@ -82,6 +86,15 @@ class Aktualizr {
    */
   void Shutdown();
 
+  /**
+   * Make the currently running `RunForever()` method check for updates now
+   * instead of waiting for the rest of the polling interval. If a check is in
+   * progress, another one follows right after it.
+   *
+   * @throw std::system_error (failure to lock a mutex)
+   */
+  void WakeUp();
+
   /**
    * Check for campaigns.
    * Campaigns are a concept outside of Uptane, and allow for user approval of
@@ -302,6 +315,13 @@ class Aktualizr {
    */
   bool UptaneCycle();
 
+  /**
+   * Number of new connections, and so TLS handshakes, that the last completed
+   * `UptaneCycle()` opened to the server. Always 0 if the HTTP client does not
+   * count them.
+   */
+  uint64_t LastCycleHandshakes() const { return last_cycle_handshakes_; }
+
   /**
    * Add new Secondary to aktualizr. Must be called before Initialize.
    * @param secondary An object to perform installation on a Secondary ECU.
@@ -364,11 +384,16 @@ class Aktualizr {
     std::mutex m;
     std::condition_variable cv;
     bool flag = false;
+    bool wake = false;
   } exit_cond_;
 
   std::shared_ptr<INvStorage> storage_;
   std::shared_ptr<event::Channel> sig_;
   std::unique_ptr<api::CommandQueue> api_queue_;
+  std::unique_ptr<PollScheduler> poll_scheduler_;
+  std::atomic<uint64_t> last_cycle_handshakes_{0};
+
+  bool RunUptaneCycle();
 };
 
 #endif  // AKTUALIZR_H_
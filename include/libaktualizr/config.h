@@ -65,6 +65,11 @@ struct ProvisionConfig {
 
 struct UptaneConfig {
   uint64_t polling_sec{10U};
+  // See PollScheduler
+  uint64_t polling_jitter_percent{20U};
+  uint64_t polling_active_sec{0U};
+  uint64_t polling_idle_max_sec{0U};
+  uint64_t polling_backoff_max_sec{3600U};
   std::string director_server;
   std::string repo_server;
   CryptoSource key_source{CryptoSource::kFile};
@@ -72,6 +77,12 @@ struct UptaneConfig {
   bool force_install_completion{false};
   boost::filesystem::path secondary_config_file;
   uint64_t secondary_preinstall_wait_sec{600U};
+  uint64_t secondary_manifest_timeout_ms{10000U};
+  uint64_t download_parallelism{1U};
+  uint64_t download_max_tries{3U};
+  uint64_t download_retry_wait_ms{500U};
+  // Events waiting for delivery to the event handlers, 0 to deliver them synchronously
+  uint64_t event_queue_size{128U};
 
   void updateFromPropertyTree(const boost::property_tree::ptree& pt);
   void writeToStream(std::ostream& out_stream) const;
@@ -96,6 +107,11 @@ struct PackageConfig {
   std::string ostree_server;
   boost::filesystem::path images_path{"/var/sota/images"};
   boost::filesystem::path packages_file{"/usr/package.manifest"};
+  // Number of concurrent byte range requests for a single binary Target
+  uint64_t download_segments{1U};
+  // Budgets of the downloaded Targets in images_path, 0 for unlimited
+  uint64_t images_max_size{0U};
+  uint64_t images_max_age{0U};  // seconds since last use
 
   // Options for simulation
   bool fake_need_reboot{false};
@@ -122,6 +138,8 @@ struct StorageConfig {
 
   // SQLite storage
   utils::BasedPath sqldb_path{"sql.db"};  // based on `/var/sota`
+  uint64_t sqldb_pool_size{0U};
+  bool sqldb_wal{false};
 
   void updateFromPropertyTree(const boost::property_tree::ptree& pt);
   void writeToStream(std::ostream& out_stream) const;
@@ -1,8 +1,11 @@
 #ifndef PACKAGEMANAGERINTERFACE_H_
 #define PACKAGEMANAGERINTERFACE_H_
 
+#include <chrono>
 #include <fstream>
+#include <map>
 #include <mutex>
+#include <set>
 #include <string>
 
 #include "libaktualizr/config.h"
@@ -40,6 +43,43 @@ enum class TargetStatus {
   kInvalid,
 };
 
+/**
+ * Contents of the cache of downloaded Targets in images_path.
+ */
+struct TargetCacheStats {
+  /* Number of Target names with a downloaded file. */
+  uint64_t targets{0};
+  /* Number of distinct files; identical Targets share one. */
+  uint64_t files{0};
+  /* Total size of the files in bytes. */
+  uint64_t size{0};
+  /* Size of the files of installed or pending Targets, which are never evicted. */
+  uint64_t protected_size{0};
+  /* Budgets from the configuration, 0 if unlimited. */
+  uint64_t max_size{0};
+  uint64_t max_age{0};
+};
+
+/**
+ * Throughput of the stages of the last transfer of a Target: receiving from
+ * the network, writing to disk and hashing. A stage is the bottleneck if it is
+ * busy for most of the duration.
+ */
+struct DownloadStats {
+  std::chrono::nanoseconds duration{0};
+  uint64_t received_bytes{0};
+  uint64_t written_bytes{0};
+  /* Time spent writing and hashing, respectively. */
+  std::chrono::nanoseconds write_time{0};
+  uint64_t hashed_bytes{0};
+  std::chrono::nanoseconds hash_time{0};
+  /* Number of times and total time the network transfer waited for the other stages. */
+  uint64_t pauses{0};
+  std::chrono::nanoseconds paused_time{0};
+
+  std::string toString() const;
+};
+
 class PackageManagerInterface {
  public:
   PackageManagerInterface(PackageConfig pconfig, const BootloaderConfig& bconfig, std::shared_ptr<INvStorage> storage,
@@ -69,10 +109,29 @@ class PackageManagerInterface {
   virtual std::ifstream openTargetFile(const Uptane::Target& target) const;
   virtual void removeTargetFile(const Uptane::Target& target);
   virtual std::vector<Uptane::Target> getTargetFiles();
+  // Sync the index of downloaded Targets with images_path and evict what is
+  // over the size and age budgets, keeping the Targets of the coming `batch`
+  // of downloads. Called at startup and before each batch.
+  virtual void maintainTargetCache(const std::vector<Uptane::Target>& batch);
+  virtual TargetCacheStats getTargetCacheStats() const;
+  // Stats of the last transfer of `target` that was written and hashed on the
+  // way, which is not the case for segmented downloads. For a delta patch, the
+  // received data is the rebuilt image.
+  boost::optional<DownloadStats> getDownloadStats(const Uptane::Target& target) const;
 
  protected:
   PackageConfig config;
   std::shared_ptr<INvStorage> storage_;
   std::shared_ptr<HttpInterface> http_;
+
+ private:
+  void recordDownloadStats(const Uptane::Target& target, const DownloadStats& stats);
+
+  // Targets of the current batch of downloads, which are not evicted to make
+  // room for each other.
+  std::set<std::string> cache_pins_;
+  std::mutex cache_mutex_;
+  std::map<std::string, DownloadStats> download_stats_;
+  mutable std::mutex download_stats_mutex_;
 };
 #endif  // PACKAGEMANAGERINTERFACE_H_
@@ -1,7 +1,12 @@
 #ifndef UPTANE_SECONDARY_PROVIDER_H
 #define UPTANE_SECONDARY_PROVIDER_H
 
+#include <istream>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include "libaktualizr/config.h"
 #include "libaktualizr/packagemanagerinterface.h"
@@ -10,6 +15,7 @@
 class INvStorage;
 
 class SecondaryProviderBuilder;
+class FirmwareBroadcast;
 
 class SecondaryProvider {
  public:
@@ -20,6 +26,20 @@ class SecondaryProvider {
   bool getImageRepoMetadata(Uptane::MetaBundle* meta_bundle, const Uptane::Target& target) const;
   std::string getTreehubCredentials() const;
   std::ifstream getTargetFileHandle(const Uptane::Target& target) const;
+  /**
+   * The image of `target` for the Secondary `serial`. If the image is shared
+   * with other Secondaries, it is read only once for all of them.
+   */
+  std::unique_ptr<std::istream> openTargetFile(const Uptane::Target& target, const Uptane::EcuSerial& serial) const;
+
+  /**
+   * Read the image of `target` once for all of `serials`, which are about to
+   * be sent it. Each of them must call releaseTargetFile() once it is done, or
+   * the others will wait for it. If the image can not be opened, each of them
+   * opens it on its own instead.
+   */
+  void shareTargetFile(const Uptane::Target& target, const std::vector<Uptane::EcuSerial>& serials);
+  void releaseTargetFile(const Uptane::Target& target, const Uptane::EcuSerial& serial);
 
  private:
   SecondaryProvider(Config& config_in, std::shared_ptr<const INvStorage> storage_in,
@@ -30,6 +50,10 @@ class SecondaryProvider {
   Config& config_;
   std::shared_ptr<const INvStorage> storage_;
   std::shared_ptr<const PackageManagerInterface> package_manager_;
+
+  mutable std::mutex broadcasts_mutex_;
+  // Shared images by all of their hashes, see Hash::encodeVector().
+  std::map<std::string, std::shared_ptr<FirmwareBroadcast>> broadcasts_;
 };
 
 #endif  // UPTANE_SECONDARY_PROVIDER_H
@@ -3,6 +3,7 @@
 /** \file */
 
 #include <algorithm>
+#include <memory>
 #include <stdexcept>
 #include <unordered_map>
 
@@ -125,6 +126,8 @@ inline std::ostream &operator<<(std::ostream &os, CryptoSource cs) {
   return os;
 }
 
+class PublicKeyVerifier;
+
 class PublicKey {
  public:
   PublicKey() = default;
@@ -158,6 +161,8 @@ class PublicKey {
   PublicKey(std::string);  // NOLINT(google-explicit-constructor, hicpp-explicit-conversions)
   std::string value_;
   KeyType type_{KeyType::kUnknown};
+  // Parsed once on construction and shared between copies.
+  std::shared_ptr<const PublicKeyVerifier> verifier_;
 };
 
 /**
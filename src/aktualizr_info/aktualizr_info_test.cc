@@ -717,6 +717,47 @@ TEST_F(AktualizrInfoTest, PrintDelegations) {
   }
 }
 
+/**
+ * Verifies aktualizr-info output of the cache of downloaded Targets
+ *
+ * Checks actions:
+ *
+ *  - [x] Print the number and size of downloaded Targets, counting shared files once
+ *  - [x] Print nothing about the cache if it has no budget
+ */
+TEST_F(AktualizrInfoTest, PrintTargetCacheStats) {
+  db_storage_->storeEcuSerials({{primary_ecu_serial, primary_hw_id}});
+  db_storage_->storeEcuRegistered();
+
+  const std::string shared_file = "4d7b0c5e2a8f4f1b9a6c3e2d1f0a9b8c7d6e5f4a3b2c1d0e9f8a7b6c5d4e3f2a";
+  const std::string other_file = "0f1e2d3c4b5a69788796a5b4c3d2e1f00f1e2d3c4b5a69788796a5b4c3d2e1f0";
+  db_storage_->storeTargetFilename("update.bin", shared_file);
+  db_storage_->storeTargetFileUsage("update.bin", 100, 1);
+  db_storage_->storeTargetFilename("update-copy.bin", shared_file);
+  db_storage_->storeTargetFileUsage("update-copy.bin", 100, 2);
+  db_storage_->storeTargetFilename("old.bin", other_file);
+  db_storage_->storeTargetFileUsage("old.bin", 200, 3);
+
+  Uptane::EcuMap ecu_map{{primary_ecu_serial, primary_hw_id}};
+  db_storage_->savePrimaryInstalledVersion({"update.bin", ecu_map, {{Hash::Type::kSha256, shared_file}}, 100},
+                                           InstalledVersionUpdateMode::kCurrent, "corrid");
+
+  aktualizr_info_process_.run();
+  ASSERT_FALSE(aktualizr_info_output.empty());
+  EXPECT_EQ(aktualizr_info_output.find("Downloaded Targets"), std::string::npos);
+
+  config_.pacman.images_max_size = 1000;
+  {
+    boost::filesystem::ofstream conf_file(test_conf_file_);
+    config_.writeToStream(conf_file);
+  }
+  aktualizr_info_process_.run();
+  ASSERT_FALSE(aktualizr_info_output.empty());
+  EXPECT_NE(aktualizr_info_output.find("Downloaded Targets: 3 in 2 files, 300 bytes (100 bytes installed or pending)"),
+            std::string::npos);
+  EXPECT_NE(aktualizr_info_output.find("Download cache limits: 1000 bytes, unlimited age"), std::string::npos);
+}
+
 /**
  * Verifies aktualizr-info output when metadata is not present
  *
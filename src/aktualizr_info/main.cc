@@ -451,6 +451,18 @@ int main(int argc, char **argv) {
     if (!!pending) {
       std::cout << "Pending " << ecu_name << " ECU version: " << pending->sha256Hash() << std::endl;
     }
+
+    // The cache of downloaded Targets is only managed with a budget, and only
+    // reported if it holds anything.
+    const TargetCacheStats cache = pacman->getTargetCacheStats();
+    if ((cache.max_size != 0 || cache.max_age != 0) && cache.targets != 0) {
+      std::cout << "Downloaded Targets: " << cache.targets << " in " << cache.files << " files, " << cache.size
+                << " bytes (" << cache.protected_size << " bytes installed or pending)" << std::endl;
+      std::cout << "Download cache limits: "
+                << (cache.max_size != 0 ? std::to_string(cache.max_size) + " bytes" : std::string("unlimited size"))
+                << ", " << (cache.max_age != 0 ? std::to_string(cache.max_age) + " s" : std::string("unlimited age"))
+                << std::endl;
+    }
   } catch (const bpo::error &o) {
     std::cout << o.what() << std::endl << description;
     return EXIT_FAILURE;
@@ -70,10 +70,12 @@ void initSecondaries(Aktualizr& aktualizr, const boost::filesystem::path& config
 
 class SecondaryWaiter {
  public:
-  SecondaryWaiter(Aktualizr& aktualizr, uint16_t wait_port, int timeout_s, Secondaries& secondaries)
+  SecondaryWaiter(Aktualizr& aktualizr, uint16_t wait_port, int timeout_s, std::chrono::milliseconds idle_timeout,
+                  Secondaries& secondaries)
       : aktualizr_(aktualizr),
         endpoint_{boost::asio::ip::tcp::v4(), wait_port},
         timeout_{static_cast<boost::posix_time::seconds>(timeout_s)},
+        idle_timeout_{idle_timeout},
         timer_{io_context_},
         connected_secondaries_{secondaries} {}
 
@@ -120,7 +122,8 @@ class SecondaryWaiter {
 
       LOG_INFO << "Accepted connection from a Secondary: (" << sec_ip << ":" << sec_port << ")";
       try {
-        auto secondary = Uptane::IpUptaneSecondary::create(sec_ip, sec_port, it->second, con_socket_.native_handle());
+        auto secondary =
+            Uptane::IpUptaneSecondary::create(sec_ip, sec_port, it->second, con_socket_.native_handle(), idle_timeout_);
         if (secondary) {
           connected_secondaries_.push_back(secondary);
           // set ip/port in the db so that we can match everything later
@@ -156,6 +159,7 @@ class SecondaryWaiter {
   boost::asio::ip::tcp::acceptor acceptor_{io_context_, endpoint_};
   boost::asio::ip::tcp::socket con_socket_{io_context_};
   boost::posix_time::seconds timeout_;
+  std::chrono::milliseconds idle_timeout_;
   boost::asio::deadline_timer timer_;
 
   Secondaries& connected_secondaries_;
@@ -170,7 +174,8 @@ class SecondaryWaiter {
 // 4. Secondary is stored but not configured: it must have been removed. Skip it. This will cause re-registration.
 static Secondaries createIPSecondaries(const IPSecondariesConfig& config, Aktualizr& aktualizr) {
   Secondaries result;
-  SecondaryWaiter sec_waiter{aktualizr, config.secondaries_wait_port, config.secondaries_timeout_s, result};
+  SecondaryWaiter sec_waiter{aktualizr, config.secondaries_wait_port, config.secondaries_timeout_s,
+                             config.secondaries_idle_timeout, result};
   auto secondaries_info = aktualizr.GetSecondaries();
 
   for (const auto& cfg : config.secondaries_cfg) {
@@ -199,7 +204,8 @@ static Secondaries createIPSecondaries(const IPSecondariesConfig& config, Aktual
       LOG_INFO << "Migrated a single IP Secondary to new storage format.";
     } else if (f == secondaries_info.cend()) {
       // Secondary was not found in storage; it must be new.
-      secondary = Uptane::IpUptaneSecondary::connectAndCreate(cfg.ip, cfg.port, cfg.verification_type);
+      secondary = Uptane::IpUptaneSecondary::connectAndCreate(cfg.ip, cfg.port, cfg.verification_type,
+                                                              config.secondaries_idle_timeout);
       if (secondary == nullptr) {
         LOG_DEBUG << "Could not connect to IP Secondary at " << cfg.ip << ":" << cfg.port
                   << "; now trying to wait for it.";
@@ -221,7 +227,8 @@ static Secondaries createIPSecondaries(const IPSecondariesConfig& config, Aktual
 
     if (secondary == nullptr) {
       secondary = Uptane::IpUptaneSecondary::connectAndCheck(cfg.ip, cfg.port, cfg.verification_type, info->serial,
-                                                             info->hw_id, info->pub_key);
+                                                             info->hw_id, info->pub_key,
+                                                             config.secondaries_idle_timeout);
       if (secondary == nullptr) {
         throw std::runtime_error("Unable to connect to or verify IP Secondary at " + cfg.ip + ":" +
                                  std::to_string(cfg.port));
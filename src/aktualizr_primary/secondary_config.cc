@@ -5,6 +5,7 @@
 
 #include <json/json.h>
 
+#include "ipuptanesecondary.h"
 #include "logging/logging.h"
 #include "secondary_config.h"
 #include "utilities/utils.h"
@@ -35,6 +36,7 @@ config file example
   "IP": {
                 "secondaries_wait_port": 9040,
                 "secondaries_wait_timeout": 20,
+                "secondaries_idle_timeout_ms": 10000,
                 "secondaries": [
                         {"addr": "127.0.0.1:9031", "verification_type": "Full"}
                         {"addr": "127.0.0.1:9032", "verification_type": "Tuf"}
@@ -91,9 +93,14 @@ static std::pair<std::string, uint16_t> getIPAndPort(const std::string& addr) {
 }
 
 void JsonConfigParser::createIPSecondariesCfg(Configs& configs, const Json::Value& json_ip_sec_cfg) {
+  // Optional, the default of IpUptaneSecondary if not specified.
+  std::chrono::milliseconds idle_timeout = Uptane::IpUptaneSecondary::kDefaultIdleTimeout;
+  if (json_ip_sec_cfg.isMember(IPSecondariesConfig::IdleTimeoutField)) {
+    idle_timeout = std::chrono::milliseconds(json_ip_sec_cfg[IPSecondariesConfig::IdleTimeoutField].asUInt());
+  }
   auto resultant_cfg = std::make_shared<IPSecondariesConfig>(
       static_cast<uint16_t>(json_ip_sec_cfg[IPSecondariesConfig::PortField].asUInt()),
-      json_ip_sec_cfg[IPSecondariesConfig::TimeoutField].asInt());
+      json_ip_sec_cfg[IPSecondariesConfig::TimeoutField].asInt(), idle_timeout);
   auto secondaries = json_ip_sec_cfg[IPSecondariesConfig::SecondariesField];
 
   LOG_INFO << "Found IP secondaries config: " << *resultant_cfg;
@@ -1,6 +1,7 @@
 #ifndef SECONDARY_CONFIG_H_
 #define SECONDARY_CONFIG_H_
 
+#include <chrono>
 #include <string>
 #include <unordered_map>
 
@@ -36,18 +37,26 @@ class IPSecondariesConfig : public SecondaryConfig {
   static constexpr const char* const Type{"IP"};
   static constexpr const char* const PortField{"secondaries_wait_port"};
   static constexpr const char* const TimeoutField{"secondaries_wait_timeout"};
+  static constexpr const char* const IdleTimeoutField{"secondaries_idle_timeout_ms"};
   static constexpr const char* const SecondariesField{"secondaries"};
 
-  IPSecondariesConfig(const uint16_t wait_port, const int timeout_s)
-      : SecondaryConfig(Type), secondaries_wait_port{wait_port}, secondaries_timeout_s{timeout_s} {}
+  IPSecondariesConfig(const uint16_t wait_port, const int timeout_s, const std::chrono::milliseconds idle_timeout)
+      : SecondaryConfig(Type),
+        secondaries_wait_port{wait_port},
+        secondaries_timeout_s{timeout_s},
+        secondaries_idle_timeout{idle_timeout} {}
 
   friend std::ostream& operator<<(std::ostream& os, const IPSecondariesConfig& cfg) {
-    os << "(wait_port: " << cfg.secondaries_wait_port << " timeout_s: " << cfg.secondaries_timeout_s << ")";
+    os << "(wait_port: " << cfg.secondaries_wait_port << " timeout_s: " << cfg.secondaries_timeout_s
+       << " idle_timeout_ms: " << cfg.secondaries_idle_timeout.count() << ")";
     return os;
   }
 
   const uint16_t secondaries_wait_port;
   const int secondaries_timeout_s;
+  // How long a connection to a Secondary is reused after a request; zero
+  // opens a new connection for every request.
+  const std::chrono::milliseconds secondaries_idle_timeout;
   std::vector<IPSecondaryConfig> secondaries_cfg;
 };
 
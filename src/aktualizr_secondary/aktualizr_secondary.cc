@@ -279,12 +279,16 @@ MsgHandler::ReturnCode AktualizrSecondary::getInfoHdlr(Asn1Message& in_msg, Asn1
 }
 
 MsgHandler::ReturnCode AktualizrSecondary::versionHdlr(Asn1Message& in_msg, Asn1Message& out_msg) {
-  const uint32_t version = 2;
+  const uint32_t version = 3;
   auto version_req = in_msg.versionReq();
   const auto primary_version = static_cast<uint32_t>(version_req->version);
-  if (primary_version < version) {
+  if (primary_version < 2) {
     LOG_ERROR << "Primary protocol version is " << primary_version << " but Secondary version is " << version
               << "! Communication will most likely fail!";
+  } else if (primary_version < version) {
+    // Version 3 only adds streamed uploads, so a version 2 Primary still works.
+    LOG_INFO << "Primary protocol version is " << primary_version << " but Secondary version is " << version
+             << ". Firmware uploads will not be streamed.";
   } else if (primary_version > version) {
     LOG_INFO << "Primary protocol version is " << primary_version << " but Secondary version is " << version
              << ". Please consider upgrading the Secondary.";
@@ -1,5 +1,7 @@
 #include "aktualizr_secondary_file.h"
 
+#include <algorithm>
+
 #include "storage/invstorage.h"
 #include "update_agent_file.h"
 
@@ -14,6 +16,8 @@ AktualizrSecondaryFile::AktualizrSecondaryFile(const AktualizrSecondaryConfig& c
     : AktualizrSecondary(config, std::move(storage)), update_agent_{std::move(update_agent)} {
   registerHandler(AKIpUptaneMes_PR_uploadDataReq, std::bind(&AktualizrSecondaryFile::uploadDataHdlr, this,
                                                             std::placeholders::_1, std::placeholders::_2));
+  registerHandler(AKIpUptaneMes_PR_uploadStreamReq, std::bind(&AktualizrSecondaryFile::uploadStreamHdlr, this,
+                                                              std::placeholders::_1, std::placeholders::_2));
   if (!update_agent_) {
     std::string current_target_name;
 
@@ -65,6 +69,10 @@ void AktualizrSecondaryFile::completeInstall() { return update_agent_->completeI
 MsgHandler::ReturnCode AktualizrSecondaryFile::uploadDataHdlr(Asn1Message& in_msg, Asn1Message& out_msg) {
   if (last_msg_ != AKIpUptaneMes_PR_uploadDataReq) {
     LOG_INFO << "Received an initial data upload request message; attempting to receive data...";
+    if (last_msg_ != AKIpUptaneMes_PR_uploadStreamReq) {
+      // A protocol v2 upload, which comes without a chunk size.
+      stream_chunk_size_ = 0;
+    }
   } else {
     LOG_DEBUG << "Received another data upload request message; attempting to receive data...";
   }
@@ -75,7 +83,17 @@ MsgHandler::ReturnCode AktualizrSecondaryFile::uploadDataHdlr(Asn1Message& in_ms
     return ReturnCode::kOk;
   }
 
-  auto result = receiveData(in_msg.uploadDataReq()->data.buf, static_cast<size_t>(rec_buf_size));
+  data::InstallationResult result;
+  if (stream_chunk_size_ > 0 && rec_buf_size > stream_chunk_size_) {
+    LOG_ERROR << "Received a chunk of " << rec_buf_size << " bytes, larger than the agreed chunk size of "
+              << stream_chunk_size_;
+    result = data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed,
+                                      "Chunk of " + std::to_string(rec_buf_size) +
+                                          " bytes exceeds the agreed chunk size of " +
+                                          std::to_string(stream_chunk_size_));
+  } else {
+    result = receiveData(in_msg.uploadDataReq()->data.buf, static_cast<size_t>(rec_buf_size));
+  }
 
   auto m = out_msg.present(AKIpUptaneMes_PR_uploadDataResp).uploadDataResp();
   m->result = static_cast<AKInstallationResultCode_t>(result.result_code.num_code);
@@ -83,3 +101,20 @@ MsgHandler::ReturnCode AktualizrSecondaryFile::uploadDataHdlr(Asn1Message& in_ms
 
   return ReturnCode::kOk;
 }
+
+MsgHandler::ReturnCode AktualizrSecondaryFile::uploadStreamHdlr(Asn1Message& in_msg, Asn1Message& out_msg) {
+  auto req = in_msg.uploadStreamReq();
+  const auto chunk_size = std::max<long>(1, std::min<long>(req->chunkSize, kMaxStreamChunkSize));
+  const auto window = std::max<long>(1, std::min<long>(req->window, kMaxStreamWindow));
+  LOG_INFO << "Received a request to stream firmware; accepting chunks of " << chunk_size << " bytes, window of "
+           << window;
+
+  stream_chunk_size_ = chunk_size;
+
+  auto m = out_msg.present(AKIpUptaneMes_PR_uploadStreamResp).uploadStreamResp();
+  m->result = static_cast<AKInstallationResultCode_t>(data::ResultCode::Numeric::kOk);
+  m->chunkSize = chunk_size;
+  m->window = window;
+
+  return ReturnCode::kOk;
+}
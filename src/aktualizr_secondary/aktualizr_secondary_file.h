@@ -26,9 +26,19 @@ class AktualizrSecondaryFile : public AktualizrSecondary {
   void completeInstall() override;
 
   ReturnCode uploadDataHdlr(Asn1Message& in_msg, Asn1Message& out_msg);
+  ReturnCode uploadStreamHdlr(Asn1Message& in_msg, Asn1Message& out_msg);
+
+  // Upper bounds on what a Primary may request for a streamed upload: the
+  // size of a single uploadDataReq payload and how many of them may be
+  // in flight before the Primary waits for a response.
+  static constexpr long kMaxStreamChunkSize = 1024L * 1024;  // NOLINT(google-runtime-int)
+  static constexpr long kMaxStreamWindow = 16;               // NOLINT(google-runtime-int)
 
  private:
   std::shared_ptr<FileUpdateAgent> update_agent_;
+  // Chunk size agreed on for the current streamed upload, zero if the
+  // Primary did not ask for one.
+  long stream_chunk_size_{0};  // NOLINT(google-runtime-int)
 };
 
 #endif  // AKTUALIZR_SECONDARY_FILE_H
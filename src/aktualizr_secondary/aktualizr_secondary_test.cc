@@ -458,6 +458,37 @@ TEST_F(SecondaryTest, InvalidImageData) {
   EXPECT_FALSE(secondary_->install().isSuccess());
 }
 
+/* A Primary that streams firmware (protocol v3) must keep to the chunk size
+ * that was agreed on; larger chunks are rejected without being written. */
+TEST_F(SecondaryTest, StreamedUploadRejectsOversizedChunk) {
+  EXPECT_CALL(update_agent_, receiveData).Times(1);
+  EXPECT_TRUE(secondary_->putMetadata(uptane_repo_.getCurrentMetadata()).isSuccess());
+
+  Asn1Message::Ptr stream_req(Asn1Message::Empty());
+  stream_req->present(AKIpUptaneMes_PR_uploadStreamReq);
+  stream_req->uploadStreamReq()->chunkSize = send_buffer_size;
+  stream_req->uploadStreamReq()->window = 4;
+  Asn1Message::Ptr stream_resp(Asn1Message::Empty());
+  ASSERT_EQ(secondary_->handleMsg(stream_req, stream_resp), MsgHandler::kOk);
+  ASSERT_EQ(stream_resp->present(), AKIpUptaneMes_PR_uploadStreamResp);
+  // NOLINTNEXTLINE(google-runtime-int)
+  EXPECT_EQ(stream_resp->uploadStreamResp()->chunkSize, static_cast<long>(send_buffer_size));
+  EXPECT_EQ(stream_resp->uploadStreamResp()->window, 4);
+
+  const std::string chunk(send_buffer_size + 1, 'a');
+  auto send_chunk = [this, &chunk](size_t size) {
+    Asn1Message::Ptr req(Asn1Message::Empty());
+    req->present(AKIpUptaneMes_PR_uploadDataReq);
+    OCTET_STRING_fromBuf(&req->uploadDataReq()->data, chunk.c_str(), static_cast<int>(size));
+    Asn1Message::Ptr resp(Asn1Message::Empty());
+    EXPECT_EQ(secondary_->handleMsg(req, resp), MsgHandler::kOk);
+    EXPECT_EQ(resp->present(), AKIpUptaneMes_PR_uploadDataResp);
+    return static_cast<data::ResultCode::Numeric>(resp->uploadDataResp()->result);
+  };
+  EXPECT_EQ(send_chunk(send_buffer_size), data::ResultCode::Numeric::kOk);
+  EXPECT_EQ(send_chunk(send_buffer_size + 1), data::ResultCode::Numeric::kDownloadFailed);
+}
+
 class SecondaryTestTuf
     : public SecondaryTest,
       public ::testing::WithParamInterface<std::pair<std::vector<std::string>, boost::optional<std::string>>> {
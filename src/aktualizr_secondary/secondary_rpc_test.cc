@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <chrono>
 #include <thread>
 
 #include <gtest/gtest.h>
@@ -15,15 +17,15 @@
 #include "storage/invstorage.h"
 #include "test_utils.h"
 
-enum class HandlerVersion { kV1, kV2, kV2Failure };
+enum class HandlerVersion { kV1, kV2, kV2Failure, kV3 };
 
 /* This class allows us to divert messages from the regular handlers in
  * AktualizrSecondary to our own test functions. This lets us test only what was
  * received by the Secondary but not how it was processed.
  *
- * It also has handlers for both the old/v1 and new/v2 versions of the RPC
+ * It also has handlers for the old/v1, v2 and streaming/v3 versions of the RPC
  * protocol, so this is how we prove that the Primary is still
- * backwards-compatible with older/v1 Secondaries. */
+ * backwards-compatible with older Secondaries. */
 class SecondaryMock : public MsgDispatcher {
  public:
   SecondaryMock(const Uptane::EcuSerial& serial, const Uptane::HardwareIdentifier& hdw_id, const PublicKey& pub_key,
@@ -44,6 +46,7 @@ class SecondaryMock : public MsgDispatcher {
   const std::string upload_data_failure = "Expected data upload test failure";
   const std::string ostree_failure = "Expected OSTree download test failure";
   const std::string installation_failure = "Expected installation test failure";
+  const std::string oversized_chunk_failure = "Chunk larger than the agreed chunk size";
 
   const Uptane::EcuSerial& serial() const { return serial_; }
   const Uptane::HardwareIdentifier& hwID() const { return hdw_id_; }
@@ -58,12 +61,22 @@ class SecondaryMock : public MsgDispatcher {
       registerV1Handlers();
     } else if (handler_version_ == HandlerVersion::kV2) {
       registerV2Handlers();
+    } else if (handler_version_ == HandlerVersion::kV3) {
+      registerV3Handlers();
     } else {
       registerV2FailureHandlers();
     }
   }
 
   void resetImageHash() const { hasher_->reset(); }
+  size_t uploadDataRequests() const { return upload_data_requests_; }
+  void resetUploadDataRequests() { upload_data_requests_ = 0; }
+  // Largest chunk size and window to accept for a streamed upload; zero
+  // accepts whatever the Primary proposes.
+  void setStreamLimits(long chunk_size, long window) {  // NOLINT(google-runtime-int)
+    max_stream_chunk_size_ = chunk_size;
+    max_stream_window_ = window;
+  }
   Hash getReceivedImageHash() const { return hasher_->getHash(); }
   size_t getReceivedImageSize() const { return boost::filesystem::file_size(image_filepath_); }
 
@@ -111,6 +124,13 @@ class SecondaryMock : public MsgDispatcher {
                     std::bind(&SecondaryMock::putRootHdlr, this, std::placeholders::_1, std::placeholders::_2));
   }
 
+  // Used by protocol v3, which only adds streamed uploads on top of v2:
+  void registerV3Handlers() {
+    registerV2Handlers();
+    registerHandler(AKIpUptaneMes_PR_uploadStreamReq,
+                    std::bind(&SecondaryMock::uploadStreamHdlr, this, std::placeholders::_1, std::placeholders::_2));
+  }
+
   // Procotol v2 handlers that fail in predictable ways.
   void registerV2FailureHandlers() {
     registerHandler(AKIpUptaneMes_PR_putMetaReq2,
@@ -148,6 +168,8 @@ class SecondaryMock : public MsgDispatcher {
     auto m = out_msg.present(AKIpUptaneMes_PR_versionResp).versionResp();
     if (handler_version_ == HandlerVersion::kV1) {
       m->version = 1;
+    } else if (handler_version_ == HandlerVersion::kV3) {
+      m->version = 3;
     } else {
       m->version = 2;
     }
@@ -298,8 +320,14 @@ class SecondaryMock : public MsgDispatcher {
       return ReturnCode::kOk;
     }
 
+    ++upload_data_requests_;
     size_t data_size = static_cast<size_t>(in_msg.uploadDataReq()->data.size);
-    auto result = receiveImageData(in_msg.uploadDataReq()->data.buf, data_size);
+    data::InstallationResult result;
+    if (stream_chunk_size_ > 0 && in_msg.uploadDataReq()->data.size > stream_chunk_size_) {
+      result = data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed, oversized_chunk_failure);
+    } else {
+      result = receiveImageData(in_msg.uploadDataReq()->data.buf, data_size);
+    }
 
     auto m = out_msg.present(AKIpUptaneMes_PR_uploadDataResp).uploadDataResp();
     m->result = static_cast<AKInstallationResultCode_t>(result.result_code.num_code);
@@ -308,6 +336,17 @@ class SecondaryMock : public MsgDispatcher {
     return ReturnCode::kOk;
   }
 
+  MsgHandler::ReturnCode uploadStreamHdlr(Asn1Message& in_msg, Asn1Message& out_msg) {
+    auto req = in_msg.uploadStreamReq();
+    auto m = out_msg.present(AKIpUptaneMes_PR_uploadStreamResp).uploadStreamResp();
+    m->result = static_cast<AKInstallationResultCode_t>(data::ResultCode::Numeric::kOk);
+    m->chunkSize = max_stream_chunk_size_ > 0 ? std::min(req->chunkSize, max_stream_chunk_size_) : req->chunkSize;
+    m->window = max_stream_window_ > 0 ? std::min(req->window, max_stream_window_) : req->window;
+    stream_chunk_size_ = m->chunkSize;
+
+    return ReturnCode::kOk;
+  }
+
   MsgHandler::ReturnCode uploadDataFailureHdlr(Asn1Message& in_msg, Asn1Message& out_msg) {
     (void)in_msg;
 
@@ -436,6 +475,10 @@ class SecondaryMock : public MsgDispatcher {
   std::string received_firmware_data_;
   VerificationType vtype_;
   HandlerVersion handler_version_;
+  size_t upload_data_requests_{0};
+  long max_stream_chunk_size_{0};  // NOLINT(google-runtime-int)
+  long max_stream_window_{0};      // NOLINT(google-runtime-int)
+  long stream_chunk_size_{0};      // NOLINT(google-runtime-int)
 };
 
 class TargetFile {
@@ -747,6 +790,13 @@ INSTANTIATE_TEST_SUITE_P(SecondaryRpcTestCases, SecondaryRpcTest,
                                            std::make_tuple(1024 - 1, HandlerVersion::kV1, VerificationType::kFull),
                                            std::make_tuple(1024 + 1, HandlerVersion::kV1, VerificationType::kFull),
                                            std::make_tuple(1024 * 10 + 1, HandlerVersion::kV1, VerificationType::kFull),
+                                           std::make_tuple(1, HandlerVersion::kV3, VerificationType::kFull),
+                                           std::make_tuple(1024 * 10 + 1, HandlerVersion::kV3, VerificationType::kFull),
+                                           std::make_tuple(1024 * 1024 + 1, HandlerVersion::kV3,
+                                                           VerificationType::kFull),
+                                           std::make_tuple(4 * 1024 * 1024 + 1, HandlerVersion::kV3,
+                                                           VerificationType::kFull),
+                                           std::make_tuple(1024 * 10 + 1, HandlerVersion::kV3, VerificationType::kTuf),
                                            std::make_tuple(1024, HandlerVersion::kV2Failure, VerificationType::kFull)));
 
 class SecondaryRpcUpgrade : public SecondaryRpcCommon {
@@ -775,6 +825,54 @@ TEST_F(SecondaryRpcUpgrade, VersionUpgrade) {
   installOstreeRev();
 }
 
+class SecondaryRpcStream : public SecondaryRpcCommon {
+ protected:
+  SecondaryRpcStream() : SecondaryRpcCommon(4 * 1024 * 1024, HandlerVersion::kV2, VerificationType::kFull) {}
+
+  size_t uploadRequests(HandlerVersion handler_version) {
+    resetHandlers(handler_version);
+    secondary_.resetImageHash();
+    secondary_.resetUploadDataRequests();
+    sendAndInstallBinaryImage();
+    return secondary_.uploadDataRequests();
+  }
+
+  double uploadMBps(HandlerVersion handler_version) {
+    resetHandlers(handler_version);
+    secondary_.resetImageHash();
+    const auto start = std::chrono::steady_clock::now();
+    sendAndInstallBinaryImage();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<double>(image_file_.size()) / (1024 * 1024) / elapsed.count();
+  }
+};
+
+/* v2 sends the image in 1 KiB chunks, each with its own round trip. v3 sends
+ * the largest chunks the Secondary accepts and never more than it agreed to. */
+TEST_F(SecondaryRpcStream, ChunkSize) {
+  ASSERT_TRUE(ip_secondary_ != nullptr) << "Failed to create IP Secondary";
+
+  EXPECT_EQ(uploadRequests(HandlerVersion::kV2), 4 * 1024U);
+  EXPECT_EQ(uploadRequests(HandlerVersion::kV3), 4 * 1024U / 256);
+
+  secondary_.setStreamLimits(64 * 1024, 2);
+  EXPECT_EQ(uploadRequests(HandlerVersion::kV3), 4 * 1024U / 64);
+}
+
+/* Compare the upload throughput of v2, with a connection per 1 KiB chunk, to
+ * the streamed upload of v3. Run with the "benchmark" label. */
+TEST_F(SecondaryRpcStream, DISABLED_BenchmarkChunkSizeThroughput) {
+  ASSERT_TRUE(ip_secondary_ != nullptr) << "Failed to create IP Secondary";
+
+  const double v2_rate = uploadMBps(HandlerVersion::kV2);
+  const double v3_rate = uploadMBps(HandlerVersion::kV3);
+  secondary_.setStreamLimits(64 * 1024, 2);
+  const double v3_small_rate = uploadMBps(HandlerVersion::kV3);
+  LOG_INFO << "Firmware upload throughput: v2 " << v2_rate << " MB/s, v3 " << v3_rate << " MB/s, v3 with 64 KiB chunks "
+           << v3_small_rate << " MB/s";
+  EXPECT_GT(v3_rate, v2_rate);
+}
+
 TEST(SecondaryTcpServer, TestIpSecondaryIfSecondaryIsNotRunning) {
   in_port_t secondary_port = TestUtils::getFreePortAsInt();
   SecondaryInterface::Ptr ip_secondary;
@@ -837,21 +935,37 @@ class SecondaryRpcTestPositive : public ::testing::Test, public MsgHandler {
     return ReturnCode::kOk;
   }
 
-  AKIpUptaneMes_PR sendInstallMsg() {
-    // compose and send a valid message
+  static Asn1Message::Ptr installMsg() {
     Asn1Message::Ptr req(Asn1Message::Empty());
     req->present(AKIpUptaneMes_PR_installReq);
 
     // prepare request message
     auto req_mes = req->installReq();
     SetString(&req_mes->hash, "target_name");
+    return req;
+  }
+
+  AKIpUptaneMes_PR sendInstallMsg() {
+    // compose and send a valid message
+    auto req = installMsg();
     // send request and receive response, a request-response type of RPC
-    std::pair<std::string, uint16_t> secondary_server_addr{"127.0.0.1", secondary_server_.port()};
-    auto resp = Asn1Rpc(req, secondary_server_addr);
+    auto resp = Asn1Rpc(req, serverAddr());
 
     return resp->present();
   }
 
+  std::pair<std::string, uint16_t> serverAddr() const { return {"127.0.0.1", secondary_server_.port()}; }
+
+  // Number of connections the server accepted for the requests.
+  uint64_t connectionsForRpcs(Asn1Session& session, uint64_t requests) {
+    const uint64_t before = secondary_server_.connections_accepted();
+    auto req = installMsg();
+    for (uint64_t i = 0; i < requests; ++i) {
+      EXPECT_EQ(session.Rpc(req)->present(), AKIpUptaneMes_PR_installResp);
+    }
+    return secondary_server_.connections_accepted() - before;
+  }
+
  protected:
   SecondaryTcpServer secondary_server_;
   std::thread secondary_server_thread_;
@@ -913,6 +1027,51 @@ TEST_F(SecondaryRpcTestPositive, primaryConnectAndSendGarbage) {
   ASSERT_EQ(sendInstallMsg(), AKIpUptaneMes_PR_installResp);
 }
 
+/* A session without an idle timeout opens a connection per request; with one,
+ * all requests share a single connection. */
+TEST_F(SecondaryRpcTestPositive, sessionConnections) {
+  const uint64_t requests = 50;
+  Asn1Session per_request{serverAddr(), std::chrono::milliseconds(0)};
+  EXPECT_EQ(connectionsForRpcs(per_request, requests), requests);
+
+  Asn1Session keep_alive{serverAddr()};
+  EXPECT_EQ(connectionsForRpcs(keep_alive, requests), 1U);
+  keep_alive.Close();
+
+  // The server must still accept new connections once the session is closed.
+  ASSERT_EQ(sendInstallMsg(), AKIpUptaneMes_PR_installResp);
+}
+
+/* The first request after the idle timeout closes the old connection and
+ * opens a new one. */
+TEST_F(SecondaryRpcTestPositive, sessionReconnectsAfterIdleTimeout) {
+  Asn1Session session{serverAddr(), std::chrono::milliseconds(50)};
+  EXPECT_EQ(connectionsForRpcs(session, 2), 1U);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(connectionsForRpcs(session, 2), 1U);
+}
+
+/* Compare the average request latency with a connection per request to that
+ * of a kept-alive session. Run with the "benchmark" label. */
+TEST_F(SecondaryRpcTestPositive, DISABLED_BenchmarkSessionLatency) {
+  const uint64_t requests = 1000;
+  auto latency = [this, requests](Asn1Session& session) {
+    const auto start = std::chrono::steady_clock::now();
+    connectionsForRpcs(session, requests);
+    const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / static_cast<double>(requests);
+  };
+
+  Asn1Session per_request{serverAddr(), std::chrono::milliseconds(0)};
+  const double per_request_us = latency(per_request);
+  Asn1Session keep_alive{serverAddr()};
+  const double keep_alive_us = latency(keep_alive);
+  keep_alive.Close();
+  LOG_INFO << "Average request latency: connection per request " << per_request_us << " us, kept-alive session "
+           << keep_alive_us << " us";
+  EXPECT_LT(keep_alive_us, per_request_us);
+}
+
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
 
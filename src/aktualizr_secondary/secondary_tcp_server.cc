@@ -61,13 +61,27 @@ void SecondaryTcpServer::run() {
       break;
     }
 
+    ++connections_accepted_;
     if (first_connection) {
       LOG_INFO << "Primary connected.";
       first_connection = false;
     } else {
       LOG_DEBUG << "Primary reconnected.";
     }
-    auto continue_running = HandleOneConnection(*Socket(con_fd));
+    Socket session(con_fd);
+    {
+      std::lock_guard<std::mutex> lock(session_mutex_);
+      session_fd_ = con_fd;
+    }
+    // Keep the session open while the Primary uses it, but do not let an idle
+    // Primary lock out everyone else.
+    timeval timeout{static_cast<time_t>(kSessionIdleTimeout.count()), 0};
+    setsockopt(con_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    auto continue_running = HandleOneConnection(con_fd);
+    {
+      std::lock_guard<std::mutex> lock(session_mutex_);
+      session_fd_ = -1;
+    }
     if (!continue_running) {
       keep_running_.store(false);
     }
@@ -86,6 +100,13 @@ void SecondaryTcpServer::run() {
 void SecondaryTcpServer::stop() {
   LOG_DEBUG << "Stopping Secondary TCP server...";
   keep_running_.store(false);
+  // unblock a session that is waiting for the next request
+  {
+    std::lock_guard<std::mutex> lock(session_mutex_);
+    if (session_fd_ != -1) {
+      shutdown(session_fd_, SHUT_RDWR);
+    }
+  }
   // unblock accept
   ConnectionSocket("localhost", listen_socket_.port()).connect();
 }
@@ -96,30 +117,37 @@ SecondaryTcpServer::ExitReason SecondaryTcpServer::exit_reason() const { return
 static bool sendResponseMessage(int socket_fd, const Asn1Message::Ptr &resp_msg);
 
 bool SecondaryTcpServer::HandleOneConnection(int socket) {
-  // Outside the message loop, because one recv() may have parts of 2 messages
-  // Note that one recv() call returning 2+ messages doesn't work at the
-  // moment. This shouldn't be a problem until we have messages that aren't
-  // strictly request/response
+  // Outside the message loop, because one recv() may have parts of 2 messages,
+  // e.g. when the Primary pipelines uploadDataReq messages (protocol v3).
   DequeueBuffer buffer;
   bool keep_running_server = true;
   bool keep_running_current_session = true;
+  Asn1SetNoDelay(socket);
 
   while (keep_running_current_session) {  // Keep reading until we get an error
     // Read an incoming message
     AKIpUptaneMes_t *m = nullptr;
     asn_dec_rval_t res{};
     asn_codec_ctx_s context{};
-    ssize_t received;
+    // Decode what is already buffered before reading more, as it may contain
+    // the whole next message.
+    auto received = static_cast<ssize_t>(buffer.Size());
+    bool need_data = (received == 0);
 
     do {
-      received = recv(socket, buffer.Tail(), buffer.TailSpace(), 0);
-      if (received < 0) {
-        LOG_ERROR << "Failed to read data from a server socket: " << strerror(errno);
-        break;
+      if (need_data) {
+        received = recv(socket, buffer.Tail(), buffer.TailSpace(), 0);
+        if (received < 0) {
+          if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            LOG_ERROR << "Failed to read data from a server socket: " << strerror(errno);
+          }
+          break;
+        }
+        buffer.HaveEnqueued(static_cast<size_t>(received));
       }
-      buffer.HaveEnqueued(static_cast<size_t>(received));
       res = ber_decode(&context, &asn_DEF_AKIpUptaneMes, reinterpret_cast<void **>(&m), buffer.Head(), buffer.Size());
       buffer.Consume(res.consumed);
+      need_data = true;
     } while (res.code == RC_WMORE && received > 0);
     // Note that ber_decode allocates *m even on failure, so this must always be done
     Asn1Message::Ptr request_msg = Asn1Message::FromRaw(&m);
@@ -130,7 +158,12 @@ bool SecondaryTcpServer::HandleOneConnection(int socket) {
     }
 
     if (received < 0) {
-      LOG_ERROR << "Error while reading message data from a socket: " << strerror(errno);
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        LOG_DEBUG << "Closing the connection to the Primary after " << kSessionIdleTimeout.count()
+                  << " seconds of inactivity";
+      } else {
+        LOG_ERROR << "Error while reading message data from a socket: " << strerror(errno);
+      }
       break;
     }
 
@@ -180,16 +213,9 @@ void SecondaryTcpServer::wait_until_running(int timeout) {
 bool sendResponseMessage(int socket_fd, const Asn1Message::Ptr &resp_msg) {
   LOG_DEBUG << "Encoding and sending response message";
 
-  int optval = 0;
-  setsockopt(socket_fd, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(int));
-  asn_enc_rval_t encode_result = der_encode(&asn_DEF_AKIpUptaneMes, &resp_msg->msg_, Asn1SocketWriteCallback,
-                                            reinterpret_cast<void *>(&socket_fd));
-  if (encode_result.encoded == -1) {
-    LOG_ERROR << "Failed to encode a response message";
+  if (!Asn1Send(resp_msg, socket_fd)) {
+    LOG_ERROR << "Failed to send a response message";
     return false;  // write error
   }
-  optval = 1;
-  setsockopt(socket_fd, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(int));
-
   return true;
 }
@@ -2,6 +2,7 @@
 #define AKTUALIZR_SECONDARY_TCP_SERVER_H_
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
 
@@ -11,10 +12,15 @@ class MsgHandler;
 
 /**
  * Listens on a socket, decodes calls (ASN.1) and forwards them to an Uptane Secondary
- * implementation
+ * implementation. A connection may carry any number of calls; it is closed by
+ * the server after kSessionIdleTimeout without a request.
  */
 class SecondaryTcpServer {
  public:
+  // Longer than Asn1Session::kDefaultIdleTimeout, so that the Primary
+  // normally reconnects before the server drops a connection it still uses.
+  static constexpr std::chrono::seconds kSessionIdleTimeout{30};
+
   enum class ExitReason {
     kNotApplicable,
     kRebootNeeded,
@@ -39,6 +45,8 @@ class SecondaryTcpServer {
 
   in_port_t port() const;
   ExitReason exit_reason() const;
+  // Number of connections accepted by run() so far.
+  uint64_t connections_accepted() const { return connections_accepted_.load(); }
 
  private:
   bool HandleOneConnection(int socket);
@@ -46,9 +54,13 @@ class SecondaryTcpServer {
   MsgHandler& msg_handler_;
   ListenSocket listen_socket_;
   std::atomic<bool> keep_running_;
+  std::atomic<uint64_t> connections_accepted_{0};
   bool reboot_after_install_;
   ExitReason exit_reason_{ExitReason::kNotApplicable};
 
+  std::mutex session_mutex_;
+  int session_fd_{-1};
+
   bool is_running_;
   std::mutex running_condition_mutex_;
   std::condition_variable running_condition_;
@@ -52,31 +52,45 @@ void SetString(OCTET_STRING_t* dest, const std::string& str) {
   OCTET_STRING_fromBuf(dest, str.c_str(), static_cast<int>(str.size()));
 }
 
-Asn1Message::Ptr Asn1Rpc(const Asn1Message::Ptr& tx, int con_fd) {
-  der_encode(&asn_DEF_AKIpUptaneMes, &tx->msg_, Asn1SocketWriteCallback, &con_fd);
-
-  // Bounce TCP_NODELAY to flush the TCP send buffer
+void Asn1SetNoDelay(int con_fd) {
   int no_delay = 1;
   setsockopt(con_fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(int));
-  no_delay = 0;
-  setsockopt(con_fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(int));
+}
 
+bool Asn1Send(const Asn1Message::Ptr& tx, int con_fd) {
+  // Encode into memory first: der_encode() emits many small pieces, which
+  // would otherwise each end up in their own TCP segment.
+  std::string out;
+  asn_enc_rval_t res = der_encode(&asn_DEF_AKIpUptaneMes, &tx->msg_, Asn1StringAppendCallback, &out);
+  if (res.encoded == -1) {
+    LOG_ERROR << "Failed to encode a message: " << tx->toStr();
+    return false;
+  }
+  return Asn1SocketWriteCallback(out.data(), out.size(), &con_fd) == 0;
+}
+
+Asn1Message::Ptr Asn1Receive(int con_fd, DequeueBuffer& buffer) {
   AKIpUptaneMes_t* m = nullptr;
   asn_dec_rval_t res;
   asn_codec_ctx_s context{};
-  DequeueBuffer buffer;
-  ssize_t received;
+  // Decode what is already buffered before reading more: a previous recv() may
+  // have returned this message as well as the one before it.
+  auto received = static_cast<ssize_t>(buffer.Size());
+  bool need_data = (received == 0);
   do {
     res.code = RC_FAIL;
-    received = recv(con_fd, buffer.Tail(), buffer.TailSpace(), 0);
-    if (received < 0) {
-      LOG_ERROR << "Failed to read data from a connection socket: " << strerror(errno);
-      break;
+    if (need_data) {
+      received = recv(con_fd, buffer.Tail(), buffer.TailSpace(), 0);
+      if (received < 0) {
+        LOG_ERROR << "Failed to read data from a connection socket: " << strerror(errno);
+        break;
+      }
+      LOG_TRACE << "Asn1Rpc read " << Utils::toBase64(std::string(buffer.Tail(), static_cast<size_t>(received)));
+      buffer.HaveEnqueued(static_cast<size_t>(received));
     }
-    LOG_TRACE << "Asn1Rpc read " << Utils::toBase64(std::string(buffer.Tail(), static_cast<size_t>(received)));
-    buffer.HaveEnqueued(static_cast<size_t>(received));
     res = ber_decode(&context, &asn_DEF_AKIpUptaneMes, reinterpret_cast<void**>(&m), buffer.Head(), buffer.Size());
     buffer.Consume(res.consumed);
+    need_data = true;
   } while (res.code == RC_WMORE && received > 0);
   // Note that ber_decode allocates *m even on failure, so this must always be done
   Asn1Message::Ptr msg = Asn1Message::FromRaw(&m);
@@ -89,6 +103,16 @@ Asn1Message::Ptr Asn1Rpc(const Asn1Message::Ptr& tx, int con_fd) {
   return msg;
 }
 
+Asn1Message::Ptr Asn1Rpc(const Asn1Message::Ptr& tx, int con_fd) {
+  Asn1SetNoDelay(con_fd);
+  if (!Asn1Send(tx, con_fd)) {
+    LOG_ERROR << "Failed to send a message to the Secondary";
+    return Asn1Message::Empty();
+  }
+  DequeueBuffer buffer;
+  return Asn1Receive(con_fd, buffer);
+}
+
 Asn1Message::Ptr Asn1Rpc(const Asn1Message::Ptr& tx, const std::pair<std::string, uint16_t>& addr) {
   ConnectionSocket connection(addr.first, addr.second);
 
@@ -99,3 +123,66 @@ Asn1Message::Ptr Asn1Rpc(const Asn1Message::Ptr& tx, const std::pair<std::string
   }
   return Asn1Rpc(tx, *connection);
 }
+
+Asn1Session::Asn1Session(std::pair<std::string, uint16_t> addr, std::chrono::milliseconds idle_timeout)
+    : addr_{std::move(addr)}, idle_timeout_{idle_timeout} {}
+
+Asn1Session::~Asn1Session() = default;
+
+Asn1Message::Ptr Asn1Session::Rpc(const Asn1Message::Ptr& tx) {
+  Asn1Message::Ptr resp = Asn1Message::Empty();
+  Exchange([&tx, &resp](int con_fd, DequeueBuffer& buffer) {
+    if (!Asn1Send(tx, con_fd)) {
+      return false;
+    }
+    resp = Asn1Receive(con_fd, buffer);
+    return resp->present() != AKIpUptaneMes_PR_NOTHING;
+  });
+  return resp;
+}
+
+bool Asn1Session::Exchange(const std::function<bool(int con_fd, DequeueBuffer& buffer)>& fn) {
+  std::lock_guard<std::mutex> guard(mutex_);
+
+  if (connection_ != nullptr) {
+    // Reconnect rather than reuse a connection that the Secondary may have
+    // dropped in the meantime, e.g. because it timed out or rebooted.
+    const bool idle = std::chrono::steady_clock::now() - last_used_ > idle_timeout_;
+    if (idle || PeerClosed(**connection_)) {
+      LOG_DEBUG << "Reopening the connection to " << addr_.first << ":" << addr_.second;
+      connection_.reset();
+    }
+  }
+
+  if (connection_ == nullptr) {
+    connection_ = std_::make_unique<ConnectionSocket>(addr_.first, addr_.second);
+    if (connection_->connect() < 0) {
+      LOG_ERROR << "Failed to connect to the Secondary ( " << addr_.first << ":" << addr_.second
+                << "): " << std::strerror(errno);
+      connection_.reset();
+      return false;
+    }
+    Asn1SetNoDelay(**connection_);
+    buffer_ = DequeueBuffer();
+  }
+
+  const bool ok = fn(**connection_, buffer_);
+  last_used_ = std::chrono::steady_clock::now();
+  // After a failure the position in the message stream is unknown, so the
+  // connection can not be used any more.
+  if (!ok || idle_timeout_.count() == 0) {
+    connection_.reset();
+  }
+  return ok;
+}
+
+void Asn1Session::Close() {
+  std::lock_guard<std::mutex> guard(mutex_);
+  connection_.reset();
+}
+
+bool Asn1Session::PeerClosed(int con_fd) {
+  char c;
+  ssize_t res = recv(con_fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  return res == 0 || (res < 0 && errno != EAGAIN && errno != EWOULDBLOCK);
+}
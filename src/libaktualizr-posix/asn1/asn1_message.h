@@ -1,11 +1,20 @@
 #ifndef ASN1_MESSAGE_H_
 #define ASN1_MESSAGE_H_
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
 #include <boost/intrusive_ptr.hpp>
 
 #include "AKIpUptaneMes.h"
 #include "AKTlsConfig.h"
+#include "utilities/dequeue_buffer.h"
 
 class Asn1Message;
+class ConnectionSocket;
 
 template <typename T>
 class Asn1Sub {
@@ -99,6 +108,9 @@ class Asn1Message {
   ASN1_MESSAGE_DEFINE_ACCESSOR(AKPutRootReqMes_t, putRootReq);
   ASN1_MESSAGE_DEFINE_ACCESSOR(AKPutRootRespMes_t, putRootResp);
 
+  ASN1_MESSAGE_DEFINE_ACCESSOR(AKUploadStreamReqMes_t, uploadStreamReq);
+  ASN1_MESSAGE_DEFINE_ACCESSOR(AKUploadStreamRespMes_t, uploadStreamResp);
+
 #define ASN1_MESSAGE_DEFINE_STR_NAME(MessageID) \
   case MessageID:                               \
     return #MessageID;
@@ -132,6 +144,9 @@ class Asn1Message {
         ASN1_MESSAGE_DEFINE_STR_NAME(AKIpUptaneMes_PR_rootVerResp);
         ASN1_MESSAGE_DEFINE_STR_NAME(AKIpUptaneMes_PR_putRootReq);
         ASN1_MESSAGE_DEFINE_STR_NAME(AKIpUptaneMes_PR_putRootResp);
+
+        ASN1_MESSAGE_DEFINE_STR_NAME(AKIpUptaneMes_PR_uploadStreamReq);
+        ASN1_MESSAGE_DEFINE_STR_NAME(AKIpUptaneMes_PR_uploadStreamResp);
     }
     return "Unknown";
   };
@@ -176,6 +191,26 @@ std::string ToString(const OCTET_STRING_t& octet_str);
 
 void SetString(OCTET_STRING_t* dest, const std::string& str);
 
+/**
+ * Disable Nagle's algorithm on a connection. Asn1Send() writes each message in
+ * one go, so there is nothing to gain from delaying the last segment.
+ */
+void Asn1SetNoDelay(int con_fd);
+
+/**
+ * Send a message over an open connection without waiting for a response.
+ * Returns false if the message could not be written.
+ */
+bool Asn1Send(const Asn1Message::Ptr& tx, int con_fd);
+
+/**
+ * Read one message from an open connection. Data received beyond the end of
+ * the message is kept in buffer and used by the next call, so the same buffer
+ * must be passed for all the messages read from a connection.
+ * Returns a message with present() == AKIpUptaneMes_PR_NOTHING on failure.
+ */
+Asn1Message::Ptr Asn1Receive(int con_fd, DequeueBuffer& buffer);
+
 /**
  * Open a TCP connection to client; send a message and wait for a
  * response.
@@ -183,6 +218,53 @@ void SetString(OCTET_STRING_t* dest, const std::string& str);
 Asn1Message::Ptr Asn1Rpc(const Asn1Message::Ptr& tx, int con_fd);
 Asn1Message::Ptr Asn1Rpc(const Asn1Message::Ptr& tx, const std::pair<std::string, uint16_t>& addr);
 
+/**
+ * A connection to a Secondary that is kept open between requests. It is
+ * opened on first use. A request that comes after the connection has been
+ * idle for idle_timeout, or after the Secondary has closed it, opens a new
+ * one. An idle_timeout of zero uses a new connection for every request, like
+ * Asn1Rpc() does.
+ *
+ * Requests are serialized, so a session may be shared between threads.
+ */
+class Asn1Session {
+ public:
+  static constexpr std::chrono::milliseconds kDefaultIdleTimeout{10000};
+
+  explicit Asn1Session(std::pair<std::string, uint16_t> addr,
+                       std::chrono::milliseconds idle_timeout = kDefaultIdleTimeout);
+  ~Asn1Session();
+  Asn1Session(const Asn1Session&) = delete;
+  Asn1Session(Asn1Session&&) = delete;
+  Asn1Session& operator=(const Asn1Session&) = delete;
+  Asn1Session& operator=(Asn1Session&&) = delete;
+
+  /**
+   * Send a message and wait for the response.
+   */
+  Asn1Message::Ptr Rpc(const Asn1Message::Ptr& tx);
+
+  /**
+   * Run fn with exclusive use of the connection, for exchanges that are not a
+   * single request and response. fn must return false if the connection is
+   * left in an unknown state. Returns false if that happened or no connection
+   * could be made.
+   */
+  bool Exchange(const std::function<bool(int con_fd, DequeueBuffer& buffer)>& fn);
+
+  void Close();
+
+ private:
+  static bool PeerClosed(int con_fd);
+
+  const std::pair<std::string, uint16_t> addr_;
+  const std::chrono::milliseconds idle_timeout_;
+  std::mutex mutex_;
+  std::unique_ptr<ConnectionSocket> connection_;
+  DequeueBuffer buffer_;
+  std::chrono::steady_clock::time_point last_used_;
+};
+
 /*
  * Helper function for creating pointers to ASN.1 types. Note that the encoder
  * will free these objects for you.
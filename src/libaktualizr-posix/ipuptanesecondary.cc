@@ -3,22 +3,47 @@
 #include <arpa/inet.h>
 #include <netinet/tcp.h>
 
+#include <algorithm>
 #include <array>
+#include <cstring>
 #include <fstream>
 #include <memory>
+#include <vector>
 
 #include "asn1/asn1_message.h"
 #include "der_encoder.h"
 #include "libaktualizr/secondary_provider.h"
 #include "logging/logging.h"
 #include "uptane/tuf.h"
+#include "utilities/dequeue_buffer.h"
 #include "utilities/flow_control.h"
 #include "utilities/utils.h"
 
+static data::InstallationResult uploadDataResult(const Uptane::EcuSerial& serial, const Asn1Message::Ptr& resp) {
+  if (resp->present() == AKIpUptaneMes_PR_NOTHING) {
+    LOG_ERROR << "Secondary " << serial << " failed to respond to a request to receive firmware data.";
+    return data::InstallationResult(
+        data::ResultCode::Numeric::kUnknown,
+        "Secondary " + serial.ToString() + " failed to respond to a request to receive firmware data.");
+  }
+  if (resp->present() != AKIpUptaneMes_PR_uploadDataResp) {
+    LOG_ERROR << "Secondary " << serial << " returned an invalid response to a request to receive firmware data.";
+    return data::InstallationResult(
+        data::ResultCode::Numeric::kInternalError,
+        "Secondary " + serial.ToString() + " returned an invalid reponse to a request to receive firmware data.");
+  }
+
+  auto r = resp->uploadDataResp();
+  return data::InstallationResult(static_cast<data::ResultCode::Numeric>(r->result), ToString(r->description));
+}
+
 namespace Uptane {
 
+const std::chrono::milliseconds IpUptaneSecondary::kDefaultIdleTimeout{Asn1Session::kDefaultIdleTimeout};
+
 SecondaryInterface::Ptr IpUptaneSecondary::connectAndCreate(const std::string& address, unsigned short port,
-                                                            VerificationType verification_type) {
+                                                            VerificationType verification_type,
+                                                            std::chrono::milliseconds idle_timeout) {
   LOG_INFO << "Connecting to and getting info about IP Secondary: " << address << ":" << port << "...";
 
   ConnectionSocket con_sock{address, port};
@@ -31,11 +56,12 @@ SecondaryInterface::Ptr IpUptaneSecondary::connectAndCreate(const std::string& a
     return nullptr;
   }
 
-  return create(address, port, verification_type, *con_sock);
+  return create(address, port, verification_type, *con_sock, idle_timeout);
 }
 
 SecondaryInterface::Ptr IpUptaneSecondary::create(const std::string& address, unsigned short port,
-                                                  VerificationType verification_type, int con_fd) {
+                                                  VerificationType verification_type, int con_fd,
+                                                  std::chrono::milliseconds idle_timeout) {
   Asn1Message::Ptr req(Asn1Message::Empty());
   req->present(AKIpUptaneMes_PR_getInfoReq);
 
@@ -45,7 +71,8 @@ SecondaryInterface::Ptr IpUptaneSecondary::create(const std::string& address, un
   if (resp->present() != AKIpUptaneMes_PR_getInfoResp) {
     LOG_ERROR << "IP Secondary failed to respond to information request at " << address << ":" << port;
     return std::make_shared<IpUptaneSecondary>(address, port, verification_type, EcuSerial::Unknown(),
-                                               HardwareIdentifier::Unknown(), PublicKey("", KeyType::kUnknown));
+                                               HardwareIdentifier::Unknown(), PublicKey("", KeyType::kUnknown),
+                                               idle_timeout);
   }
   auto r = resp->getInfoResp();
 
@@ -58,17 +85,18 @@ SecondaryInterface::Ptr IpUptaneSecondary::create(const std::string& address, un
   LOG_INFO << "Got ECU information from IP Secondary: "
            << "hardware ID: " << hw_id << " serial: " << serial;
 
-  return std::make_shared<IpUptaneSecondary>(address, port, verification_type, serial, hw_id, pub_key);
+  return std::make_shared<IpUptaneSecondary>(address, port, verification_type, serial, hw_id, pub_key, idle_timeout);
 }
 
 SecondaryInterface::Ptr IpUptaneSecondary::connectAndCheck(const std::string& address, unsigned short port,
                                                            VerificationType verification_type, EcuSerial serial,
-                                                           HardwareIdentifier hw_id, PublicKey pub_key) {
+                                                           HardwareIdentifier hw_id, PublicKey pub_key,
+                                                           std::chrono::milliseconds idle_timeout) {
   // try to connect:
   // - if it succeeds compare with what we expect
   // - otherwise, keep using what we know
   try {
-    auto sec = IpUptaneSecondary::connectAndCreate(address, port, verification_type);
+    auto sec = IpUptaneSecondary::connectAndCreate(address, port, verification_type, idle_timeout);
     if (sec != nullptr) {
       auto s = sec->getSerial();
       if (s != serial && serial != EcuSerial::Unknown()) {
@@ -96,17 +124,20 @@ SecondaryInterface::Ptr IpUptaneSecondary::connectAndCheck(const std::string& ad
   }
 
   return std::make_shared<IpUptaneSecondary>(address, port, verification_type, std::move(serial), std::move(hw_id),
-                                             std::move(pub_key));
+                                             std::move(pub_key), idle_timeout);
 }
 
 IpUptaneSecondary::IpUptaneSecondary(const std::string& address, unsigned short port,
                                      VerificationType verification_type, EcuSerial serial, HardwareIdentifier hw_id,
-                                     PublicKey pub_key)
+                                     PublicKey pub_key, std::chrono::milliseconds idle_timeout)
     : addr_{address, port},
       verification_type_{verification_type},
       serial_{std::move(serial)},
       hw_id_{std::move(hw_id)},
-      pub_key_{std::move(pub_key)} {}
+      pub_key_{std::move(pub_key)},
+      session_{std_::make_unique<Asn1Session>(addr_, idle_timeout)} {}
+
+IpUptaneSecondary::~IpUptaneSecondary() = default;
 
 /* Determine the best protocol version to use for this Secondary. This did not
  * exist for v1 and thus only works for v2 and beyond. It would be great if we
@@ -115,12 +146,12 @@ IpUptaneSecondary::IpUptaneSecondary(const std::string& address, unsigned short
  * installation. */
 void IpUptaneSecondary::getSecondaryVersion() const {
   LOG_DEBUG << "Negotiating the protocol version with Secondary " << getSerial();
-  const uint32_t latest_version = 2;
+  const uint32_t latest_version = 3;
   Asn1Message::Ptr req(Asn1Message::Empty());
   req->present(AKIpUptaneMes_PR_versionReq);
   auto m = req->versionReq();
   m->version = latest_version;
-  auto resp = Asn1Rpc(req, getAddr());
+  auto resp = session_->Rpc(req);
 
   if (resp->present() != AKIpUptaneMes_PR_versionResp) {
     // Bad response probably means v1, but make sure the Secondary is actually
@@ -164,7 +195,7 @@ data::InstallationResult IpUptaneSecondary::putMetadata(const Target& target) {
 
   LOG_INFO << "Sending Uptane metadata to the Secondary";
   data::InstallationResult put_result;
-  if (protocol_version == 2) {
+  if (protocol_version >= 2) {
     put_result = putMetadata_v2(meta_bundle);
   } else if (protocol_version == 1) {
     put_result = putMetadata_v1(meta_bundle);
@@ -207,7 +238,7 @@ data::InstallationResult IpUptaneSecondary::putMetadata_v1(const Uptane::MetaBun
   SetString(&m->image.choice.json.targets,
             getMetaFromBundle(meta_bundle, Uptane::RepositoryType::Image(), Uptane::Role::Targets()));
 
-  auto resp = Asn1Rpc(req, getAddr());
+  auto resp = session_->Rpc(req);
 
   if (resp->present() != AKIpUptaneMes_PR_putMetaResp) {
     LOG_ERROR << "Secondary " << getSerial() << " failed to respond to a request to receive metadata.";
@@ -256,7 +287,7 @@ data::InstallationResult IpUptaneSecondary::putMetadata_v2(const Uptane::MetaBun
   // NOLINTNEXTLINE(cppcoreguidelines-pro-type-union-access)
   addMetadata(meta_bundle, Uptane::RepositoryType::Image(), Uptane::Role::Targets(), m->imageRepo.choice.collection);
 
-  auto resp = Asn1Rpc(req, getAddr());
+  auto resp = session_->Rpc(req);
 
   if (resp->present() != AKIpUptaneMes_PR_putMetaResp2) {
     LOG_ERROR << "Secondary " << getSerial() << " failed to respond to a request to receive metadata.";
@@ -283,7 +314,7 @@ int32_t IpUptaneSecondary::getRootVersion(bool director) const {
     m->repotype = AKRepoType_image;
   }
 
-  auto resp = Asn1Rpc(req, getAddr());
+  auto resp = session_->Rpc(req);
   if (resp->present() != AKIpUptaneMes_PR_rootVerResp) {
     // v1 (and v2 until this was added) Secondaries won't understand this.
     // Return 0 to indicate that this is unsupported. Sending intermediate Roots
@@ -313,7 +344,7 @@ data::InstallationResult IpUptaneSecondary::putRoot(const std::string& root, boo
   }
   SetString(&m->json, root);
 
-  auto resp = Asn1Rpc(req, getAddr());
+  auto resp = session_->Rpc(req);
   if (resp->present() != AKIpUptaneMes_PR_putRootResp) {
     LOG_ERROR << "Secondary " << getSerial() << " failed to respond to a request to receive Root metadata.";
     return data::InstallationResult(
@@ -332,7 +363,7 @@ Manifest IpUptaneSecondary::getManifest() const {
   Asn1Message::Ptr req(Asn1Message::Empty());
 
   req->present(AKIpUptaneMes_PR_manifestReq);
-  auto resp = Asn1Rpc(req, getAddr());
+  auto resp = session_->Rpc(req);
 
   if (resp->present() != AKIpUptaneMes_PR_manifestResp) {
     LOG_ERROR << "Secondary " << getSerial() << " failed to respond to a manifest request.";
@@ -354,7 +385,7 @@ bool IpUptaneSecondary::ping() const {
 
   auto m = req->getInfoReq();
 
-  auto resp = Asn1Rpc(req, getAddr());
+  auto resp = session_->Rpc(req);
 
   return resp->present() == AKIpUptaneMes_PR_getInfoResp;
 }
@@ -367,7 +398,7 @@ data::InstallationResult IpUptaneSecondary::sendFirmware(const Uptane::Target& t
     return data::InstallationResult(data::ResultCode::Numeric::kOperationCancelled, "");
   }
 
-  if (protocol_version == 2) {
+  if (protocol_version >= 2) {
     return sendFirmware_v2(target);
   }
   if (protocol_version == 1) {
@@ -386,8 +417,8 @@ data::InstallationResult IpUptaneSecondary::sendFirmware_v1(const Uptane::Target
     data_to_send = secondary_provider_->getTreehubCredentials();
   } else {
     std::stringstream sstr;
-    auto str = secondary_provider_->getTargetFileHandle(target);
-    sstr << str.rdbuf();
+    auto str = secondary_provider_->openTargetFile(target, getSerial());
+    sstr << str->rdbuf();
     data_to_send = sstr.str();
   }
 
@@ -397,7 +428,7 @@ data::InstallationResult IpUptaneSecondary::sendFirmware_v1(const Uptane::Target
 
   auto m = req->sendFirmwareReq();
   SetString(&m->firmware, data_to_send);
-  auto resp = Asn1Rpc(req, getAddr());
+  auto resp = session_->Rpc(req);
 
   if (resp->present() != AKIpUptaneMes_PR_sendFirmwareResp) {
     LOG_ERROR << "Secondary " << getSerial() << " failed to respond to a request to receive firmware.";
@@ -431,7 +462,7 @@ data::InstallationResult IpUptaneSecondary::install(const Uptane::Target& target
   }
 
   data::InstallationResult install_result;
-  if (protocol_version == 2) {
+  if (protocol_version >= 2) {
     install_result = install_v2(target);
   } else if (protocol_version == 1) {
     install_result = install_v1(target);
@@ -454,7 +485,7 @@ data::InstallationResult IpUptaneSecondary::install_v1(const Uptane::Target& tar
   auto req_mes = req->installReq();
   SetString(&req_mes->hash, target.filename());
   // send request and receive response, a request-response type of RPC
-  auto resp = Asn1Rpc(req, getAddr());
+  auto resp = session_->Rpc(req);
 
   // invalid type of an response message
   if (resp->present() != AKIpUptaneMes_PR_installResp) {
@@ -483,7 +514,7 @@ data::InstallationResult IpUptaneSecondary::downloadOstreeRev(const Uptane::Targ
 
   auto m = req->downloadOstreeRevReq();
   SetString(&m->tlsCred, tls_creds);
-  auto resp = Asn1Rpc(req, getAddr());
+  auto resp = session_->Rpc(req);
 
   if (resp->present() != AKIpUptaneMes_PR_downloadOstreeRevResp) {
     LOG_ERROR << "Secondary " << getSerial() << " failed to respond to a request to download an OSTree commit.";
@@ -500,9 +531,13 @@ data::InstallationResult IpUptaneSecondary::uploadFirmware(const Uptane::Target&
   LOG_INFO << "Uploading the target image (" << target.filename() << ") "
            << "to the Secondary (" << getSerial() << ")";
 
+  if (protocol_version >= 3) {
+    return uploadFirmwareStream(target);
+  }
+
   auto upload_result = data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed, "");
 
-  auto image_reader = secondary_provider_->getTargetFileHandle(target);
+  auto image_reader = secondary_provider_->openTargetFile(target, getSerial());
 
   uint64_t image_size = target.length();
   const size_t size = 1024;
@@ -511,9 +546,9 @@ data::InstallationResult IpUptaneSecondary::uploadFirmware(const Uptane::Target&
   auto upload_data_result = data::InstallationResult(data::ResultCode::Numeric::kOk, "");
 
   while (total_send_data < image_size && upload_data_result.isSuccess()) {
-    image_reader.read(reinterpret_cast<char*>(buf.data()), buf.size());
-    upload_data_result = uploadFirmwareData(buf.data(), static_cast<size_t>(image_reader.gcount()));
-    total_send_data += static_cast<size_t>(image_reader.gcount());
+    image_reader->read(reinterpret_cast<char*>(buf.data()), buf.size());
+    upload_data_result = uploadFirmwareData(buf.data(), static_cast<size_t>(image_reader->gcount()));
+    total_send_data += static_cast<size_t>(image_reader->gcount());
   }
   if (upload_data_result.isSuccess() && total_send_data == image_size) {
     upload_result = data::InstallationResult(data::ResultCode::Numeric::kOk, "");
@@ -522,7 +557,96 @@ data::InstallationResult IpUptaneSecondary::uploadFirmware(const Uptane::Target&
   } else {
     upload_result = data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed, "Incomplete upload");
   }
-  image_reader.close();
+  image_reader.reset();
+  return upload_result;
+}
+
+/* Protocol v3: send the whole image over a single connection. The chunk size
+ * and the number of uploadDataReq messages that may be sent before their
+ * responses are read are agreed on with the Secondary first. */
+data::InstallationResult IpUptaneSecondary::uploadFirmwareStream(const Uptane::Target& target) {
+  auto upload_result = data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed,
+                                                "Failed to connect to Secondary " + getSerial().ToString());
+  session_->Exchange([this, &target, &upload_result](int con_fd, DequeueBuffer& buffer) {
+    Asn1Message::Ptr req(Asn1Message::Empty());
+    req->present(AKIpUptaneMes_PR_uploadStreamReq);
+    auto m = req->uploadStreamReq();
+    m->chunkSize = kStreamChunkSize;
+    m->window = kStreamWindow;
+    Asn1Message::Ptr resp = Asn1Send(req, con_fd) ? Asn1Receive(con_fd, buffer) : Asn1Message::Empty();
+
+    if (resp->present() != AKIpUptaneMes_PR_uploadStreamResp) {
+      LOG_ERROR << "Secondary " << getSerial() << " failed to respond to a request to stream firmware.";
+      upload_result = data::InstallationResult(
+          data::ResultCode::Numeric::kDownloadFailed,
+          "Secondary " + getSerial().ToString() + " failed to respond to a request to stream firmware.");
+      return false;
+    }
+    auto r = resp->uploadStreamResp();
+    if (r->result != static_cast<AKInstallationResultCode_t>(data::ResultCode::Numeric::kOk)) {
+      upload_result = data::InstallationResult(static_cast<data::ResultCode::Numeric>(r->result),
+                                               "Secondary " + getSerial().ToString() + " refused to stream firmware.");
+      return true;
+    }
+    const auto chunk_size = static_cast<size_t>(std::max<long>(1, std::min<long>(r->chunkSize, kStreamChunkSize)));
+    const auto window = static_cast<size_t>(std::max<long>(1, std::min<long>(r->window, kStreamWindow)));
+    LOG_DEBUG << "Streaming firmware to Secondary " << getSerial() << " in chunks of " << chunk_size
+              << " bytes, window of " << window;
+
+    auto image_reader = secondary_provider_->openTargetFile(target, getSerial());
+    const uint64_t image_size = target.length();
+    uint64_t total_send_data = 0;
+    size_t in_flight = 0;
+    bool connection_ok = true;
+    std::vector<uint8_t> buf(chunk_size);
+    upload_result = data::InstallationResult(data::ResultCode::Numeric::kOk, "");
+
+    auto receive_result = [&]() {
+      Asn1Message::Ptr data_resp = Asn1Receive(con_fd, buffer);
+      connection_ok = connection_ok && data_resp->present() != AKIpUptaneMes_PR_NOTHING;
+      --in_flight;
+      return uploadDataResult(getSerial(), data_resp);
+    };
+
+    while (total_send_data < image_size && upload_result.isSuccess()) {
+      image_reader->read(reinterpret_cast<char*>(buf.data()), static_cast<std::streamsize>(buf.size()));
+      const auto read_size = static_cast<size_t>(image_reader->gcount());
+      if (read_size == 0) {
+        break;
+      }
+
+      Asn1Message::Ptr data_req(Asn1Message::Empty());
+      data_req->present(AKIpUptaneMes_PR_uploadDataReq);
+      OCTET_STRING_fromBuf(&data_req->uploadDataReq()->data, reinterpret_cast<const char*>(buf.data()),
+                           static_cast<int>(read_size));
+      if (!Asn1Send(data_req, con_fd)) {
+        upload_result = data::InstallationResult(
+            data::ResultCode::Numeric::kDownloadFailed,
+            "Failed to send firmware data to Secondary " + getSerial().ToString() + ": " + std::strerror(errno));
+        connection_ok = false;
+        break;
+      }
+      total_send_data += read_size;
+      ++in_flight;
+
+      if (in_flight >= window) {
+        upload_result = receive_result();
+      }
+    }
+    // Collect the outstanding responses, keeping the first error.
+    while (in_flight > 0 && connection_ok) {
+      auto result = receive_result();
+      if (upload_result.isSuccess()) {
+        upload_result = result;
+      }
+    }
+    image_reader.reset();
+
+    if (upload_result.isSuccess() && total_send_data != image_size) {
+      upload_result = data::InstallationResult(data::ResultCode::Numeric::kDownloadFailed, "Incomplete upload");
+    }
+    return connection_ok;
+  });
   return upload_result;
 }
 
@@ -532,25 +656,10 @@ data::InstallationResult IpUptaneSecondary::uploadFirmwareData(const uint8_t* da
 
   auto m = req->uploadDataReq();
   OCTET_STRING_fromBuf(&m->data, reinterpret_cast<const char*>(data), static_cast<int>(size));
-  auto resp = Asn1Rpc(req, getAddr());
-
-  if (resp->present() == AKIpUptaneMes_PR_NOTHING) {
-    LOG_ERROR << "Secondary " << getSerial() << " failed to respond to a request to receive firmware data.";
-    return data::InstallationResult(
-        data::ResultCode::Numeric::kUnknown,
-        "Secondary " + getSerial().ToString() + " failed to respond to a request to receive firmware data.");
-  }
-  if (resp->present() != AKIpUptaneMes_PR_uploadDataResp) {
-    LOG_ERROR << "Secondary " << getSerial() << " returned an invalid response to a request to receive firmware data.";
-    return data::InstallationResult(
-        data::ResultCode::Numeric::kInternalError,
-        "Secondary " + getSerial().ToString() + " returned an invalid reponse to a request to receive firmware data.");
-  }
-
-  auto r = resp->uploadDataResp();
-  return data::InstallationResult(static_cast<data::ResultCode::Numeric>(r->result), ToString(r->description));
+  return uploadDataResult(getSerial(), session_->Rpc(req));
 }
 
+
 data::InstallationResult IpUptaneSecondary::invokeInstallOnSecondary(const Uptane::Target& target) {
   Asn1Message::Ptr req(Asn1Message::Empty());
   req->present(AKIpUptaneMes_PR_installReq);
@@ -559,7 +668,7 @@ data::InstallationResult IpUptaneSecondary::invokeInstallOnSecondary(const Uptan
   auto req_mes = req->installReq();
   SetString(&req_mes->hash, target.filename());
   // send request and receive response, a request-response type of RPC
-  auto resp = Asn1Rpc(req, getAddr());
+  auto resp = session_->Rpc(req);
 
   // invalid type of an response message
   if (resp->present() != AKIpUptaneMes_PR_installResp2) {
@@ -1,27 +1,43 @@
 #ifndef UPTANE_IPUPTANESECONDARY_H_
 #define UPTANE_IPUPTANESECONDARY_H_
 
+#include <chrono>
+#include <memory>
+
 #include "libaktualizr/secondaryinterface.h"
 #include "libaktualizr/types.h"
 
 struct AKMetaCollection;
 using AKMetaCollection_t = struct AKMetaCollection;
+class Asn1Session;
 
 namespace Uptane {
 
 class IpUptaneSecondary : public SecondaryInterface {
  public:
+  // How long the connection to the Secondary is reused after a request, see Asn1Session.
+  static const std::chrono::milliseconds kDefaultIdleTimeout;
+
   static SecondaryInterface::Ptr connectAndCreate(const std::string& address, unsigned short port,
-                                                  VerificationType verification_type);
+                                                  VerificationType verification_type,
+                                                  std::chrono::milliseconds idle_timeout = kDefaultIdleTimeout);
   static SecondaryInterface::Ptr create(const std::string& address, unsigned short port,
-                                        VerificationType verification_type, int con_fd);
+                                        VerificationType verification_type, int con_fd,
+                                        std::chrono::milliseconds idle_timeout = kDefaultIdleTimeout);
 
   static SecondaryInterface::Ptr connectAndCheck(const std::string& address, unsigned short port,
                                                  VerificationType verification_type, EcuSerial serial,
-                                                 HardwareIdentifier hw_id, PublicKey pub_key);
+                                                 HardwareIdentifier hw_id, PublicKey pub_key,
+                                                 std::chrono::milliseconds idle_timeout = kDefaultIdleTimeout);
 
   explicit IpUptaneSecondary(const std::string& address, unsigned short port, VerificationType verification_type,
-                             EcuSerial serial, HardwareIdentifier hw_id, PublicKey pub_key);
+                             EcuSerial serial, HardwareIdentifier hw_id, PublicKey pub_key,
+                             std::chrono::milliseconds idle_timeout = kDefaultIdleTimeout);
+  ~IpUptaneSecondary() override;
+  IpUptaneSecondary(const IpUptaneSecondary&) = delete;
+  IpUptaneSecondary(IpUptaneSecondary&&) = delete;
+  IpUptaneSecondary& operator=(const IpUptaneSecondary&) = delete;
+  IpUptaneSecondary& operator=(IpUptaneSecondary&&) = delete;
 
   std::string Type() const override { return "IP"; }
   EcuSerial getSerial() const override { return serial_; };
@@ -54,14 +70,22 @@ class IpUptaneSecondary : public SecondaryInterface {
   data::InstallationResult invokeInstallOnSecondary(const Uptane::Target& target);
   data::InstallationResult downloadOstreeRev(const Uptane::Target& target);
   data::InstallationResult uploadFirmware(const Uptane::Target& target);
+  data::InstallationResult uploadFirmwareStream(const Uptane::Target& target);
   data::InstallationResult uploadFirmwareData(const uint8_t* data, size_t size);
 
+  // Largest chunk size and number of unacknowledged chunks proposed to v3
+  // Secondaries for streamed firmware uploads.
+  static constexpr long kStreamChunkSize = 256L * 1024;  // NOLINT(google-runtime-int)
+  static constexpr long kStreamWindow = 8;               // NOLINT(google-runtime-int)
+
   std::shared_ptr<SecondaryProvider> secondary_provider_;
   const std::pair<std::string, uint16_t> addr_;
   const VerificationType verification_type_;
   const EcuSerial serial_;
   const HardwareIdentifier hw_id_;
   const PublicKey pub_key_;
+  // All requests to the Secondary share one connection while it is in use.
+  const std::unique_ptr<Asn1Session> session_;
   mutable uint32_t protocol_version{0};
 };
 
@@ -87,6 +87,10 @@ void ProvisionConfig::writeToStream(std::ostream& out_stream) const {
 
 void UptaneConfig::updateFromPropertyTree(const boost::property_tree::ptree& pt) {
   CopyFromConfig(polling_sec, "polling_sec", pt);
+  CopyFromConfig(polling_jitter_percent, "polling_jitter_percent", pt);
+  CopyFromConfig(polling_active_sec, "polling_active_sec", pt);
+  CopyFromConfig(polling_idle_max_sec, "polling_idle_max_sec", pt);
+  CopyFromConfig(polling_backoff_max_sec, "polling_backoff_max_sec", pt);
   CopyFromConfig(director_server, "director_server", pt);
   CopyFromConfig(repo_server, "repo_server", pt);
   CopyFromConfig(key_source, "key_source", pt);
@@ -94,10 +98,19 @@ void UptaneConfig::updateFromPropertyTree(const boost::property_tree::ptree& pt)
   CopyFromConfig(force_install_completion, "force_install_completion", pt);
   CopyFromConfig(secondary_config_file, "secondary_config_file", pt);
   CopyFromConfig(secondary_preinstall_wait_sec, "secondary_preinstall_wait_sec", pt);
+  CopyFromConfig(secondary_manifest_timeout_ms, "secondary_manifest_timeout_ms", pt);
+  CopyFromConfig(download_parallelism, "download_parallelism", pt);
+  CopyFromConfig(download_max_tries, "download_max_tries", pt);
+  CopyFromConfig(download_retry_wait_ms, "download_retry_wait_ms", pt);
+  CopyFromConfig(event_queue_size, "event_queue_size", pt);
 }
 
 void UptaneConfig::writeToStream(std::ostream& out_stream) const {
   writeOption(out_stream, polling_sec, "polling_sec");
+  writeOption(out_stream, polling_jitter_percent, "polling_jitter_percent");
+  writeOption(out_stream, polling_active_sec, "polling_active_sec");
+  writeOption(out_stream, polling_idle_max_sec, "polling_idle_max_sec");
+  writeOption(out_stream, polling_backoff_max_sec, "polling_backoff_max_sec");
   writeOption(out_stream, director_server, "director_server");
   writeOption(out_stream, repo_server, "repo_server");
   writeOption(out_stream, key_source, "key_source");
@@ -105,6 +118,11 @@ void UptaneConfig::writeToStream(std::ostream& out_stream) const {
   writeOption(out_stream, force_install_completion, "force_install_completion");
   writeOption(out_stream, secondary_config_file, "secondary_config_file");
   writeOption(out_stream, secondary_preinstall_wait_sec, "secondary_preinstall_wait_sec");
+  writeOption(out_stream, secondary_manifest_timeout_ms, "secondary_manifest_timeout_ms");
+  writeOption(out_stream, download_parallelism, "download_parallelism");
+  writeOption(out_stream, download_max_tries, "download_max_tries");
+  writeOption(out_stream, download_retry_wait_ms, "download_retry_wait_ms");
+  writeOption(out_stream, event_queue_size, "event_queue_size");
 }
 
 /**
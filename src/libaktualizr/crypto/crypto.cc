@@ -1,6 +1,7 @@
 #include "crypto.h"
 
 #include <array>
+#include <cstring>
 #include <iostream>
 #include <random>
 #include <string>
@@ -23,7 +24,9 @@
 #endif
 
 PublicKey::PublicKey(const boost::filesystem::path &path)
-    : value_(Utils::readFile(path)), type_(Crypto::IdentifyRSAKeyType(value_)) {}
+    : value_(Utils::readFile(path)), verifier_(PublicKeyVerifier::fromRSA(value_)) {
+  type_ = verifier_ != nullptr ? verifier_->type() : KeyType::kUnknown;
+}
 
 PublicKey::PublicKey(const Json::Value &uptane_json) {
   std::string keytype;
@@ -57,8 +60,10 @@ PublicKey::PublicKey(const Json::Value &uptane_json) {
   KeyType type;
   if (keytype == "ed25519") {
     type = KeyType::kED25519;
+    verifier_ = PublicKeyVerifier::fromED25519(keyvalue);
   } else if (keytype == "rsa") {
-    type = Crypto::IdentifyRSAKeyType(keyvalue);
+    verifier_ = PublicKeyVerifier::fromRSA(keyvalue);
+    type = verifier_ != nullptr ? verifier_->type() : KeyType::kUnknown;
     if (type == KeyType::kUnknown) {
       LOG_WARNING << "Couldn't identify length of RSA key";
     }
@@ -71,20 +76,26 @@ PublicKey::PublicKey(const Json::Value &uptane_json) {
 
 PublicKey::PublicKey(const std::string &value, KeyType type) : value_(value), type_(type) {
   if (Crypto::IsRsaKeyType(type)) {
-    if (type != Crypto::IdentifyRSAKeyType(value)) {
+    verifier_ = PublicKeyVerifier::fromRSA(value);
+    if (verifier_ == nullptr || type != verifier_->type()) {
       throw std::logic_error("RSA key length is incorrect");
     }
+  } else if (type == KeyType::kED25519) {
+    verifier_ = PublicKeyVerifier::fromED25519(value);
   }
 }
 
 bool PublicKey::VerifySignature(const std::string &signature, const std::string &message) const {
   switch (type_) {
     case KeyType::kED25519:
-      return Crypto::ED25519Verify(boost::algorithm::unhex(value_), Utils::fromBase64(signature), message);
     case KeyType::kRSA2048:
     case KeyType::kRSA3072:
     case KeyType::kRSA4096:
-      return Crypto::RSAPSSVerify(value_, Utils::fromBase64(signature), message);
+      if (verifier_ == nullptr) {
+        LOG_ERROR << "Can't verify a signature with an invalid public key";
+        return false;
+      }
+      return verifier_->verify(Utils::fromBase64(signature), message);
     default:
       return false;
   }
@@ -215,45 +226,92 @@ std::string Crypto::ED25519Sign(const std::string &private_key, const std::strin
 }
 
 bool Crypto::RSAPSSVerify(const std::string &public_key, const std::string &signature, const std::string &message) {
-  StructGuard<RSA> rsa(nullptr, RSA_free);
-  StructGuard<BIO> bio(BIO_new_mem_buf(const_cast<char *>(public_key.c_str()), static_cast<int>(public_key.size())),
-                       BIO_vfree);
-  {
-    RSA *r = nullptr;
-    if (PEM_read_bio_RSA_PUBKEY(bio.get(), &r, nullptr, nullptr) == nullptr) {
-      LOG_ERROR << "PEM_read_bio_RSA_PUBKEY failed with error " << ERR_error_string(ERR_get_error(), nullptr);
-      return false;
-    }
-    rsa.reset(r);
+  auto verifier = PublicKeyVerifier::fromRSA(public_key);
+  if (verifier == nullptr) {
+    LOG_ERROR << "Reading the RSA public key failed with error " << ERR_error_string(ERR_get_error(), nullptr);
+    return false;
   }
+  return verifier->verify(signature, message);
+}
 
+std::shared_ptr<const PublicKeyVerifier> PublicKeyVerifier::fromRSA(const std::string &public_key_pem) {
+  StructGuard<BIO> bufio(BIO_new_mem_buf(reinterpret_cast<const void *>(public_key_pem.c_str()),
+                                         static_cast<int>(public_key_pem.length())),
+                         BIO_vfree);
+  if (bufio.get() == nullptr) {
+    throw std::runtime_error("BIO_new_mem_buf failed");
+  }
+  std::shared_ptr<PublicKeyVerifier> verifier(new PublicKeyVerifier());
+  verifier->rsa_ = StructGuard<RSA>(PEM_read_bio_RSA_PUBKEY(bufio.get(), nullptr, nullptr, nullptr), RSA_free);
+  if (verifier->rsa_ == nullptr) {
+    return nullptr;
+  }
+  // Verify in software even if an engine such as pkcs11 is the default one.
 #if AKTUALIZR_OPENSSL_PRE_11
-  RSA_set_method(rsa.get(), RSA_PKCS1_SSLeay());
+  RSA_set_method(verifier->rsa_.get(), RSA_PKCS1_SSLeay());
 #else
-  RSA_set_method(rsa.get(), RSA_PKCS1_OpenSSL());
+  RSA_set_method(verifier->rsa_.get(), RSA_PKCS1_OpenSSL());
 #endif
 
-  const auto size = static_cast<unsigned int>(RSA_size(rsa.get()));
+  int key_length = RSA_size(verifier->rsa_.get()) * 8;
+  // It is not clear from the OpenSSL documentation if RSA_size returns
+  // exactly 2048 or 4096, or if this can vary. For now we will assume that if
+  // OpenSSL has been asked to generate a 'N bit' key, RSA_size() will return
+  // exactly N
+  switch (key_length) {
+    case 2048:
+      verifier->type_ = KeyType::kRSA2048;
+      break;
+    case 3072:
+      verifier->type_ = KeyType::kRSA3072;
+      break;
+    case 4096:
+      verifier->type_ = KeyType::kRSA4096;
+      break;
+    default:
+      LOG_WARNING << "Weird key length:" << key_length;
+      verifier->type_ = KeyType::kUnknown;
+  }
+  return verifier;
+}
+
+std::shared_ptr<const PublicKeyVerifier> PublicKeyVerifier::fromED25519(const std::string &public_key_hex) {
+  std::shared_ptr<PublicKeyVerifier> verifier(new PublicKeyVerifier());
+  try {
+    verifier->ed25519_key_ = boost::algorithm::unhex(public_key_hex);
+  } catch (const boost::algorithm::hex_decode_error &) {
+    return nullptr;
+  }
+  verifier->type_ = KeyType::kED25519;
+  return verifier;
+}
+
+bool PublicKeyVerifier::verify(const std::string &signature, const std::string &message) const {
+  if (type_ == KeyType::kED25519) {
+    return Crypto::ED25519Verify(ed25519_key_, signature, message);
+  }
+
+  // RSA_public_decrypt() only reads the key, so the key can be shared.
+  const auto size = static_cast<unsigned int>(RSA_size(rsa_.get()));
   boost::scoped_array<unsigned char> pDecrypted(new unsigned char[size]);
   /* now we will verify the signature
     Start by a RAW decrypt of the signature
   */
   int status =
       RSA_public_decrypt(static_cast<int>(signature.size()), reinterpret_cast<const unsigned char *>(signature.c_str()),
-                         pDecrypted.get(), rsa.get(), RSA_NO_PADDING);
+                         pDecrypted.get(), rsa_.get(), RSA_NO_PADDING);
   if (status == -1) {
     LOG_ERROR << "RSA_public_decrypt failed with error " << ERR_error_string(ERR_get_error(), nullptr);
     return false;
   }
 
   std::string digest = Crypto::sha256digest(message);
-
   /* verify the data */
-  status = RSA_verify_PKCS1_PSS(rsa.get(), reinterpret_cast<const unsigned char *>(digest.c_str()), EVP_sha256(),
+  status = RSA_verify_PKCS1_PSS(rsa_.get(), reinterpret_cast<const unsigned char *>(digest.c_str()), EVP_sha256(),
                                 pDecrypted.get(), -2 /* salt length recovered from signature*/);
-
   return status == 1;
 }
+
 bool Crypto::ED25519Verify(const std::string &public_key, const std::string &signature, const std::string &message) {
   if (public_key.size() < crypto_sign_PUBLICKEYBYTES || signature.size() < crypto_sign_BYTES) {
     return false;
@@ -482,34 +540,8 @@ bool Crypto::IsRsaKeyType(KeyType type) {
 }
 
 KeyType Crypto::IdentifyRSAKeyType(const std::string &public_key_pem) {
-  StructGuard<BIO> bufio(BIO_new_mem_buf(reinterpret_cast<const void *>(public_key_pem.c_str()),
-                                         static_cast<int>(public_key_pem.length())),
-                         BIO_vfree);
-  if (bufio.get() == nullptr) {
-    throw std::runtime_error("BIO_new_mem_buf failed");
-  }
-  StructGuard<::RSA> rsa(PEM_read_bio_RSA_PUBKEY(bufio.get(), nullptr, nullptr, nullptr), RSA_free);
-
-  if (rsa.get() == nullptr) {
-    return KeyType::kUnknown;
-  }
-
-  int key_length = RSA_size(rsa.get()) * 8;
-  // It is not clear from the OpenSSL documentation if RSA_size returns
-  // exactly 2048 or 4096, or if this can vary. For now we will assume that if
-  // OpenSSL has been asked to generate a 'N bit' key, RSA_size() will return
-  // exactly N
-  switch (key_length) {
-    case 2048:
-      return KeyType::kRSA2048;
-    case 3072:
-      return KeyType::kRSA3072;
-    case 4096:
-      return KeyType::kRSA4096;
-    default:
-      LOG_WARNING << "Weird key length:" << key_length;
-      return KeyType::kUnknown;
-  }
+  auto verifier = PublicKeyVerifier::fromRSA(public_key_pem);
+  return verifier != nullptr ? verifier->type() : KeyType::kUnknown;
 }
 
 StructGuard<X509> Crypto::generateCert(const int rsa_bits, const int cert_days, const std::string &cert_c,
@@ -709,6 +741,85 @@ std::string MultiPartSHA256Hasher::getHexDigest() {
   return boost::algorithm::hex(std::string(reinterpret_cast<char *>(sha256_hash.data()), crypto_hash_sha256_BYTES));
 }
 
+// Hasher states are stored field by field in big-endian order after a format
+// version and the hash type, so that they do not depend on the struct layout
+// of the libsodium build or the byte order of the machine.
+static constexpr char kHasherStateVersion = 1;
+
+template <typename T>
+static void appendBigEndian(std::string *out, const T value) {
+  for (int shift = 8 * static_cast<int>(sizeof(T) - 1); shift >= 0; shift -= 8) {
+    out->push_back(static_cast<char>((value >> shift) & 0xFFU));
+  }
+}
+
+template <typename T>
+static T readBigEndian(const std::string &in, size_t *pos) {
+  T value = 0;
+  for (size_t ii = 0; ii < sizeof(T); ++ii) {
+    value = static_cast<T>((value << 8U) | static_cast<unsigned char>(in[(*pos)++]));
+  }
+  return value;
+}
+
+static std::string hasherStateHeader(Hash::Type type) {
+  return std::string{kHasherStateVersion, static_cast<char>(type)};
+}
+
+std::string MultiPartSHA512Hasher::saveState() const {
+  std::string out = hasherStateHeader(Hash::Type::kSha512);
+  for (const auto word : state_.state) {
+    appendBigEndian(&out, word);
+  }
+  for (const auto count : state_.count) {
+    appendBigEndian(&out, count);
+  }
+  out.append(reinterpret_cast<const char *>(state_.buf), sizeof(state_.buf));
+  return out;
+}
+
+bool MultiPartSHA512Hasher::restoreState(const std::string &state) {
+  const std::string header = hasherStateHeader(Hash::Type::kSha512);
+  if (state.size() != header.size() + sizeof(state_.state) + sizeof(state_.count) + sizeof(state_.buf) ||
+      state.compare(0, header.size(), header) != 0) {
+    return false;
+  }
+  size_t pos = header.size();
+  for (auto &word : state_.state) {
+    word = readBigEndian<uint64_t>(state, &pos);
+  }
+  for (auto &count : state_.count) {
+    count = readBigEndian<uint64_t>(state, &pos);
+  }
+  std::memcpy(state_.buf, state.data() + pos, sizeof(state_.buf));
+  return true;
+}
+
+std::string MultiPartSHA256Hasher::saveState() const {
+  std::string out = hasherStateHeader(Hash::Type::kSha256);
+  for (const auto word : state_.state) {
+    appendBigEndian(&out, word);
+  }
+  appendBigEndian(&out, state_.count);
+  out.append(reinterpret_cast<const char *>(state_.buf), sizeof(state_.buf));
+  return out;
+}
+
+bool MultiPartSHA256Hasher::restoreState(const std::string &state) {
+  const std::string header = hasherStateHeader(Hash::Type::kSha256);
+  if (state.size() != header.size() + sizeof(state_.state) + sizeof(state_.count) + sizeof(state_.buf) ||
+      state.compare(0, header.size(), header) != 0) {
+    return false;
+  }
+  size_t pos = header.size();
+  for (auto &word : state_.state) {
+    word = readBigEndian<uint32_t>(state, &pos);
+  }
+  state_.count = readBigEndian<uint64_t>(state, &pos);
+  std::memcpy(state_.buf, state.data() + pos, sizeof(state_.buf));
+  return true;
+}
+
 Hash Hash::generate(Type type, const std::string &data) {
   std::string hash;
 
@@ -40,6 +40,11 @@ class MultiPartHasher {
   virtual void reset() = 0;
   virtual std::string getHexDigest() = 0;
   virtual Hash getHash() = 0;
+  // Versioned snapshot of the intermediate state, so that hashing of a long
+  // stream can be resumed later. restoreState() rejects a snapshot of another
+  // hash type or format version.
+  virtual std::string saveState() const = 0;
+  virtual bool restoreState(const std::string &state) = 0;
 };
 
 class MultiPartSHA512Hasher : public MultiPartHasher {
@@ -54,6 +59,8 @@ class MultiPartSHA512Hasher : public MultiPartHasher {
   void reset() override { crypto_hash_sha512_init(&state_); }
   std::string getHexDigest() override;
   Hash getHash() override { return Hash(Hash::Type::kSha512, getHexDigest()); }
+  std::string saveState() const override;
+  bool restoreState(const std::string &state) override;
 
  private:
   crypto_hash_sha512_state state_{};
@@ -72,11 +79,44 @@ class MultiPartSHA256Hasher : public MultiPartHasher {
   std::string getHexDigest() override;
 
   Hash getHash() override { return Hash(Hash::Type::kSha256, getHexDigest()); }
+  std::string saveState() const override;
+  bool restoreState(const std::string &state) override;
 
  private:
   crypto_hash_sha256_state state_{};
 };
 
+/**
+ * A public key parsed once, so that any number of signatures can be verified
+ * without decoding the key again. Can be shared between threads.
+ */
+class PublicKeyVerifier {
+ public:
+  /** Returns nullptr if the PEM does not hold an RSA key. The type is identified from the key length. */
+  static std::shared_ptr<const PublicKeyVerifier> fromRSA(const std::string &public_key_pem);
+  /** Returns nullptr if the key is not valid hex. */
+  static std::shared_ptr<const PublicKeyVerifier> fromED25519(const std::string &public_key_hex);
+
+  ~PublicKeyVerifier() = default;
+  PublicKeyVerifier(const PublicKeyVerifier &) = delete;
+  PublicKeyVerifier(PublicKeyVerifier &&) = delete;
+  PublicKeyVerifier &operator=(const PublicKeyVerifier &) = delete;
+  PublicKeyVerifier &operator=(PublicKeyVerifier &&) = delete;
+
+  KeyType type() const { return type_; }
+  /** Verify a raw, not base64 encoded, signature. */
+  bool verify(const std::string &signature, const std::string &message) const;
+
+ private:
+  PublicKeyVerifier() = default;
+
+  KeyType type_{KeyType::kUnknown};
+  std::string ed25519_key_;
+  // Pinned to the software RSA method. The deleter is set in crypto.cc, the
+  // only file built with the RSA API that OpenSSL 3 deprecates.
+  StructGuard<RSA> rsa_{nullptr, nullptr};
+};
+
 class Crypto {
  public:
   static std::string sha256digest(const std::string &text);
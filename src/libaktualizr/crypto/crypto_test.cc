@@ -39,6 +39,29 @@ TEST(crypto, sha512_is_correct) {
   EXPECT_EQ(expected_result, result);
 }
 
+/* Resume a multi-part hash from a saved state. */
+TEST(crypto, hasher_save_restore_state) {
+  const std::string first = "This is string ";
+  const std::string second = "for testing";
+  for (const auto type : {Hash::Type::kSha256, Hash::Type::kSha512}) {
+    auto hasher = MultiPartHasher::create(type);
+    hasher->update(reinterpret_cast<const unsigned char *>(first.data()), first.size());
+    const std::string state = hasher->saveState();
+
+    auto resumed = MultiPartHasher::create(type);
+    EXPECT_FALSE(resumed->restoreState("garbage"));
+    std::string other_version = state;
+    other_version[0] = static_cast<char>(other_version[0] + 1);
+    EXPECT_FALSE(resumed->restoreState(other_version));
+    ASSERT_TRUE(resumed->restoreState(state));
+    resumed->update(reinterpret_cast<const unsigned char *>(second.data()), second.size());
+    EXPECT_EQ(resumed->getHash(), Hash::generate(type, first + second));
+
+    const auto other_type = type == Hash::Type::kSha256 ? Hash::Type::kSha512 : Hash::Type::kSha256;
+    EXPECT_FALSE(MultiPartHasher::create(other_type)->restoreState(state));
+  }
+}
+
 /* Sign and verify a file with RSA key stored in a file. */
 TEST(crypto, sign_verify_rsa_file) {
   std::string text = "This is text for sign";
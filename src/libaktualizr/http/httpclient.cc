@@ -1,8 +1,15 @@
 #include "httpclient.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <ctime>
 #include <sstream>
 
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/trim.hpp>
+
 #include "utilities/utils.h"
 
 struct WriteStringArg {
@@ -34,6 +41,54 @@ static size_t writeString(void* contents, size_t size, size_t nmemb, void* userp
   return size * nmemb;
 }
 
+struct ResponseHeaders {
+  HttpValidators validators;
+  std::string retry_after;
+};
+
+// Header callback picking the headers of interest out of the response.
+static size_t collectHeaders(char* buffer, size_t size, size_t nitems, void* userp) {
+  auto* headers = static_cast<ResponseHeaders*>(userp);
+  const std::string line(buffer, size * nitems);
+  if (boost::algorithm::starts_with(line, "HTTP/")) {
+    // A new response, after a redirect or a retry
+    *headers = ResponseHeaders();
+  }
+  const auto colon = line.find(':');
+  if (colon != std::string::npos) {
+    const std::string name = boost::algorithm::to_lower_copy(line.substr(0, colon));
+    const std::string value = boost::algorithm::trim_copy(line.substr(colon + 1));
+    if (name == "etag") {
+      headers->validators.etag = value;
+    } else if (name == "last-modified") {
+      headers->validators.last_modified = value;
+    } else if (name == "retry-after") {
+      headers->retry_after = value;
+    }
+  }
+  return size * nitems;
+}
+
+// Retry-After is either a number of seconds or an HTTP date. Anything beyond
+// a day is taken as a day, so that the value can be safely converted to
+// other units.
+static int64_t parseRetryAfter(const std::string& value) {
+  static constexpr int64_t kMaxRetryAfter = 24 * 3600;
+  if (!value.empty() &&
+      std::all_of(value.begin(), value.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)) != 0; })) {
+    try {
+      return std::min<int64_t>(std::stoll(value), kMaxRetryAfter);
+    } catch (const std::out_of_range&) {
+      return kMaxRetryAfter;
+    }
+  }
+  const time_t date = curl_getdate(value.c_str(), nullptr);
+  if (date < 0) {
+    return 0;
+  }
+  return std::min<int64_t>(std::max<int64_t>(date - time(nullptr), 0), kMaxRetryAfter);
+}
+
 static int ProgressHandler(void* clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow) {
   (void)dltotal;
   (void)dlnow;
@@ -58,7 +113,71 @@ static int ProgressHandler(void* clientp, curl_off_t dltotal, curl_off_t dlnow,
   return 0;
 }
 
-HttpClient::HttpClient(const std::vector<std::string>* extra_headers) {
+CurlShareWrapper::CurlShareWrapper() : sessions_(makeShare(false)) {}
+
+CurlShareWrapper::~CurlShareWrapper() {
+  for (auto& thread_share : threads_) {
+    curl_share_cleanup(thread_share.second->handle);
+  }
+  curl_share_cleanup(sessions_->handle);
+}
+
+std::unique_ptr<CurlShareWrapper::Share> CurlShareWrapper::makeShare(bool connections) {
+  auto share = std_::make_unique<Share>();
+  share->handle = curl_share_init();
+  if (share->handle == nullptr) {
+    throw std::runtime_error("Could not initialize curl share");
+  }
+  curl_share_setopt(share->handle, CURLSHOPT_LOCKFUNC, CurlShareWrapper::lock);
+  curl_share_setopt(share->handle, CURLSHOPT_UNLOCKFUNC, CurlShareWrapper::unlock);
+  curl_share_setopt(share->handle, CURLSHOPT_USERDATA, share.get());
+  if (connections) {
+    curl_share_setopt(share->handle, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+  }
+  curl_share_setopt(share->handle, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+  curl_share_setopt(share->handle, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+  return share;
+}
+
+void CurlShareWrapper::attach(CURL* handle) {
+  std::lock_guard<std::mutex> guard(threads_mutex_);
+  auto it = threads_.find(std::this_thread::get_id());
+  if (it == threads_.end()) {
+    if (threads_.size() >= kMaxThreadShares) {
+      // A share with no handles attached can go: if its thread is still
+      // around, it just starts over with a new one.
+      for (auto old = threads_.begin(); old != threads_.end();) {
+        if (curl_share_cleanup(old->second->handle) == CURLSHE_OK) {
+          old = threads_.erase(old);
+        } else {
+          ++old;
+        }
+      }
+    }
+    it = threads_.emplace(std::this_thread::get_id(), makeShare(true)).first;
+  }
+  curlEasySetoptWrapper(handle, CURLOPT_SHARE, it->second->handle);
+}
+
+void CurlShareWrapper::attachSessions(CURL* handle) const {
+  curlEasySetoptWrapper(handle, CURLOPT_SHARE, sessions_->handle);
+}
+
+void CurlShareWrapper::lock(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr) {
+  (void)handle;
+  (void)access;
+  static_cast<Share*>(userptr)->mutexes.at(static_cast<size_t>(data)).lock();
+}
+
+void CurlShareWrapper::unlock(CURL* handle, curl_lock_data data, void* userptr) {
+  (void)handle;
+  static_cast<Share*>(userptr)->mutexes.at(static_cast<size_t>(data)).unlock();
+}
+
+HttpClient::HttpClient(const std::vector<std::string>* extra_headers)
+    : share_(std::make_shared<CurlShareWrapper>()),
+      connections_opened_(std::make_shared<std::atomic<uint64_t>>(0)),
+      retry_after_(std::make_shared<std::atomic<int64_t>>(0)) {
   curl = curl_easy_init();
   if (curl == nullptr) {
     throw std::runtime_error("Could not initialize curl");
@@ -95,7 +214,12 @@ HttpClient::HttpClient(const std::string& socket) : HttpClient() {
 }
 
 HttpClient::HttpClient(const HttpClient& curl_in)
-    : HttpInterface(curl_in), pkcs11_key(curl_in.pkcs11_key), pkcs11_cert(curl_in.pkcs11_key) {
+    : HttpInterface(curl_in),
+      share_(curl_in.share_),
+      connections_opened_(curl_in.connections_opened_),
+      retry_after_(curl_in.retry_after_),
+      pkcs11_key(curl_in.pkcs11_key),
+      pkcs11_cert(curl_in.pkcs11_key) {
   curl = curl_easy_duphandle(curl_in.curl);
   headers = curl_slist_dup(curl_in.headers);
 }
@@ -149,9 +273,28 @@ void HttpClient::setCerts(const std::string& ca, CryptoSource ca_source, const s
 }
 
 HttpResponse HttpClient::get(const std::string& url, int64_t maxsize, const api::FlowControlToken* flow_control) {
-  CURL* curl_get = Utils::curlDupHandleWrapper(curl, pkcs11_key);
+  return performGet(url, maxsize, flow_control, headers);
+}
+
+HttpResponse HttpClient::getIfModified(const std::string& url, int64_t maxsize,
+                                       const api::FlowControlToken* flow_control, const HttpValidators& validators) {
+  curl_slist* req_headers = curl_slist_dup(headers);
+  if (!validators.etag.empty()) {
+    req_headers = curl_slist_append(req_headers, ("If-None-Match: " + validators.etag).c_str());
+  }
+  if (!validators.last_modified.empty()) {
+    req_headers = curl_slist_append(req_headers, ("If-Modified-Since: " + validators.last_modified).c_str());
+  }
+  HttpResponse response = performGet(url, maxsize, flow_control, req_headers);
+  curl_slist_free_all(req_headers);
+  return response;
+}
+
+HttpResponse HttpClient::performGet(const std::string& url, int64_t maxsize,
+                                    const api::FlowControlToken* flow_control, curl_slist* req_headers) {
+  CURL* curl_get = dupHandle();
 
-  curlEasySetoptWrapper(curl_get, CURLOPT_HTTPHEADER, headers);
+  curlEasySetoptWrapper(curl_get, CURLOPT_HTTPHEADER, req_headers);
 
   if (pkcs11_cert) {
     curlEasySetoptWrapper(curl_get, CURLOPT_SSLCERTTYPE, "ENG");
@@ -176,7 +319,7 @@ HttpResponse HttpClient::get(const std::string& url, int64_t maxsize, const api:
 }
 
 HttpResponse HttpClient::post(const std::string& url, const std::string& content_type, const std::string& data) {
-  CURL* curl_post = Utils::curlDupHandleWrapper(curl, pkcs11_key);
+  CURL* curl_post = dupHandle();
   curl_slist* req_headers = curl_slist_dup(headers);
   req_headers = curl_slist_append(req_headers, (std::string("Content-Type: ") + content_type).c_str());
   curlEasySetoptWrapper(curl_post, CURLOPT_HTTPHEADER, req_headers);
@@ -196,7 +339,7 @@ HttpResponse HttpClient::post(const std::string& url, const Json::Value& data) {
 }
 
 HttpResponse HttpClient::put(const std::string& url, const std::string& content_type, const std::string& data) {
-  CURL* curl_put = Utils::curlDupHandleWrapper(curl, pkcs11_key);
+  CURL* curl_put = dupHandle();
   curl_slist* req_headers = curl_slist_dup(headers);
   req_headers = curl_slist_append(req_headers, (std::string("Content-Type: ") + content_type).c_str());
   curlEasySetoptWrapper(curl_put, CURLOPT_HTTPHEADER, req_headers);
@@ -215,6 +358,33 @@ HttpResponse HttpClient::put(const std::string& url, const Json::Value& data) {
   return put(url, "application/json", data_str);
 }
 
+void HttpClient::setConnectionReuse(bool enabled) {
+  if (enabled && share_ == nullptr) {
+    share_ = std::make_shared<CurlShareWrapper>();
+  } else if (!enabled) {
+    share_.reset();
+  }
+}
+
+CURL* HttpClient::dupHandle(bool own_thread) const {
+  CURL* handle = Utils::curlDupHandleWrapper(curl, pkcs11_key);
+  if (share_ == nullptr) {
+    curlEasySetoptWrapper(handle, CURLOPT_SHARE, nullptr);
+  } else if (own_thread) {
+    share_->attachSessions(handle);
+  } else {
+    share_->attach(handle);
+  }
+  return handle;
+}
+
+void HttpClient::countConnections(CURL* curl_handler, std::atomic<uint64_t>& counter) {
+  long num_connects = 0;  // NOLINT(google-runtime-int)
+  if (curl_easy_getinfo(curl_handler, CURLINFO_NUM_CONNECTS, &num_connects) == CURLE_OK && num_connects > 0) {
+    counter += static_cast<uint64_t>(num_connects);
+  }
+}
+
 // NOLINTNEXTLINE(misc-no-recursion)
 HttpResponse HttpClient::perform(CURL* curl_handler, int retry_times, int64_t size_limit) {
   if (size_limit >= 0) {
@@ -228,17 +398,29 @@ HttpResponse HttpClient::perform(CURL* curl_handler, int retry_times, int64_t si
   WriteStringArg response_arg;
   response_arg.limit = size_limit;
   curlEasySetoptWrapper(curl_handler, CURLOPT_WRITEDATA, static_cast<void*>(&response_arg));
+  ResponseHeaders response_headers;
+  curlEasySetoptWrapper(curl_handler, CURLOPT_HEADERFUNCTION, collectHeaders);
+  curlEasySetoptWrapper(curl_handler, CURLOPT_HEADERDATA, static_cast<void*>(&response_headers));
   CURLcode result = curl_easy_perform(curl_handler);
+  countConnections(curl_handler, *connections_opened_);
   long http_code;  // NOLINT(google-runtime-int)
   curl_easy_getinfo(curl_handler, CURLINFO_RESPONSE_CODE, &http_code);
   HttpResponse response(response_arg.out, http_code, result, (result != CURLE_OK) ? curl_easy_strerror(result) : "");
+  response.validators = response_headers.validators;
+  int64_t retry_delay = 1;
+  if ((http_code == 429 || http_code == 503) && !response_headers.retry_after.empty()) {
+    retry_delay = parseRetryAfter(response_headers.retry_after);
+    *retry_after_ = retry_delay;
+  }
   if (response.curl_code != CURLE_OK || response.http_status_code >= 500) {
     std::ostringstream error_message;
     error_message << "curl error " << response.curl_code << " (http code " << response.http_status_code
                   << "): " << response.error_message;
     LOG_ERROR << error_message.str();
-    if (retry_times != 0) {
-      sleep(1);
+    // A server asking for a longer break is left to the caller, see takeRetryAfter().
+    if (retry_times != 0 && retry_delay <= kMaxRetryWait) {
+      *retry_after_ = 0;
+      std::this_thread::sleep_for(std::chrono::seconds(retry_delay));
       // NOLINTNEXTLINE(misc-no-recursion)
       response = perform(curl_handler, --retry_times, size_limit);
     }
@@ -248,6 +430,70 @@ HttpResponse HttpClient::perform(CURL* curl_handler, int retry_times, int64_t si
   return response;
 }
 
+static thread_local CURL* current_transfer = nullptr;
+static thread_local std::shared_ptr<HttpClient::TransferResumer> current_resumer;
+
+CURL* HttpClient::currentTransfer() { return current_transfer; }
+
+std::shared_ptr<HttpClient::TransferResumer> HttpClient::currentResumer() { return current_resumer; }
+
+void HttpClient::TransferResumer::resume() {
+  std::lock_guard<std::mutex> lk(m_);
+  requested_ = true;
+  if (multi_ != nullptr) {
+    curl_multi_wakeup(multi_);
+  }
+}
+
+CURLcode HttpClient::TransferResumer::perform(CURL* handle) {
+  CURLM* multi = curl_multi_init();
+  if (multi == nullptr) {
+    return CURLE_OUT_OF_MEMORY;
+  }
+  curl_multi_add_handle(multi, handle);
+  {
+    std::lock_guard<std::mutex> lk(m_);
+    multi_ = multi;
+  }
+
+  CURLcode result = CURLE_OK;
+  int running = 1;
+  while (running > 0) {
+    CURLMcode code = curl_multi_perform(multi, &running);
+    if (code == CURLM_OK && running > 0) {
+      code = curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+    }
+    if (code != CURLM_OK) {
+      LOG_ERROR << "curl multi error: " << curl_multi_strerror(code);
+      result = CURLE_RECV_ERROR;
+      break;
+    }
+    bool requested;
+    {
+      std::lock_guard<std::mutex> lk(m_);
+      requested = requested_;
+      requested_ = false;
+    }
+    if (requested) {
+      curl_easy_pause(handle, CURLPAUSE_CONT);
+    }
+  }
+  int queued = 0;
+  while (CURLMsg* msg = curl_multi_info_read(multi, &queued)) {
+    if (msg->msg == CURLMSG_DONE && msg->easy_handle == handle) {
+      result = msg->data.result;
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lk(m_);
+    multi_ = nullptr;
+  }
+  curl_multi_remove_handle(multi, handle);
+  curl_multi_cleanup(multi);
+  return result;
+}
+
 HttpResponse HttpClient::download(const std::string& url, curl_write_callback write_cb,
                                   curl_xferinfo_callback progress_cb, void* userp, curl_off_t from) {
   return downloadAsync(url, write_cb, progress_cb, userp, from, nullptr).get();
@@ -256,15 +502,33 @@ HttpResponse HttpClient::download(const std::string& url, curl_write_callback wr
 std::future<HttpResponse> HttpClient::downloadAsync(const std::string& url, curl_write_callback write_cb,
                                                     curl_xferinfo_callback progress_cb, void* userp, curl_off_t from,
                                                     CurlHandler* easyp) {
-  CURL* curl_download = Utils::curlDupHandleWrapper(curl, pkcs11_key);
+  return startDownload(url, write_cb, progress_cb, userp, from, -1, easyp);
+}
 
-  CurlHandler curlp = CurlHandler(curl_download, curl_easy_cleanup);
+HttpResponse HttpClient::downloadRange(const std::string& url, curl_write_callback write_cb,
+                                       curl_xferinfo_callback progress_cb, void* userp, curl_off_t from,
+                                       curl_off_t to) {
+  return startDownload(url, write_cb, progress_cb, userp, from, to, nullptr).get();
+}
+
+std::future<HttpResponse> HttpClient::startDownload(const std::string& url, curl_write_callback write_cb,
+                                                    curl_xferinfo_callback progress_cb, void* userp, curl_off_t from,
+                                                    curl_off_t to, CurlHandler* easyp) {
+  CURL* curl_download = dupHandle(true);
+  // The transfer may outlive this client: keep the share and the headers
+  // alive for as long as the handle that uses them.
+  curl_slist* download_headers = curl_slist_dup(headers);
+
+  CurlHandler curlp = CurlHandler(curl_download, [share = share_, download_headers](CURL* handle) {
+    curl_easy_cleanup(handle);
+    curl_slist_free_all(download_headers);
+  });
 
   if (easyp != nullptr) {
     *easyp = curlp;
   }
 
-  curlEasySetoptWrapper(curl_download, CURLOPT_HTTPHEADER, headers);
+  curlEasySetoptWrapper(curl_download, CURLOPT_HTTPHEADER, download_headers);
   curlEasySetoptWrapper(curl_download, CURLOPT_URL, url.c_str());
   curlEasySetoptWrapper(curl_download, CURLOPT_HTTPGET, 1L);
   curlEasySetoptWrapper(curl_download, CURLOPT_WRITEFUNCTION, write_cb);
@@ -277,13 +541,23 @@ std::future<HttpResponse> HttpClient::downloadAsync(const std::string& url, curl
   curlEasySetoptWrapper(curl_download, CURLOPT_TIMEOUT, 0);
   curlEasySetoptWrapper(curl_download, CURLOPT_LOW_SPEED_TIME, speed_limit_time_interval_);
   curlEasySetoptWrapper(curl_download, CURLOPT_LOW_SPEED_LIMIT, speed_limit_bytes_per_sec_);
-  curlEasySetoptWrapper(curl_download, CURLOPT_RESUME_FROM_LARGE, from);
+  if (to < 0) {
+    curlEasySetoptWrapper(curl_download, CURLOPT_RESUME_FROM_LARGE, from);
+  } else {
+    const std::string range = std::to_string(from) + "-" + std::to_string(to);
+    curlEasySetoptWrapper(curl_download, CURLOPT_RANGE, range.c_str());
+  }
 
   std::promise<HttpResponse> resp_promise;
   auto resp_future = resp_promise.get_future();
   std::thread(
-      [curlp](std::promise<HttpResponse> promise) {
-        CURLcode result = curl_easy_perform(curlp.get());
+      [curlp, share = share_, connections_opened = connections_opened_](std::promise<HttpResponse> promise) {
+        current_transfer = curlp.get();
+        current_resumer = std::make_shared<TransferResumer>();
+        CURLcode result = current_resumer->perform(curlp.get());
+        current_transfer = nullptr;
+        current_resumer.reset();
+        countConnections(curlp.get(), *connections_opened);
         long http_code;  // NOLINT(google-runtime-int)
         curl_easy_getinfo(curlp.get(), CURLINFO_RESPONSE_CODE, &http_code);
         HttpResponse response("", http_code, result, (result != CURLE_OK) ? curl_easy_strerror(result) : "");
@@ -1,8 +1,13 @@
 #ifndef HTTPCLIENT_H_
 #define HTTPCLIENT_H_
 
+#include <array>
+#include <atomic>
 #include <future>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <thread>
 
 #include <curl/curl.h>
 #include "gtest/gtest_prod.h"
@@ -23,6 +28,42 @@ class CurlGlobalInitWrapper {
   CurlGlobalInitWrapper &operator=(CurlGlobalInitWrapper &&) = delete;
 };
 
+/**
+ * Helper class to manage curl share objects. libcurl does not support sharing
+ * a connection cache between threads, so every thread gets its own share with
+ * its own connections, TLS sessions and DNS lookups. Handles that are
+ * performed on a thread of their own only share TLS sessions and DNS lookups.
+ */
+class CurlShareWrapper {
+ public:
+  CurlShareWrapper();
+  ~CurlShareWrapper();
+  CurlShareWrapper(const CurlShareWrapper &) = delete;
+  CurlShareWrapper(CurlShareWrapper &&) = delete;
+  CurlShareWrapper &operator=(const CurlShareWrapper &) = delete;
+  CurlShareWrapper &operator=(CurlShareWrapper &&) = delete;
+  // Attach a handle that is going to be performed on the calling thread.
+  void attach(CURL *handle);
+  // Attach a handle that is going to be performed on a new thread.
+  void attachSessions(CURL *handle) const;
+
+ private:
+  struct Share {
+    CURLSH *handle{nullptr};
+    std::array<std::mutex, CURL_LOCK_DATA_LAST> mutexes;
+  };
+  // Shares of threads that have gone away are cleaned up once there are more than this.
+  static constexpr size_t kMaxThreadShares = 16;
+
+  static std::unique_ptr<Share> makeShare(bool connections);
+  static void lock(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr);
+  static void unlock(CURL *handle, curl_lock_data data, void *userptr);
+
+  std::unique_ptr<Share> sessions_;
+  std::mutex threads_mutex_;
+  std::map<std::thread::id, std::unique_ptr<Share>> threads_;
+};
+
 class HttpClient : public HttpInterface {
  public:
   explicit HttpClient(const std::vector<std::string> *extra_headers = nullptr);
@@ -33,6 +74,8 @@ class HttpClient : public HttpInterface {
   HttpClient &operator=(const HttpClient &) = delete;
   HttpClient &operator=(HttpClient &&) = default;
   HttpResponse get(const std::string &url, int64_t maxsize, const api::FlowControlToken *flow_control) override;
+  HttpResponse getIfModified(const std::string &url, int64_t maxsize, const api::FlowControlToken *flow_control,
+                             const HttpValidators &validators) override;
   HttpResponse post(const std::string &url, const std::string &content_type, const std::string &data) override;
   HttpResponse post(const std::string &url, const Json::Value &data) override;
   HttpResponse put(const std::string &url, const std::string &content_type, const std::string &data) override;
@@ -43,18 +86,76 @@ class HttpClient : public HttpInterface {
   std::future<HttpResponse> downloadAsync(const std::string &url, curl_write_callback write_cb,
                                           curl_xferinfo_callback progress_cb, void *userp, curl_off_t from,
                                           CurlHandler *easyp) override;
+  HttpResponse downloadRange(const std::string &url, curl_write_callback write_cb, curl_xferinfo_callback progress_cb,
+                             void *userp, curl_off_t from, curl_off_t to) override;
   void setCerts(const std::string &ca, CryptoSource ca_source, const std::string &cert, CryptoSource cert_source,
                 const std::string &pkey, CryptoSource pkey_source) override;
   bool updateHeader(const std::string &name, const std::string &value);
   void timeout(int64_t ms);
 
+  /**
+   * Enable or disable reuse of connections, TLS sessions and DNS cache entries
+   * between requests. Reuse is enabled by default and is shared with copies of
+   * this client. Must not be called while requests are in flight.
+   */
+  void setConnectionReuse(bool enabled);
+  /**
+   * Number of new connections (and thus TLS handshakes) opened by this client
+   * and its copies since construction or the last reset.
+   */
+  uint64_t connectionsOpened() const override { return *connections_opened_; }
+  void resetConnectionsOpened() { *connections_opened_ = 0; }
+  std::chrono::seconds takeRetryAfter() override { return std::chrono::seconds(retry_after_->exchange(0)); }
+  /**
+   * The transfer performed by the calling thread, or nullptr. Lets download
+   * callbacks pause and resume their transfer with curl_easy_pause().
+   */
+  static CURL *currentTransfer();
+
+  /**
+   * Lets any thread resume a transfer that a download callback has paused.
+   * Only the thread of the transfer may unpause it with curl_easy_pause(), so
+   * resume() wakes that thread up to do it.
+   */
+  class TransferResumer {
+   public:
+    /** Can be called at any time, even after the transfer is over. */
+    void resume();
+
+   private:
+    friend class HttpClient;
+    // Like curl_easy_perform(), but on a multi handle that resume() can wake up.
+    CURLcode perform(CURL *handle);
+
+    std::mutex m_;
+    CURLM *multi_{nullptr};
+    bool requested_{false};
+  };
+  /** The resumer of currentTransfer(), or nullptr. */
+  static std::shared_ptr<TransferResumer> currentResumer();
+
  private:
   FRIEND_TEST(GetTest, download_speed_limit);
 
+  // Longest Retry-After, in seconds, that a failed request waits for before it is retried.
+  static constexpr int64_t kMaxRetryWait = 10;
   static const CurlGlobalInitWrapper manageCurlGlobalInit_;
   CURL *curl;
   curl_slist *headers;
+  std::shared_ptr<CurlShareWrapper> share_;
+  std::shared_ptr<std::atomic<uint64_t>> connections_opened_;
+  std::shared_ptr<std::atomic<int64_t>> retry_after_;
+  // Duplicates the base handle for a request performed on the calling thread,
+  // or on a thread of its own if `own_thread` is set.
+  CURL *dupHandle(bool own_thread = false) const;
+  HttpResponse performGet(const std::string &url, int64_t maxsize, const api::FlowControlToken *flow_control,
+                          curl_slist *req_headers);
+  // Downloads from `from` to the end, or to `to` (inclusive) if it is not negative.
+  std::future<HttpResponse> startDownload(const std::string &url, curl_write_callback write_cb,
+                                          curl_xferinfo_callback progress_cb, void *userp, curl_off_t from,
+                                          curl_off_t to, CurlHandler *easyp);
   HttpResponse perform(CURL *curl_handler, int retry_times, int64_t size_limit);
+  static void countConnections(CURL *curl_handler, std::atomic<uint64_t> &counter);
   static curl_slist *curl_slist_dup(curl_slist *sl);
 
   std::unique_ptr<TemporaryFile> tls_ca_file;
@@ -141,6 +141,137 @@ TEST(Headers, update_header) {
   EXPECT_EQ(response["status"].asString(), "good");
 }
 
+/* Count new connections, shared between copies of a client. The fake server
+ * closes every connection after the response, so each request opens a new
+ * one, whether or not reuse is enabled. */
+TEST(HttpClient, connections_opened) {
+  HttpClient http;
+  http.setConnectionReuse(false);
+  EXPECT_EQ(http.connectionsOpened(), 0);
+
+  const std::string path = "/path/1/2/3";
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_TRUE(http.get(server + path, HttpInterface::kNoLimit, nullptr).isOk());
+  }
+  EXPECT_EQ(http.connectionsOpened(), 3);
+
+  HttpClient http_copy(http);
+  Json::Value data;
+  data["key"] = "val";
+  EXPECT_TRUE(http_copy.post(server + path, data).isOk());
+  EXPECT_EQ(http.connectionsOpened(), 4);
+
+  http.resetConnectionsOpened();
+  EXPECT_EQ(http_copy.connectionsOpened(), 0);
+}
+
+/* Sequential requests to a server that keeps the connection alive go over a
+ * single connection, also from copies of the client. Downloads run on a thread
+ * of their own and open their own connection. Without reuse every request
+ * opens its own. */
+TEST(HttpClient, connection_reuse) {
+  const std::string path = "/keep_alive";
+  HttpClient http;
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_TRUE(http.get(server + path, HttpInterface::kNoLimit, nullptr).isOk());
+  }
+  EXPECT_EQ(http.connectionsOpened(), 1);
+
+  HttpClient http_copy(http);
+  EXPECT_TRUE(http_copy.get(server + path, HttpInterface::kNoLimit, nullptr).isOk());
+  std::string body;
+  const auto write_cb = [](char* data, size_t size, size_t nmemb, void* userp) -> size_t {
+    static_cast<std::string*>(userp)->append(data, size * nmemb);
+    return size * nmemb;
+  };
+  EXPECT_TRUE(http_copy.download(server + path, write_cb, nullptr, &body, 0).isOk());
+  EXPECT_EQ(body, "{\"status\": \"good\"}");
+  EXPECT_EQ(http.connectionsOpened(), 2);
+
+  HttpClient http_no_reuse;
+  http_no_reuse.setConnectionReuse(false);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_TRUE(http_no_reuse.get(server + path, HttpInterface::kNoLimit, nullptr).isOk());
+  }
+  EXPECT_EQ(http_no_reuse.connectionsOpened(), 3);
+}
+
+/* A download keeps running and finishes normally after the client that
+ * started it is destroyed. */
+TEST(HttpClient, download_outlives_client) {
+  std::future<HttpResponse> resp;
+  std::string body;
+  {
+    HttpClient http;
+    resp = http.downloadAsync(
+        server + "/slow_file",
+        [](char* data, size_t size, size_t nmemb, void* userp) -> size_t {
+          static_cast<std::string*>(userp)->append(data, size * nmemb);
+          return size * nmemb;
+        },
+        nullptr, &body, 0, nullptr);
+  }
+  EXPECT_TRUE(resp.get().isOk());
+  EXPECT_EQ(body, "aaaaaaaaaa");
+}
+
+/* Requests from several threads through one client don't share connections:
+ * each thread keeps its own. */
+TEST(HttpClient, connection_reuse_threads) {
+  HttpClient http;
+  const std::string path = "/keep_alive";
+  std::vector<std::thread> threads;
+  std::atomic<int> successes{0};
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&http, &path, &successes] {
+      for (int j = 0; j < 5; ++j) {
+        if (http.get(server + path, HttpInterface::kNoLimit, nullptr).isOk()) {
+          ++successes;
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_EQ(successes, 20);
+  EXPECT_EQ(http.connectionsOpened(), 4);
+}
+
+/* A Retry-After in seconds that is too long to wait for is not retried but
+ * left for the caller. */
+TEST(HttpClient, retry_after_seconds) {
+  HttpClient http;
+  const auto start = std::chrono::steady_clock::now();
+  HttpResponse resp = http.get(server + "/retry_after/120", HttpInterface::kNoLimit, nullptr);
+  EXPECT_EQ(resp.http_status_code, 503);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+  EXPECT_EQ(http.takeRetryAfter(), std::chrono::seconds(120));
+  EXPECT_EQ(http.takeRetryAfter(), std::chrono::seconds(0));
+}
+
+/* A Retry-After can also be an HTTP-date. */
+TEST(HttpClient, retry_after_date) {
+  HttpClient http;
+  HttpResponse resp = http.get(server + "/retry_after_date/3600", HttpInterface::kNoLimit, nullptr);
+  EXPECT_EQ(resp.http_status_code, 503);
+  const auto delay = http.takeRetryAfter();
+  EXPECT_GE(delay, std::chrono::seconds(3590));
+  EXPECT_LE(delay, std::chrono::seconds(3600));
+}
+
+/* A short Retry-After is waited for before the request is retried. */
+TEST(HttpClient, retry_after_short) {
+  HttpClient http;
+  const std::string path = "/retry_after_once/2/" + Utils::randomUuid();
+  const auto start = std::chrono::steady_clock::now();
+  HttpResponse resp = http.get(server + path, HttpInterface::kNoLimit, nullptr);
+  EXPECT_TRUE(resp.isOk());
+  EXPECT_EQ(resp.getJson()["path"].asString(), path);
+  EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::seconds(2));
+  EXPECT_EQ(http.takeRetryAfter(), std::chrono::seconds(0));
+}
+
 // TODO(OTA-4546): add tests for HttpClient::download
 
 #ifndef __NO_MAIN__
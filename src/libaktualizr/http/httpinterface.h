@@ -1,6 +1,7 @@
 #ifndef HTTPINTERFACE_H_
 #define HTTPINTERFACE_H_
 
+#include <chrono>
 #include <future>
 #include <string>
 #include <utility>
@@ -15,6 +16,16 @@
 
 using CurlHandler = std::shared_ptr<CURL>;
 
+/**
+ * Validators of a response (RFC 7232), which let a later request for the same
+ * resource be answered with 304 Not Modified if it didn't change.
+ */
+struct HttpValidators {
+  std::string etag;
+  std::string last_modified;
+  bool empty() const { return etag.empty() && last_modified.empty(); }
+};
+
 struct HttpResponse {
   HttpResponse() = default;
   HttpResponse(std::string body_in, const long http_status_code_in,  //  NOLINT(google-runtime-int)
@@ -27,6 +38,8 @@ struct HttpResponse {
   long http_status_code{0};  // NOLINT(google-runtime-int)
   CURLcode curl_code{CURLE_OK};
   std::string error_message;
+  // Not filled in for downloads.
+  HttpValidators validators;
   bool isOk() const { return (curl_code == CURLE_OK && http_status_code >= 200 && http_status_code < 400); }
   bool wasInterrupted() const { return curl_code == CURLE_ABORTED_BY_CALLBACK; };
   std::string getStatusStr() const {
@@ -42,6 +55,17 @@ class HttpInterface {
   virtual ~HttpInterface() = default;
   virtual HttpResponse get(const std::string &url, int64_t maxsize, const api::FlowControlToken *flow_control) = 0;
   HttpResponse get(const std::string &url, int64_t maxsize) { return get(url, maxsize, nullptr); }
+  /**
+   * Like get(), but the server may answer with status 304 and no body if the
+   * resource is unchanged since a response with `validators` was received.
+   * The validators of the response are returned along with it. Not supported
+   * by default, in which case this is an unconditional get().
+   */
+  virtual HttpResponse getIfModified(const std::string &url, int64_t maxsize,
+                                     const api::FlowControlToken *flow_control, const HttpValidators &validators) {
+    (void)validators;
+    return get(url, maxsize, flow_control);
+  }
   virtual HttpResponse post(const std::string &url, const std::string &content_type, const std::string &data) = 0;
   virtual HttpResponse post(const std::string &url, const Json::Value &data) = 0;
   virtual HttpResponse put(const std::string &url, const std::string &content_type, const std::string &data) = 0;
@@ -52,8 +76,34 @@ class HttpInterface {
   virtual std::future<HttpResponse> downloadAsync(const std::string &url, curl_write_callback write_cb,
                                                   curl_xferinfo_callback progress_cb, void *userp, curl_off_t from,
                                                   CurlHandler *easyp) = 0;
+  /**
+   * Download the bytes `from` to `to` (inclusive) of a resource. A server may
+   * ignore the range and answer with the whole resource, so callers have to
+   * check for status 206. Not supported by default.
+   */
+  virtual HttpResponse downloadRange(const std::string &url, curl_write_callback write_cb,
+                                     curl_xferinfo_callback progress_cb, void *userp, curl_off_t from, curl_off_t to) {
+    (void)url;
+    (void)write_cb;
+    (void)progress_cb;
+    (void)userp;
+    (void)from;
+    (void)to;
+    return HttpResponse("", 0, CURLE_RANGE_ERROR, "Byte range requests are not supported");
+  }
   virtual void setCerts(const std::string &ca, CryptoSource ca_source, const std::string &cert,
                         CryptoSource cert_source, const std::string &pkey, CryptoSource pkey_source) = 0;
+  /**
+   * The delay that the server last asked for with Retry-After in a 429 or 503
+   * response, if it did since the previous call. Short delays may already have
+   * been waited for by retrying the request.
+   */
+  virtual std::chrono::seconds takeRetryAfter() { return std::chrono::seconds{0}; }
+  /**
+   * Number of new connections, and so TLS handshakes, opened so far, if the
+   * implementation counts them.
+   */
+  virtual uint64_t connectionsOpened() const { return 0; }
   static constexpr int64_t kNoLimit = 0;  // no limit the size of downloaded data
   static constexpr int64_t kPostRespLimit = 64L * 1024;
   static constexpr int64_t kPutRespLimit = 64L * 1024;
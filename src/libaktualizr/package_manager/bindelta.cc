@@ -0,0 +1,153 @@
+#include "bindelta.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+static constexpr uint32_t HashMultiplier = 0x01000193;
+
+static void putUint64(std::string& out, uint64_t value) {
+  for (int i = 0; i < 8; ++i) {
+    out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+  }
+}
+
+static uint64_t getUint64(std::istream& in) {
+  unsigned char bytes[8];
+  in.read(reinterpret_cast<char*>(bytes), sizeof(bytes));
+  if (in.gcount() != sizeof(bytes)) {
+    throw std::runtime_error("Invalid delta patch: truncated");
+  }
+  uint64_t value = 0;
+  for (int i = 7; i >= 0; --i) {
+    value = (value << 8) | bytes[i];
+  }
+  return value;
+}
+
+static uint32_t blockHash(const char* data) {
+  uint32_t hash = 0;
+  for (size_t i = 0; i < BinaryDelta::kBlockSize; ++i) {
+    hash = hash * HashMultiplier + static_cast<unsigned char>(data[i]);
+  }
+  return hash;
+}
+
+static void putLiteral(std::string& patch, const std::string& image, size_t begin, size_t end) {
+  if (end > begin) {
+    patch.push_back('L');
+    putUint64(patch, end - begin);
+    patch.append(image, begin, end - begin);
+  }
+}
+
+// Greedy matching against the blocks of the base image at multiples of
+// kBlockSize, with a rolling hash over the new image. Matches are extended in
+// both directions, so unchanged regions become a single copy command.
+std::string BinaryDelta::create(const std::string& base, const std::string& image) {
+  if (base.size() > kMaxCreateSize || image.size() > kMaxCreateSize) {
+    throw std::runtime_error("Delta patches can only be created for images of up to " +
+                             std::to_string(kMaxCreateSize) + " bytes");
+  }
+  std::string patch(kMagic, kMagicSize);
+  putUint64(patch, image.size());
+
+  std::unordered_map<uint32_t, size_t> blocks;
+  for (size_t offset = 0; offset + kBlockSize <= base.size(); offset += kBlockSize) {
+    blocks.emplace(blockHash(&base[offset]), offset);
+  }
+
+  uint32_t top_factor = 1;
+  for (size_t i = 1; i < kBlockSize; ++i) {
+    top_factor *= HashMultiplier;
+  }
+
+  size_t literal_start = 0;
+  size_t pos = 0;
+  uint32_t hash = image.size() >= kBlockSize ? blockHash(&image[0]) : 0;
+  while (pos + kBlockSize <= image.size()) {
+    auto found = blocks.find(hash);
+    if (found != blocks.end() && std::memcmp(&base[found->second], &image[pos], kBlockSize) == 0) {
+      size_t base_begin = found->second;
+      size_t begin = pos;
+      while (begin > literal_start && base_begin > 0 && base[base_begin - 1] == image[begin - 1]) {
+        --begin;
+        --base_begin;
+      }
+      size_t length = pos - begin + kBlockSize;
+      while (begin + length < image.size() && base_begin + length < base.size() &&
+             base[base_begin + length] == image[begin + length]) {
+        ++length;
+      }
+      putLiteral(patch, image, literal_start, begin);
+      patch.push_back('C');
+      putUint64(patch, base_begin);
+      putUint64(patch, length);
+
+      pos = literal_start = begin + length;
+      if (pos + kBlockSize <= image.size()) {
+        hash = blockHash(&image[pos]);
+      }
+      continue;
+    }
+
+    if (pos + kBlockSize < image.size()) {
+      hash = (hash - top_factor * static_cast<unsigned char>(image[pos])) * HashMultiplier +
+             static_cast<unsigned char>(image[pos + kBlockSize]);
+    }
+    ++pos;
+  }
+  putLiteral(patch, image, literal_start, image.size());
+  patch.push_back('E');
+  return patch;
+}
+
+void BinaryDelta::apply(std::istream& base, std::istream& patch, const Sink& sink) {
+  std::string magic(kMagicSize, '\0');
+  patch.read(&magic[0], static_cast<std::streamsize>(kMagicSize));
+  if (magic != std::string(kMagic, kMagicSize)) {
+    throw std::runtime_error("Invalid delta patch: unknown format");
+  }
+  const uint64_t image_length = getUint64(patch);
+
+  std::vector<char> buf(1 << 16);
+  uint64_t written = 0;
+  // Pass `length` bytes from `in` to the sink.
+  auto forward = [&](std::istream& in, uint64_t length, const char* source) {
+    if (length > image_length - written) {
+      throw std::runtime_error("Invalid delta patch: longer than the image");
+    }
+    while (length > 0) {
+      const auto chunk = static_cast<std::streamsize>(std::min<uint64_t>(length, buf.size()));
+      in.read(buf.data(), chunk);
+      if (in.gcount() != chunk) {
+        throw std::runtime_error(std::string("Invalid delta patch: ") + source + " is too short");
+      }
+      sink(buf.data(), static_cast<size_t>(chunk));
+      written += static_cast<uint64_t>(chunk);
+      length -= static_cast<uint64_t>(chunk);
+    }
+  };
+
+  for (;;) {
+    const int tag = patch.get();
+    if (tag == 'C') {
+      const uint64_t offset = getUint64(patch);
+      const uint64_t length = getUint64(patch);
+      base.clear();
+      base.seekg(static_cast<std::streamoff>(offset));
+      forward(base, length, "base image");
+    } else if (tag == 'L') {
+      forward(patch, getUint64(patch), "literal data");
+    } else if (tag == 'E') {
+      break;
+    } else {
+      throw std::runtime_error("Invalid delta patch: unknown command");
+    }
+  }
+  if (written != image_length) {
+    throw std::runtime_error("Invalid delta patch: shorter than the image");
+  }
+}
@@ -0,0 +1,46 @@
+#ifndef BINDELTA_H_
+#define BINDELTA_H_
+
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <string>
+
+/**
+ * Patches that rebuild a binary image from an older one, in the style of
+ * `zstd --patch-from`: the new image is a sequence of ranges copied from the
+ * base image and literal data that is not found in it.
+ *
+ * Format: the magic "AKTDLTA1", the length of the new image and a list of
+ * commands, each a tag byte followed by its arguments. Integers are 64 bit
+ * little endian.
+ *   'C' offset length: copy `length` bytes of the base image from `offset`
+ *   'L' length data:   append `length` literal bytes
+ *   'E':               end of the patch
+ */
+class BinaryDelta {
+ public:
+  using Sink = std::function<void(const char* data, size_t size)>;
+
+  /**
+   * Create a patch from `base` to `image`. Everything is held in memory, along
+   * with an index of the base of about half its size, so both are limited to
+   * kMaxCreateSize. Throws std::runtime_error if they are larger.
+   */
+  static std::string create(const std::string& base, const std::string& image);
+  /**
+   * Rebuild the image from `base` and `patch`, passing it to `sink` in order.
+   * Works in constant memory for images of any size; the sink is expected to
+   * enforce the expected length.
+   * Throws std::runtime_error if the patch is malformed or doesn't fit the base.
+   */
+  static void apply(std::istream& base, std::istream& patch, const Sink& sink);
+
+  static constexpr const char* kMagic = "AKTDLTA1";
+  static constexpr size_t kMagicSize = 8;
+  // Shortest run of bytes looked up in the base image.
+  static constexpr size_t kBlockSize = 64;
+  static constexpr size_t kMaxCreateSize = 64 << 20;
+};
+
+#endif  // BINDELTA_H_
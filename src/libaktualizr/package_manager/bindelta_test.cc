@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+
+#include "package_manager/bindelta.h"
+#include "utilities/utils.h"
+
+static std::string applyPatch(const std::string& base, const std::string& patch) {
+  std::istringstream base_stream(base);
+  std::istringstream patch_stream(patch);
+  std::string image;
+  BinaryDelta::apply(base_stream, patch_stream, [&image](const char* data, size_t size) { image.append(data, size); });
+  return image;
+}
+
+static std::string randomData(size_t size) {
+  std::string data;
+  while (data.size() < size) {
+    data += Utils::randomUuid();
+  }
+  data.resize(size);
+  return data;
+}
+
+/* A patch rebuilds the image from the base and only holds what changed. */
+TEST(BinaryDelta, RoundTrip) {
+  const std::string base = randomData(1 << 20);
+  std::string image = base;
+  image.replace(1000, 16, "changed in place");
+  image.insert(300000, "inserted");
+  image.erase(600000, 5000);
+  image += randomData(4000);
+
+  const std::string patch = BinaryDelta::create(base, image);
+  EXPECT_LT(patch.size(), 16000);
+  EXPECT_EQ(applyPatch(base, patch), image);
+}
+
+/* Images with nothing in common with the base, and empty ones, work too. */
+TEST(BinaryDelta, Unrelated) {
+  const std::string base = randomData(10000);
+  const std::string image = randomData(20000);
+  EXPECT_EQ(applyPatch(base, BinaryDelta::create(base, image)), image);
+  EXPECT_EQ(applyPatch(base, BinaryDelta::create(base, "")), "");
+  EXPECT_EQ(applyPatch("", BinaryDelta::create("", image)), image);
+}
+
+/* A patch that doesn't fit the base or is damaged is rejected. */
+TEST(BinaryDelta, Invalid) {
+  const std::string base = randomData(100000);
+  std::string image = base;
+  image.replace(50000, 10, "0123456789");
+  const std::string patch = BinaryDelta::create(base, image);
+
+  EXPECT_THROW(applyPatch(base.substr(0, 1000), patch), std::runtime_error);
+  EXPECT_THROW(applyPatch(base, patch.substr(0, patch.size() - 1)), std::runtime_error);
+  EXPECT_THROW(applyPatch(base, "not a patch"), std::runtime_error);
+  std::string wrong_length = patch;
+  wrong_length[BinaryDelta::kMagicSize] = static_cast<char>(wrong_length[BinaryDelta::kMagicSize] + 1);
+  EXPECT_THROW(applyPatch(base, wrong_length), std::runtime_error);
+}
+
+/* Patches are not created for images that are too large to hold in memory. */
+TEST(BinaryDelta, CreateSizeLimit) {
+  const std::string large(BinaryDelta::kMaxCreateSize + 1, 'x');
+  EXPECT_THROW(BinaryDelta::create(large, "image"), std::runtime_error);
+  EXPECT_THROW(BinaryDelta::create("base", large), std::runtime_error);
+}
+
+#ifndef __NO_MAIN__
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+#endif
@@ -0,0 +1,87 @@
+#include "compression.h"
+
+#include <lzma.h>
+
+#include <stdexcept>
+#include <vector>
+
+#include "utilities/utils.h"
+
+class XzDecoder : public StreamDecoder {
+ public:
+  explicit XzDecoder(uint64_t memlimit) {
+    if (lzma_stream_decoder(&stream_, memlimit, 0) != LZMA_OK) {
+      throw std::runtime_error("Could not initialize the xz decoder");
+    }
+  }
+  ~XzDecoder() override { lzma_end(&stream_); }
+  XzDecoder(const XzDecoder&) = delete;
+  XzDecoder(XzDecoder&&) = delete;
+  XzDecoder& operator=(const XzDecoder&) = delete;
+  XzDecoder& operator=(XzDecoder&&) = delete;
+
+  void decode(const char* data, size_t size, const Sink& sink) override {
+    if (size == 0) {
+      return;
+    }
+    if (finished_) {
+      throw std::runtime_error("Data after the end of the xz stream");
+    }
+    stream_.next_in = reinterpret_cast<const uint8_t*>(data);
+    stream_.avail_in = size;
+    do {
+      stream_.next_out = reinterpret_cast<uint8_t*>(buf_.data());
+      stream_.avail_out = buf_.size();
+      const lzma_ret ret = lzma_code(&stream_, LZMA_RUN);
+      const size_t produced = buf_.size() - stream_.avail_out;
+      if (produced > 0) {
+        sink(buf_.data(), produced);
+      }
+      if (ret == LZMA_STREAM_END) {
+        finished_ = true;
+        if (stream_.avail_in > 0) {
+          throw std::runtime_error("Data after the end of the xz stream");
+        }
+        return;
+      }
+      if (ret == LZMA_MEMLIMIT_ERROR) {
+        throw std::runtime_error("The xz data needs " + std::to_string(lzma_memusage(&stream_)) +
+                                 " bytes of memory to decompress");
+      }
+      if (ret != LZMA_OK) {
+        throw std::runtime_error("Corrupt xz data, error " + std::to_string(ret));
+      }
+    } while (stream_.avail_in > 0 || stream_.avail_out == 0);
+  }
+
+  bool finished() const override { return finished_; }
+
+ private:
+  lzma_stream stream_ = LZMA_STREAM_INIT;
+  std::vector<char> buf_ = std::vector<char>(1 << 16);
+  bool finished_{false};
+};
+
+bool Compression::supported(const std::string& encoding) { return encoding == kXz; }
+
+std::unique_ptr<StreamDecoder> Compression::decoder(const std::string& encoding, uint64_t memlimit) {
+  if (encoding == kXz) {
+    return std_::make_unique<XzDecoder>(memlimit);
+  }
+  return nullptr;
+}
+
+std::string Compression::compress(const std::string& encoding, const std::string& data) {
+  if (encoding != kXz) {
+    throw std::runtime_error("Unsupported compression: " + encoding);
+  }
+  std::string out(lzma_stream_buffer_bound(data.size()), '\0');
+  size_t out_pos = 0;
+  if (lzma_easy_buffer_encode(LZMA_PRESET_DEFAULT, LZMA_CHECK_CRC64, nullptr,
+                              reinterpret_cast<const uint8_t*>(data.data()), data.size(),
+                              reinterpret_cast<uint8_t*>(&out[0]), &out_pos, out.size()) != LZMA_OK) {
+    throw std::runtime_error("Could not compress the data with xz");
+  }
+  out.resize(out_pos);
+  return out;
+}
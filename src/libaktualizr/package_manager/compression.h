@@ -0,0 +1,46 @@
+#ifndef COMPRESSION_H_
+#define COMPRESSION_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+/**
+ * Decompresses a stream that arrives in pieces, like a download.
+ */
+class StreamDecoder {
+ public:
+  using Sink = std::function<void(const char* data, size_t size)>;
+
+  StreamDecoder() = default;
+  virtual ~StreamDecoder() = default;
+  StreamDecoder(const StreamDecoder&) = delete;
+  StreamDecoder(StreamDecoder&&) = delete;
+  StreamDecoder& operator=(const StreamDecoder&) = delete;
+  StreamDecoder& operator=(StreamDecoder&&) = delete;
+
+  /** Pass the data decompressed from `data` to `sink`. Throws std::runtime_error on corrupt data. */
+  virtual void decode(const char* data, size_t size, const Sink& sink) = 0;
+  /** Whether the end of the compressed stream has been reached. */
+  virtual bool finished() const = 0;
+};
+
+class Compression {
+ public:
+  /** Whether decoder() can decompress `encoding`. */
+  static bool supported(const std::string& encoding);
+  /**
+   * Returns nullptr if the encoding is not supported. Data that needs more
+   * than `memlimit` bytes to decompress is rejected as corrupt.
+   */
+  static std::unique_ptr<StreamDecoder> decoder(const std::string& encoding, uint64_t memlimit = kMaxDecoderMemory);
+  /** Compress a whole buffer, for tests and uptane-generator. Throws std::runtime_error on failure. */
+  static std::string compress(const std::string& encoding, const std::string& data);
+
+  static constexpr const char* kXz = "xz";
+  // Enough for anything made by `xz -9`, which needs 65 MiB to decompress.
+  static constexpr uint64_t kMaxDecoderMemory = 128U << 20U;
+};
+
+#endif  // COMPRESSION_H_
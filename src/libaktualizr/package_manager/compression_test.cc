@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "package_manager/compression.h"
+#include "utilities/utils.h"
+
+static std::string decodeInChunks(StreamDecoder& decoder, const std::string& data, size_t chunk) {
+  std::string out;
+  for (size_t pos = 0; pos < data.size(); pos += chunk) {
+    const std::string part = data.substr(pos, chunk);
+    decoder.decode(part.data(), part.size(), [&out](const char* d, size_t size) { out.append(d, size); });
+  }
+  return out;
+}
+
+/* Compressed data is restored whatever pieces it arrives in. */
+TEST(Compression, XzRoundTrip) {
+  std::string data;
+  while (data.size() < (1 << 20)) {
+    data += Utils::randomUuid() + std::string(100, 'a');
+  }
+  const std::string compressed = Compression::compress(Compression::kXz, data);
+  EXPECT_LT(compressed.size(), data.size() / 2);
+
+  for (size_t chunk : {size_t{1} << 20, size_t{16384}, size_t{7}}) {
+    auto decoder = Compression::decoder(Compression::kXz);
+    ASSERT_NE(decoder, nullptr);
+    EXPECT_EQ(decodeInChunks(*decoder, compressed, chunk), data);
+    EXPECT_TRUE(decoder->finished());
+  }
+}
+
+/* A stream that is cut short is not finished. Damaged data and data after the end are rejected. */
+TEST(Compression, XzInvalid) {
+  const std::string data(100000, 'x');
+  const std::string compressed = Compression::compress(Compression::kXz, data);
+
+  auto decoder = Compression::decoder(Compression::kXz);
+  decodeInChunks(*decoder, compressed.substr(0, compressed.size() / 2), 1000);
+  EXPECT_FALSE(decoder->finished());
+
+  decoder = Compression::decoder(Compression::kXz);
+  EXPECT_THROW(decodeInChunks(*decoder, compressed + "garbage", 1000), std::runtime_error);
+
+  std::string damaged = compressed;
+  damaged[damaged.size() / 2] = static_cast<char>(damaged[damaged.size() / 2] ^ 0xff);
+  decoder = Compression::decoder(Compression::kXz);
+  EXPECT_THROW(decodeInChunks(*decoder, damaged, 1000), std::runtime_error);
+}
+
+/* Data that needs more memory to decompress than allowed is rejected. */
+TEST(Compression, XzMemoryLimit) {
+  // The default preset uses an 8 MiB dictionary.
+  const std::string compressed = Compression::compress(Compression::kXz, std::string(100000, 'x'));
+
+  auto decoder = Compression::decoder(Compression::kXz, 1U << 20U);
+  EXPECT_THROW(decodeInChunks(*decoder, compressed, 1000), std::runtime_error);
+
+  decoder = Compression::decoder(Compression::kXz);
+  EXPECT_EQ(decodeInChunks(*decoder, compressed, 1000), std::string(100000, 'x'));
+}
+
+TEST(Compression, Unsupported) {
+  EXPECT_TRUE(Compression::supported(Compression::kXz));
+  EXPECT_FALSE(Compression::supported("rar"));
+  EXPECT_EQ(Compression::decoder("rar"), nullptr);
+  EXPECT_THROW(Compression::compress("rar", "data"), std::runtime_error);
+}
+
+#ifndef __NO_MAIN__
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+#endif
@@ -0,0 +1,248 @@
+#include "downloadpipeline.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include "logging/logging.h"
+
+static double toSeconds(std::chrono::nanoseconds time) { return std::chrono::duration<double>(time).count(); }
+
+static double mibPerSecond(uint64_t bytes, std::chrono::nanoseconds time) {
+  const double seconds = toSeconds(time);
+  return seconds > 0 ? static_cast<double>(bytes) / (1 << 20) / seconds : 0.;
+}
+
+static double percentOf(std::chrono::nanoseconds part, std::chrono::nanoseconds whole) {
+  return whole.count() > 0 ? 100. * toSeconds(part) / toSeconds(whole) : 0.;
+}
+
+// The rate of a stage is computed over the time it was busy, so the slowest
+// stage is the one that is busy for most of the download.
+std::string DownloadStats::toString() const {
+  std::ostringstream os;
+  os << std::fixed << std::setprecision(1);
+  os << "received " << static_cast<double>(received_bytes) / (1 << 20) << " MiB in " << toSeconds(duration) << " s ("
+     << mibPerSecond(received_bytes, duration) << " MiB/s), write " << mibPerSecond(written_bytes, write_time)
+     << " MiB/s (busy " << percentOf(write_time, duration) << "%), hash " << mibPerSecond(hashed_bytes, hash_time)
+     << " MiB/s (busy " << percentOf(hash_time, duration) << "%), network paused " << pauses << " times for "
+     << toSeconds(paused_time) << " s";
+  return os.str();
+}
+
+DownloadPipeline::DownloadPipeline(std::ostream& output, MultiPartHasher& hasher, uint64_t start_offset,
+                                   HashedCb hashed_cb)
+    : output_(output),
+      hasher_(hasher),
+      start_offset_(start_offset),
+      hashed_cb_(std::move(hashed_cb)),
+      ring_(kBlockCount),
+      start_(std::chrono::steady_clock::now()) {
+  writer_ = std::thread(&DownloadPipeline::writeLoop, this);
+  hasher_thread_ = std::thread(&DownloadPipeline::hashLoop, this);
+}
+
+DownloadPipeline::~DownloadPipeline() { finish(); }
+
+DownloadPipeline::PushResult DownloadPipeline::push(const char* data, size_t size, bool wait) {
+  if (failed_) {
+    return PushResult::kFailed;
+  }
+  if (size > available() && !wait && size <= kBlockSize * kBlockCount) {
+    if (!full_) {
+      full_ = true;
+      full_since_ = std::chrono::steady_clock::now();
+      ++stats_.pauses;
+    }
+    return PushResult::kFull;
+  }
+  if (full_) {
+    full_ = false;
+    stats_.paused_time += std::chrono::steady_clock::now() - full_since_;
+  }
+
+  // Without waiting, there is room for everything at this point.
+  while (size > 0) {
+    if (available() == 0) {
+      std::unique_lock<std::mutex> lk(m_);
+      cv_.wait(lk, [this] { return available() > 0 || failed_; });
+      if (failed_) {
+        return PushResult::kFailed;
+      }
+    }
+    Block& block = ring_[published_.load(std::memory_order_relaxed) % kBlockCount];
+    if (block.data.empty()) {
+      block.data.resize(kBlockSize);
+    }
+    const size_t n = std::min(size, kBlockSize - fill_);
+    std::memcpy(block.data.data() + fill_, data, n);
+    fill_ += n;
+    data += n;
+    size -= n;
+    stats_.received_bytes += n;
+    if (fill_ == kBlockSize) {
+      publish();
+    }
+  }
+  return PushResult::kAccepted;
+}
+
+bool DownloadPipeline::hasRoom() {
+  const bool room = failed_ || available() >= kBlockSize * kBlockCount / 4;
+  if (room && full_) {
+    full_ = false;
+    stats_.paused_time += std::chrono::steady_clock::now() - full_since_;
+  } else if (!room && !full_) {
+    // The producer pauses on this answer without having been refused by push().
+    full_ = true;
+    full_since_ = std::chrono::steady_clock::now();
+    ++stats_.pauses;
+  }
+  return room;
+}
+
+void DownloadPipeline::notifyWhenRoom(std::function<void()> room_cb) {
+  {
+    std::lock_guard<std::mutex> lk(m_);
+    room_cb_ = std::move(room_cb);
+  }
+  checkRoom();
+}
+
+bool DownloadPipeline::finish() {
+  if (finished_) {
+    return !failed_;
+  }
+  finished_ = true;
+
+  if (fill_ > 0) {
+    publish();
+  }
+  closed_ = true;
+  notify();
+  writer_.join();
+  hasher_thread_.join();
+  {
+    std::lock_guard<std::mutex> lk(m_);
+    room_cb_ = nullptr;
+  }
+
+  if (full_) {
+    full_ = false;
+    stats_.paused_time += std::chrono::steady_clock::now() - full_since_;
+  }
+  stats_.duration = std::chrono::steady_clock::now() - start_;
+  stats_.written_bytes = written_bytes_;
+  stats_.write_time = write_time_;
+  stats_.hashed_bytes = hashed_bytes_;
+  stats_.hash_time = hash_time_;
+  return !failed_;
+}
+
+DownloadPipeline::Stats DownloadPipeline::stats() const { return stats_; }
+
+size_t DownloadPipeline::available() const {
+  // Blocks that were handed over and are not done by both consumers yet. The
+  // block being filled can be used if it is not one of them.
+  const uint64_t done = std::min(written_.load(), hashed_.load());
+  const uint64_t in_use = published_.load(std::memory_order_relaxed) - done;
+  if (in_use >= kBlockCount) {
+    return 0;
+  }
+  return static_cast<size_t>(kBlockCount - in_use) * kBlockSize - fill_;
+}
+
+uint64_t DownloadPipeline::freeBlocks() const {
+  const uint64_t done = std::min(written_.load(), hashed_.load());
+  const uint64_t in_use = published_.load() - done;
+  return in_use >= kBlockCount ? 0 : kBlockCount - in_use;
+}
+
+// With more than a quarter of the blocks free, available() exceeds what
+// hasRoom() asks for whatever the fill of the current block.
+void DownloadPipeline::checkRoom() {
+  std::function<void()> room_cb;
+  {
+    std::lock_guard<std::mutex> lk(m_);
+    if (!room_cb_ || (!failed_ && freeBlocks() <= kBlockCount / 4)) {
+      return;
+    }
+    room_cb = std::move(room_cb_);
+    room_cb_ = nullptr;
+  }
+  room_cb();
+}
+
+void DownloadPipeline::publish() {
+  const uint64_t current = published_.load(std::memory_order_relaxed);
+  ring_[current % kBlockCount].size = fill_;
+  fill_ = 0;
+  published_.store(current + 1);
+  notify();
+}
+
+void DownloadPipeline::notify() {
+  {
+    std::lock_guard<std::mutex> lk(m_);
+  }
+  cv_.notify_all();
+}
+
+bool DownloadPipeline::waitForBlock(uint64_t consumed) {
+  std::unique_lock<std::mutex> lk(m_);
+  cv_.wait(lk, [this, consumed] { return published_.load() > consumed || closed_; });
+  return published_.load() > consumed;
+}
+
+void DownloadPipeline::writeLoop() {
+  uint64_t consumed = 0;
+  while (waitForBlock(consumed)) {
+    const Block& block = ring_[consumed % kBlockCount];
+    if (!failed_) {
+      const auto start = std::chrono::steady_clock::now();
+      output_.write(block.data.data(), static_cast<std::streamsize>(block.size));
+      output_.flush();
+      write_time_ += std::chrono::steady_clock::now() - start;
+      if (!output_.good()) {
+        LOG_ERROR << "Could not write downloaded data to disk";
+        failed_ = true;
+      } else {
+        written_bytes_ += block.size;
+      }
+    }
+    written_ = ++consumed;
+    notify();
+    checkRoom();
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  output_.flush();
+  write_time_ += std::chrono::steady_clock::now() - start;
+}
+
+void DownloadPipeline::hashLoop() {
+  uint64_t consumed = 0;
+  while (waitForBlock(consumed)) {
+    const Block& block = ring_[consumed % kBlockCount];
+    const auto start = std::chrono::steady_clock::now();
+    hasher_.update(reinterpret_cast<const unsigned char*>(block.data.data()), block.size);
+    hash_time_ += std::chrono::steady_clock::now() - start;
+    hashed_bytes_ += block.size;
+    if (hashed_cb_) {
+      // The writer goes through every block, also after a failure.
+      {
+        std::unique_lock<std::mutex> lk(m_);
+        cv_.wait(lk, [this, consumed] { return written_.load() > consumed; });
+      }
+      try {
+        hashed_cb_(start_offset_ + hashed_bytes_);
+      } catch (const std::exception& e) {
+        LOG_WARNING << "Error after hashing downloaded data: " << e.what();
+      }
+    }
+    hashed_ = ++consumed;
+    notify();
+    checkRoom();
+  }
+}
@@ -0,0 +1,128 @@
+#ifndef DOWNLOADPIPELINE_H_
+#define DOWNLOADPIPELINE_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "crypto/crypto.h"
+#include "libaktualizr/packagemanagerinterface.h"
+
+/**
+ * Writes and hashes downloaded data on two threads of their own, so that slow
+ * storage or an expensive hash does not hold back the network transfer.
+ *
+ * The producer (a curl write callback) copies data into a ring of fixed-size
+ * blocks. Every complete block is handed to the writer and the hasher through
+ * atomic counters, without taking a lock on the data path. When the ring is
+ * full, push() refuses the data so that the transfer can be paused until
+ * hasRoom() reports free space again, which notifyWhenRoom() tells right away.
+ *
+ * All producer-side methods must be called from a single thread.
+ */
+class DownloadPipeline {
+ public:
+  enum class PushResult { kAccepted, kFull, kFailed };
+
+  using Stats = DownloadStats;
+
+  // Called from the hashing thread with the total number of hashed bytes,
+  // including the start offset, after every block. By then the block has also
+  // been written to the output and flushed, so that a hasher checkpoint taken
+  // here never covers more than the output holds.
+  using HashedCb = std::function<void(uint64_t hashed_size)>;
+
+  static constexpr size_t kBlockSize = 256 << 10;
+  static constexpr size_t kBlockCount = 64;
+
+  DownloadPipeline(std::ostream& output, MultiPartHasher& hasher, uint64_t start_offset, HashedCb hashed_cb = nullptr);
+  ~DownloadPipeline();
+  DownloadPipeline(const DownloadPipeline&) = delete;
+  DownloadPipeline(DownloadPipeline&&) = delete;
+  DownloadPipeline& operator=(const DownloadPipeline&) = delete;
+  DownloadPipeline& operator=(DownloadPipeline&&) = delete;
+
+  /**
+   * Accept all of `data` or none of it. With `wait` set, or if the data can
+   * never fit in the ring, blocks until there is room instead of returning
+   * kFull. Returns kFailed once writing has failed.
+   */
+  PushResult push(const char* data, size_t size, bool wait);
+  /**
+   * Whether the producer may go on. A producer that pauses on a false result
+   * is counted in the stats as if push() had refused its data.
+   */
+  bool hasRoom();
+  /**
+   * Call `room_cb` once, from any thread, as soon as hasRoom() would return
+   * true, which may be right away. Replaces an earlier callback that was not
+   * called yet.
+   */
+  void notifyWhenRoom(std::function<void()> room_cb);
+  /**
+   * Hand over the last partial block and wait until all accepted data has
+   * been written and hashed. Returns false if writing failed. Idempotent.
+   */
+  bool finish();
+  /** Only complete after finish(). */
+  Stats stats() const;
+
+ private:
+  struct Block {
+    std::vector<char> data;
+    size_t size{0};
+  };
+
+  size_t available() const;
+  // Blocks that are done by both consumers, counting the one being filled.
+  // Unlike available(), this can be called from any thread.
+  uint64_t freeBlocks() const;
+  // Call room_cb_ if there is room, from any thread.
+  void checkRoom();
+  void publish();
+  void notify();
+  void writeLoop();
+  void hashLoop();
+  // Wait until `published_` exceeds `consumed` or the pipeline is closed.
+  bool waitForBlock(uint64_t consumed);
+
+  std::ostream& output_;
+  MultiPartHasher& hasher_;
+  const uint64_t start_offset_;
+  HashedCb hashed_cb_;
+  std::vector<Block> ring_;
+
+  // Counts of blocks handed over by the producer and done by each consumer.
+  std::atomic<uint64_t> published_{0};
+  std::atomic<uint64_t> written_{0};
+  std::atomic<uint64_t> hashed_{0};
+  std::atomic<bool> closed_{false};
+  std::atomic<bool> failed_{false};
+  // Only used to sleep while there is nothing to do, and to guard room_cb_.
+  std::mutex m_;
+  std::condition_variable cv_;
+  std::function<void()> room_cb_;
+
+  // Producer state.
+  size_t fill_{0};
+  bool finished_{false};
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::steady_clock::time_point full_since_;
+  bool full_{false};
+  Stats stats_;
+  uint64_t written_bytes_{0};
+  std::chrono::nanoseconds write_time_{0};
+  uint64_t hashed_bytes_{0};
+  std::chrono::nanoseconds hash_time_{0};
+
+  std::thread writer_;
+  std::thread hasher_thread_;
+};
+
+#endif  // DOWNLOADPIPELINE_H_
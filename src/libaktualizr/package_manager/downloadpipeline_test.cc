@@ -0,0 +1,215 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <thread>
+
+#include "crypto/crypto.h"
+#include "package_manager/downloadpipeline.h"
+#include "utilities/utils.h"
+
+static constexpr size_t kRingSize = DownloadPipeline::kBlockSize * DownloadPipeline::kBlockCount;
+
+// Push like a curl write callback that pauses the transfer when the pipeline is full.
+static void pushAll(DownloadPipeline& pipeline, const std::string& data, size_t chunk) {
+  for (size_t pos = 0; pos < data.size();) {
+    const size_t size = std::min(chunk, data.size() - pos);
+    const auto result = pipeline.push(&data[pos], size, false);
+    ASSERT_NE(result, DownloadPipeline::PushResult::kFailed);
+    if (result == DownloadPipeline::PushResult::kFull) {
+      while (!pipeline.hasRoom()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      continue;
+    }
+    pos += size;
+  }
+}
+
+/* Downloaded data is written and hashed completely and in order. */
+TEST(DownloadPipeline, WriteAndHash) {
+  std::string data;
+  while (data.size() < kRingSize + 12345) {
+    data += Utils::randomUuid();
+  }
+
+  std::ostringstream output;
+  MultiPartSHA256Hasher hasher;
+  uint64_t last_hashed = 0;
+  DownloadPipeline pipeline(output, hasher, 100, [&last_hashed](uint64_t hashed_size) { last_hashed = hashed_size; });
+  pushAll(pipeline, data, 16381);
+  EXPECT_TRUE(pipeline.finish());
+
+  EXPECT_EQ(output.str(), data);
+  EXPECT_EQ(hasher.getHash(), Hash::generate(Hash::Type::kSha256, data));
+  EXPECT_EQ(last_hashed, 100 + data.size());
+  const auto stats = pipeline.stats();
+  EXPECT_EQ(stats.received_bytes, data.size());
+  EXPECT_EQ(stats.written_bytes, data.size());
+  EXPECT_EQ(stats.hashed_bytes, data.size());
+}
+
+class GatedHasher : public MultiPartSHA256Hasher {
+ public:
+  explicit GatedHasher(std::shared_future<void> gate) : gate_(std::move(gate)) {}
+  void update(const unsigned char* part, uint64_t size) override {
+    gate_.wait();
+    MultiPartSHA256Hasher::update(part, size);
+  }
+
+ private:
+  std::shared_future<void> gate_;
+};
+
+/* A slow stage makes the pipeline refuse data until it has caught up. */
+TEST(DownloadPipeline, Backpressure) {
+  std::promise<void> open_gate;
+  std::ostringstream output;
+  GatedHasher hasher(open_gate.get_future().share());
+  DownloadPipeline pipeline(output, hasher, 0);
+
+  const std::string block(DownloadPipeline::kBlockSize, 'x');
+  for (size_t i = 0; i < DownloadPipeline::kBlockCount; ++i) {
+    EXPECT_EQ(pipeline.push(block.data(), block.size(), false), DownloadPipeline::PushResult::kAccepted);
+  }
+  EXPECT_EQ(pipeline.push("y", 1, false), DownloadPipeline::PushResult::kFull);
+  EXPECT_FALSE(pipeline.hasRoom());
+
+  open_gate.set_value();
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (!pipeline.hasRoom() && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ(pipeline.push("y", 1, false), DownloadPipeline::PushResult::kAccepted);
+  EXPECT_TRUE(pipeline.finish());
+
+  EXPECT_EQ(output.str().size(), kRingSize + 1);
+  const auto stats = pipeline.stats();
+  EXPECT_EQ(stats.pauses, 1);
+  EXPECT_EQ(stats.hashed_bytes, kRingSize + 1);
+}
+
+/* A producer that checks for room before pushing has its pauses counted too. */
+TEST(DownloadPipeline, PauseOnHasRoom) {
+  std::promise<void> open_gate;
+  std::ostringstream output;
+  GatedHasher hasher(open_gate.get_future().share());
+  DownloadPipeline pipeline(output, hasher, 0);
+
+  const std::string block(DownloadPipeline::kBlockSize, 'x');
+  for (size_t i = 0; i < DownloadPipeline::kBlockCount; ++i) {
+    EXPECT_EQ(pipeline.push(block.data(), block.size(), false), DownloadPipeline::PushResult::kAccepted);
+  }
+  EXPECT_FALSE(pipeline.hasRoom());
+  EXPECT_FALSE(pipeline.hasRoom());
+
+  open_gate.set_value();
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (!pipeline.hasRoom() && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_TRUE(pipeline.finish());
+
+  const auto stats = pipeline.stats();
+  EXPECT_EQ(stats.pauses, 1);
+  EXPECT_GT(stats.paused_time.count(), 0);
+}
+
+/* A producer that pauses is told as soon as there is room again. */
+TEST(DownloadPipeline, NotifyWhenRoom) {
+  std::promise<void> open_gate;
+  std::ostringstream output;
+  GatedHasher hasher(open_gate.get_future().share());
+  DownloadPipeline pipeline(output, hasher, 0);
+
+  const std::string block(DownloadPipeline::kBlockSize, 'x');
+  for (size_t i = 0; i < DownloadPipeline::kBlockCount; ++i) {
+    EXPECT_EQ(pipeline.push(block.data(), block.size(), false), DownloadPipeline::PushResult::kAccepted);
+  }
+  EXPECT_EQ(pipeline.push("y", 1, false), DownloadPipeline::PushResult::kFull);
+  std::promise<void> room;
+  auto room_future = room.get_future();
+  pipeline.notifyWhenRoom([&room]() { room.set_value(); });
+  EXPECT_EQ(room_future.wait_for(std::chrono::milliseconds(100)), std::future_status::timeout);
+
+  open_gate.set_value();
+  ASSERT_EQ(room_future.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+  EXPECT_TRUE(pipeline.hasRoom());
+
+  // With room already, the callback is called right away.
+  bool called = false;
+  pipeline.notifyWhenRoom([&called]() { called = true; });
+  EXPECT_TRUE(called);
+  EXPECT_EQ(pipeline.push("y", 1, false), DownloadPipeline::PushResult::kAccepted);
+  EXPECT_TRUE(pipeline.finish());
+  EXPECT_EQ(pipeline.stats().pauses, 1);
+}
+
+// Takes a while for every write and only counts data as stored on a flush.
+class SlowFlushingBuf : public std::streambuf {
+ public:
+  std::atomic<uint64_t> flushed{0};
+
+ protected:
+  std::streamsize xsputn(const char* /*s*/, std::streamsize n) override {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    pending_ += static_cast<uint64_t>(n);
+    return n;
+  }
+  int sync() override {
+    flushed += pending_;
+    pending_ = 0;
+    return 0;
+  }
+
+ private:
+  uint64_t pending_{0};
+};
+
+/* The hashed size is only reported once the output holds that much, even if
+ * the hasher is ahead of the writer, so that a checkpoint never covers data
+ * missing from the file. */
+TEST(DownloadPipeline, HashedSizeIsFlushed) {
+  SlowFlushingBuf buf;
+  std::ostream output(&buf);
+  MultiPartSHA256Hasher hasher;
+  size_t reports = 0;
+  DownloadPipeline pipeline(output, hasher, 100, [&buf, &reports](uint64_t hashed_size) {
+    EXPECT_LE(hashed_size - 100, buf.flushed.load());
+    ++reports;
+  });
+
+  const std::string block(DownloadPipeline::kBlockSize, 'x');
+  for (size_t i = 0; i < DownloadPipeline::kBlockCount / 2; ++i) {
+    EXPECT_EQ(pipeline.push(block.data(), block.size(), true), DownloadPipeline::PushResult::kAccepted);
+  }
+  EXPECT_TRUE(pipeline.finish());
+  EXPECT_EQ(reports, DownloadPipeline::kBlockCount / 2);
+  EXPECT_EQ(buf.flushed.load(), DownloadPipeline::kBlockSize * DownloadPipeline::kBlockCount / 2);
+}
+
+/* A write error is reported to the producer and by finish(). */
+TEST(DownloadPipeline, WriteFailure) {
+  std::ofstream output("/nonexistent/directory/file");
+  MultiPartSHA256Hasher hasher;
+  DownloadPipeline pipeline(output, hasher, 0);
+
+  const std::string block(DownloadPipeline::kBlockSize, 'x');
+  EXPECT_EQ(pipeline.push(block.data(), block.size(), true), DownloadPipeline::PushResult::kAccepted);
+  EXPECT_FALSE(pipeline.finish());
+  EXPECT_EQ(pipeline.push("y", 1, true), DownloadPipeline::PushResult::kFailed);
+  EXPECT_EQ(pipeline.stats().written_bytes, 0);
+}
+
+#ifndef __NO_MAIN__
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+#endif
@@ -7,8 +7,10 @@
 #include <string>
 #include <thread>
 
+#include <boost/algorithm/hex.hpp>
 #include <boost/process.hpp>
 
+#include "crypto/crypto.h"
 #include "crypto/keymanager.h"
 #include "http/httpclient.h"
 #include "httpfake.h"
@@ -20,6 +22,7 @@
 #include "test_utils.h"
 #include "uptane/fetcher.h"
 #include "uptane/tuf.h"
+#include "uptane_repo.h"
 #include "utilities/apiqueue.h"
 
 static const int pause_after = 50;        // percent
@@ -132,6 +135,368 @@ TEST(Fetcher, PauseBinary) {
   test_pause(target);
 }
 
+/* Download a binary target in concurrent byte ranges.
+ * Pause and resume a download in byte ranges. */
+TEST(Fetcher, SegmentedBinary) {
+  Json::Value target_json;
+  target_json["hashes"]["sha256"] = "dd7bd1c37a3226e520b8d6939c30991b1c08772d5dab62b381c3a63541dc629a";
+  target_json["length"] = 100 * (1 << 20);
+  Uptane::Target target("large_file", target_json);
+
+  config.pacman.download_segments = 4;
+  test_pause(target);
+  config.pacman.download_segments = 1;
+}
+
+// Serves a file over a single connection only.
+class HttpNoRanges : public HttpFake {
+ public:
+  HttpNoRanges(const boost::filesystem::path& test_dir_in, std::string content_in)
+      : HttpFake(test_dir_in), content(std::move(content_in)) {}
+  HttpResponse download(const std::string& url, curl_write_callback write_cb, curl_xferinfo_callback progress_cb,
+                        void* userp, curl_off_t from) override {
+    (void)url;
+    (void)progress_cb;
+    for (auto pos = static_cast<size_t>(from); pos < content.size(); pos += 1 << 16) {
+      std::string chunk = content.substr(pos, 1 << 16);
+      write_cb(&chunk[0], 1, chunk.size(), userp);
+    }
+    return HttpResponse("", 200, CURLE_OK, "");
+  }
+
+  const std::string content;
+};
+
+/* Fall back to a single connection if the server doesn't support byte ranges. */
+TEST(Fetcher, SegmentedFallback) {
+  TemporaryDirectory temp_dir;
+  config.storage.path = temp_dir.Path();
+  config.pacman.images_path = temp_dir.Path() / "images";
+  config.uptane.repo_server = server;
+  config.pacman.download_segments = 4;
+
+  std::string content;
+  while (content.size() < 20 * (1 << 20)) {
+    content += Utils::randomUuid();
+  }
+  std::shared_ptr<INvStorage> storage(new SQLStorage(config.storage, false));
+  auto http = std::make_shared<HttpNoRanges>(temp_dir.Path(), content);
+  auto pacman = std::make_shared<PackageManagerFake>(config.pacman, config.bootloader, storage, http);
+  KeyManager keys(storage, config.keymanagerConfig());
+  Uptane::Fetcher fetcher(config, http);
+  config.pacman.download_segments = 1;
+
+  Json::Value target_json;
+  target_json["hashes"]["sha256"] = boost::algorithm::hex(Crypto::sha256digest(content));
+  target_json["length"] = Json::UInt64(content.size());
+  Uptane::Target target("fake_file", target_json);
+  EXPECT_TRUE(pacman->fetchTarget(target, fetcher, keys, progress_cb, nullptr));
+  EXPECT_EQ(pacman->verifyTarget(target), TargetStatus::kGood);
+  EXPECT_EQ(Utils::readFile(pacman->checkTargetFile(target)->second), content);
+}
+
+/* Report the throughput of the stages of a download. */
+TEST(Fetcher, DownloadStats) {
+  TemporaryDirectory temp_dir;
+  config.storage.path = temp_dir.Path();
+  config.pacman.images_path = temp_dir.Path() / "images";
+  config.uptane.repo_server = server;
+
+  std::string content;
+  while (content.size() < 3 * (1 << 20)) {
+    content += Utils::randomUuid();
+  }
+  std::shared_ptr<INvStorage> storage(new SQLStorage(config.storage, false));
+  auto http = std::make_shared<HttpNoRanges>(temp_dir.Path(), content);
+  auto pacman = std::make_shared<PackageManagerFake>(config.pacman, config.bootloader, storage, http);
+  KeyManager keys(storage, config.keymanagerConfig());
+  Uptane::Fetcher fetcher(config, http);
+
+  Json::Value target_json;
+  target_json["hashes"]["sha256"] = boost::algorithm::hex(Crypto::sha256digest(content));
+  target_json["length"] = Json::UInt64(content.size());
+  Uptane::Target target("fake_file", target_json);
+  EXPECT_FALSE(pacman->getDownloadStats(target));
+  EXPECT_TRUE(pacman->fetchTarget(target, fetcher, keys, progress_cb, nullptr));
+
+  const auto stats = pacman->getDownloadStats(target);
+  ASSERT_TRUE(stats);
+  EXPECT_EQ(stats->received_bytes, content.size());
+  EXPECT_EQ(stats->written_bytes, content.size());
+  EXPECT_EQ(stats->hashed_bytes, content.size());
+  EXPECT_GT(stats->duration.count(), 0);
+  EXPECT_GT(stats->write_time.count(), 0);
+  EXPECT_GT(stats->hash_time.count(), 0);
+  EXPECT_NE(stats->toString().find("received 3."), std::string::npos);
+}
+
+// Serves byte ranges of a file in small chunks, stopping when asked to.
+class HttpRanges : public HttpFake {
+ public:
+  HttpRanges(const boost::filesystem::path& test_dir_in, std::string content_in)
+      : HttpFake(test_dir_in), content(std::move(content_in)) {}
+  HttpResponse download(const std::string& url, curl_write_callback write_cb, curl_xferinfo_callback progress_cb,
+                        void* userp, curl_off_t from) override {
+    return downloadRange(url, write_cb, progress_cb, userp, from, static_cast<curl_off_t>(content.size()) - 1);
+  }
+  HttpResponse downloadRange(const std::string& url, curl_write_callback write_cb, curl_xferinfo_callback progress_cb,
+                             void* userp, curl_off_t from, curl_off_t to) override {
+    (void)url;
+    for (auto pos = static_cast<size_t>(from); pos <= static_cast<size_t>(to); pos += 1 << 16) {
+      std::string chunk = content.substr(pos, std::min<size_t>(1 << 16, static_cast<size_t>(to) + 1 - pos));
+      if (write_cb(&chunk[0], 1, chunk.size(), userp) != chunk.size()) {
+        return HttpResponse("", 206, CURLE_WRITE_ERROR, "");
+      }
+      if (progress_cb(userp, 0, 0, 0, 0) != 0) {
+        return HttpResponse("", 206, CURLE_ABORTED_BY_CALLBACK, "");
+      }
+    }
+    return HttpResponse("", 206, CURLE_OK, "");
+  }
+
+  const std::string content;
+};
+
+/* A segmented download that fails with an exception leaves only the hashed
+ * prefix in the file, without any gap, and can be resumed from there. */
+TEST(Fetcher, SegmentedFailureKeepsPrefix) {
+  TemporaryDirectory temp_dir;
+  config.storage.path = temp_dir.Path();
+  config.pacman.images_path = temp_dir.Path() / "images";
+  config.uptane.repo_server = server;
+  config.pacman.download_segments = 4;
+
+  std::string content;
+  while (content.size() < 20 * (1 << 20)) {
+    content += Utils::randomUuid();
+  }
+  std::shared_ptr<INvStorage> storage(new SQLStorage(config.storage, false));
+  auto http = std::make_shared<HttpRanges>(temp_dir.Path(), content);
+  auto pacman = std::make_shared<PackageManagerFake>(config.pacman, config.bootloader, storage, http);
+  KeyManager keys(storage, config.keymanagerConfig());
+  Uptane::Fetcher fetcher(config, http);
+  config.pacman.download_segments = 1;
+
+  Json::Value target_json;
+  target_json["hashes"]["sha256"] = boost::algorithm::hex(Crypto::sha256digest(content));
+  target_json["length"] = Json::UInt64(content.size());
+  Uptane::Target target("fake_file", target_json);
+  auto failing_cb = [](const Uptane::Target& /*target*/, const std::string& /*description*/, unsigned int progress) {
+    if (progress >= 50) {
+      throw std::runtime_error("progress callback failure");
+    }
+  };
+  EXPECT_FALSE(pacman->fetchTarget(target, fetcher, keys, failing_cb, nullptr));
+
+  const auto partial = pacman->checkTargetFile(target);
+  ASSERT_TRUE(partial);
+  EXPECT_LT(partial->first, content.size());
+  EXPECT_EQ(Utils::readFile(partial->second), content.substr(0, partial->first));
+  EXPECT_FALSE(storage->loadTargetFilePrefix(target.filename(), nullptr));
+  EXPECT_EQ(pacman->verifyTarget(target), TargetStatus::kIncomplete);
+
+  EXPECT_TRUE(pacman->fetchTarget(target, fetcher, keys, nullptr, nullptr));
+  EXPECT_EQ(pacman->verifyTarget(target), TargetStatus::kGood);
+  EXPECT_EQ(Utils::readFile(pacman->checkTargetFile(target)->second), content);
+}
+
+/* A segmented download that was interrupted by a crash is resumed from the
+ * recorded prefix, not from the end of the data written past it. */
+TEST(Fetcher, SegmentedCrashKeepsPrefix) {
+  TemporaryDirectory temp_dir;
+  config.storage.path = temp_dir.Path();
+  config.pacman.images_path = temp_dir.Path() / "images";
+  config.uptane.repo_server = server;
+
+  std::string content;
+  while (content.size() < 20 * (1 << 20)) {
+    content += Utils::randomUuid();
+  }
+  std::shared_ptr<INvStorage> storage(new SQLStorage(config.storage, false));
+  auto http = std::make_shared<HttpRanges>(temp_dir.Path(), content);
+  auto pacman = std::make_shared<PackageManagerFake>(config.pacman, config.bootloader, storage, http);
+  KeyManager keys(storage, config.keymanagerConfig());
+  Uptane::Fetcher fetcher(config, http);
+
+  Json::Value target_json;
+  target_json["hashes"]["sha256"] = boost::algorithm::hex(Crypto::sha256digest(content));
+  target_json["length"] = Json::UInt64(content.size());
+  Uptane::Target target("fake_file", target_json);
+
+  // The first segment got 5 MiB before the crash, and the next one had
+  // written 3 MiB at its offset with a gap in between.
+  const size_t prefix = 5 * (1 << 20);
+  {
+    std::ofstream file = pacman->createTargetFile(target);
+    file << content.substr(0, prefix) << std::string(2 * (1 << 20), '\0') << content.substr(7 * (1 << 20), 3 << 20);
+  }
+  storage->storeTargetFilePrefix(target.filename(), prefix);
+
+  EXPECT_TRUE(pacman->fetchTarget(target, fetcher, keys, nullptr, nullptr));
+  EXPECT_EQ(pacman->verifyTarget(target), TargetStatus::kGood);
+  EXPECT_EQ(Utils::readFile(pacman->checkTargetFile(target)->second), content);
+  EXPECT_FALSE(storage->loadTargetFilePrefix(target.filename(), nullptr));
+}
+
+// Serves the files of a generated repository and records what was downloaded.
+class HttpRepoFiles : public HttpFake {
+ public:
+  HttpRepoFiles(const boost::filesystem::path& test_dir_in, const boost::filesystem::path& repo_dir)
+      : HttpFake(test_dir_in, "", repo_dir) {}
+  HttpResponse download(const std::string& url, curl_write_callback write_cb, curl_xferinfo_callback progress_cb,
+                        void* userp, curl_off_t from) override {
+    requested.push_back(url);
+    return HttpFake::download(url, write_cb, progress_cb, userp, from);
+  }
+
+  std::vector<std::string> requested;
+};
+
+/* Rebuild a binary Target from a delta patch against the image it replaces.
+ * Download the full image if the rebuilt one doesn't match. */
+TEST(Fetcher, DeltaBinary) {
+  TemporaryDirectory temp_dir;
+  config.storage.path = temp_dir.Path();
+  config.pacman.images_path = temp_dir.Path() / "images";
+
+  std::string base;
+  while (base.size() < 200000) {
+    base += Utils::randomUuid();
+  }
+  std::string image = base;
+  image.replace(10000, 7, "changed");
+  image.insert(150000, "inserted");
+  Utils::writeFile(temp_dir / "v1.img", base);
+  Utils::writeFile(temp_dir / "v2.img", image);
+
+  UptaneRepo repo(temp_dir.Path(), "", "");
+  repo.generateRepo(KeyType::kED25519);
+  repo.addImage(temp_dir / "v1.img", "firmware-v1", "primary_hw");
+  Json::Value custom;
+  custom["delta"] = repo.addDeltaPatch(temp_dir / "v1.img", temp_dir / "v2.img", "firmware-v2");
+  repo.addImage(temp_dir / "v2.img", "firmware-v2", "primary_hw", "", 0, Delegation(), custom);
+  const Json::Value targets =
+      Utils::parseJSONFile(temp_dir.Path() / ImageRepo::dir / "targets.json")["signed"]["targets"];
+  const Uptane::Target base_target("firmware-v1", targets["firmware-v1"]);
+  const Uptane::Target target("firmware-v2", targets["firmware-v2"]);
+
+  std::shared_ptr<INvStorage> storage(new SQLStorage(config.storage, false));
+  auto http = std::make_shared<HttpRepoFiles>(temp_dir.Path(), temp_dir.Path() / "repo");
+  config.uptane.repo_server = http->tls_server + "/repo";
+  auto pacman = std::make_shared<PackageManagerFake>(config.pacman, config.bootloader, storage, http);
+  KeyManager keys(storage, config.keymanagerConfig());
+  Uptane::Fetcher fetcher(config, http);
+  ASSERT_TRUE(pacman->fetchTarget(base_target, fetcher, keys, progress_cb, nullptr));
+
+  http->requested.clear();
+  EXPECT_TRUE(pacman->fetchTarget(target, fetcher, keys, progress_cb, nullptr));
+  EXPECT_EQ(http->requested, std::vector<std::string>{config.uptane.repo_server + "/targets/firmware-v2.delta"});
+  const std::string target_path = pacman->checkTargetFile(target)->second;
+  EXPECT_EQ(Utils::readFile(target_path), image);
+  EXPECT_EQ(pacman->verifyTarget(target), TargetStatus::kGood);
+  EXPECT_FALSE(boost::filesystem::exists(target_path + ".delta"));
+  const auto stats = pacman->getDownloadStats(target);
+  ASSERT_TRUE(stats);
+  EXPECT_EQ(stats->written_bytes, image.size());
+  EXPECT_EQ(stats->hashed_bytes, image.size());
+
+  pacman->removeTargetFile(target);
+  Utils::writeFile(pacman->checkTargetFile(base_target)->second, "x" + base.substr(1));
+  http->requested.clear();
+  EXPECT_TRUE(pacman->fetchTarget(target, fetcher, keys, progress_cb, nullptr));
+  EXPECT_EQ(http->requested.size(), 2);
+  EXPECT_EQ(Utils::readFile(pacman->checkTargetFile(target)->second), image);
+}
+
+/* Find the base of a delta patch whose file is named after a SHA-512 hash. */
+TEST(Fetcher, DeltaBinarySha512Base) {
+  TemporaryDirectory temp_dir;
+  config.storage.path = temp_dir.Path();
+  config.pacman.images_path = temp_dir.Path() / "images";
+
+  std::string base;
+  while (base.size() < 200000) {
+    base += Utils::randomUuid();
+  }
+  std::string image = base;
+  image.replace(10000, 7, "changed");
+  Utils::writeFile(temp_dir / "v1.img", base);
+  Utils::writeFile(temp_dir / "v2.img", image);
+
+  UptaneRepo repo(temp_dir.Path(), "", "");
+  repo.generateRepo(KeyType::kED25519);
+  repo.addImage(temp_dir / "v1.img", "firmware-v1", "primary_hw");
+  Json::Value custom;
+  custom["delta"] = repo.addDeltaPatch(temp_dir / "v1.img", temp_dir / "v2.img", "firmware-v2");
+  repo.addImage(temp_dir / "v2.img", "firmware-v2", "primary_hw", "", 0, Delegation(), custom);
+  const Json::Value targets =
+      Utils::parseJSONFile(temp_dir.Path() / ImageRepo::dir / "targets.json")["signed"]["targets"];
+  Json::Value base_json;
+  base_json["hashes"]["sha512"] = Crypto::sha512digestHex(base);
+  base_json["length"] = Json::UInt64(base.size());
+  const Uptane::Target base_target("firmware-v1", base_json);
+  const Uptane::Target target("firmware-v2", targets["firmware-v2"]);
+
+  std::shared_ptr<INvStorage> storage(new SQLStorage(config.storage, false));
+  auto http = std::make_shared<HttpRepoFiles>(temp_dir.Path(), temp_dir.Path() / "repo");
+  config.uptane.repo_server = http->tls_server + "/repo";
+  auto pacman = std::make_shared<PackageManagerFake>(config.pacman, config.bootloader, storage, http);
+  KeyManager keys(storage, config.keymanagerConfig());
+  Uptane::Fetcher fetcher(config, http);
+  ASSERT_TRUE(pacman->fetchTarget(base_target, fetcher, keys, progress_cb, nullptr));
+  EXPECT_EQ(boost::filesystem::path(pacman->checkTargetFile(base_target)->second).filename().string().size(), 128U);
+
+  http->requested.clear();
+  EXPECT_TRUE(pacman->fetchTarget(target, fetcher, keys, progress_cb, nullptr));
+  EXPECT_EQ(http->requested, std::vector<std::string>{config.uptane.repo_server + "/targets/firmware-v2.delta"});
+  EXPECT_EQ(Utils::readFile(pacman->checkTargetFile(target)->second), image);
+}
+
+/* Download a compressed variant of a binary Target and decompress it on the way.
+ * Download the plain image if the decompressed one doesn't match. */
+TEST(Fetcher, CompressedBinary) {
+  TemporaryDirectory temp_dir;
+  config.storage.path = temp_dir.Path();
+  config.pacman.images_path = temp_dir.Path() / "images";
+
+  std::string image;
+  while (image.size() < 300000) {
+    image += "firmware block " + std::to_string(image.size() % 1000) + "\n";
+  }
+  Utils::writeFile(temp_dir / "firmware.img", image);
+  UptaneRepo repo(temp_dir.Path(), "", "");
+  repo.generateRepo(KeyType::kED25519);
+  Json::Value custom;
+  custom["compressed"] = repo.addCompressedImage(temp_dir / "firmware.img", "firmware", "xz");
+  repo.addImage(temp_dir / "firmware.img", "firmware", "primary_hw", "", 0, Delegation(), custom);
+  const Json::Value targets =
+      Utils::parseJSONFile(temp_dir.Path() / ImageRepo::dir / "targets.json")["signed"]["targets"];
+  const Uptane::Target target("firmware", targets["firmware"]);
+  EXPECT_LT(targets["firmware"]["custom"]["compressed"]["length"].asUInt64(), image.size() / 10);
+
+  std::shared_ptr<INvStorage> storage(new SQLStorage(config.storage, false));
+  auto http = std::make_shared<HttpRepoFiles>(temp_dir.Path(), temp_dir.Path() / "repo");
+  config.uptane.repo_server = http->tls_server + "/repo";
+  auto pacman = std::make_shared<PackageManagerFake>(config.pacman, config.bootloader, storage, http);
+  KeyManager keys(storage, config.keymanagerConfig());
+  Uptane::Fetcher fetcher(config, http);
+
+  EXPECT_TRUE(pacman->fetchTarget(target, fetcher, keys, progress_cb, nullptr));
+  EXPECT_EQ(http->requested, std::vector<std::string>{config.uptane.repo_server + "/targets/firmware.xz"});
+  EXPECT_EQ(Utils::readFile(pacman->checkTargetFile(target)->second), image);
+  EXPECT_EQ(pacman->verifyTarget(target), TargetStatus::kGood);
+
+  pacman->removeTargetFile(target);
+  const boost::filesystem::path compressed_path = temp_dir.Path() / ImageRepo::dir / "targets/firmware.xz";
+  std::string damaged = Utils::readFile(compressed_path);
+  damaged[damaged.size() / 2] = static_cast<char>(damaged[damaged.size() / 2] ^ 0xff);
+  Utils::writeFile(compressed_path, damaged);
+  http->requested.clear();
+  EXPECT_TRUE(pacman->fetchTarget(target, fetcher, keys, progress_cb, nullptr));
+  EXPECT_EQ(http->requested.size(), 2);
+  EXPECT_EQ(Utils::readFile(pacman->checkTargetFile(target)->second), image);
+}
+
 class HttpCustomUri : public HttpFake {
  public:
   HttpCustomUri(const boost::filesystem::path& test_dir_in) : HttpFake(test_dir_in) {}
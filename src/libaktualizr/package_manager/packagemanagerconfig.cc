@@ -15,6 +15,12 @@ void PackageConfig::updateFromPropertyTree(const boost::property_tree::ptree& pt
       CopyFromConfig(images_path, cp.first, pt);
     } else if (cp.first == "packages_file") {
       CopyFromConfig(packages_file, cp.first, pt);
+    } else if (cp.first == "download_segments") {
+      CopyFromConfig(download_segments, cp.first, pt);
+    } else if (cp.first == "images_max_size") {
+      CopyFromConfig(images_max_size, cp.first, pt);
+    } else if (cp.first == "images_max_age") {
+      CopyFromConfig(images_max_age, cp.first, pt);
     } else if (cp.first == "fake_need_reboot") {
       CopyFromConfig(fake_need_reboot, cp.first, pt);
     } else if (cp.first == "booted") {
@@ -32,6 +38,9 @@ void PackageConfig::writeToStream(std::ostream& out_stream) const {
   writeOption(out_stream, ostree_server, "ostree_server");
   writeOption(out_stream, images_path, "images_path");
   writeOption(out_stream, packages_file, "packages_file");
+  writeOption(out_stream, download_segments, "download_segments");
+  writeOption(out_stream, images_max_size, "images_max_size");
+  writeOption(out_stream, images_max_age, "images_max_age");
   writeOption(out_stream, fake_need_reboot, "fake_need_reboot");
   writeOption(out_stream, booted, "booted");
 
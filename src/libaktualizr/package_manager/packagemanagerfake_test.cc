@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 
+#include <fstream>
 #include <iostream>
 #include <memory>
 #include <sstream>
@@ -14,6 +15,7 @@
 #include "libaktualizr/types.h"
 #include "package_manager/packagemanagerfake.h"
 #include "storage/invstorage.h"
+#include "storage/sqlstorage.h"
 #include "uptane/fetcher.h"
 #include "utilities/utils.h"
 
@@ -157,6 +159,64 @@ TEST(PackageManagerFake, Verify) {
   whandle.write(content, length);
   whandle.close();
   EXPECT_EQ(fakepm.verifyTarget(target), TargetStatus::kGood);
+
+  // The verified file is remembered until it is modified.
+  VerifiedTargetFile verified;
+  ASSERT_TRUE(storage->loadVerifiedTargetFile(target.filename(), &verified));
+  EXPECT_EQ(verified.size, length);
+  EXPECT_EQ(verified.hash, Hash(Hash::Type::kSha256, hash));
+  EXPECT_EQ(fakepm.verifyTarget(target), TargetStatus::kGood);
+
+  const auto path = fakepm.checkTargetFile(target)->second;
+  const auto mtime = boost::filesystem::last_write_time(path);
+  {
+    std::fstream fs(path, std::ios::binary | std::ios::in | std::ios::out);
+    fs.write(content_bad, 1);
+  }
+  // Make sure the change is visible even on filesystems with coarse timestamps.
+  boost::filesystem::last_write_time(path, mtime + 10);
+  EXPECT_EQ(fakepm.verifyTarget(target), TargetStatus::kHashMismatch);
+}
+
+class SQLStorageBrokenVerifiedFiles : public SQLStorage {
+ public:
+  using SQLStorage::SQLStorage;
+  void storeVerifiedTargetFile(const std::string &targetname, const VerifiedTargetFile &file) const override {
+    (void)targetname;
+    (void)file;
+    throw SQLException("storeVerifiedTargetFile failed");
+  }
+  bool loadVerifiedTargetFile(const std::string &targetname, VerifiedTargetFile *file) const override {
+    (void)targetname;
+    (void)file;
+    throw SQLException("loadVerifiedTargetFile failed");
+  }
+};
+
+/* A storage error on the record of verified files falls back to hashing the
+ * whole file. */
+TEST(PackageManagerFake, VerifyStorageError) {
+  TemporaryDirectory temp_dir;
+  Config config;
+  config.pacman.type = PACKAGE_MANAGER_NONE;
+  config.pacman.images_path = temp_dir.Path() / "images";
+  config.storage.path = temp_dir.Path();
+  auto storage = std::make_shared<SQLStorageBrokenVerifiedFiles>(config.storage, false);
+
+  Uptane::EcuMap primary_ecu{{Uptane::EcuSerial("primary"), Uptane::HardwareIdentifier("primary_hw")}};
+  const std::string content = "good";
+  Uptane::Target target("some-pkg", primary_ecu, {Hash::generate(Hash::Type::kSha256, content)}, content.size());
+
+  PackageManagerFake fakepm(config.pacman, config.bootloader, storage, nullptr);
+  auto whandle = fakepm.createTargetFile(target);
+  whandle.write(content.data(), static_cast<std::streamsize>(content.size()));
+  whandle.close();
+  EXPECT_EQ(fakepm.verifyTarget(target), TargetStatus::kGood);
+
+  whandle = fakepm.createTargetFile(target);
+  whandle.write("bad!", 4);
+  whandle.close();
+  EXPECT_EQ(fakepm.verifyTarget(target), TargetStatus::kHashMismatch);
 }
 
 TEST(PackageManagerFake, FinalizeAfterReboot) {
@@ -1,13 +1,28 @@
 #include "libaktualizr/packagemanagerinterface.h"
 
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <sys/statvfs.h>
+#include <unistd.h>
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/filesystem.hpp>
+#include <cerrno>
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <future>
+#include <mutex>
 
 #include "crypto/crypto.h"
 #include "crypto/keymanager.h"
 #include "http/httpclient.h"
 #include "logging/logging.h"
+#include "package_manager/bindelta.h"
+#include "package_manager/compression.h"
+#include "package_manager/downloadpipeline.h"
+#include "package_manager/targetcache.h"
 #include "storage/invstorage.h"
 #include "uptane/exceptions.h"
 #include "uptane/fetcher.h"
@@ -21,6 +36,12 @@ struct DownloadMetaStruct {
         token{token_in},
         progress_cb{std::move(progress_cb_in)},
         time_lastreport{std::chrono::steady_clock::now()} {}
+  // The pipeline uses the hashers, so it has to be stopped first.
+  ~DownloadMetaStruct() { pipeline.reset(); }
+  DownloadMetaStruct(const DownloadMetaStruct&) = delete;
+  DownloadMetaStruct(DownloadMetaStruct&&) = delete;
+  DownloadMetaStruct& operator=(const DownloadMetaStruct&) = delete;
+  DownloadMetaStruct& operator=(DownloadMetaStruct&&) = delete;
   uintmax_t downloaded_length{0};
   unsigned int last_progress{0};
   std::ofstream fhandle;
@@ -40,12 +61,65 @@ struct DownloadMetaStruct {
   FetcherProgressCb progress_cb;
   // each LogProgressInterval msec log dowload progress for big files
   std::chrono::time_point<std::chrono::steady_clock> time_lastreport;
+  // Hasher checkpoints are persisted here while downloading, if set.
+  const INvStorage* storage{nullptr};
+  uintmax_t checkpoint_length{0};
+  // The hash of the bytes before the checkpoint was not computed from the file.
+  bool resumed_from_checkpoint{false};
+  // Writes and hashes the data received by DownloadHandler.
+  std::unique_ptr<DownloadPipeline> pipeline;
+  // Set while a compressed variant of the Target is downloaded, of which
+  // `received_length` out of `compressed_length` bytes have been received.
+  std::unique_ptr<StreamDecoder> decoder;
+  uintmax_t received_length{0};
+  uintmax_t compressed_length{0};
+
+  // Must be called from the thread that owns the hasher, once the first
+  // `hashed_size` bytes have been written to the file and flushed.
+  void checkpointHasher(uintmax_t hashed_size) {
+    if (storage == nullptr) {
+      return;
+    }
+    try {
+      storage->storeTargetHasherCheckpoint(target.filename(), {hash_type, hashed_size, hasher().saveState()});
+      checkpoint_length = hashed_size;
+    } catch (const std::exception& e) {
+      LOG_WARNING << "Could not store hasher checkpoint for " << target.filename() << ": " << e.what();
+    }
+  }
+
+  void startPipeline() {
+    pipeline = std_::make_unique<DownloadPipeline>(fhandle, hasher(), downloaded_length, [this](uint64_t hashed_size) {
+      if (hashed_size - checkpoint_length >= HasherCheckpointInterval) {
+        checkpointHasher(hashed_size);
+      }
+    });
+  }
+
+  // The hash of everything handed to the hasher. Finalizing the hasher can
+  // only be done once, so the result is kept.
+  const Hash& digest() {
+    if (!digest_) {
+      digest_ = Hash(hash_type, hasher().getHexDigest());
+    }
+    return *digest_;
+  }
+
+  static constexpr uintmax_t HasherCheckpointInterval = 64 << 20;
 
  private:
   MultiPartSHA256Hasher sha256_hasher;
   MultiPartSHA512Hasher sha512_hasher;
+  boost::optional<Hash> digest_;
 };
 
+// Pauses the transfer until the pipeline has room again. The pipeline threads
+// can't unpause it themselves, so they wake up the thread of the transfer.
+static size_t pauseUntilRoom(DownloadMetaStruct& ds) {
+  ds.pipeline->notifyWhenRoom([resumer = HttpClient::currentResumer()]() { resumer->resume(); });
+  return CURL_WRITEFUNC_PAUSE;
+}
+
 static size_t DownloadHandler(char* contents, size_t size, size_t nmemb, void* userp) {
   assert(userp);
   auto* ds = static_cast<DownloadMetaStruct*>(userp);
@@ -55,49 +129,677 @@ static size_t DownloadHandler(char* contents, size_t size, size_t nmemb, void* u
     return downloaded + 1;  // curl will abort if return unexpected size;
   }
 
-  ds->fhandle.write(contents, static_cast<std::streamsize>(downloaded));
-  ds->hasher().update(reinterpret_cast<const unsigned char*>(contents), downloaded);
+  // A transfer can only be resumed from its own thread, so block if the data
+  // doesn't come from one that can be paused.
+  const bool can_pause = HttpClient::currentTransfer() != nullptr;
+  switch (ds->pipeline->push(contents, downloaded, !can_pause)) {
+    case DownloadPipeline::PushResult::kFull:
+      return pauseUntilRoom(*ds);
+    case DownloadPipeline::PushResult::kFailed:
+      return downloaded + 1;
+    default:
+      break;
+  }
   ds->downloaded_length += downloaded;
   return downloaded;
 }
 
+// The decompressed size of the data is not known up front, so the transfer
+// is paused before decoding while the pipeline is short of room, and the
+// decoded data is pushed in full.
+static size_t CompressedDownloadHandler(char* contents, size_t size, size_t nmemb, void* userp) {
+  assert(userp);
+  auto* ds = static_cast<DownloadMetaStruct*>(userp);
+  const size_t received = size * nmemb;
+  if (HttpClient::currentTransfer() != nullptr && !ds->pipeline->hasRoom()) {
+    return pauseUntilRoom(*ds);
+  }
+  if (ds->received_length + received > ds->compressed_length) {
+    LOG_WARNING << "The compressed variant of " << ds->target.filename() << " is longer than expected";
+    return received + 1;
+  }
+
+  try {
+    ds->decoder->decode(contents, received, [ds](const char* data, size_t length) {
+      if (ds->downloaded_length + length > ds->target.length()) {
+        throw std::runtime_error("the decompressed data is longer than the Target");
+      }
+      if (ds->pipeline->push(data, length, true) == DownloadPipeline::PushResult::kFailed) {
+        throw std::runtime_error("could not write the decompressed data");
+      }
+      ds->downloaded_length += length;
+    });
+  } catch (const std::runtime_error& e) {
+    LOG_WARNING << "Could not decompress " << ds->target.filename() << ": " << e.what();
+    return received + 1;
+  }
+  ds->received_length += received;
+  return received;
+}
+
 static constexpr int64_t LogProgressInterval = 15000;
 
+static void reportProgress(DownloadMetaStruct& ds, uint64_t received) {
+  uint64_t expected = ds.target.length();
+  auto progress = static_cast<unsigned int>((received * 100) / expected);
+  if (ds.progress_cb && progress > ds.last_progress) {
+    ds.last_progress = progress;
+    ds.progress_cb(ds.target, "Downloading", progress);
+    // OTA-4864:Improve binary file download progress logging. Report each XX sec report event that notify user
+    auto now = std::chrono::steady_clock::now();
+    auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(now - ds.time_lastreport);
+    if (milliseconds.count() > LogProgressInterval) {
+      LOG_INFO << "Download progress for file " << ds.target.filename() << ": " << progress << "%";
+      ds.time_lastreport = now;
+    }
+  }
+}
+
 static int ProgressHandler(void* clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow) {
   (void)dltotal;
   (void)dlnow;
   (void)ultotal;
   (void)ulnow;
   auto* ds = static_cast<DownloadMetaStruct*>(clientp);
-
-  uint64_t expected = ds->target.length();
-  auto progress = static_cast<unsigned int>((ds->downloaded_length * 100) / expected);
-  if (ds->progress_cb && progress > ds->last_progress) {
-    ds->last_progress = progress;
-    ds->progress_cb(ds->target, "Downloading", progress);
-    // OTA-4864:Improve binary file download progress logging. Report each XX sec report event that notify user
-    auto now = std::chrono::steady_clock::now();
-    auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(now - ds->time_lastreport);
-    if (milliseconds.count() > LogProgressInterval) {
-      LOG_INFO << "Download progress for file " << ds->target.filename() << ": " << progress << "%";
-      ds->time_lastreport = now;
-    }
-  }
+  reportProgress(*ds, ds->downloaded_length);
   if (ds->token != nullptr && ds->token->hasAborted()) {
     return 1;
   }
   return 0;
 }
 
-static void restoreHasherState(MultiPartHasher& hasher, std::ifstream data) {
-  static constexpr size_t buf_len = 1024;
-  std::array<uint8_t, buf_len> buf{};
+static void updateHasher(MultiPartHasher& hasher, std::istream& data) {
+  static constexpr size_t buf_len = 1 << 16;
+  std::vector<uint8_t> buf(buf_len);
   do {
-    data.read(reinterpret_cast<char*>(buf.data()), buf.size());
+    data.read(reinterpret_cast<char*>(buf.data()), static_cast<std::streamsize>(buf.size()));
     hasher.update(buf.data(), static_cast<uint64_t>(data.gcount()));
   } while (data.gcount() != 0);
 }
 
+// Brings the hasher up to the end of a partially downloaded file, starting
+// from the last persisted checkpoint if it is usable.
+static void restoreHasherState(DownloadMetaStruct& ds, const INvStorage& storage, std::ifstream data) {
+  TargetHasherCheckpoint checkpoint;
+  bool usable = false;
+  try {
+    usable = storage.loadTargetHasherCheckpoint(ds.target.filename(), &checkpoint) && checkpoint.type == ds.hash_type;
+  } catch (const std::exception& e) {
+    LOG_WARNING << "Could not load the hash checkpoint of " << ds.target.filename() << ": " << e.what();
+  }
+  if (usable && checkpoint.offset > ds.downloaded_length) {
+    // The file lost data that was hashed already, so nothing before the end
+    // of the file can be trusted to match the checkpoint.
+    LOG_WARNING << "The hash checkpoint of " << ds.target.filename() << " at byte " << checkpoint.offset
+                << " is beyond the end of the file at byte " << ds.downloaded_length << ", rehashing it";
+    usable = false;
+  }
+  if (usable && ds.hasher().restoreState(checkpoint.state)) {
+    LOG_DEBUG << "Resuming hash of " << ds.target.filename() << " from byte " << checkpoint.offset;
+    data.seekg(static_cast<std::streamoff>(checkpoint.offset));
+    ds.checkpoint_length = checkpoint.offset;
+    ds.resumed_from_checkpoint = checkpoint.offset > 0;
+  } else {
+    ds.hasher().reset();
+  }
+  updateHasher(ds.hasher(), data);
+}
+
+// Cuts a Target file back to its contiguous prefix if a segmented download of
+// it was interrupted without doing so.
+static void restoreTargetFilePrefix(const INvStorage& storage, const std::string& targetname,
+                                    const std::string& path) {
+  try {
+    uint64_t prefix = 0;
+    if (!storage.loadTargetFilePrefix(targetname, &prefix)) {
+      return;
+    }
+    boost::system::error_code ec;
+    const uintmax_t size = boost::filesystem::file_size(path, ec);
+    if (!ec && size > prefix) {
+      LOG_INFO << "Keeping the first " << prefix << " bytes of the interrupted download of " << targetname;
+      boost::filesystem::resize_file(path, prefix, ec);
+    }
+    if (ec) {
+      LOG_WARNING << "Could not cut back " << path << ": " << ec.message();
+      return;
+    }
+    storage.clearTargetFilePrefix(targetname);
+  } catch (const std::exception& e) {
+    LOG_WARNING << "Could not restore the downloaded prefix of " << targetname << ": " << e.what();
+  }
+}
+
+// Segments of a Target downloaded concurrently with byte range requests.
+static constexpr uint64_t MinSegmentSize = 4 << 20;
+
+// Every segment is written in place, at its offset in the Target file. Until
+// the file is cut back to the hashed prefix, the storage tells how much of it
+// is contiguous, so that a resume after a crash doesn't take the gaps between
+// the segments for downloaded data.
+struct SegmentedDownload {
+  explicit SegmentedDownload(const api::FlowControlToken* token_in) : token{token_in} {}
+  ~SegmentedDownload() {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+  SegmentedDownload(const SegmentedDownload&) = delete;
+  SegmentedDownload(SegmentedDownload&&) = delete;
+  SegmentedDownload& operator=(const SegmentedDownload&) = delete;
+  SegmentedDownload& operator=(SegmentedDownload&&) = delete;
+
+  void notify() {
+    {
+      std::lock_guard<std::mutex> lk(m);
+    }
+    cv.notify_all();
+  }
+
+  int fd{-1};
+  const api::FlowControlToken* token;
+  std::atomic<bool> range_unsupported{false};
+  std::atomic<bool> write_failed{false};
+  // Makes the remaining transfers give up, once the contiguous prefix can't grow anymore.
+  std::atomic<bool> stop{false};
+  std::mutex m;
+  std::condition_variable cv;
+};
+
+struct DownloadSegment {
+  DownloadSegment(SegmentedDownload& parent_in, uint64_t begin_in, uint64_t end_in)
+      : parent{parent_in}, begin{begin_in}, end{end_in} {}
+  SegmentedDownload& parent;
+  const uint64_t begin;
+  const uint64_t end;
+  std::atomic<uint64_t> received{0};
+  bool range_checked{false};
+};
+
+static size_t SegmentHandler(char* contents, size_t size, size_t nmemb, void* userp) {
+  assert(userp);
+  auto* seg = static_cast<DownloadSegment*>(userp);
+  SegmentedDownload& sd = seg->parent;
+  const size_t downloaded = size * nmemb;
+
+  // A server that ignores the range sends the whole file from the start.
+  CURL* transfer = HttpClient::currentTransfer();
+  if (!seg->range_checked && transfer != nullptr) {
+    seg->range_checked = true;
+    long http_code = 0;  // NOLINT(google-runtime-int)
+    curl_easy_getinfo(transfer, CURLINFO_RESPONSE_CODE, &http_code);
+    if (http_code != 206) {
+      sd.range_unsupported = true;
+      return downloaded + 1;
+    }
+  }
+
+  const uint64_t received = seg->received;
+  if (received + downloaded > seg->end - seg->begin) {
+    return downloaded + 1;
+  }
+  size_t written = 0;
+  while (written < downloaded) {
+    const ssize_t res = ::pwrite(sd.fd, contents + written, downloaded - written,
+                                 static_cast<off_t>(seg->begin + received + written));
+    if (res < 0 && errno != EINTR) {
+      LOG_ERROR << "Could not write downloaded data to disk: " << std::strerror(errno);
+      sd.write_failed = true;
+      return downloaded + 1;
+    }
+    written += static_cast<size_t>(std::max<ssize_t>(res, 0));
+  }
+  seg->received = received + downloaded;
+  sd.notify();
+  return downloaded;
+}
+
+static int SegmentProgressHandler(void* clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal,
+                                  curl_off_t ulnow) {
+  (void)dltotal;
+  (void)dlnow;
+  (void)ultotal;
+  (void)ulnow;
+  const SegmentedDownload& sd = static_cast<DownloadSegment*>(clientp)->parent;
+  if (sd.stop || (sd.token != nullptr && sd.token->hasAborted())) {
+    return 1;
+  }
+  return 0;
+}
+
+static void readFully(int fd, uint8_t* buf, size_t size, uint64_t offset) {
+  size_t done = 0;
+  while (done < size) {
+    const ssize_t res = ::pread(fd, buf + done, size - done, static_cast<off_t>(offset + done));
+    if (res < 0 && errno == EINTR) {
+      continue;
+    }
+    if (res <= 0) {
+      throw std::runtime_error(std::string("Could not read back downloaded data: ") + std::strerror(errno));
+    }
+    done += static_cast<size_t>(res);
+  }
+}
+
+/**
+ * Download the rest of a Target as up to `max_segments` concurrent byte ranges
+ * into the file at `path`. The hash is computed in order, reading back the
+ * contiguous prefix of the file as it completes.
+ *
+ * Returns false if the download should continue over a single connection
+ * instead. Whether it returns or throws, the file is cut back to the part that
+ * was hashed, and the hasher is checkpointed there for a later resume.
+ */
+static bool fetchSegmented(HttpInterface& http, DownloadMetaStruct& ds, const std::string& url,
+                           const std::string& path, uint64_t max_segments) {
+  const uint64_t length = ds.target.length();
+  for (;;) {
+    const uint64_t start = ds.downloaded_length;
+    const uint64_t count = std::min(max_segments, (length - start) / MinSegmentSize);
+    if (count <= 1 || ds.storage == nullptr) {
+      return false;
+    }
+
+    SegmentedDownload sd(ds.token);
+    sd.fd = ::open(path.c_str(), O_RDWR);
+    if (sd.fd < 0) {
+      throw std::runtime_error("Can't open file " + path);
+    }
+    // Without a record of the prefix, nothing may be written past it.
+    try {
+      ds.storage->storeTargetFilePrefix(ds.target.filename(), start);
+    } catch (const std::exception& e) {
+      LOG_WARNING << "Could not store the downloaded prefix of " << ds.target.filename() << ": " << e.what();
+      return false;
+    }
+    const uint64_t segment_size = (length - start + count - 1) / count;
+    std::vector<std::unique_ptr<DownloadSegment>> segments;
+    for (uint64_t begin = start; begin < length; begin += segment_size) {
+      segments.emplace_back(std_::make_unique<DownloadSegment>(sd, begin, std::min(length, begin + segment_size)));
+    }
+    LOG_DEBUG << "Downloading " << ds.target.filename() << " from byte " << start << " in " << segments.size()
+              << " segments";
+
+    // Declared after `sd`, so that the transfers are waited for before the file is closed.
+    std::vector<std::future<HttpResponse>> responses;
+    for (const auto& seg : segments) {
+      DownloadSegment* s = seg.get();
+      responses.emplace_back(std::async(std::launch::async, [&http, &url, s]() {
+        return http.downloadRange(url, SegmentHandler, SegmentProgressHandler, s, static_cast<curl_off_t>(s->begin),
+                                  static_cast<curl_off_t>(s->end - 1));
+      }));
+    }
+
+    uint64_t hashed = start;
+    // The recorded prefix only grows, so an older one is still correct if
+    // storing a newer one fails.
+    auto checkpoint = [&]() {
+      try {
+        ds.storage->storeTargetFilePrefix(ds.target.filename(), hashed);
+      } catch (const std::exception& e) {
+        LOG_WARNING << "Could not store the downloaded prefix of " << ds.target.filename() << ": " << e.what();
+      }
+      ds.checkpointHasher(hashed);
+    };
+    // Stops the transfers that are still running and cuts the file back to
+    // the hashed prefix, which is all that a later attempt resumes from.
+    // Returns false if the file could not be cut back.
+    auto keepHashedPrefix = [&]() {
+      sd.stop = hashed < length;
+      for (auto& response : responses) {
+        response.wait();
+      }
+      ds.downloaded_length = hashed;
+      if (hashed < length) {
+        if (::ftruncate(sd.fd, static_cast<off_t>(hashed)) != 0) {
+          LOG_WARNING << "Could not truncate " << path << ": " << std::strerror(errno);
+          checkpoint();
+          return false;
+        }
+        ds.checkpointHasher(hashed);
+      }
+      try {
+        ds.storage->clearTargetFilePrefix(ds.target.filename());
+      } catch (const std::exception& e) {
+        LOG_WARNING << "Could not clear the downloaded prefix of " << ds.target.filename() << ": " << e.what();
+      }
+      return true;
+    };
+    try {
+      std::vector<uint8_t> buf(1 << 20);
+      size_t current = 0;
+      while (hashed < length) {
+        const DownloadSegment& seg = *segments[current];
+        const uint64_t available = seg.begin + seg.received - hashed;
+        if (available > 0) {
+          const auto n = static_cast<size_t>(std::min<uint64_t>(available, buf.size()));
+          readFully(sd.fd, buf.data(), n, hashed);
+          ds.hasher().update(buf.data(), n);
+          hashed += n;
+          if (hashed == seg.end) {
+            ++current;
+          }
+          if (hashed - ds.checkpoint_length >= DownloadMetaStruct::HasherCheckpointInterval) {
+            checkpoint();
+          }
+          uint64_t received = start;
+          for (const auto& s : segments) {
+            received += s->received;
+          }
+          reportProgress(ds, received);
+          continue;
+        }
+        // The segment at the end of the prefix has finished without completing
+        // it, unless it received more data after the check above.
+        if (responses[current].wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+          if (seg.begin + seg.received > hashed) {
+            continue;
+          }
+          break;
+        }
+        std::unique_lock<std::mutex> lk(sd.m);
+        sd.cv.wait_for(lk, std::chrono::milliseconds(100),
+                       [&seg, hashed] { return seg.begin + seg.received > hashed; });
+      }
+    } catch (...) {
+      keepHashedPrefix();
+      throw;
+    }
+
+    if (!keepHashedPrefix()) {
+      throw Uptane::Exception("image", "Could not cut back the partially downloaded file");
+    }
+    std::vector<HttpResponse> results;
+    for (auto& response : responses) {
+      results.push_back(response.get());
+    }
+    if (hashed == length) {
+      return true;
+    }
+
+    if (sd.write_failed) {
+      throw Uptane::Exception("image", "Could not write downloaded data to disk");
+    }
+    const bool range_error = std::any_of(results.cbegin(), results.cend(), [](const HttpResponse& r) {
+      return r.curl_code == CURLE_RANGE_ERROR;
+    });
+    if (sd.range_unsupported || range_error) {
+      LOG_WARNING << "The image server doesn't support byte range requests, downloading " << ds.target.filename()
+                  << " over a single connection";
+      return false;
+    }
+    for (const auto& r : results) {
+      if (!r.isOk() && !r.wasInterrupted()) {
+        throw Uptane::Exception("image", "Could not download file, error: " + r.error_message);
+      }
+    }
+    if (ds.token == nullptr || !ds.token->hasAborted()) {
+      throw Uptane::Exception("image", "Could not download file, a segment ended early");
+    }
+    // sleep if paused or abort the download
+    if (!ds.token->canContinue()) {
+      throw Uptane::Exception("image", "Download of a target was aborted");
+    }
+  }
+}
+
+// A Target can also be downloaded as another file that it is rebuilt from,
+// described in its custom metadata:
+//   "delta": {"base_sha256": "<hash>", "base_sha512": "<hash>", "name": "<patch>", "length": <size>,
+//             "uri": "<optional URL>"}
+//   "compressed": {"encoding": "xz", "name": "<file>", "length": <size>, "uri": "<optional URL>"}
+// A delta is a patch against an older image that is still in images_path. The
+// file is fetched from the Image repository next to the Targets unless it has
+// a URL of its own. The rebuilt image is checked against the Target hashes
+// like a downloaded one.
+struct TargetVariant {
+  std::string url;
+  uint64_t length{0};
+  Json::Value meta;
+};
+
+static boost::optional<TargetVariant> getTargetVariant(const Uptane::Target& target, const std::string& key,
+                                                       const std::string& repo_server) {
+  TargetVariant variant;
+  variant.meta = target.custom_data()[key];
+  if (!variant.meta.isObject() || !variant.meta["length"].isIntegral()) {
+    return boost::none;
+  }
+  variant.length = variant.meta["length"].asUInt64();
+  if (variant.meta["uri"].isString() && !variant.meta["uri"].asString().empty()) {
+    variant.url = variant.meta["uri"].asString();
+  } else if (variant.meta["name"].isString() && !variant.meta["name"].asString().empty()) {
+    variant.url = repo_server + "/targets/" + Utils::urlEncode(variant.meta["name"].asString());
+  } else {
+    return boost::none;
+  }
+  // A file that is not smaller than the image is of no use.
+  if (variant.length == 0 || variant.length >= target.length()) {
+    return boost::none;
+  }
+  return variant;
+}
+
+// The hashes of the base image given by the delta metadata, at least one of
+// which is needed.
+static std::vector<std::string> deltaBaseHashes(const TargetVariant& delta) {
+  std::vector<std::string> hashes;
+  for (const char* key : {"base_sha256", "base_sha512"}) {
+    if (delta.meta[key].isString() && !delta.meta[key].asString().empty()) {
+      hashes.push_back(delta.meta[key].asString());
+    }
+  }
+  return hashes;
+}
+
+// Image files are named after the first hash of their Target, which is either
+// a SHA-256 or a SHA-512 one, so the base is looked up by all of its hashes.
+static boost::optional<std::string> findDeltaBase(const INvStorage& storage, const boost::filesystem::path& images_path,
+                                                  const std::vector<std::string>& base_hashes) {
+  for (const auto& entry : storage.loadTargetFileIndex()) {
+    const std::string& filename = entry.filename;
+    const bool matches = std::any_of(base_hashes.cbegin(), base_hashes.cend(), [&filename](const std::string& hash) {
+      return boost::algorithm::iequals(filename, hash);
+    });
+    if (!filename.empty() && matches && boost::filesystem::exists(images_path / filename)) {
+      return (images_path / filename).string();
+    }
+  }
+  return boost::none;
+}
+
+// The patch is kept in a temporary file next to the images.
+struct PatchDownload {
+  PatchDownload(std::string path_in, uint64_t expected_in, const api::FlowControlToken* token_in)
+      : path{std::move(path_in)}, expected{expected_in}, token{token_in} {
+    file.open(path, std::ios::binary | std::ios::trunc);
+  }
+  ~PatchDownload() {
+    file.close();
+    boost::system::error_code ec;
+    boost::filesystem::remove(path, ec);
+  }
+  PatchDownload(const PatchDownload&) = delete;
+  PatchDownload(PatchDownload&&) = delete;
+  PatchDownload& operator=(const PatchDownload&) = delete;
+  PatchDownload& operator=(PatchDownload&&) = delete;
+
+  const std::string path;
+  const uint64_t expected;
+  const api::FlowControlToken* token;
+  std::ofstream file;
+  uint64_t received{0};
+};
+
+static size_t PatchHandler(char* contents, size_t size, size_t nmemb, void* userp) {
+  auto* pd = static_cast<PatchDownload*>(userp);
+  const size_t received = size * nmemb;
+  if (pd->received + received > pd->expected) {
+    return received + 1;
+  }
+  pd->file.write(contents, static_cast<std::streamsize>(received));
+  if (!pd->file.good()) {
+    return received + 1;
+  }
+  pd->received += received;
+  return received;
+}
+
+static int PatchProgressHandler(void* clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal,
+                                curl_off_t ulnow) {
+  (void)dltotal;
+  (void)dlnow;
+  (void)ultotal;
+  (void)ulnow;
+  const auto* pd = static_cast<PatchDownload*>(clientp);
+  return (pd->token != nullptr && pd->token->hasAborted()) ? 1 : 0;
+}
+
+// Downloads the patch and passes the rebuilt image through the pipeline to
+// ds.fhandle. Returns false if that did not result in the Target, leaving what
+// was written for the caller to discard.
+static bool fetchDelta(HttpInterface& http, DownloadMetaStruct& ds, const TargetVariant& delta,
+                       const std::string& base_path, const std::string& patch_path) {
+  PatchDownload pd(patch_path, delta.length, ds.token);
+  if (!pd.file.good()) {
+    LOG_WARNING << "Could not create " << patch_path;
+    return false;
+  }
+  for (;;) {
+    const HttpResponse response = http.download(delta.url, PatchHandler, PatchProgressHandler, &pd,
+                                                static_cast<curl_off_t>(pd.received));
+    if (!response.wasInterrupted()) {
+      if (!response.isOk() || pd.received != pd.expected) {
+        LOG_WARNING << "Could not download the delta patch for " << ds.target.filename() << ": "
+                    << response.getStatusStr();
+        return false;
+      }
+      break;
+    }
+    // sleep if paused or abort the download
+    if (ds.token == nullptr || !ds.token->canContinue()) {
+      throw Uptane::Exception("image", "Download of a target was aborted");
+    }
+  }
+  pd.file.close();
+
+  std::ifstream base(base_path, std::ios::binary);
+  std::ifstream patch(patch_path, std::ios::binary);
+  const uint64_t expected = ds.target.length();
+  ds.startPipeline();
+  try {
+    BinaryDelta::apply(base, patch, [&ds, expected](const char* data, size_t size) {
+      if (ds.downloaded_length + size > expected) {
+        throw std::runtime_error("the rebuilt image is too long");
+      }
+      if (ds.pipeline->push(data, size, true) == DownloadPipeline::PushResult::kFailed) {
+        throw std::runtime_error("could not write the rebuilt image to disk");
+      }
+      ds.downloaded_length += size;
+      reportProgress(ds, ds.downloaded_length);
+    });
+  } catch (const std::runtime_error& e) {
+    ds.pipeline->finish();
+    LOG_WARNING << "Could not apply the delta patch for " << ds.target.filename() << ": " << e.what();
+    return false;
+  }
+  const bool written = ds.pipeline->finish();
+  LOG_DEBUG << "Rebuild stages for " << ds.target.filename() << ": " << ds.pipeline->stats().toString();
+  if (!written) {
+    LOG_WARNING << "Could not write the image rebuilt from the delta patch for " << ds.target.filename();
+    return false;
+  }
+  if (ds.downloaded_length != expected || !ds.target.MatchHash(ds.digest())) {
+    LOG_WARNING << "The image rebuilt from the delta patch doesn't match " << ds.target.filename();
+    return false;
+  }
+  return true;
+}
+
+// Downloads a compressed variant of the Target and decompresses it into the
+// pipeline on the way. Returns false if that did not result in the Target,
+// leaving what was written for the caller to discard.
+static bool fetchCompressed(HttpInterface& http, DownloadMetaStruct& ds, const TargetVariant& compressed) {
+  ds.decoder = Compression::decoder(compressed.meta["encoding"].asString());
+  ds.compressed_length = compressed.length;
+  for (;;) {
+    ds.startPipeline();
+    const HttpResponse response = http.download(compressed.url, CompressedDownloadHandler, ProgressHandler, &ds,
+                                                static_cast<curl_off_t>(ds.received_length));
+    const bool written = ds.pipeline->finish();
+    LOG_DEBUG << "Download stages for " << ds.target.filename() << ": " << ds.pipeline->stats().toString();
+    if (!written) {
+      throw Uptane::Exception("image", "Could not write downloaded data to disk");
+    }
+    if (!response.wasInterrupted()) {
+      if (!response.isOk() || !ds.decoder->finished() || ds.received_length != ds.compressed_length) {
+        LOG_WARNING << "Could not download the compressed variant of " << ds.target.filename() << ": "
+                    << response.getStatusStr();
+        return false;
+      }
+      break;
+    }
+    ds.checkpointHasher(ds.downloaded_length);
+    // sleep if paused or abort the download
+    if (ds.token == nullptr || !ds.token->canContinue()) {
+      throw Uptane::Exception("image", "Download of a target was aborted");
+    }
+  }
+  LOG_INFO << "Received " << ds.received_length << " compressed bytes for " << ds.downloaded_length << " bytes of "
+           << ds.target.filename();
+  if (ds.downloaded_length != ds.target.length() || !ds.target.MatchHash(ds.digest())) {
+    LOG_WARNING << "The decompressed image doesn't match " << ds.target.filename();
+    return false;
+  }
+  return true;
+}
+
+// Reserve the space of the whole file up front, so that it is not fragmented
+// by small allocations. The size of the file is kept, because it tells how
+// much was already downloaded.
+static void preallocateTargetFile(const std::string& path, uint64_t length) {
+  const int fd = ::open(path.c_str(), O_WRONLY);
+  if (fd < 0) {
+    return;
+  }
+  if (::fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(length)) != 0) {
+    LOG_DEBUG << "Could not preallocate " << path << ": " << std::strerror(errno);
+  }
+  ::close(fd);
+}
+
+static constexpr uint64_t kReservedDiskSpace = 1 << 20;
+
+// Whether `required_bytes` fit on the filesystem of `path` and still leave
+// kReservedDiskSpace free. Assumes they do if that can't be told.
+static bool hasDiskSpace(const boost::filesystem::path& path, const uint64_t required_bytes,
+                         uint64_t* available_bytes) {
+  struct statvfs stvfsbuf {};
+  const int stat_res = statvfs(path.c_str(), &stvfsbuf);
+  if (stat_res < 0) {
+    LOG_WARNING << "Unable to read filesystem statistics: error code " << stat_res;
+    return true;
+  }
+  const uint64_t available = (static_cast<uint64_t>(stvfsbuf.f_bsize) * stvfsbuf.f_bavail);
+  if (available_bytes != nullptr) {
+    *available_bytes = available;
+  }
+  return required_bytes + kReservedDiskSpace < available;
+}
+
+// Identity of a file, to tell whether it was modified since it was verified.
+static boost::optional<VerifiedTargetFile> statTargetFile(const std::string& path) {
+  struct stat st {};
+  if (::stat(path.c_str(), &st) != 0) {
+    return boost::none;
+  }
+  VerifiedTargetFile file;
+  file.size = static_cast<uint64_t>(st.st_size);
+  file.mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+  file.inode = static_cast<uint64_t>(st.st_ino);
+  return file;
+}
+
 bool PackageManagerInterface::fetchTarget(const Uptane::Target& target, Uptane::Fetcher& fetcher,
                                           const KeyManager& keys, const FetcherProgressCb& progress_cb,
                                           const api::FlowControlToken* token) {
@@ -107,22 +809,45 @@ bool PackageManagerInterface::fetchTarget(const Uptane::Target& target, Uptane::
     if (target.hashes().empty()) {
       throw Uptane::Exception("image", "No hash defined for the target");
     }
+    {
+      std::lock_guard<std::mutex> guard(cache_mutex_);
+      cache_pins_.insert(target.filename());
+    }
+    {
+      std::lock_guard<std::mutex> guard(download_stats_mutex_);
+      download_stats_.erase(target.filename());
+    }
+    const TargetCache cache(config, *storage_);
+    auto partial = checkTargetFile(target);
+    if (partial) {
+      restoreTargetFilePrefix(*storage_, target.filename(), partial->second);
+    }
     TargetStatus exists = PackageManagerInterface::verifyTarget(target);
+    if (exists == TargetStatus::kNotFound && cache.link(target)) {
+      exists = PackageManagerInterface::verifyTarget(target);
+    }
     if (exists == TargetStatus::kGood) {
       LOG_INFO << "Image already downloaded; skipping download";
+      cache.touch(target.filename(), target.length());
       return true;
     }
     std::unique_ptr<DownloadMetaStruct> ds = std_::make_unique<DownloadMetaStruct>(target, progress_cb, token);
+    ds->storage = storage_.get();
     if (target.length() == 0) {
       LOG_INFO << "Skipping download of target with length 0";
       ds->fhandle = createTargetFile(target);
+      cache.touch(target.filename(), 0);
       return true;
     }
+    auto target_check = checkTargetFile(target);
+    if (exists == TargetStatus::kIncomplete && !target_check) {
+      LOG_WARNING << "The incomplete download of " << target.filename() << " is gone, starting over";
+      exists = TargetStatus::kNotFound;
+    }
     if (exists == TargetStatus::kIncomplete) {
       LOG_INFO << "Continuing incomplete download of file " << target.filename();
-      auto target_check = checkTargetFile(target);
       ds->downloaded_length = target_check->first;
-      ::restoreHasherState(ds->hasher(), openTargetFile(target));
+      ::restoreHasherState(*ds, *storage_, openTargetFile(target));
       ds->fhandle = appendTargetFile(target);
     } else {
       // If the target was found, but is oversized or the hash doesn't match,
@@ -132,6 +857,11 @@ bool PackageManagerInterface::fetchTarget(const Uptane::Target& target, Uptane::
     }
 
     const uint64_t required_bytes = target.length() - ds->downloaded_length;
+    {
+      std::lock_guard<std::mutex> guard(cache_mutex_);
+      cache.evict(required_bytes, cache_pins_,
+                  [this](uint64_t bytes) { return hasDiskSpace(config.images_path, bytes, nullptr); });
+    }
     if (!checkAvailableDiskSpace(required_bytes)) {
       throw std::runtime_error("Insufficient disk space available to download target");
     }
@@ -141,23 +871,96 @@ bool PackageManagerInterface::fetchTarget(const Uptane::Target& target, Uptane::
       target_url = fetcher.getRepoServer() + "/targets/" + Utils::urlEncode(target.filename());
     }
 
+    auto preallocate = [&]() {
+      const auto file = checkTargetFile(target);
+      if (file) {
+        preallocateTargetFile(file->second, target.length());
+      }
+    };
+    preallocate();
+
+    // Discard what was written by an attempt that didn't result in the Target.
+    auto startOver = [&]() {
+      ds = std_::make_unique<DownloadMetaStruct>(target, progress_cb, token);
+      ds->storage = storage_.get();
+      ds->fhandle = createTargetFile(target);
+    };
+    bool downloaded = false;
+    auto delta = getTargetVariant(target, "delta", fetcher.getRepoServer());
+    const auto target_file = checkTargetFile(target);
+    if (delta && !deltaBaseHashes(*delta).empty() && exists != TargetStatus::kIncomplete && target_file) {
+      const std::string& target_path = target_file->second;
+      auto base = findDeltaBase(*storage_, config.images_path, deltaBaseHashes(*delta));
+      if (base && *base != target_path) {
+        LOG_INFO << "Downloading a delta patch of " << delta->length << " bytes for " << target.filename();
+        downloaded = fetchDelta(*http_, *ds, *delta, *base, target_path + ".delta");
+        if (ds->pipeline) {
+          recordDownloadStats(target, ds->pipeline->stats());
+        }
+        if (!downloaded) {
+          LOG_WARNING << "Downloading the full image of " << target.filename() << " instead";
+          startOver();
+        }
+      }
+    }
+    // A compressed download can't be resumed from the decompressed size, so
+    // an incomplete file is continued with the plain image.
+    auto compressed = getTargetVariant(target, "compressed", fetcher.getRepoServer());
+    if (!downloaded && compressed && ds->downloaded_length == 0 &&
+        Compression::supported(compressed->meta["encoding"].asString())) {
+      LOG_INFO << "Downloading " << compressed->meta["encoding"].asString() << " compressed " << target.filename();
+      downloaded = fetchCompressed(*http_, *ds, *compressed);
+      if (ds->pipeline) {
+        recordDownloadStats(target, ds->pipeline->stats());
+      }
+      if (!downloaded) {
+        LOG_WARNING << "Downloading the plain image of " << target.filename() << " instead";
+        startOver();
+      }
+    }
+    if (!downloaded && config.download_segments > 1 && target_file) {
+      ds->fhandle.close();
+      downloaded = fetchSegmented(*http_, *ds, target_url, target_file->second, config.download_segments);
+      if (!downloaded) {
+        ds->fhandle = appendTargetFile(target);
+      }
+    }
+
     HttpResponse response;
-    for (;;) {
+    while (!downloaded) {
+      ds->startPipeline();
       response = http_->download(target_url, DownloadHandler, ProgressHandler, ds.get(),
                                  static_cast<curl_off_t>(ds->downloaded_length));
+      const bool written = ds->pipeline->finish();
+      LOG_DEBUG << "Download stages for " << target.filename() << ": " << ds->pipeline->stats().toString();
+      recordDownloadStats(target, ds->pipeline->stats());
+      if (!written) {
+        throw Uptane::Exception("image", "Could not write downloaded data to disk");
+      }
 
       if (response.curl_code == CURLE_RANGE_ERROR) {
         LOG_WARNING << "The image server doesn't support byte range requests,"
                        " try to download the image from the beginning: "
                     << target_url;
         ds = std_::make_unique<DownloadMetaStruct>(target, progress_cb, token);
+        ds->storage = storage_.get();
         ds->fhandle = createTargetFile(target);
+        preallocate();
         continue;
       }
 
       if (!response.wasInterrupted()) {
+        LOG_TRACE << "Download status: " << response.getStatusStr() << std::endl;
+        if (!response.isOk()) {
+          if (response.curl_code == CURLE_WRITE_ERROR) {
+            throw Uptane::OversizedTarget(target.filename());
+          }
+          throw Uptane::Exception("image", "Could not download file, error: " + response.error_message);
+        }
+        downloaded = true;
         break;
       }
+      ds->checkpointHasher(ds->downloaded_length);
       ds->fhandle.close();
       // sleep if paused or abort the download
       if (!token->canContinue()) {
@@ -165,19 +968,27 @@ bool PackageManagerInterface::fetchTarget(const Uptane::Target& target, Uptane::
       }
       ds->fhandle = appendTargetFile(target);
     }
-    LOG_TRACE << "Download status: " << response.getStatusStr() << std::endl;
-    if (!response.isOk()) {
-      if (response.curl_code == CURLE_WRITE_ERROR) {
-        throw Uptane::OversizedTarget(target.filename());
-      }
-      throw Uptane::Exception("image", "Could not download file, error: " + response.error_message);
-    }
-    if (!target.MatchHash(Hash(ds->hash_type, ds->hasher().getHexDigest()))) {
+    const Hash hash = ds->digest();
+    if (!target.MatchHash(hash)) {
       ds->fhandle.close();
       removeTargetFile(target);
       throw Uptane::TargetHashMismatch(target.filename());
     }
     ds->fhandle.close();
+    // A hash resumed from a checkpoint doesn't vouch for the bytes before it,
+    // so leave it to verifyTarget() to read the whole file once.
+    if (!ds->resumed_from_checkpoint) {
+      auto file = checkTargetFile(target);
+      boost::optional<VerifiedTargetFile> verified;
+      if (file) {
+        verified = statTargetFile(file->second);
+      }
+      if (verified) {
+        verified->hash = hash;
+        storage_->storeVerifiedTargetFile(target.filename(), *verified);
+      }
+    }
+    cache.touch(target.filename(), target.length());
     result = true;
   } catch (const std::exception& e) {
     LOG_WARNING << "Error while downloading a target: " << e.what();
@@ -198,33 +1009,54 @@ TargetStatus PackageManagerInterface::verifyTarget(const Uptane::Target& target)
     return TargetStatus::kOversized;
   }
 
-  // Even if the file exists and the length matches, recheck the hash.
+  // Even if the file exists and the length matches, recheck the hash, unless
+  // the file is untouched since it was last verified. The identity is taken
+  // before hashing so that concurrent modifications invalidate the record.
+  // The record only saves time, so a storage error just means rehashing.
+  auto verified = statTargetFile(target_exists->second);
+  VerifiedTargetFile stored;
+  bool have_stored = false;
+  if (verified) {
+    try {
+      have_stored = storage_->loadVerifiedTargetFile(target.filename(), &stored);
+    } catch (const std::exception& e) {
+      LOG_WARNING << "Could not load the verification record of " << target.filename() << ": " << e.what();
+    }
+  }
+  if (have_stored && stored.size == verified->size && stored.mtime_ns == verified->mtime_ns &&
+      stored.inode == verified->inode && target.MatchHash(stored.hash)) {
+    LOG_DEBUG << "File " << target.filename() << " is unchanged since it was last verified.";
+    return TargetStatus::kGood;
+  }
+
   DownloadMetaStruct ds(target, nullptr, nullptr);
   ds.downloaded_length = target_exists->first;
-  ::restoreHasherState(ds.hasher(), openTargetFile(target));
-  if (!target.MatchHash(Hash(ds.hash_type, ds.hasher().getHexDigest()))) {
+  auto data = openTargetFile(target);
+  updateHasher(ds.hasher(), data);
+  const Hash hash(ds.hash_type, ds.hasher().getHexDigest());
+  if (!target.MatchHash(hash)) {
     LOG_ERROR << "Target exists with expected length, but hash does not match metadata! " << target;
     return TargetStatus::kHashMismatch;
   }
 
+  if (verified) {
+    verified->hash = hash;
+    try {
+      storage_->storeVerifiedTargetFile(target.filename(), *verified);
+    } catch (const std::exception& e) {
+      LOG_WARNING << "Could not store the verification record of " << target.filename() << ": " << e.what();
+    }
+  }
   return TargetStatus::kGood;
 }
 
 bool PackageManagerInterface::checkAvailableDiskSpace(const uint64_t required_bytes) const {
-  struct statvfs stvfsbuf {};
-  const int stat_res = statvfs(config.images_path.c_str(), &stvfsbuf);
-  if (stat_res < 0) {
-    LOG_WARNING << "Unable to read filesystem statistics: error code " << stat_res;
-    return true;
-  }
-  const uint64_t available_bytes = (static_cast<uint64_t>(stvfsbuf.f_bsize) * stvfsbuf.f_bavail);
-  const uint64_t reserved_bytes = 1 << 20;
-
-  if (required_bytes + reserved_bytes < available_bytes) {
+  uint64_t available_bytes = 0;
+  if (hasDiskSpace(config.images_path, required_bytes, &available_bytes)) {
     return true;
   } else {
     LOG_ERROR << "Insufficient disk space available to download target! Required: " << required_bytes
-              << ", available: " << available_bytes << ", reserved: " << reserved_bytes;
+              << ", available: " << available_bytes << ", reserved: " << kReservedDiskSpace;
     return false;
   }
 }
@@ -233,9 +1065,10 @@ boost::optional<std::pair<uintmax_t, std::string>> PackageManagerInterface::chec
     const Uptane::Target& target) const {
   std::string filename = storage_->getTargetFilename(target.filename());
   if (!filename.empty()) {
-    auto path = config.images_path / filename;
-    if (boost::filesystem::exists(path)) {
-      return {{boost::filesystem::file_size(path), path.string()}};
+    const std::string path = (config.images_path / filename).string();
+    auto file = statTargetFile(path);
+    if (file) {
+      return {{file->size, path}};
     }
   }
   return boost::none;
@@ -282,7 +1115,12 @@ void PackageManagerInterface::removeTargetFile(const Uptane::Target& target) {
   if (!file) {
     throw std::runtime_error("File doesn't exist for target " + target.filename());
   }
-  boost::filesystem::remove(file->second);
+  // Targets with the same content share a file, which stays while any of them
+  // is still there.
+  const std::string filename = storage_->getTargetFilename(target.filename());
+  if (TargetCache(config, *storage_).isOnlyUser(target.filename(), filename)) {
+    boost::filesystem::remove(file->second);
+  }
   storage_->deleteTargetInfo(target.filename());
 }
 
@@ -295,3 +1133,36 @@ std::vector<Uptane::Target> PackageManagerInterface::getTargetFiles() {
   }
   return v;
 }
+
+void PackageManagerInterface::maintainTargetCache(const std::vector<Uptane::Target>& batch) {
+  std::lock_guard<std::mutex> guard(cache_mutex_);
+  cache_pins_.clear();
+  for (const auto& target : batch) {
+    cache_pins_.insert(target.filename());
+  }
+  try {
+    const TargetCache cache(config, *storage_);
+    cache.reconcile();
+    cache.evict(0, cache_pins_, nullptr);
+  } catch (const std::exception& e) {
+    LOG_WARNING << "Could not maintain the cache of downloaded Targets: " << e.what();
+  }
+}
+
+TargetCacheStats PackageManagerInterface::getTargetCacheStats() const {
+  return TargetCache(config, *storage_).stats();
+}
+
+boost::optional<DownloadStats> PackageManagerInterface::getDownloadStats(const Uptane::Target& target) const {
+  std::lock_guard<std::mutex> guard(download_stats_mutex_);
+  auto it = download_stats_.find(target.filename());
+  if (it == download_stats_.end()) {
+    return boost::none;
+  }
+  return it->second;
+}
+
+void PackageManagerInterface::recordDownloadStats(const Uptane::Target& target, const DownloadStats& stats) {
+  std::lock_guard<std::mutex> guard(download_stats_mutex_);
+  download_stats_[target.filename()] = stats;
+}
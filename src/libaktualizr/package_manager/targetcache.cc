@@ -0,0 +1,226 @@
+#include "targetcache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <map>
+#include <vector>
+
+#include <boost/algorithm/string/join.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem.hpp>
+
+#include "logging/logging.h"
+#include "storage/invstorage.h"
+
+namespace {
+
+struct CachedFile {
+  std::vector<std::string> names;
+  uint64_t size{0};
+  int64_t last_used{0};
+  bool is_protected{false};
+};
+
+int64_t now() {
+  return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+// Files created by createTargetFile() are named after a SHA-256 or SHA-512
+// hash. Nothing else in images_path is ever removed.
+bool isHashFilename(const std::string& name) {
+  return (name.size() == 64 || name.size() == 128) &&
+         std::all_of(name.begin(), name.end(), [](char c) { return std::isxdigit(static_cast<unsigned char>(c)); });
+}
+
+// Temporary files of downloads are named after the image file with a suffix.
+bool stripTemporarySuffix(std::string& name) {
+  for (const std::string suffix : {".delta", ".segments"}) {
+    if (boost::algorithm::ends_with(name, suffix)) {
+      name.resize(name.size() - suffix.size());
+      return true;
+    }
+  }
+  return false;
+}
+
+std::map<std::string, CachedFile> groupByFile(const std::vector<StoredTargetFile>& index,
+                                              const std::set<std::string>& protected_names) {
+  std::map<std::string, CachedFile> files;
+  for (const auto& entry : index) {
+    CachedFile& file = files[entry.filename];
+    file.names.push_back(entry.targetname);
+    file.size = std::max(file.size, entry.size);
+    file.last_used = std::max(file.last_used, entry.last_used);
+    file.is_protected = file.is_protected || protected_names.count(entry.targetname) != 0;
+  }
+  return files;
+}
+
+}  // namespace
+
+void TargetCache::reconcile() const {
+  std::map<std::string, uint64_t> on_disk;
+  boost::system::error_code ec;
+  for (boost::filesystem::directory_iterator it(config_.images_path, ec), end; !ec && it != end; it.increment(ec)) {
+    if (boost::filesystem::is_regular_file(it->status())) {
+      on_disk[it->path().filename().string()] = boost::filesystem::file_size(it->path(), ec);
+    }
+  }
+
+  const int64_t current_time = now();
+  std::set<std::string> referenced;
+  for (const auto& entry : storage_.loadTargetFileIndex()) {
+    auto found = on_disk.find(entry.filename);
+    if (found == on_disk.end()) {
+      LOG_DEBUG << "File of Target " << entry.targetname << " is gone, removing it from the index";
+      storage_.deleteTargetInfo(entry.targetname);
+      continue;
+    }
+    referenced.insert(entry.filename);
+    // Targets from before the index had times of use start aging now.
+    if (found->second != entry.size || entry.last_used == 0) {
+      storage_.storeTargetFileUsage(entry.targetname, found->second,
+                                    entry.last_used == 0 ? current_time : entry.last_used);
+    }
+  }
+
+  for (const auto& file : on_disk) {
+    std::string hash_name = file.first;
+    if (!stripTemporarySuffix(hash_name) && referenced.count(hash_name) != 0) {
+      continue;
+    }
+    if (isHashFilename(hash_name)) {
+      LOG_INFO << "Removing unused file " << file.first << " from " << config_.images_path;
+      boost::filesystem::remove(config_.images_path / file.first, ec);
+    }
+  }
+}
+
+uint64_t TargetCache::evict(const uint64_t required_bytes, const std::set<std::string>& pinned,
+                            const std::function<bool(uint64_t)>& has_space) const {
+  std::set<std::string> protected_names = installedOrPending();
+  protected_names.insert(pinned.begin(), pinned.end());
+  auto files = groupByFile(storage_.loadTargetFileIndex(), protected_names);
+
+  uint64_t total = 0;
+  std::vector<std::pair<std::string, CachedFile*>> candidates;
+  for (auto& file : files) {
+    total += file.second.size;
+    if (!file.second.is_protected) {
+      candidates.emplace_back(file.first, &file.second);
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(),
+            [](const std::pair<std::string, CachedFile*>& a, const std::pair<std::string, CachedFile*>& b) {
+              return a.second->last_used < b.second->last_used;
+            });
+
+  uint64_t freed = 0;
+  auto evictFile = [&](const std::string& filename, const CachedFile& file, const char* reason) {
+    LOG_INFO << "Evicting " << boost::algorithm::join(file.names, ", ") << " from the Target cache: " << reason;
+    for (const auto& name : file.names) {
+      storage_.deleteTargetInfo(name);
+    }
+    boost::system::error_code ec;
+    boost::filesystem::remove(config_.images_path / filename, ec);
+    total -= file.size;
+    freed += file.size;
+  };
+
+  const int64_t current_time = now();
+  auto it = candidates.begin();
+  if (config_.images_max_age > 0) {
+    const int64_t oldest = current_time - static_cast<int64_t>(config_.images_max_age);
+    for (; it != candidates.end() && it->second->last_used < oldest; ++it) {
+      evictFile(it->first, *it->second, "not used within images_max_age");
+    }
+  }
+
+  auto over_budget = [&]() { return config_.images_max_size > 0 && total + required_bytes > config_.images_max_size; };
+  for (; it != candidates.end(); ++it) {
+    if (over_budget()) {
+      evictFile(it->first, *it->second, "over images_max_size");
+    } else if (has_space && !has_space(required_bytes)) {
+      evictFile(it->first, *it->second, "out of disk space");
+    } else {
+      break;
+    }
+  }
+  if (over_budget()) {
+    LOG_WARNING << "The Target cache exceeds images_max_size, but all of it is in use";
+  }
+  return freed;
+}
+
+bool TargetCache::link(const Uptane::Target& target) const {
+  const std::string filename = target.hashes()[0].HashString();
+  if (!boost::filesystem::exists(config_.images_path / filename)) {
+    return false;
+  }
+  for (const auto& entry : storage_.loadTargetFileIndex()) {
+    if (entry.filename == filename && entry.targetname != target.filename()) {
+      LOG_INFO << "Target " << target.filename() << " has the same content as " << entry.targetname
+               << ", reusing its file";
+      storage_.storeTargetFilename(target.filename(), filename);
+      storage_.storeTargetFileUsage(target.filename(), entry.size, now());
+      return true;
+    }
+  }
+  return false;
+}
+
+void TargetCache::touch(const std::string& targetname, const uint64_t size) const {
+  storage_.storeTargetFileUsage(targetname, size, now());
+}
+
+bool TargetCache::isOnlyUser(const std::string& targetname, const std::string& filename) const {
+  const auto index = storage_.loadTargetFileIndex();
+  return std::none_of(index.begin(), index.end(), [&](const StoredTargetFile& entry) {
+    return entry.filename == filename && entry.targetname != targetname;
+  });
+}
+
+TargetCacheStats TargetCache::stats() const {
+  const auto index = storage_.loadTargetFileIndex();
+  TargetCacheStats stats;
+  stats.targets = index.size();
+  stats.max_size = config_.images_max_size;
+  stats.max_age = config_.images_max_age;
+  for (const auto& file : groupByFile(index, installedOrPending())) {
+    ++stats.files;
+    stats.size += file.second.size;
+    if (file.second.is_protected) {
+      stats.protected_size += file.second.size;
+    }
+  }
+  return stats;
+}
+
+std::set<std::string> TargetCache::installedOrPending() const {
+  std::vector<std::string> serials;
+  EcuSerials ecu_serials;
+  if (storage_.loadEcuSerials(&ecu_serials)) {
+    for (const auto& ecu : ecu_serials) {
+      serials.push_back(ecu.first.ToString());
+    }
+  }
+  if (serials.empty()) {
+    serials.emplace_back("");
+  }
+
+  std::set<std::string> names;
+  for (const auto& serial : serials) {
+    boost::optional<Uptane::Target> current;
+    boost::optional<Uptane::Target> pending;
+    storage_.loadInstalledVersions(serial, &current, &pending);
+    if (current) {
+      names.insert(current->filename());
+    }
+    if (pending) {
+      names.insert(pending->filename());
+    }
+  }
+  return names;
+}
@@ -0,0 +1,62 @@
+#ifndef TARGETCACHE_H_
+#define TARGETCACHE_H_
+
+#include <cstdint>
+#include <functional>
+#include <set>
+#include <string>
+
+#include "libaktualizr/config.h"
+#include "libaktualizr/packagemanagerinterface.h"
+#include "libaktualizr/types.h"
+
+class INvStorage;
+
+/**
+ * Budgets for the downloaded binary Targets in images_path.
+ *
+ * Files are named after the first hash of their Target, so Targets with the
+ * same content under different names share a file. The index in the
+ * target_images table holds the name, file, size and time of last use of every
+ * Target, which is all that eviction needs without touching the filesystem.
+ *
+ * Files of installed or pending Targets on any ECU are never evicted, and
+ * neither are those of the `pinned` Targets passed by the caller.
+ */
+class TargetCache {
+ public:
+  TargetCache(const PackageConfig& config, const INvStorage& storage) : config_(config), storage_(storage) {}
+
+  /**
+   * Sync the index with images_path in a single directory scan: drop Targets
+   * whose file is gone, record the actual sizes and remove files of Targets
+   * that are no longer known, as well as temporary files left by interrupted
+   * downloads. Must not run concurrently with downloads.
+   */
+  void reconcile() const;
+  /**
+   * Evict Targets over the age budget, then the least recently used ones until
+   * `required_bytes` more fit in the size budget and `has_space` (if set)
+   * agrees that they fit on the disk. Returns the number of bytes freed.
+   */
+  uint64_t evict(uint64_t required_bytes, const std::set<std::string>& pinned,
+                 const std::function<bool(uint64_t)>& has_space) const;
+  /**
+   * Make `target` use the file of another Target with the same content, if one
+   * was already downloaded. Returns whether a file was found.
+   */
+  bool link(const Uptane::Target& target) const;
+  /** Record that the file of `targetname` is `size` bytes and was used now. */
+  void touch(const std::string& targetname, uint64_t size) const;
+  /** Whether no Target but `targetname` uses `filename`. */
+  bool isOnlyUser(const std::string& targetname, const std::string& filename) const;
+  TargetCacheStats stats() const;
+
+ private:
+  std::set<std::string> installedOrPending() const;
+
+  const PackageConfig& config_;
+  const INvStorage& storage_;
+};
+
+#endif  // TARGETCACHE_H_
@@ -0,0 +1,175 @@
+#include <gtest/gtest.h>
+
+#include <ctime>
+#include <memory>
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+#include "libaktualizr/config.h"
+#include "libaktualizr/types.h"
+#include "package_manager/packagemanagerfake.h"
+#include "package_manager/targetcache.h"
+#include "storage/invstorage.h"
+#include "utilities/utils.h"
+
+class TargetCacheTest : public ::testing::Test {
+ protected:
+  TargetCacheTest() {
+    config.pacman.type = PACKAGE_MANAGER_NONE;
+    config.pacman.images_path = temp_dir.Path() / "images";
+    config.storage.path = temp_dir.Path();
+    storage = INvStorage::newStorage(config.storage);
+    pacman = std::make_shared<PackageManagerFake>(config.pacman, config.bootloader, storage, nullptr);
+  }
+
+  static Uptane::Target makeTarget(const std::string& name, const std::string& hash, uint64_t size) {
+    Json::Value target_json;
+    target_json["hashes"]["sha256"] = hash;
+    target_json["length"] = Json::UInt64(size);
+    return Uptane::Target(name, target_json);
+  }
+
+  // Store a downloaded Target of `size` bytes that was last used `age` seconds ago.
+  Uptane::Target addTarget(const std::string& name, const std::string& hash, uint64_t size, int64_t age) {
+    auto target = makeTarget(name, hash, size);
+    {
+      auto out = pacman->createTargetFile(target);
+      out << std::string(size, 'x');
+    }
+    storage->storeTargetFileUsage(name, size, static_cast<int64_t>(std::time(nullptr)) - age);
+    return target;
+  }
+
+  bool exists(const std::string& hash) { return boost::filesystem::exists(config.pacman.images_path / hash); }
+
+  TemporaryDirectory temp_dir;
+  Config config;
+  std::shared_ptr<INvStorage> storage;
+  std::shared_ptr<PackageManagerFake> pacman;
+};
+
+static const std::string hash_a = std::string(64, 'a');
+static const std::string hash_b = std::string(64, 'b');
+static const std::string hash_c = std::string(64, 'c');
+static const std::string hash_d = std::string(64, 'd');
+
+/* The least recently used Targets are evicted first, down to the size budget. */
+TEST_F(TargetCacheTest, EvictLeastRecentlyUsed) {
+  config.pacman.images_max_size = 350;
+  addTarget("a.bin", hash_a, 100, 400);
+  addTarget("b.bin", hash_b, 100, 300);
+  addTarget("c.bin", hash_c, 100, 200);
+  addTarget("d.bin", hash_d, 100, 100);
+
+  TargetCache cache(config.pacman, *storage);
+  EXPECT_EQ(cache.evict(0, {}, nullptr), 100U);
+  EXPECT_FALSE(exists(hash_a));
+  EXPECT_TRUE(exists(hash_b));
+  EXPECT_EQ(storage->getTargetFilename("a.bin"), "");
+
+  // Room for another 100 bytes
+  EXPECT_EQ(cache.evict(100, {}, nullptr), 100U);
+  EXPECT_FALSE(exists(hash_b));
+  EXPECT_TRUE(exists(hash_c));
+  EXPECT_TRUE(exists(hash_d));
+
+  // Or until the disk has room
+  config.pacman.images_max_size = 0;
+  int checks = 0;
+  EXPECT_EQ(cache.evict(0, {}, [&checks](uint64_t) { return ++checks > 1; }), 100U);
+  EXPECT_FALSE(exists(hash_c));
+  EXPECT_TRUE(exists(hash_d));
+}
+
+/* Targets that were not used within the age budget are evicted. */
+TEST_F(TargetCacheTest, EvictOld) {
+  config.pacman.images_max_age = 1000;
+  addTarget("a.bin", hash_a, 100, 5000);
+  addTarget("b.bin", hash_b, 100, 10);
+
+  TargetCache cache(config.pacman, *storage);
+  EXPECT_EQ(cache.evict(0, {}, nullptr), 100U);
+  EXPECT_FALSE(exists(hash_a));
+  EXPECT_TRUE(exists(hash_b));
+}
+
+/* Installed, pending and pinned Targets are kept whatever the budgets. */
+TEST_F(TargetCacheTest, KeepInUse) {
+  config.pacman.images_max_size = 1;
+  config.pacman.images_max_age = 1;
+  const auto current = addTarget("a.bin", hash_a, 100, 5000);
+  const auto pending = addTarget("b.bin", hash_b, 100, 5000);
+  addTarget("c.bin", hash_c, 100, 5000);
+  addTarget("d.bin", hash_d, 100, 5000);
+  storage->savePrimaryInstalledVersion(current, InstalledVersionUpdateMode::kCurrent, "");
+  storage->savePrimaryInstalledVersion(pending, InstalledVersionUpdateMode::kPending, "");
+
+  TargetCache cache(config.pacman, *storage);
+  EXPECT_EQ(cache.evict(0, {"c.bin"}, nullptr), 100U);
+  EXPECT_TRUE(exists(hash_a));
+  EXPECT_TRUE(exists(hash_b));
+  EXPECT_TRUE(exists(hash_c));
+  EXPECT_FALSE(exists(hash_d));
+
+  const TargetCacheStats stats = cache.stats();
+  EXPECT_EQ(stats.targets, 3U);
+  EXPECT_EQ(stats.files, 3U);
+  EXPECT_EQ(stats.size, 300U);
+  EXPECT_EQ(stats.protected_size, 200U);
+}
+
+/* Targets with the same content share a file, which stays until the last of them is removed. */
+TEST_F(TargetCacheTest, Dedup) {
+  addTarget("a.bin", hash_a, 100, 0);
+  const auto copy = makeTarget("copy.bin", hash_a, 100);
+
+  TargetCache cache(config.pacman, *storage);
+  EXPECT_FALSE(cache.link(makeTarget("b.bin", hash_b, 100)));
+  ASSERT_TRUE(cache.link(copy));
+  EXPECT_EQ(pacman->checkTargetFile(copy)->first, 100U);
+
+  const TargetCacheStats stats = cache.stats();
+  EXPECT_EQ(stats.targets, 2U);
+  EXPECT_EQ(stats.files, 1U);
+  EXPECT_EQ(stats.size, 100U);
+
+  pacman->removeTargetFile(makeTarget("a.bin", hash_a, 100));
+  EXPECT_TRUE(exists(hash_a));
+  EXPECT_EQ(storage->getTargetFilename("a.bin"), "");
+  pacman->removeTargetFile(copy);
+  EXPECT_FALSE(exists(hash_a));
+}
+
+/* Reconciling drops Targets whose file is gone and files of unknown Targets, and records sizes. */
+TEST_F(TargetCacheTest, Reconcile) {
+  addTarget("a.bin", hash_a, 100, 0);
+  addTarget("b.bin", hash_b, 100, 0);
+  storage->storeTargetFileUsage("b.bin", 0, 0);
+  boost::filesystem::remove(config.pacman.images_path / hash_a);
+  Utils::writeFile(config.pacman.images_path / hash_c, std::string("orphan"));
+  Utils::writeFile(config.pacman.images_path / (hash_b + ".delta"), std::string("leftover patch"));
+  Utils::writeFile(config.pacman.images_path / (hash_b + ".segments"), std::string("leftover segments"));
+  Utils::writeFile(config.pacman.images_path / "notes.txt", std::string("not ours"));
+
+  TargetCache cache(config.pacman, *storage);
+  cache.reconcile();
+
+  EXPECT_EQ(storage->getTargetFilename("a.bin"), "");
+  EXPECT_FALSE(exists(hash_c));
+  EXPECT_FALSE(exists(hash_b + ".delta"));
+  EXPECT_FALSE(exists(hash_b + ".segments"));
+  EXPECT_TRUE(exists("notes.txt"));
+  const auto index = storage->loadTargetFileIndex();
+  ASSERT_EQ(index.size(), 1U);
+  EXPECT_EQ(index[0].targetname, "b.bin");
+  EXPECT_EQ(index[0].size, 100U);
+  EXPECT_GT(index[0].last_used, 0);
+}
+
+#ifndef __NO_MAIN__
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+#endif
@@ -5,6 +5,7 @@
 
 #include "libaktualizr/aktualizr.h"
 #include "libaktualizr/events.h"
+#include "primary/pollscheduler.h"
 #include "primary/sotauptaneclient.h"
 #include "utilities/apiqueue.h"
 #include "utilities/timer.h"
@@ -16,7 +17,10 @@ Aktualizr::Aktualizr(const Config &config)
 
 Aktualizr::Aktualizr(Config config, std::shared_ptr<INvStorage> storage_in,
                      const std::shared_ptr<HttpInterface> &http_in)
-    : config_{std::move(config)}, sig_{new event::Channel()}, api_queue_{new api::CommandQueue()} {
+    : config_{std::move(config)},
+      sig_{new event::Channel()},
+      api_queue_{new api::CommandQueue()},
+      poll_scheduler_{new PollScheduler(config_.uptane)} {
   if (sodium_init() == -1) {  // Note that sodium_init doesn't require a matching 'sodium_deinit'
     throw std::runtime_error("Unable to initialize libsodium");
   }
@@ -35,14 +39,24 @@ void Aktualizr::Initialize() {
 }
 
 bool Aktualizr::UptaneCycle() {
+  const uint64_t connections_before = uptane_client_->connectionsOpened();
+  const bool result = RunUptaneCycle();
+  last_cycle_handshakes_ = uptane_client_->connectionsOpened() - connections_before;
+  LOG_DEBUG << "Uptane cycle opened " << last_cycle_handshakes_ << " new connection(s)";
+  return result;
+}
+
+bool Aktualizr::RunUptaneCycle() {
   result::UpdateCheck update_result = CheckUpdates().get();
   if (update_result.updates.empty()) {
     if (update_result.status == result::UpdateStatus::kError) {
+      poll_scheduler_->record(PollScheduler::Outcome::kError);
       // If the metadata verification failed, inform the backend immediately.
       SendManifest().get();
     }
     return true;
   }
+  poll_scheduler_->record(PollScheduler::Outcome::kActive);
 
   result::Download download_result = Download(update_result.updates).get();
   if (download_result.status != result::DownloadStatus::kSuccess || download_result.updates.empty()) {
@@ -73,9 +87,18 @@ bool Aktualizr::UptaneCycle() {
 
 std::future<void> Aktualizr::RunForever() {
   std::future<void> future = std::async(std::launch::async, [this]() {
-    std::unique_lock<std::mutex> l(exit_cond_.m);
+    // Wait until the next check is due, WakeUp() or Shutdown(). Returns true on
+    // Shutdown().
+    auto wait = [this](std::chrono::milliseconds delay) {
+      std::unique_lock<std::mutex> l(exit_cond_.m);
+      exit_cond_.cv.wait_for(l, delay, [this] { return exit_cond_.flag || exit_cond_.wake; });
+      exit_cond_.wake = false;
+      return exit_cond_.flag;
+    };
+
     bool have_sent_device_data = false;
-    while (true) {
+    bool shutdown = wait(poll_scheduler_->initialDelay());
+    while (!shutdown) {
       try {
         if (!have_sent_device_data) {
           // Can throw SotaUptaneClient::ProvisioningFailed
@@ -86,14 +109,17 @@ std::future<void> Aktualizr::RunForever() {
         if (!UptaneCycle()) {
           break;
         }
+        if (uptane_client_->hasPendingUpdates()) {
+          poll_scheduler_->record(PollScheduler::Outcome::kActive);
+        }
       } catch (SotaUptaneClient::ProvisioningFailed &e) {
         LOG_DEBUG << "Not provisioned yet:" << e.what();
+        poll_scheduler_->record(PollScheduler::Outcome::kError);
       }
 
-      if (exit_cond_.cv.wait_for(l, std::chrono::seconds(config_.uptane.polling_sec),
-                                 [this] { return exit_cond_.flag; })) {
-        break;
-      }
+      const std::chrono::milliseconds delay = poll_scheduler_->nextDelay(uptane_client_->takeRetryAfter());
+      LOG_TRACE << "Next update check in " << delay.count() << " ms";
+      shutdown = wait(delay);
     }
     uptane_client_->completeInstall();
   });
@@ -108,6 +134,14 @@ void Aktualizr::Shutdown() {
   exit_cond_.cv.notify_all();
 }
 
+void Aktualizr::WakeUp() {
+  {
+    std::lock_guard<std::mutex> g(exit_cond_.m);
+    exit_cond_.wake = true;
+  }
+  exit_cond_.cv.notify_all();
+}
+
 void Aktualizr::AddSecondary(const std::shared_ptr<SecondaryInterface> &secondary) {
   uptane_client_->addSecondary(secondary);
 }
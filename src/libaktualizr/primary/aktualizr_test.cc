@@ -1,7 +1,9 @@
 #include <gtest/gtest.h>
 
 #include <chrono>
+#include <condition_variable>
 #include <future>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -1336,6 +1338,112 @@ TEST(Aktualizr, CheckNoUpdates) {
   verifyNothingInstalled(aktualizr.uptane_client()->AssembleManifest());
 }
 
+// Opens a new connection for the first request after a disconnect and reuses
+// it for the rest.
+class HttpFakeConnections : public HttpFake {
+ public:
+  HttpFakeConnections(const boost::filesystem::path& test_dir_in, const boost::filesystem::path& meta_dir_in)
+      : HttpFake(test_dir_in, "noupdates", meta_dir_in) {}
+
+  using HttpFake::get;
+  using HttpFake::post;
+  using HttpFake::put;
+  HttpResponse get(const std::string& url, int64_t maxsize, const api::FlowControlToken* flow_control) override {
+    connect();
+    return HttpFake::get(url, maxsize, flow_control);
+  }
+  HttpResponse put(const std::string& url, const Json::Value& data) override {
+    connect();
+    return HttpFake::put(url, data);
+  }
+  HttpResponse post(const std::string& url, const Json::Value& data) override {
+    connect();
+    return HttpFake::post(url, data);
+  }
+  uint64_t connectionsOpened() const override { return connections_; }
+  void disconnect() { connected_ = false; }
+
+ private:
+  void connect() {
+    if (!connected_) {
+      connected_ = true;
+      ++connections_;
+    }
+  }
+
+  std::atomic<uint64_t> connections_{0};
+  std::atomic<bool> connected_{false};
+};
+
+/*
+ * The handshakes that an Uptane cycle needs are counted per cycle.
+ */
+TEST(Aktualizr, CycleHandshakes) {
+  TemporaryDirectory temp_dir;
+  auto http = std::make_shared<HttpFakeConnections>(temp_dir.Path(), fake_meta_dir);
+  Config conf = UptaneTestCommon::makeTestConfig(temp_dir, http->tls_server);
+
+  auto storage = INvStorage::newStorage(conf.storage);
+  UptaneTestCommon::TestAktualizr aktualizr(conf, storage, http);
+  aktualizr.Initialize();
+  EXPECT_EQ(aktualizr.LastCycleHandshakes(), 0);
+
+  http->disconnect();
+  aktualizr.UptaneCycle();
+  EXPECT_EQ(aktualizr.LastCycleHandshakes(), 1);
+
+  // All requests of the next cycle go over the open connection.
+  aktualizr.UptaneCycle();
+  EXPECT_EQ(aktualizr.LastCycleHandshakes(), 0);
+
+  http->disconnect();
+  aktualizr.UptaneCycle();
+  EXPECT_EQ(aktualizr.LastCycleHandshakes(), 1);
+}
+
+/*
+ * RunForever -> WakeUp -> update check without waiting for polling_sec.
+ */
+TEST(Aktualizr, RunForeverWakeUp) {
+  TemporaryDirectory temp_dir;
+  auto http = std::make_shared<HttpFake>(temp_dir.Path(), "noupdates", fake_meta_dir);
+  Config conf = UptaneTestCommon::makeTestConfig(temp_dir, http->tls_server);
+  conf.uptane.polling_sec = 3600;
+
+  std::mutex m;
+  std::condition_variable cv;
+  int checks = 0;
+  auto f_cb = [&m, &cv, &checks](const std::shared_ptr<event::BaseEvent>& event) {
+    if (event->variant == "UpdateCheckComplete") {
+      {
+        std::lock_guard<std::mutex> l(m);
+        ++checks;
+      }
+      cv.notify_all();
+    }
+  };
+  auto waitForChecks = [&m, &cv, &checks](int count) {
+    std::unique_lock<std::mutex> l(m);
+    return cv.wait_for(l, std::chrono::seconds(20), [&checks, count] { return checks >= count; });
+  };
+
+  auto storage = INvStorage::newStorage(conf.storage);
+  UptaneTestCommon::TestAktualizr aktualizr(conf, storage, http);
+  boost::signals2::connection conn = aktualizr.SetSignalHandler(f_cb);
+  aktualizr.Initialize();
+  auto aktualizr_cycle_thread = aktualizr.RunForever();
+
+  aktualizr.WakeUp();
+  EXPECT_TRUE(waitForChecks(1));
+  aktualizr.WakeUp();
+  EXPECT_TRUE(waitForChecks(2));
+
+  aktualizr.Shutdown();
+  aktualizr_cycle_thread.get();
+  std::lock_guard<std::mutex> l(m);
+  EXPECT_EQ(checks, 2);
+}
+
 /*
  * Initialize -> Download -> nothing to download.
  *
@@ -1429,6 +1537,69 @@ TEST(Aktualizr, DownloadWithUpdates) {
   verifyNothingInstalled(aktualizr.uptane_client()->AssembleManifest());
 }
 
+// Records how many downloads run at the same time.
+class HttpFakeConcurrentDownloads : public HttpFake {
+ public:
+  HttpFakeConcurrentDownloads(const boost::filesystem::path& test_dir_in, const boost::filesystem::path& meta_dir_in)
+      : HttpFake(test_dir_in, "hasupdates", meta_dir_in) {}
+
+  HttpResponse download(const std::string& url, curl_write_callback write_cb, curl_xferinfo_callback progress_cb,
+                        void* userp, curl_off_t from) override {
+    const int active = ++active_;
+    int max = max_active_;
+    while (active > max && !max_active_.compare_exchange_weak(max, active)) {
+    }
+    HttpResponse response = HttpFake::download(url, write_cb, progress_cb, userp, from);
+    --active_;
+    return response;
+  }
+
+  std::atomic<int> active_{0};
+  std::atomic<int> max_active_{0};
+};
+
+/*
+ * Download several targets in parallel.
+ * The downloads overlap, the result lists the targets in the order they were
+ * requested, and a DownloadTargetComplete event is sent for each of them.
+ */
+TEST(Aktualizr, DownloadParallel) {
+  TemporaryDirectory temp_dir;
+  auto http = std::make_shared<HttpFakeConcurrentDownloads>(temp_dir.Path(), fake_meta_dir);
+  Config conf = UptaneTestCommon::makeTestConfig(temp_dir, http->tls_server);
+  conf.uptane.download_parallelism = 4;
+
+  auto storage = INvStorage::newStorage(conf.storage);
+  UptaneTestCommon::TestAktualizr aktualizr(conf, storage, http);
+
+  std::mutex events_mutex;
+  std::vector<std::string> completed;
+  auto f_cb = [&events_mutex, &completed](const std::shared_ptr<event::BaseEvent>& event) {
+    if (event->isTypeOf<event::DownloadTargetComplete>()) {
+      const auto download_event = dynamic_cast<event::DownloadTargetComplete*>(event.get());
+      EXPECT_TRUE(download_event->success);
+      std::lock_guard<std::mutex> guard(events_mutex);
+      completed.push_back(download_event->update.filename());
+    }
+  };
+  boost::signals2::connection conn = aktualizr.SetSignalHandler(f_cb);
+
+  aktualizr.Initialize();
+  result::UpdateCheck update_result = aktualizr.CheckUpdates().get();
+  ASSERT_EQ(update_result.updates.size(), 2);
+
+  result::Download result = aktualizr.Download(update_result.updates).get();
+  EXPECT_EQ(result.status, result::DownloadStatus::kSuccess);
+  ASSERT_EQ(result.updates.size(), 2);
+  EXPECT_EQ(result.updates[0].filename(), update_result.updates[0].filename());
+  EXPECT_EQ(result.updates[1].filename(), update_result.updates[1].filename());
+  // primary_firmware.txt takes a while to download, so the other one starts before it ends.
+  EXPECT_EQ(http->max_active_, 2);
+
+  std::lock_guard<std::mutex> guard(events_mutex);
+  EXPECT_EQ(completed.size(), 2);
+}
+
 class HttpDownloadFailure : public HttpFake {
  public:
   using Responses = std::vector<std::pair<std::string, HttpResponse>>;
@@ -0,0 +1,138 @@
+#include "eventbus.h"
+
+#include <iterator>
+
+#include "logging/logging.h"
+
+namespace {
+
+const event::DownloadProgressReport* asProgress(const std::shared_ptr<event::BaseEvent>& event) {
+  if (!event->isTypeOf<event::DownloadProgressReport>()) {
+    return nullptr;
+  }
+  return dynamic_cast<const event::DownloadProgressReport*>(event.get());
+}
+
+}  // namespace
+
+EventBus::EventBus(std::shared_ptr<event::Channel> channel, const size_t queue_size)
+    : channel_(std::move(channel)), queue_size_(queue_size) {
+  if (queue_size_ > 0) {
+    thread_ = std::thread(&EventBus::run, this);
+  }
+}
+
+EventBus::~EventBus() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_);
+    shutdown_ = true;
+  }
+  cv_.notify_all();
+  thread_.join();
+
+  if (stats_.dropped > 0) {
+    LOG_INFO << "Dropped " << stats_.dropped << " of " << stats_.delivered + stats_.dropped + stats_.coalesced
+             << " events because event handlers did not keep up";
+  }
+}
+
+void EventBus::post(std::shared_ptr<event::BaseEvent> event) {
+  if (!thread_.joinable()) {
+    (*channel_)(event);
+    std::lock_guard<std::mutex> lock(m_);
+    ++stats_.delivered;
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(m_);
+  const auto* progress = asProgress(event);
+  if (progress != nullptr) {
+    auto queued = progress_.find(progress->target.filename());
+    if (queued != progress_.end()) {
+      *queued->second = std::move(event);
+      ++stats_.coalesced;
+      return;
+    }
+  }
+
+  if (queue_.size() >= queue_size_) {
+    dropOldestProgress();
+  }
+  if (queue_.size() >= queue_size_) {
+    if (progress != nullptr) {
+      ++stats_.dropped;
+      return;
+    }
+    // A handler that posts an event must not wait for itself.
+    if (std::this_thread::get_id() != thread_.get_id()) {
+      cv_.wait(lock, [this] { return queue_.size() < queue_size_ || shutdown_; });
+    }
+  }
+
+  queue_.push_back(std::move(event));
+  if (progress != nullptr) {
+    progress_[progress->target.filename()] = std::prev(queue_.end());
+  }
+  lock.unlock();
+  cv_.notify_all();
+}
+
+void EventBus::flush() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(m_);
+  cv_.wait(lock, [this] { return (queue_.empty() && !delivering_) || shutdown_; });
+}
+
+EventBus::Stats EventBus::stats() const {
+  std::lock_guard<std::mutex> lock(m_);
+  return stats_;
+}
+
+void EventBus::dropOldestProgress() {
+  for (auto it = queue_.begin(); it != queue_.end(); ++it) {
+    const auto* progress = asProgress(*it);
+    if (progress != nullptr) {
+      progress_.erase(progress->target.filename());
+      queue_.erase(it);
+      ++stats_.dropped;
+      return;
+    }
+  }
+}
+
+void EventBus::run() {
+  std::unique_lock<std::mutex> lock(m_);
+  while (true) {
+    cv_.wait(lock, [this] { return !queue_.empty() || shutdown_; });
+    // Deliver what is left before shutting down.
+    if (queue_.empty()) {
+      break;
+    }
+
+    std::shared_ptr<event::BaseEvent> event = std::move(queue_.front());
+    queue_.pop_front();
+    const auto* progress = asProgress(event);
+    if (progress != nullptr) {
+      progress_.erase(progress->target.filename());
+    }
+    delivering_ = true;
+    lock.unlock();
+    cv_.notify_all();
+
+    try {
+      (*channel_)(event);
+    } catch (const std::exception& e) {
+      LOG_ERROR << "Handler of " << event->variant << " event failed: " << e.what();
+    }
+
+    lock.lock();
+    delivering_ = false;
+    ++stats_.delivered;
+    cv_.notify_all();
+  }
+}
@@ -0,0 +1,71 @@
+#ifndef EVENTBUS_H_
+#define EVENTBUS_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "libaktualizr/events.h"
+
+/**
+ * Delivers events to the handlers connected to an event::Channel.
+ *
+ * With a queue size of 0, events are delivered on the thread that posts them,
+ * exactly as if the channel was called directly. Otherwise they are queued and
+ * delivered in order on a dedicated thread, so that slow handlers don't hold up
+ * downloads and installations. A DownloadProgressReport replaces the one for
+ * the same Target that is still queued, if any, so that handlers only get the
+ * latest progress.
+ *
+ * When the queue is full, the oldest queued progress report is dropped to make
+ * room. If there is none, a new progress report is dropped too, but any other
+ * event waits for room: those report the end of an operation and are never
+ * lost.
+ */
+class EventBus {
+ public:
+  struct Stats {
+    uint64_t delivered{0};
+    // Progress reports replaced by a newer one for the same Target
+    uint64_t coalesced{0};
+    // Progress reports dropped because the queue was full
+    uint64_t dropped{0};
+  };
+
+  EventBus(std::shared_ptr<event::Channel> channel, size_t queue_size);
+  ~EventBus();
+  EventBus(const EventBus&) = delete;
+  EventBus(EventBus&&) = delete;
+  EventBus& operator=(const EventBus&) = delete;
+  EventBus& operator=(EventBus&&) = delete;
+
+  void post(std::shared_ptr<event::BaseEvent> event);
+  /** Wait until all the events posted so far have been delivered. */
+  void flush();
+  Stats stats() const;
+
+ private:
+  using Queue = std::list<std::shared_ptr<event::BaseEvent>>;
+
+  void run();
+  void dropOldestProgress();
+
+  std::shared_ptr<event::Channel> channel_;
+  const size_t queue_size_;
+  mutable std::mutex m_;
+  std::condition_variable cv_;
+  Queue queue_;
+  // Queued progress reports by Target filename
+  std::map<std::string, Queue::iterator> progress_;
+  bool delivering_{false};
+  bool shutdown_{false};
+  Stats stats_;
+  std::thread thread_;
+};
+
+#endif  // EVENTBUS_H_
@@ -0,0 +1,142 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "eventbus.h"
+#include "libaktualizr/events.h"
+#include "logging/logging.h"
+
+class EventBusTest : public ::testing::Test {
+ protected:
+  EventBusTest() {
+    channel->connect([this](const std::shared_ptr<event::BaseEvent>& event) {
+      if (block_first_ && received().empty()) {
+        started_.set_value();
+        release_.get_future().wait();
+      }
+      std::lock_guard<std::mutex> lock(m_);
+      threads_.push_back(std::this_thread::get_id());
+      events_.push_back(describe(*event));
+    });
+  }
+
+  static std::string describe(event::BaseEvent& event) {
+    if (event.isTypeOf<event::DownloadProgressReport>()) {
+      const auto& progress = dynamic_cast<const event::DownloadProgressReport&>(event);
+      return progress.target.filename() + " " + std::to_string(progress.progress);
+    }
+    return event.variant;
+  }
+
+  static Uptane::Target target(const std::string& name) {
+    Json::Value target_json;
+    target_json["hashes"]["sha256"] = std::string(64, 'a');
+    target_json["length"] = 0;
+    return Uptane::Target(name, target_json);
+  }
+
+  // Make the handler wait in the first event until release() is called.
+  void blockHandler(EventBus& bus) {
+    block_first_ = true;
+    bus.post(std::make_shared<event::SendDeviceDataComplete>());
+    started_.get_future().wait();
+  }
+
+  void release() { release_.set_value(); }
+
+  std::vector<std::string> received() {
+    std::lock_guard<std::mutex> lock(m_);
+    return events_;
+  }
+
+  std::shared_ptr<event::Channel> channel{std::make_shared<event::Channel>()};
+  std::vector<std::thread::id> threads_;
+
+ private:
+  std::mutex m_;
+  std::vector<std::string> events_;
+  bool block_first_{false};
+  std::promise<void> started_;
+  std::promise<void> release_;
+};
+
+/* Without a queue, events are delivered before post() returns. */
+TEST_F(EventBusTest, Synchronous) {
+  EventBus bus(channel, 0);
+  bus.post(std::make_shared<event::DownloadProgressReport>(target("a.bin"), "", 10));
+  bus.post(std::make_shared<event::DownloadProgressReport>(target("a.bin"), "", 20));
+  EXPECT_EQ(received(), std::vector<std::string>({"a.bin 10", "a.bin 20"}));
+  EXPECT_EQ(threads_[0], std::this_thread::get_id());
+  EXPECT_EQ(bus.stats().delivered, 2U);
+}
+
+/* Events are delivered in order on another thread, with only the latest progress for each Target. */
+TEST_F(EventBusTest, Coalesce) {
+  EventBus bus(channel, 16);
+  blockHandler(bus);
+  for (unsigned int progress = 1; progress <= 100; ++progress) {
+    bus.post(std::make_shared<event::DownloadProgressReport>(target("a.bin"), "", progress));
+    bus.post(std::make_shared<event::DownloadProgressReport>(target("b.bin"), "", progress / 2));
+  }
+  bus.post(std::make_shared<event::DownloadTargetComplete>(target("a.bin"), true));
+  bus.post(std::make_shared<event::DownloadProgressReport>(target("a.bin"), "", 0));
+  release();
+  bus.flush();
+
+  EXPECT_EQ(received(), std::vector<std::string>({"SendDeviceDataComplete", "a.bin 100", "b.bin 50",
+                                                  "DownloadTargetComplete", "a.bin 0"}));
+  EXPECT_NE(threads_[0], std::this_thread::get_id());
+  const EventBus::Stats stats = bus.stats();
+  EXPECT_EQ(stats.delivered, 5U);
+  EXPECT_EQ(stats.coalesced, 198U);
+  EXPECT_EQ(stats.dropped, 0U);
+}
+
+/* A full queue drops progress reports, but waits for room for other events. */
+TEST_F(EventBusTest, Full) {
+  EventBus bus(channel, 2);
+  blockHandler(bus);
+  bus.post(std::make_shared<event::DownloadProgressReport>(target("a.bin"), "", 1));
+  bus.post(std::make_shared<event::DownloadProgressReport>(target("b.bin"), "", 1));
+  bus.post(std::make_shared<event::DownloadProgressReport>(target("c.bin"), "", 1));
+  bus.post(std::make_shared<event::PutManifestComplete>(true));
+  bus.post(std::make_shared<event::SendDeviceDataComplete>());
+  bus.post(std::make_shared<event::DownloadProgressReport>(target("d.bin"), "", 1));
+  EXPECT_EQ(bus.stats().dropped, 4U);
+
+  std::thread poster([&bus]() { bus.post(std::make_shared<event::AllInstallsComplete>(result::Install())); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(received().size(), 0U);
+  release();
+  poster.join();
+  bus.flush();
+
+  EXPECT_EQ(received(), std::vector<std::string>({"SendDeviceDataComplete", "PutManifestComplete",
+                                                  "SendDeviceDataComplete", "AllInstallsComplete"}));
+  EXPECT_EQ(bus.stats().dropped, 4U);
+}
+
+/* Queued events are delivered before the bus is destroyed. */
+TEST_F(EventBusTest, DeliverOnShutdown) {
+  {
+    EventBus bus(channel, 16);
+    blockHandler(bus);
+    bus.post(std::make_shared<event::PutManifestComplete>(true));
+    release();
+  }
+  EXPECT_EQ(received(), std::vector<std::string>({"SendDeviceDataComplete", "PutManifestComplete"}));
+}
+
+#ifndef __NO_MAIN__
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  logger_init();
+  return RUN_ALL_TESTS();
+}
+#endif
@@ -0,0 +1,139 @@
+#include "firmwarebroadcast.h"
+
+#include <algorithm>
+#include <streambuf>
+
+class FirmwareBroadcast::StreamBuf : public std::streambuf {
+ public:
+  StreamBuf(std::shared_ptr<FirmwareBroadcast> broadcast, Uptane::EcuSerial reader)
+      : broadcast_(std::move(broadcast)), reader_(std::move(reader)) {}
+  ~StreamBuf() override { broadcast_->leave(reader_); }
+  StreamBuf(const StreamBuf&) = delete;
+  StreamBuf(StreamBuf&&) = delete;
+  StreamBuf& operator=(const StreamBuf&) = delete;
+  StreamBuf& operator=(StreamBuf&&) = delete;
+
+ protected:
+  // Hands out the shared chunks themselves; nothing is copied until read().
+  int_type underflow() override {
+    if (gptr() < egptr()) {
+      return traits_type::to_int_type(*gptr());
+    }
+    chunk_ = broadcast_->chunk(reader_, next_);
+    if (chunk_ == nullptr) {
+      return traits_type::eof();
+    }
+    ++next_;
+    setg(chunk_->data(), chunk_->data(), chunk_->data() + chunk_->size());
+    return traits_type::to_int_type(*gptr());
+  }
+
+ private:
+  std::shared_ptr<FirmwareBroadcast> broadcast_;
+  const Uptane::EcuSerial reader_;
+  size_t next_{0};
+  Chunk chunk_;
+};
+
+class FirmwareBroadcast::Stream : public std::istream {
+ public:
+  Stream(std::shared_ptr<FirmwareBroadcast> broadcast, Uptane::EcuSerial reader)
+      : std::istream(nullptr), buf_(std::move(broadcast), std::move(reader)) {
+    rdbuf(&buf_);
+  }
+
+ private:
+  StreamBuf buf_;
+};
+
+FirmwareBroadcast::FirmwareBroadcast(std::unique_ptr<std::istream> source,
+                                     const std::vector<Uptane::EcuSerial>& readers, const size_t chunk_size,
+                                     const size_t max_chunks)
+    : chunk_size_(std::max<size_t>(chunk_size, 1)), max_chunks_(std::max<size_t>(max_chunks, 1)),
+      source_(std::move(source)) {
+  for (const auto& reader : readers) {
+    positions_.emplace(reader, 0);
+  }
+}
+
+std::unique_ptr<std::istream> FirmwareBroadcast::open(const Uptane::EcuSerial& reader) {
+  std::lock_guard<std::mutex> lock(m_);
+  if (positions_.count(reader) == 0 || !opened_.insert(reader).second) {
+    return nullptr;
+  }
+  return std::unique_ptr<std::istream>(new Stream(shared_from_this(), reader));
+}
+
+void FirmwareBroadcast::leave(const Uptane::EcuSerial& reader) {
+  {
+    std::lock_guard<std::mutex> lock(m_);
+    positions_.erase(reader);
+    opened_.insert(reader);
+    trim();
+  }
+  cv_.notify_all();
+}
+
+bool FirmwareBroadcast::finished() const {
+  std::lock_guard<std::mutex> lock(m_);
+  return positions_.empty();
+}
+
+FirmwareBroadcast::Stats FirmwareBroadcast::stats() const {
+  std::lock_guard<std::mutex> lock(m_);
+  return stats_;
+}
+
+FirmwareBroadcast::Chunk FirmwareBroadcast::chunk(const Uptane::EcuSerial& reader, const size_t index) {
+  std::unique_lock<std::mutex> lock(m_);
+  while (true) {
+    auto position = positions_.find(reader);
+    if (position == positions_.end() || index < first_) {
+      return nullptr;
+    }
+    if (index < first_ + ring_.size()) {
+      Chunk chunk = ring_[index - first_];
+      position->second = index + 1;
+      trim();
+      lock.unlock();
+      cv_.notify_all();
+      return chunk;
+    }
+    if (end_) {
+      return nullptr;
+    }
+
+    // Read the next chunk unless another reader already does, or the slowest
+    // reader is a whole ring behind.
+    if (!reading_ && ring_.size() < max_chunks_) {
+      reading_ = true;
+      lock.unlock();
+      auto data = std::make_shared<std::vector<char>>(chunk_size_);
+      source_->read(data->data(), static_cast<std::streamsize>(data->size()));
+      data->resize(static_cast<size_t>(source_->gcount()));
+      lock.lock();
+      reading_ = false;
+      if (data->empty()) {
+        end_ = true;
+      } else {
+        ring_.push_back(std::move(data));
+        ++stats_.chunks_read;
+        stats_.max_buffered = std::max(stats_.max_buffered, ring_.size());
+      }
+      cv_.notify_all();
+      continue;
+    }
+    cv_.wait(lock);
+  }
+}
+
+void FirmwareBroadcast::trim() {
+  size_t slowest = first_ + ring_.size();
+  for (const auto& position : positions_) {
+    slowest = std::min(slowest, position.second);
+  }
+  while (first_ < slowest) {
+    ring_.pop_front();
+    ++first_;
+  }
+}
@@ -0,0 +1,75 @@
+#ifndef FIRMWAREBROADCAST_H_
+#define FIRMWAREBROADCAST_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <istream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include "libaktualizr/types.h"
+
+/**
+ * One image read once for several Secondaries that are sent it at the same
+ * time.
+ *
+ * The image is read in chunks into a ring shared by all readers. A chunk is
+ * dropped from the ring once every reader has taken it, and no more than
+ * `max_chunks` chunks are buffered, so a reader that gets that far ahead of
+ * the slowest one waits for it. Every reader sends at its own pace otherwise.
+ *
+ * All the readers are known up front, so that the first one does not leave
+ * the others behind before they start. A reader that stops early or never
+ * starts must leave() so that it does not hold the others back.
+ */
+class FirmwareBroadcast : public std::enable_shared_from_this<FirmwareBroadcast> {
+ public:
+  struct Stats {
+    size_t chunks_read{0};
+    size_t max_buffered{0};
+  };
+
+  FirmwareBroadcast(std::unique_ptr<std::istream> source, const std::vector<Uptane::EcuSerial>& readers,
+                    size_t chunk_size, size_t max_chunks);
+
+  /**
+   * The image for `reader`, or nullptr if it is not one of the readers or has
+   * already opened or left it. Destroying the stream leaves the broadcast.
+   */
+  std::unique_ptr<std::istream> open(const Uptane::EcuSerial& reader);
+  void leave(const Uptane::EcuSerial& reader);
+  /** Whether all the readers have left. */
+  bool finished() const;
+  Stats stats() const;
+
+ private:
+  using Chunk = std::shared_ptr<std::vector<char>>;
+  class StreamBuf;
+  class Stream;
+
+  // Chunk number `index` for `reader`, or nullptr at the end of the image.
+  Chunk chunk(const Uptane::EcuSerial& reader, size_t index);
+  void trim();
+
+  const size_t chunk_size_;
+  const size_t max_chunks_;
+
+  mutable std::mutex m_;
+  std::condition_variable cv_;
+  std::unique_ptr<std::istream> source_;
+  bool reading_{false};
+  bool end_{false};
+  std::deque<Chunk> ring_;
+  // Number of the first chunk in ring_.
+  size_t first_{0};
+  // Next chunk of each reader that has not left.
+  std::map<Uptane::EcuSerial, size_t> positions_;
+  std::set<Uptane::EcuSerial> opened_;
+  Stats stats_;
+};
+
+#endif  // FIRMWAREBROADCAST_H_
@@ -0,0 +1,155 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "firmwarebroadcast.h"
+#include "libaktualizr/types.h"
+#include "logging/logging.h"
+
+static const size_t kChunkSize = 4096;
+static const size_t kMaxChunks = 8;
+
+static std::string makeImage(const size_t size) {
+  std::string image(size, '\0');
+  for (size_t i = 0; i < size; ++i) {
+    image[i] = static_cast<char>((i * 7919) % 251);
+  }
+  return image;
+}
+
+static std::vector<Uptane::EcuSerial> makeSerials(const size_t count) {
+  std::vector<Uptane::EcuSerial> serials;
+  for (size_t i = 0; i < count; ++i) {
+    serials.emplace_back("secondary" + std::to_string(i));
+  }
+  return serials;
+}
+
+static std::shared_ptr<FirmwareBroadcast> makeBroadcast(const std::string& image,
+                                                        const std::vector<Uptane::EcuSerial>& serials) {
+  return std::make_shared<FirmwareBroadcast>(std::unique_ptr<std::istream>(new std::istringstream(image)), serials,
+                                             kChunkSize, kMaxChunks);
+}
+
+// Reads the whole stream in pieces of `piece` bytes, counting the bytes read in `progress`.
+static std::string readAll(std::istream& stream, const size_t piece, std::atomic<size_t>* progress = nullptr,
+                           const std::chrono::microseconds pause = std::chrono::microseconds{0}) {
+  std::string result;
+  std::vector<char> buf(piece);
+  while (true) {
+    stream.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+    const auto read_size = static_cast<size_t>(stream.gcount());
+    if (read_size == 0) {
+      break;
+    }
+    result.append(buf.data(), read_size);
+    if (progress != nullptr) {
+      *progress += read_size;
+    }
+    std::this_thread::sleep_for(pause);
+  }
+  return result;
+}
+
+/* Every Secondary gets the whole image, which is read only once. */
+TEST(FirmwareBroadcast, FanOut) {
+  const std::string image = makeImage(1024 * 1024 + 123);
+  const auto serials = makeSerials(8);
+  auto broadcast = makeBroadcast(image, serials);
+
+  std::vector<std::unique_ptr<std::istream>> streams;
+  for (const auto& serial : serials) {
+    streams.push_back(broadcast->open(serial));
+    ASSERT_NE(streams.back(), nullptr);
+  }
+
+  std::vector<std::string> received(serials.size());
+  std::vector<std::thread> readers;
+  for (size_t i = 0; i < serials.size(); ++i) {
+    // The last one is slower than the others, and reads in other pieces.
+    const bool slow = i + 1 == serials.size();
+    readers.emplace_back([&streams, &received, i, slow]() {
+      received[i] = readAll(*streams[i], slow ? 3000 : 1024, nullptr, std::chrono::microseconds{slow ? 100 : 0});
+      streams[i].reset();
+    });
+  }
+  for (auto& reader : readers) {
+    reader.join();
+  }
+
+  for (const auto& r : received) {
+    EXPECT_EQ(r, image);
+  }
+  const FirmwareBroadcast::Stats stats = broadcast->stats();
+  EXPECT_EQ(stats.chunks_read, (image.size() + kChunkSize - 1) / kChunkSize);
+  EXPECT_LE(stats.max_buffered, kMaxChunks);
+  EXPECT_TRUE(broadcast->finished());
+}
+
+/* A Secondary that falls behind holds the others back by no more than the buffer. */
+TEST(FirmwareBroadcast, BoundedLead) {
+  const std::string image = makeImage(kChunkSize * kMaxChunks * 4);
+  const auto serials = makeSerials(2);
+  auto broadcast = makeBroadcast(image, serials);
+
+  auto slow = broadcast->open(serials[1]);
+  ASSERT_NE(slow, nullptr);
+  std::vector<char> buf(100);
+  slow->read(buf.data(), static_cast<std::streamsize>(buf.size()));
+
+  std::atomic<size_t> progress{0};
+  std::string fast_received;
+  std::thread fast([&]() {
+    auto stream = broadcast->open(serials[0]);
+    fast_received = readAll(*stream, 1000, &progress);
+  });
+
+  // The slow one holds on to its first chunk; the fast one gets the ring ahead of it.
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  EXPECT_GE(progress, kChunkSize * kMaxChunks);
+  EXPECT_LE(progress, kChunkSize * (kMaxChunks + 1));
+
+  // Once the slow one stops, the fast one is not held back any more.
+  slow.reset();
+  fast.join();
+  EXPECT_EQ(fast_received, image);
+  EXPECT_TRUE(broadcast->finished());
+}
+
+/* Secondaries that never read, or read twice, do not hold the others back. */
+TEST(FirmwareBroadcast, Leave) {
+  const std::string image = makeImage(kChunkSize * kMaxChunks * 4);
+  const auto serials = makeSerials(3);
+  auto broadcast = makeBroadcast(image, serials);
+
+  EXPECT_EQ(broadcast->open(Uptane::EcuSerial("unknown")), nullptr);
+  broadcast->leave(serials[2]);
+  EXPECT_EQ(broadcast->open(serials[2]), nullptr);
+
+  auto stream = broadcast->open(serials[0]);
+  ASSERT_NE(stream, nullptr);
+  EXPECT_EQ(broadcast->open(serials[0]), nullptr);
+
+  std::thread other([&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    broadcast->leave(serials[1]);
+  });
+  EXPECT_EQ(readAll(*stream, 5000), image);
+  other.join();
+  stream.reset();
+  EXPECT_TRUE(broadcast->finished());
+}
+
+#ifndef __NO_MAIN__
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  logger_init();
+  return RUN_ALL_TESTS();
+}
+#endif
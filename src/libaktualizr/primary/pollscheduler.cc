@@ -0,0 +1,88 @@
+#include "pollscheduler.h"
+
+#include <algorithm>
+
+namespace {
+
+constexpr unsigned int kMaxDoublings = 32;
+
+std::chrono::milliseconds fromSeconds(uint64_t seconds) {
+  return std::chrono::seconds(static_cast<int64_t>(std::min<uint64_t>(seconds, UINT32_MAX)));
+}
+
+// `base` doubled `n` times, but no more than `limit`.
+std::chrono::milliseconds doubled(std::chrono::milliseconds base, unsigned int n, std::chrono::milliseconds limit) {
+  for (unsigned int i = 0; i < n && base < limit; ++i) {
+    base *= 2;
+  }
+  return std::min(base, limit);
+}
+
+}  // namespace
+
+PollScheduler::PollScheduler(const UptaneConfig& config, uint64_t seed)
+    : interval_(fromSeconds(config.polling_sec)),
+      active_interval_(config.polling_active_sec > 0 ? fromSeconds(config.polling_active_sec) : interval_),
+      idle_max_(std::max(fromSeconds(config.polling_idle_max_sec), interval_)),
+      backoff_max_(std::max(fromSeconds(config.polling_backoff_max_sec), interval_)),
+      jitter_percent_(std::min<uint64_t>(config.polling_jitter_percent, 100U)),
+      rng_(seed) {}
+
+void PollScheduler::record(const Outcome outcome) {
+  std::lock_guard<std::mutex> lock(m_);
+  outcome_ = std::max(outcome_, outcome);
+}
+
+std::chrono::milliseconds PollScheduler::initialDelay() {
+  std::lock_guard<std::mutex> lock(m_);
+  const int64_t spread = interval_.count() * static_cast<int64_t>(jitter_percent_) / 100;
+  if (spread <= 0) {
+    return std::chrono::milliseconds{0};
+  }
+  return std::chrono::milliseconds(std::uniform_int_distribution<int64_t>(0, spread)(rng_));
+}
+
+std::chrono::milliseconds PollScheduler::nextDelay(const std::chrono::seconds retry_after) {
+  std::lock_guard<std::mutex> lock(m_);
+  const Outcome outcome = outcome_;
+  outcome_ = Outcome::kIdle;
+
+  std::chrono::milliseconds base;
+  switch (outcome) {
+    case Outcome::kError:
+      failures_ = std::min(failures_ + 1, kMaxDoublings);
+      idle_checks_ = 0;
+      base = doubled(interval_, failures_, backoff_max_);
+      break;
+    case Outcome::kActive:
+      failures_ = 0;
+      idle_checks_ = 0;
+      base = active_interval_;
+      break;
+    case Outcome::kIdle:
+    default:
+      failures_ = 0;
+      base = doubled(interval_, idle_checks_, idle_max_);
+      idle_checks_ = std::min(idle_checks_ + 1, kMaxDoublings);
+      break;
+  }
+
+  std::chrono::milliseconds delay = jitter(base);
+  if (retry_after.count() > 0) {
+    // Compare in seconds, a huge Retry-After would overflow in milliseconds.
+    if (retry_after < std::chrono::duration_cast<std::chrono::seconds>(backoff_max_)) {
+      delay = std::max<std::chrono::milliseconds>(delay, retry_after);
+    } else {
+      delay = std::max(delay, backoff_max_);
+    }
+  }
+  return delay;
+}
+
+std::chrono::milliseconds PollScheduler::jitter(const std::chrono::milliseconds base) {
+  const int64_t spread = base.count() * static_cast<int64_t>(jitter_percent_) / 100;
+  if (spread <= 0) {
+    return base;
+  }
+  return base + std::chrono::milliseconds(std::uniform_int_distribution<int64_t>(-spread, spread)(rng_));
+}
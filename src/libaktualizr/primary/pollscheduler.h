@@ -0,0 +1,55 @@
+#ifndef POLLSCHEDULER_H_
+#define POLLSCHEDULER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <random>
+
+#include "libaktualizr/config.h"
+
+/**
+ * Decides how long Aktualizr::RunForever() waits between update checks.
+ *
+ * - Every delay is randomized by up to polling_jitter_percent either way, and
+ *   the first check by up to that share of polling_sec, so that devices that
+ *   start at the same time drift apart instead of polling in lockstep.
+ * - While an update is in progress, checks are polling_active_sec apart.
+ * - When idle, the interval starts at polling_sec and doubles after each idle
+ *   check, up to polling_idle_max_sec.
+ * - After a failed check, the interval doubles with every consecutive failure,
+ *   up to polling_backoff_max_sec.
+ * - A Retry-After delay requested by the server is respected, up to
+ *   polling_backoff_max_sec.
+ *
+ * Outcomes are recorded as they happen; the worst one since the last delay
+ * decides the next delay.
+ */
+class PollScheduler {
+ public:
+  enum class Outcome { kIdle = 0, kActive, kError };
+
+  explicit PollScheduler(const UptaneConfig& config, uint64_t seed = std::random_device{}());
+
+  void record(Outcome outcome);
+  std::chrono::milliseconds initialDelay();
+  /** Delay before the next check, given the Retry-After delay of the server if any. */
+  std::chrono::milliseconds nextDelay(std::chrono::seconds retry_after = std::chrono::seconds{0});
+
+ private:
+  std::chrono::milliseconds jitter(std::chrono::milliseconds base);
+
+  const std::chrono::milliseconds interval_;
+  const std::chrono::milliseconds active_interval_;
+  const std::chrono::milliseconds idle_max_;
+  const std::chrono::milliseconds backoff_max_;
+  const uint64_t jitter_percent_;
+
+  std::mutex m_;
+  std::mt19937_64 rng_;
+  Outcome outcome_{Outcome::kIdle};
+  unsigned int failures_{0};
+  unsigned int idle_checks_{0};
+};
+
+#endif  // POLLSCHEDULER_H_
@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "libaktualizr/config.h"
+#include "pollscheduler.h"
+
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+using Outcome = PollScheduler::Outcome;
+
+static UptaneConfig makeConfig(uint64_t jitter_percent) {
+  UptaneConfig config;
+  config.polling_sec = 60;
+  config.polling_jitter_percent = jitter_percent;
+  config.polling_active_sec = 10;
+  config.polling_idle_max_sec = 240;
+  config.polling_backoff_max_sec = 600;
+  return config;
+}
+
+static milliseconds next(PollScheduler& scheduler, Outcome outcome, seconds retry_after = seconds{0}) {
+  scheduler.record(outcome);
+  return scheduler.nextDelay(retry_after);
+}
+
+/* Idle checks slow down, active ones speed up and failures back off. */
+TEST(PollScheduler, Intervals) {
+  PollScheduler scheduler(makeConfig(0));
+  EXPECT_EQ(scheduler.initialDelay(), milliseconds{0});
+
+  EXPECT_EQ(next(scheduler, Outcome::kIdle), seconds{60});
+  EXPECT_EQ(next(scheduler, Outcome::kIdle), seconds{120});
+  EXPECT_EQ(next(scheduler, Outcome::kIdle), seconds{240});
+  EXPECT_EQ(next(scheduler, Outcome::kIdle), seconds{240});
+  EXPECT_EQ(next(scheduler, Outcome::kActive), seconds{10});
+  EXPECT_EQ(next(scheduler, Outcome::kIdle), seconds{60});
+
+  EXPECT_EQ(next(scheduler, Outcome::kError), seconds{120});
+  EXPECT_EQ(next(scheduler, Outcome::kError), seconds{240});
+  EXPECT_EQ(next(scheduler, Outcome::kError), seconds{480});
+  EXPECT_EQ(next(scheduler, Outcome::kError), seconds{600});
+  EXPECT_EQ(next(scheduler, Outcome::kError), seconds{600});
+  EXPECT_EQ(next(scheduler, Outcome::kIdle), seconds{60});
+
+  // The worst outcome since the last delay counts.
+  scheduler.record(Outcome::kError);
+  scheduler.record(Outcome::kActive);
+  EXPECT_EQ(scheduler.nextDelay(), seconds{120});
+  EXPECT_EQ(scheduler.nextDelay(), seconds{60});
+}
+
+/* The server can ask for a longer delay, up to polling_backoff_max_sec. */
+TEST(PollScheduler, RetryAfter) {
+  PollScheduler scheduler(makeConfig(0));
+  EXPECT_EQ(next(scheduler, Outcome::kError, seconds{300}), seconds{300});
+  EXPECT_EQ(next(scheduler, Outcome::kError, seconds{5}), seconds{240});
+  EXPECT_EQ(next(scheduler, Outcome::kError, seconds{100000}), seconds{600});
+  EXPECT_EQ(next(scheduler, Outcome::kError, seconds::max()), seconds{600});
+}
+
+/* Delays are randomized within polling_jitter_percent. */
+TEST(PollScheduler, Jitter) {
+  PollScheduler scheduler(makeConfig(20), 42);
+  milliseconds min_delay = milliseconds::max();
+  milliseconds max_delay = milliseconds::min();
+  for (int i = 0; i < 1000; ++i) {
+    const milliseconds initial = scheduler.initialDelay();
+    EXPECT_GE(initial, milliseconds{0});
+    EXPECT_LE(initial, seconds{12});
+    const milliseconds delay = next(scheduler, Outcome::kActive);
+    min_delay = std::min(min_delay, delay);
+    max_delay = std::max(max_delay, delay);
+  }
+  EXPECT_GE(min_delay, seconds{8});
+  EXPECT_LE(max_delay, seconds{12});
+  EXPECT_GT(max_delay - min_delay, seconds{3});
+}
+
+/*
+ * Simulation of a fleet of devices started at the same time, all polling the
+ * same server with a virtual clock. Returns the number of requests in each
+ * second. The server fails between `outage_begin` and `outage_end`, asking
+ * for `retry_after` if set.
+ */
+static std::vector<uint64_t> simulate(const UptaneConfig& config, const size_t devices, const seconds duration,
+                                      const seconds outage_begin, const seconds outage_end,
+                                      const seconds retry_after = seconds{0}) {
+  std::vector<std::unique_ptr<PollScheduler>> schedulers;
+  using Poll = std::pair<milliseconds, size_t>;
+  std::priority_queue<Poll, std::vector<Poll>, std::greater<Poll>> polls;
+  for (size_t i = 0; i < devices; ++i) {
+    schedulers.emplace_back(new PollScheduler(config, i));
+    polls.emplace(schedulers.back()->initialDelay(), i);
+  }
+
+  std::vector<uint64_t> requests(static_cast<size_t>(duration.count()), 0);
+  while (!polls.empty() && polls.top().first < duration) {
+    const Poll poll = polls.top();
+    polls.pop();
+    ++requests[static_cast<size_t>(std::chrono::duration_cast<seconds>(poll.first).count())];
+
+    PollScheduler& scheduler = *schedulers[poll.second];
+    const bool failing = poll.first >= outage_begin && poll.first < outage_end;
+    scheduler.record(failing ? Outcome::kError : Outcome::kIdle);
+    polls.emplace(poll.first + scheduler.nextDelay(failing ? retry_after : seconds{0}), poll.second);
+  }
+  return requests;
+}
+
+struct RateStats {
+  uint64_t total{0};
+  double mean{0};
+  uint64_t p50{0};
+  uint64_t p99{0};
+  uint64_t peak{0};
+};
+
+static RateStats rateStats(const std::vector<uint64_t>& requests, const seconds from, const seconds to) {
+  std::vector<uint64_t> window(requests.begin() + from.count(), requests.begin() + to.count());
+  RateStats stats;
+  for (const auto rate : window) {
+    stats.total += rate;
+  }
+  stats.mean = static_cast<double>(stats.total) / static_cast<double>(window.size());
+  std::sort(window.begin(), window.end());
+  stats.p50 = window[window.size() / 2];
+  stats.p99 = window[window.size() * 99 / 100];
+  stats.peak = window.back();
+  return stats;
+}
+
+static RateStats report(const std::string& name, const std::vector<uint64_t>& requests, const seconds from,
+                        const seconds to) {
+  const RateStats stats = rateStats(requests, from, to);
+  std::cout << name << " [" << from.count() << "s, " << to.count() << "s): " << stats.total << " requests, "
+            << stats.mean << "/s mean, " << stats.p50 << "/s median, " << stats.p99 << "/s p99, " << stats.peak
+            << "/s peak\n";
+  return stats;
+}
+
+static const size_t kDevices = 1000;
+static const seconds kDuration{3 * 3600};
+static const seconds kOutageBegin{3600};
+static const seconds kOutageEnd{4800};
+
+/* Without jitter, a fleet started at once polls in lockstep forever. */
+TEST(PollSchedulerSimulation, Lockstep) {
+  UptaneConfig config = makeConfig(0);
+  config.polling_idle_max_sec = 0;
+  config.polling_backoff_max_sec = 0;
+  const auto requests = simulate(config, kDevices, kDuration, kOutageBegin, kOutageEnd);
+  EXPECT_EQ(report("Lockstep", requests, seconds{0}, kOutageBegin).peak, kDevices);
+  EXPECT_EQ(report("Lockstep, outage", requests, kOutageBegin, kOutageEnd).peak, kDevices);
+  EXPECT_EQ(report("Lockstep, recovery", requests, kOutageEnd, kDuration).peak, kDevices);
+}
+
+/* Jitter spreads the requests, and backoff sheds load during an outage without a storm after it. */
+TEST(PollSchedulerSimulation, Spread) {
+  UptaneConfig config = makeConfig(20);
+  config.polling_idle_max_sec = 0;
+  config.polling_backoff_max_sec = 0;
+  const auto no_backoff = simulate(config, kDevices, kDuration, kOutageBegin, kOutageEnd);
+  EXPECT_LT(report("Jitter", no_backoff, seconds{0}, seconds{600}).peak, kDevices / 5);
+  EXPECT_LT(report("Jitter", no_backoff, seconds{600}, kOutageBegin).peak, kDevices / 10);
+  const RateStats outage_no_backoff = report("Jitter, outage", no_backoff, kOutageBegin, kOutageEnd);
+
+  config.polling_backoff_max_sec = 1800;
+  const auto backoff = simulate(config, kDevices, kDuration, kOutageBegin, kOutageEnd);
+  const RateStats outage_backoff = report("Jitter and backoff, outage", backoff, kOutageBegin, kOutageEnd);
+  EXPECT_LT(outage_backoff.total, outage_no_backoff.total / 2);
+  EXPECT_LT(report("Jitter and backoff, recovery", backoff, kOutageEnd, kDuration).peak, kDevices / 10);
+
+  const auto retry_after = simulate(config, kDevices, kDuration, kOutageBegin, kOutageEnd, seconds{600});
+  const RateStats outage_retry_after =
+      report("Jitter and Retry-After, outage", retry_after, kOutageBegin, kOutageEnd);
+  EXPECT_LT(outage_retry_after.total, 4 * kDevices);
+  EXPECT_LT(report("Jitter and Retry-After, recovery", retry_after, kOutageEnd, kDuration).peak, kDevices / 10);
+}
+
+#ifndef __NO_MAIN__
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+#endif
@@ -1,6 +1,8 @@
 #include "reportqueue.h"
 
+#include <algorithm>
 #include <chrono>
+#include <limits>
 
 #include "http/httpclient.h"
 #include "libaktualizr/config.h"
@@ -18,6 +20,10 @@ ReportQueue::ReportQueue(const Config& config_in, std::shared_ptr<HttpInterface>
   if (event_number_limit == 0) {
     throw std::invalid_argument("Event number limit is set to 0 what leads to event accumulation in DB");
   }
+
+  // Pick up the events left over by a previous run.
+  reloadPending();
+
   thread_ = std::thread(std::bind(&ReportQueue::run, this));
 }
 
@@ -30,68 +36,205 @@ ReportQueue::~ReportQueue() {
   thread_.join();
 
   LOG_TRACE << "Flushing report queue";
+  flush();
   flushQueue();
 }
 
 void ReportQueue::run() {
-  // Check if queue is nonempty. If so, move any reports to the Json array and
-  // try to send it to the server. Clear the Json array only if the send
-  // succeeds.
+  // Try to send everything that is pending to the server. Events are dropped
+  // from the pending list only if the send succeeds.
   std::unique_lock<std::mutex> lock(m_);
   while (!shutdown_) {
+    commitAll(lock);
+    lock.unlock();
     flushQueue();
-    cv_.wait_for(lock, std::chrono::seconds(run_pause_s_));
+    lock.lock();
+    if (cv_.wait_for(lock, std::chrono::seconds(run_pause_s_), [this] { return shutdown_ || new_events_; })) {
+      // Give a burst of events the chance to end up in the same request.
+      cv_.wait_for(lock, kFlushWindow, [this] { return shutdown_; });
+    }
+    new_events_ = false;
   }
 }
 
 void ReportQueue::enqueue(std::unique_ptr<ReportEvent> event) {
+  Json::Value json = event->toJson();
   {
     std::lock_guard<std::mutex> lock(m_);
-    storage->saveReportEvent(event->toJson());
+    staged_.push_back(std::move(json));
+    ++staged_seq_;
+    new_events_ = true;
   }
   cv_.notify_all();
 }
 
-void ReportQueue::flushQueue() {
+void ReportQueue::flush() {
+  std::unique_lock<std::mutex> lock(m_);
+  commitAll(lock);
+}
+
+void ReportQueue::commitAll(std::unique_lock<std::mutex>& lock) {
+  // Called with m_ held. Waits for a commit in progress, which may not
+  // include the latest events, and commits whatever is left.
+  const uint64_t seq = staged_seq_;
+  while (committed_seq_ < seq) {
+    if (committing_) {
+      committed_cv_.wait(lock);
+    } else {
+      commitStaged(lock);
+    }
+  }
+}
+
+void ReportQueue::commitStaged(std::unique_lock<std::mutex>& lock) {
+  // Called with m_ held, releases it while writing to the storage.
+  committing_ = true;
+  std::vector<Json::Value> staged;
+  staged.swap(staged_);
+  const uint64_t seq = staged_seq_;
+  lock.unlock();
+
   int64_t max_id = 0;
-  Json::Value report_array{Json::arrayValue};
-  storage->loadReportEvents(&report_array, &max_id, cur_event_number_limit_);
+  try {
+    if (!storage->saveReportEvents(staged, &max_id)) {
+      max_id = 0;
+    }
+  } catch (const std::exception& e) {
+    LOG_ERROR << "Failed to save report events: " << e.what();
+    max_id = 0;
+  }
+
+  lock.lock();
+  appendPending(std::move(staged), max_id);
+  committed_seq_ = seq;
+  committing_ = false;
+  committed_cv_.notify_all();
+}
+
+void ReportQueue::appendPending(std::vector<Json::Value> events, const int64_t max_id) {
+  // Called with m_ held.
+  if (max_id == 0) {
+    // Still try to send them, they just will not survive a restart.
+    if (pending_.size() + events.size() > kMaxPendingEvents) {
+      LOG_WARNING << "Dropping " << events.size() << " report events that could not be saved";
+      return;
+    }
+    for (auto& event : events) {
+      pending_.push_back({0, std::move(event)});
+    }
+    return;
+  }
 
+  if (unloaded_ || pending_.size() + events.size() > kMaxPendingEvents) {
+    // Keep the storage order: these are read back after the older ones.
+    unloaded_ = true;
+    return;
+  }
+  auto id = max_id - static_cast<int64_t>(events.size());
+  for (auto& event : events) {
+    ++id;
+    // Skip the events that a concurrent reloadPending() has already read.
+    if (id > last_id_) {
+      pending_.push_back({id, std::move(event)});
+      last_id_ = id;
+    }
+  }
+}
+
+void ReportQueue::reloadPending() {
+  std::vector<std::pair<int64_t, Json::Value>> persisted;
+  if (!storage->loadPendingReportEvents(&persisted, static_cast<int>(kMaxPendingEvents))) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(m_);
+  for (auto& event : persisted) {
+    if (event.first > last_id_) {
+      pending_.push_back({event.first, std::move(event.second)});
+      last_id_ = event.first;
+    }
+  }
+  unloaded_ = persisted.size() >= kMaxPendingEvents;
+}
+
+void ReportQueue::growEventNumberLimit() {
+  if (cur_event_number_limit_ == event_number_limit_) {
+    return;
+  }
+  // Recover from a 413 back-off gradually rather than hitting the limit of
+  // the server again right away.
+  if (cur_event_number_limit_ > std::numeric_limits<int>::max() / 2 ||
+      (event_number_limit_ > 0 && cur_event_number_limit_ * 2 >= event_number_limit_)) {
+    cur_event_number_limit_ = event_number_limit_;
+  } else {
+    cur_event_number_limit_ *= 2;
+  }
+}
+
+void ReportQueue::flushQueue() {
+  std::unique_lock<std::mutex> lock(m_);
   if (config.tls.server.empty()) {
     // Prevent a lot of unnecessary garbage output in uptane vector tests.
     LOG_TRACE << "No server specified. Clearing report queue.";
-    report_array.clear();
+    pending_.clear();
+    unloaded_ = false;
+    return;
   }
 
-  if (!report_array.empty()) {
-    HttpResponse response = http->post(config.tls.server + "/events", report_array);
+  if (pending_.empty() && unloaded_) {
+    lock.unlock();
+    reloadPending();
+    lock.lock();
+  }
+  if (pending_.empty()) {
+    return;
+  }
 
-    bool delete_events{response.isOk()};
-    // 404 implies the server does not support this feature. Nothing we can
-    // do, just move along.
-    if (response.http_status_code == 404) {
-      LOG_DEBUG << "Server does not support event reports. Clearing report queue.";
+  // Only this thread removes events from pending_, so the batch stays at its
+  // front while the lock is released for the request.
+  size_t batch_size = pending_.size();
+  if (cur_event_number_limit_ > 0) {
+    batch_size = std::min(batch_size, static_cast<size_t>(cur_event_number_limit_));
+  }
+  Json::Value report_array{Json::arrayValue};
+  int64_t max_id = 0;
+  for (size_t ii = 0; ii < batch_size; ++ii) {
+    report_array.append(pending_[ii].json);
+    max_id = std::max(max_id, pending_[ii].id);
+  }
+  lock.unlock();
+
+  HttpResponse response = http->post(config.tls.server + "/events", report_array);
+
+  bool delete_events{response.isOk()};
+  // 404 implies the server does not support this feature. Nothing we can
+  // do, just move along.
+  if (response.http_status_code == 404) {
+    LOG_DEBUG << "Server does not support event reports. Clearing report queue.";
+    delete_events = true;
+  } else if (response.http_status_code == 413) {
+    if (report_array.size() > 1) {
+      // if 413 is received to posting of more than one event then try sending less events next time
+      cur_event_number_limit_ = report_array.size() > 2 ? static_cast<int>(report_array.size() / 2U) : 1;
+      LOG_DEBUG << "Got 413 response to request that contains " << report_array.size() << " events. Will try to send "
+                << cur_event_number_limit_ << " events.";
+    } else {
+      // An event is too big to be accepted by the server, let's drop it
+      LOG_WARNING << "Dropping a report event " << report_array[0].get("id", "unknown") << " since the server `"
+                  << config.tls.server << "` cannot digest it (413).";
       delete_events = true;
-    } else if (response.http_status_code == 413) {
-      if (report_array.size() > 1) {
-        // if 413 is received to posting of more than one event then try sending less events next time
-        cur_event_number_limit_ = report_array.size() > 2 ? static_cast<int>(report_array.size() / 2U) : 1;
-        LOG_DEBUG << "Got 413 response to request that contains " << report_array.size() << " events. Will try to send "
-                  << cur_event_number_limit_ << " events.";
-      } else {
-        // An event is too big to be accepted by the server, let's drop it
-        LOG_WARNING << "Dropping a report event " << report_array[0].get("id", "unknown") << " since the server `"
-                    << config.tls.server << "` cannot digest it (413).";
-        delete_events = true;
-      }
-    } else if (!response.isOk()) {
-      LOG_WARNING << "Failed to post update events: " << response.getStatusStr();
     }
-    if (delete_events) {
-      report_array.clear();
+  } else if (!response.isOk()) {
+    LOG_WARNING << "Failed to post update events: " << response.getStatusStr();
+  }
+  if (delete_events) {
+    lock.lock();
+    pending_.erase(pending_.begin(), pending_.begin() + static_cast<std::ptrdiff_t>(batch_size));
+    lock.unlock();
+    if (max_id > 0) {
       storage->deleteReportEvents(max_id);
-      cur_event_number_limit_ = event_number_limit_;
     }
+    growEventNumberLimit();
   }
 }
 
@@ -2,12 +2,14 @@
 #define REPORTQUEUE_H_
 
 #include <json/json.h>
+#include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <memory>
 #include <mutex>
-#include <queue>
 #include <thread>
 #include <utility>  // for move
+#include <vector>
 
 #include "libaktualizr/types.h"  // for EcuSerial (ptr only), TimeStamp
 #include "utilities/utils.h"     // for Utils
@@ -94,17 +96,55 @@ class ReportQueue {
   ReportQueue& operator=(const ReportQueue&) = delete;
   ReportQueue& operator=(ReportQueue&&) = delete;
   void run();
+  // Returns once the event is queued. The queue writes it to the storage
+  // together with the other events of the same flush window.
   void enqueue(std::unique_ptr<ReportEvent> event);
+  // Returns once every event enqueued so far has been written to the storage,
+  // so that they survive a crash or a reboot.
+  void flush();
+
+  // Events enqueued within this window after the first one are posted
+  // together.
+  static constexpr std::chrono::milliseconds kFlushWindow{100};
+  // Maximum number of events kept in memory. The rest stay in the storage
+  // and are read back in batches of this size once the queue has drained.
+  static constexpr size_t kMaxPendingEvents{1000};
 
  private:
+  struct PendingEvent {
+    // 0 if the event could not be persisted.
+    int64_t id;
+    Json::Value json;
+  };
+
   void flushQueue();
+  void commitAll(std::unique_lock<std::mutex>& lock);
+  void commitStaged(std::unique_lock<std::mutex>& lock);
+  void appendPending(std::vector<Json::Value> events, int64_t max_id);
+  void reloadPending();
+  void growEventNumberLimit();
 
   const Config& config;
   std::shared_ptr<HttpInterface> http;
   std::thread thread_;
   std::condition_variable cv_;
+  std::condition_variable committed_cv_;
   std::mutex m_;
-  std::queue<std::unique_ptr<ReportEvent>> report_queue_;
+  // The members below up to shutdown_ are guarded by m_.
+  // Serialized events not yet written to the storage. The queue thread, or a
+  // flush() that finds no commit in progress, writes all of them in one
+  // transaction.
+  std::vector<Json::Value> staged_;
+  uint64_t staged_seq_{0};
+  uint64_t committed_seq_{0};
+  bool committing_{false};
+  // Persisted events not yet accepted by the server, in storage order.
+  std::deque<PendingEvent> pending_;
+  // Highest storage id in pending_ so far.
+  int64_t last_id_{0};
+  // Set when the storage holds events that did not fit into pending_.
+  bool unloaded_{false};
+  bool new_events_{false};
   bool shutdown_{false};
   std::shared_ptr<INvStorage> storage;
   const int run_pause_s_;
@@ -1,9 +1,12 @@
 #include <gtest/gtest.h>
 
 #include <unistd.h>
+#include <atomic>
 #include <future>
 #include <memory>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <json/json.h>
 
@@ -71,6 +74,22 @@ class HttpFakeRq : public HttpFake {
         expected_events_received.set_value(true);
       }
       return HttpResponse("", 200, CURLE_OK, "");
+    } else if (url.find("reportqueue/CoalescedFlush") == 0) {
+      ++requests_seen;
+      events_seen += data.size();
+      if (events_seen == expected_events_) {
+        expected_events_received.set_value(true);
+      }
+      return HttpResponse("", 200, CURLE_OK, "");
+    } else if (url.find("reportqueue/BatchedReload") == 0) {
+      ++requests_seen;
+      for (int i = 0; i < static_cast<int>(data.size()); ++i) {
+        EXPECT_EQ(data[i]["id"], std::to_string(events_seen++));
+      }
+      if (events_seen == expected_events_) {
+        expected_events_received.set_value(true);
+      }
+      return HttpResponse("", 200, CURLE_OK, "");
     } else if (url.find("reportqueue/EventNumberLimit") == 0) {
       const auto recv_event_numb{data.size()};
       EXPECT_GT(recv_event_numb, 0);
@@ -107,6 +126,7 @@ class HttpFakeRq : public HttpFake {
   }
 
   size_t events_seen{0};
+  size_t requests_seen{0};
   size_t expected_events_;
   std::promise<bool> expected_events_received{};
   int event_numb_limit_;
@@ -201,9 +221,12 @@ TEST(ReportQueue, StoreEvents) {
     for (size_t i = 0; i < num_events; ++i) {
       report_queue.enqueue(std_::make_unique<EcuDownloadCompletedReport>(
           Uptane::EcuSerial("StoreEvents" + std::to_string(i)), "", true));
+      // Persisted as soon as flush() returns.
+      report_queue.flush();
+      check_sql(i + 1);
     }
-    check_sql(num_events);
   }
+  check_sql(num_events);
 
   config.tls.server = "reportqueue/StoreEvents";
   auto http = std::make_shared<HttpFakeRq>(temp_dir.Path(), num_events);
@@ -215,6 +238,106 @@ TEST(ReportQueue, StoreEvents) {
   check_sql(0);
 }
 
+/* A burst of events from several threads is committed to the storage and
+ * posted in a few batches rather than one by one. */
+TEST(ReportQueue, CoalescedFlush) {
+  TemporaryDirectory temp_dir;
+  Config config;
+  config.storage.path = temp_dir.Path();
+  config.tls.server = "reportqueue/CoalescedFlush";
+
+  const size_t num_threads = 10;
+  const size_t num_events = 100;
+  auto http = std::make_shared<HttpFakeRq>(temp_dir.Path(), num_events);
+  auto sql_storage = std::make_shared<SQLStorage>(config.storage, false);
+  {
+    ReportQueue report_queue(config, http, sql_storage);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; ++t) {
+      threads.emplace_back([&report_queue, t]() {
+        for (size_t i = 0; i < num_events / num_threads; ++i) {
+          report_queue.enqueue(std_::make_unique<EcuDownloadCompletedReport>(
+              Uptane::EcuSerial("CoalescedFlush" + std::to_string(t) + "_" + std::to_string(i)), "", true));
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+
+    http->expected_events_received.get_future().wait_for(std::chrono::seconds(20));
+  }
+  EXPECT_EQ(http->events_seen, num_events);
+  EXPECT_LT(http->requests_seen, num_events / 10);
+
+  int64_t max_id = 0;
+  Json::Value report_array{Json::arrayValue};
+  EXPECT_FALSE(sql_storage->loadReportEvents(&report_array, &max_id, -1));
+}
+
+class SQLStorageCountingCommits : public SQLStorage {
+ public:
+  using SQLStorage::SQLStorage;
+  bool saveReportEvents(const std::vector<Json::Value> &events, int64_t *id_max) override {
+    ++commits;
+    return SQLStorage::saveReportEvents(events, id_max);
+  }
+
+  std::atomic<size_t> commits{0};
+};
+
+/* Events enqueued in a burst are written to the storage in a few transactions
+ * rather than one each. */
+TEST(ReportQueue, GroupCommit) {
+  TemporaryDirectory temp_dir;
+  Config config;
+  config.storage.path = temp_dir.Path();
+  config.tls.server = "";
+
+  const size_t num_events = 100;
+  auto sql_storage = std::make_shared<SQLStorageCountingCommits>(config.storage, false);
+  auto http = std::make_shared<HttpFakeRq>(temp_dir.Path(), num_events);
+  ReportQueue report_queue(config, http, sql_storage);
+  for (size_t i = 0; i < num_events; ++i) {
+    report_queue.enqueue(std_::make_unique<EcuDownloadCompletedReport>(
+        Uptane::EcuSerial("GroupCommit" + std::to_string(i)), "", true));
+  }
+  report_queue.flush();
+
+  int64_t max_id = 0;
+  Json::Value report_array{Json::arrayValue};
+  EXPECT_TRUE(sql_storage->loadReportEvents(&report_array, &max_id, -1));
+  EXPECT_EQ(max_id, num_events);
+  EXPECT_LT(sql_storage->commits, num_events);
+}
+
+/* Only ReportQueue::kMaxPendingEvents events are held in memory, the rest are
+ * read back from the storage in order once those have been sent. */
+TEST(ReportQueue, BatchedReload) {
+  TemporaryDirectory temp_dir;
+  Config config;
+  config.storage.path = temp_dir.Path();
+  config.tls.server = "reportqueue/BatchedReload";
+
+  const size_t num_events = ReportQueue::kMaxPendingEvents + 10;
+  auto sql_storage = std::make_shared<SQLStorage>(config.storage, false);
+  for (size_t i = 0; i < num_events; ++i) {
+    sql_storage->saveReportEvent(Utils::parseJSON(R"({"id": ")" + std::to_string(i) + R"("})"));
+  }
+
+  auto http = std::make_shared<HttpFakeRq>(temp_dir.Path(), num_events);
+  {
+    ReportQueue report_queue(config, http, sql_storage, 0);
+    http->expected_events_received.get_future().wait_for(std::chrono::seconds(20));
+  }
+  EXPECT_EQ(http->events_seen, num_events);
+  EXPECT_EQ(http->requests_seen, 2U);
+
+  int64_t max_id = 0;
+  Json::Value report_array{Json::arrayValue};
+  EXPECT_FALSE(sql_storage->loadReportEvents(&report_array, &max_id, -1));
+}
+
 TEST(ReportQueue, LimitEventNumber) {
   TemporaryDirectory temp_dir;
   Config config;
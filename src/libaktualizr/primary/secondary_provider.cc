@@ -2,6 +2,7 @@
 
 #include <fstream>
 
+#include "primary/firmwarebroadcast.h"
 #include "logging/logging.h"
 #include "storage/invstorage.h"
 #include "uptane/tuf.h"
@@ -102,3 +103,64 @@ std::string SecondaryProvider::getTreehubCredentials() const {
 std::ifstream SecondaryProvider::getTargetFileHandle(const Uptane::Target& target) const {
   return package_manager_->openTargetFile(target);
 }
+
+std::unique_ptr<std::istream> SecondaryProvider::openTargetFile(const Uptane::Target& target,
+                                                                const Uptane::EcuSerial& serial) const {
+  std::shared_ptr<FirmwareBroadcast> broadcast;
+  {
+    std::lock_guard<std::mutex> lock(broadcasts_mutex_);
+    auto it = broadcasts_.find(Hash::encodeVector(target.hashes()));
+    if (it != broadcasts_.end()) {
+      broadcast = it->second;
+    }
+  }
+  if (broadcast != nullptr) {
+    auto stream = broadcast->open(serial);
+    if (stream != nullptr) {
+      return stream;
+    }
+  }
+  return std_::make_unique<std::ifstream>(package_manager_->openTargetFile(target));
+}
+
+void SecondaryProvider::shareTargetFile(const Uptane::Target& target, const std::vector<Uptane::EcuSerial>& serials) {
+  // Chunks as big as the ones sent to the Secondaries, up to 8 MiB ahead of the slowest one.
+  static const size_t kChunkSize = 256U * 1024U;
+  static const size_t kMaxChunks = 32;
+
+  // Without a hash there is nothing to tell images apart by.
+  const std::string key = Hash::encodeVector(target.hashes());
+  if (target.IsOstree() || serials.size() < 2 || key.empty()) {
+    return;
+  }
+  std::unique_ptr<std::istream> source;
+  try {
+    source = std_::make_unique<std::ifstream>(package_manager_->openTargetFile(target));
+  } catch (const std::exception& e) {
+    // Each Secondary opens the image on its own then and reports the error.
+    LOG_WARNING << "Could not open " << target.filename() << " to share it: " << e.what();
+    return;
+  }
+  std::lock_guard<std::mutex> lock(broadcasts_mutex_);
+  if (broadcasts_.count(key) != 0) {
+    LOG_WARNING << "Image of " << target.filename() << " is already being shared";
+    return;
+  }
+  broadcasts_.emplace(key, std::make_shared<FirmwareBroadcast>(std::move(source), serials, kChunkSize, kMaxChunks));
+  LOG_DEBUG << "Reading " << target.filename() << " once for " << serials.size() << " Secondaries";
+}
+
+void SecondaryProvider::releaseTargetFile(const Uptane::Target& target, const Uptane::EcuSerial& serial) {
+  std::lock_guard<std::mutex> lock(broadcasts_mutex_);
+  auto it = broadcasts_.find(Hash::encodeVector(target.hashes()));
+  if (it == broadcasts_.end()) {
+    return;
+  }
+  it->second->leave(serial);
+  if (it->second->finished()) {
+    const FirmwareBroadcast::Stats stats = it->second->stats();
+    LOG_DEBUG << "Read " << stats.chunks_read << " chunks of " << target.filename() << " with up to "
+              << stats.max_buffered << " buffered";
+    broadcasts_.erase(it);
+  }
+}
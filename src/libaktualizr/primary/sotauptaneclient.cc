@@ -1,8 +1,13 @@
 #include "primary/sotauptaneclient.h"
 
-#include <fnmatch.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <fstream>
+#include <future>
 #include <memory>
+#include <random>
+#include <thread>
 #include <utility>
 
 #include "crypto/crypto.h"
@@ -13,13 +18,21 @@
 #include "uptane/exceptions.h"
 #include "utilities/utils.h"
 
-static void report_progress_cb(event::Channel *channel, const Uptane::Target &target, const std::string &description,
-                               unsigned int progress) {
-  if (channel == nullptr) {
-    return;
-  }
-  auto event = std::make_shared<event::DownloadProgressReport>(target, description, progress);
-  (*channel)(event);
+/**
+ * Randomize a retry wait by up to +50%, so that targets which failed at the
+ * same time (e.g. on a network outage) are not retried in lockstep.
+ */
+static std::chrono::milliseconds retryWaitWithJitter(std::chrono::milliseconds wait) {
+  static std::mutex rng_mutex;
+  static std::mt19937 rng{std::random_device{}()};
+  std::lock_guard<std::mutex> guard(rng_mutex);
+  std::uniform_int_distribution<int64_t> jitter(0, wait.count() / 2);
+  return wait + std::chrono::milliseconds(jitter(rng));
+}
+
+// The name of the file a target is downloaded to, see PackageManagerInterface::createTargetFile()
+static std::string targetFileKey(const Uptane::Target &target) {
+  return target.hashes().empty() ? target.filename() : target.hashes()[0].HashString();
 }
 
 /**
@@ -47,7 +60,9 @@ SotaUptaneClient::SotaUptaneClient(Config &config_in, std::shared_ptr<INvStorage
       uptane_fetcher(new Uptane::Fetcher(config, http)),
       events_channel(std::move(events_channel_in)),
       provisioner_(config.provision, storage, http, key_manager_, secondaries),
-      flow_control_(flow_control) {
+      flow_control_(flow_control),
+      event_bus_(events_channel ? std_::make_unique<EventBus>(events_channel, config.uptane.event_queue_size)
+                                : nullptr) {
   report_queue = std_::make_unique<ReportQueue>(config, http, storage);
   secondary_provider_ = SecondaryProviderBuilder::Build(config, storage, package_manager_);
 }
@@ -301,6 +316,37 @@ void SotaUptaneClient::reportAktualizrConfiguration() {
   }
 }
 
+bool SotaUptaneClient::verifySecondaryManifest(const SecondaryInterface &secondary, const Uptane::Manifest &manifest) {
+  try {
+    return manifest.verifySignature(secondary.getPublicKey());
+  } catch (const std::exception &ex) {
+    LOG_ERROR << "Failed to get public key from Secondary with serial " << secondary.getSerial() << ": "
+              << ex.what();
+  }
+  return false;
+}
+
+SotaUptaneClient::SecondaryManifest SotaUptaneClient::requestSecondaryManifest(
+    const SecondaryInterface::Ptr &secondary) {
+  SecondaryManifest result;
+  try {
+    result.manifest = secondary->getManifest();
+  } catch (const std::exception &ex) {
+    // Not critical; it might just be temporarily offline.
+    LOG_DEBUG << "Failed to get manifest from Secondary with serial " << secondary->getSerial() << ": " << ex.what();
+  }
+  if (!result.manifest.empty()) {
+    result.verified = verifySecondaryManifest(*secondary, result.manifest);
+  }
+  return result;
+}
+
+bool SotaUptaneClient::secondaryBusy(const Uptane::EcuSerial &serial) const {
+  const auto request = secondary_manifest_requests_.find(serial);
+  return request != secondary_manifest_requests_.end() && request->second.valid() &&
+         request->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+}
+
 Json::Value SotaUptaneClient::AssembleManifest() {
   Json::Value manifest;  // signed top-level
   Uptane::EcuSerial primary_ecu_serial = primaryEcuSerial();
@@ -309,6 +355,22 @@ Json::Value SotaUptaneClient::AssembleManifest() {
   // first part: report current version/state of all ECUs
   Json::Value version_manifest;
 
+  // Ask all Secondaries at once and do the Primary's own part in the
+  // meantime, so that a slow or unreachable Secondary only costs one timeout.
+  // A request that misses the deadline is left running and waited for again
+  // by the next call instead of sending another one to the same Secondary.
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(config.uptane.secondary_manifest_timeout_ms);
+  for (const auto &sec : secondaries) {
+    auto &request = secondary_manifest_requests_[sec.first];
+    if (request.valid() && request.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      LOG_DEBUG << "Still waiting for the previous manifest request to Secondary " << sec.first;
+      continue;
+    }
+    // A result that came in after the last deadline is outdated by now.
+    request = std::async(std::launch::async, requestSecondaryManifest, sec.second);
+  }
+
   Json::Value primary_manifest = uptane_manifest->assembleManifest(package_manager_->getCurrent());
   std::vector<std::pair<Uptane::EcuSerial, int64_t>> ecu_cnt;
   std::string report_counter;
@@ -321,23 +383,25 @@ Json::Value SotaUptaneClient::AssembleManifest() {
   }
   version_manifest[primary_ecu_serial.ToString()] = uptane_manifest->sign(primary_manifest, report_counter);
 
-  for (auto it = secondaries.begin(); it != secondaries.end(); it++) {
-    const Uptane::EcuSerial &ecu_serial = it->first;
-    Uptane::Manifest secmanifest;
-    try {
-      secmanifest = it->second->getManifest();
-    } catch (const std::exception &ex) {
-      // Not critical; it might just be temporarily offline.
-      LOG_DEBUG << "Failed to get manifest from Secondary with serial " << ecu_serial << ": " << ex.what();
+  for (const auto &sec : secondaries) {
+    const Uptane::EcuSerial &ecu_serial = sec.first;
+    auto &request = secondary_manifest_requests_[ecu_serial];
+    SecondaryManifest result;
+    if (request.wait_until(deadline) == std::future_status::ready) {
+      result = request.get();
+    } else {
+      LOG_WARNING << "Secondary " << ecu_serial << " did not send its manifest within "
+                  << config.uptane.secondary_manifest_timeout_ms << " ms";
     }
 
     bool from_cache = false;
-    if (secmanifest.empty()) {
+    if (result.manifest.empty()) {
       // Could not get the Secondary manifest directly, so just use a cached value.
       std::string cached;
       if (storage->loadCachedEcuManifest(ecu_serial, &cached)) {
         LOG_WARNING << "Could not reach Secondary " << ecu_serial << ", sending a cached version of its manifest";
-        secmanifest = Utils::parseJSON(cached);
+        result.manifest = Utils::parseJSON(cached);
+        result.verified = verifySecondaryManifest(*secondaries.at(ecu_serial), result.manifest);
         from_cache = true;
       } else {
         LOG_ERROR << "Failed to get a valid manifest from Secondary with serial " << ecu_serial << " or from cache!";
@@ -345,21 +409,15 @@ Json::Value SotaUptaneClient::AssembleManifest() {
       }
     }
 
-    bool verified = false;
-    try {
-      verified = secmanifest.verifySignature(it->second->getPublicKey());
-    } catch (const std::exception &ex) {
-      LOG_ERROR << "Failed to get public key from Secondary with serial " << ecu_serial << ": " << ex.what();
-    }
-    if (verified) {
-      version_manifest[ecu_serial.ToString()] = secmanifest;
+    if (result.verified) {
+      version_manifest[ecu_serial.ToString()] = result.manifest;
       if (!from_cache) {
-        storage->storeCachedEcuManifest(ecu_serial, Utils::jsonToCanonicalStr(secmanifest));
+        storage->storeCachedEcuManifest(ecu_serial, Utils::jsonToCanonicalStr(result.manifest));
       }
     } else {
       // TODO(OTA-4305): send a corresponding event/report in this case
       LOG_ERROR << "Invalid manifest or signature reported by Secondary: "
-                << " serial: " << ecu_serial << " manifest: " << secmanifest;
+                << " serial: " << ecu_serial << " manifest: " << result.manifest;
     }
   }
   manifest["ecu_version_manifests"] = version_manifest;
@@ -411,10 +469,22 @@ void SotaUptaneClient::initialize() {
   uptane_manifest = std::make_shared<Uptane::ManifestIssuer>(key_manager_, provisioner_.PrimaryEcuSerial());
 
   finalizeAfterReboot();
+  // Keep what was downloaded for the current Director Targets but not yet installed.
+  package_manager_->maintainTargetCache(storedDirectorTargets());
 
   attemptProvision();
 }
 
+std::vector<Uptane::Target> SotaUptaneClient::storedDirectorTargets() {
+  try {
+    director_repo.checkMetaOffline(*storage);
+  } catch (const std::exception &e) {
+    LOG_DEBUG << "No valid Director metadata stored: " << e.what();
+    return {};
+  }
+  return director_repo.getTargets().targets;
+}
+
 void SotaUptaneClient::requiresProvision() {
   if (!attemptProvision()) {
     throw ProvisioningFailed();
@@ -440,6 +510,7 @@ void SotaUptaneClient::updateDirectorMeta() {
 void SotaUptaneClient::updateImageMeta() {
   requiresProvision();
   try {
+    clearDelegationCache();
     image_repo.updateMeta(*storage, *uptane_fetcher, flow_control_);
   } catch (const std::exception &e) {
     LOG_ERROR << "Failed to update Image repo metadata: " << e.what();
@@ -460,6 +531,7 @@ void SotaUptaneClient::checkDirectorMetaOffline() {
 void SotaUptaneClient::checkImageMetaOffline() {
   requiresAlreadyProvisioned();
   try {
+    clearDelegationCache();
     image_repo.checkMetaOffline(*storage);
   } catch (const std::exception &e) {
     LOG_ERROR << "Failed to check Image repo metadata: " << e.what();
@@ -611,11 +683,11 @@ void SotaUptaneClient::getNewTargets(std::vector<Uptane::Target> *new_targets, u
 std::unique_ptr<Uptane::Target> SotaUptaneClient::findTargetHelper(const Uptane::Targets &cur_targets,
                                                                    const Uptane::Target &queried_target,
                                                                    const int level, const bool terminating,
-                                                                   const bool offline) {
-  TargetCompare target_comp(queried_target);
-  const auto it = std::find_if(cur_targets.targets.cbegin(), cur_targets.targets.cend(), target_comp);
-  if (it != cur_targets.targets.cend()) {
-    return std_::make_unique<Uptane::Target>(*it);
+                                                                   const bool offline,
+                                                                   const std::vector<std::string> &path) {
+  const Uptane::Target *found = cur_targets.findTarget(queried_target);
+  if (found != nullptr) {
+    return std_::make_unique<Uptane::Target>(*found);
   }
 
   if (terminating || level >= Uptane::kDelegationsMaxDepth) {
@@ -624,27 +696,16 @@ std::unique_ptr<Uptane::Target> SotaUptaneClient::findTargetHelper(const Uptane:
 
   for (const auto &delegate_name : cur_targets.delegated_role_names_) {
     Uptane::Role delegate_role = Uptane::Role::Delegation(delegate_name);
-    auto patterns = cur_targets.paths_for_role_.find(delegate_role);
-    if (patterns == cur_targets.paths_for_role_.end()) {
-      continue;
-    }
-
-    bool match = false;
-    for (const auto &pattern : patterns->second) {
-      if (fnmatch(pattern.c_str(), queried_target.filename().c_str(), 0) == 0) {
-        match = true;
-        break;
-      }
-    }
-    if (!match) {
+    if (!cur_targets.matchesDelegationPaths(delegate_role, queried_target.filename())) {
       continue;
     }
 
     // Target name matches one of the patterns
 
-    auto delegation = Uptane::getTrustedDelegation(delegate_role, cur_targets, image_repo, *storage, *uptane_fetcher,
-                                                   offline, flow_control_);
-    if (delegation.isExpired(TimeStamp::Now())) {
+    std::vector<std::string> delegate_path(path);
+    delegate_path.push_back(delegate_name);
+    const auto delegation = trustedDelegation(delegate_path, cur_targets, offline);
+    if (delegation->isExpired(TimeStamp::Now())) {
       continue;
     }
 
@@ -654,7 +715,8 @@ std::unique_ptr<Uptane::Target> SotaUptaneClient::findTargetHelper(const Uptane:
     }
 
     // NOLINTNEXTLINE(misc-no-recursion)
-    auto found_target = findTargetHelper(delegation, queried_target, level + 1, is_terminating->second, offline);
+    auto found_target =
+        findTargetHelper(*delegation, queried_target, level + 1, is_terminating->second, offline, delegate_path);
     if (found_target != nullptr) {
       return found_target;
     }
@@ -663,6 +725,41 @@ std::unique_ptr<Uptane::Target> SotaUptaneClient::findTargetHelper(const Uptane:
   return std::unique_ptr<Uptane::Target>(nullptr);
 }
 
+std::shared_ptr<const Uptane::Targets> SotaUptaneClient::trustedDelegation(const std::vector<std::string> &path,
+                                                                         const Uptane::Targets &parent_targets,
+                                                                         const bool offline) {
+  // Delegations are fetched and verified once per Image repo metadata update
+  // rather than once per queried target. The same role name delegated by
+  // another parent is verified with that parent's keys, so it is cached
+  // separately.
+  std::unique_lock<std::mutex> lock(delegation_cache_mutex_);
+  auto it = delegation_cache_.find(path);
+  if (it != delegation_cache_.end()) {
+    return it->second;
+  }
+  const uint64_t generation = delegation_cache_generation_;
+  lock.unlock();
+
+  // Fetching may take a while, other lookups go on meanwhile.
+  auto delegation = std::make_shared<const Uptane::Targets>(
+      Uptane::getTrustedDelegation(Uptane::Role::Delegation(path.back()), parent_targets, image_repo, *storage,
+                                   *uptane_fetcher, offline, flow_control_));
+
+  lock.lock();
+  if (delegation_cache_generation_ != generation) {
+    // The cache was cleared for newer metadata; don't mix this in.
+    return delegation;
+  }
+  // Another thread may have fetched the same delegation first; keep one copy.
+  return delegation_cache_.emplace(path, std::move(delegation)).first->second;
+}
+
+void SotaUptaneClient::clearDelegationCache() {
+  std::lock_guard<std::mutex> guard(delegation_cache_mutex_);
+  delegation_cache_.clear();
+  ++delegation_cache_generation_;
+}
+
 std::unique_ptr<Uptane::Target> SotaUptaneClient::findTargetInDelegationTree(const Uptane::Target &target,
                                                                              const bool offline) {
   auto toplevel_targets = image_repo.getTargets();
@@ -670,7 +767,7 @@ std::unique_ptr<Uptane::Target> SotaUptaneClient::findTargetInDelegationTree(con
     return std::unique_ptr<Uptane::Target>(nullptr);
   }
 
-  return findTargetHelper(*toplevel_targets, target, 0, false, offline);
+  return findTargetHelper(*toplevel_targets, target, 0, false, offline, {});
 }
 
 result::Download SotaUptaneClient::downloadImages(const std::vector<Uptane::Target> &targets) {
@@ -685,6 +782,7 @@ result::Download SotaUptaneClient::downloadImages(const std::vector<Uptane::Targ
   try {
     update_status = checkUpdatesOffline(targets);
   } catch (const std::exception &e) {
+    std::lock_guard<std::mutex> guard(last_exception_mutex);
     last_exception = std::current_exception();
     update_status = result::UpdateStatus::kError;
   }
@@ -702,10 +800,45 @@ result::Download SotaUptaneClient::downloadImages(const std::vector<Uptane::Targ
     return result;
   }
 
+  package_manager_->maintainTargetCache(targets);
+
+  // Downloads are independent of each other, so run up to
+  // download_parallelism of them at a time. Each worker picks the next pending
+  // target; results are collected in the original order of the targets.
+  primaryEcuSerial();  // resolve it once here rather than concurrently in the workers
+  std::vector<char> succeeded(targets.size(), 0);
+  std::atomic<size_t> next_target{0};
+  // Targets with the same content are stored in the same file, so only one of
+  // them is downloaded at a time. The others then just link to the file.
+  std::map<std::string, std::mutex> file_mutexes;
   for (const auto &target : targets) {
-    auto res = downloadImage(target);
-    if (res.first) {
-      downloaded_targets.push_back(res.second);
+    file_mutexes[targetFileKey(target)];
+  }
+  auto download_worker = [this, &targets, &succeeded, &next_target, &file_mutexes]() {
+    for (size_t k = next_target++; k < targets.size(); k = next_target++) {
+      std::lock_guard<std::mutex> file_guard(file_mutexes.at(targetFileKey(targets[k])));
+      succeeded[k] = static_cast<char>(downloadImage(targets[k]).first);
+    }
+  };
+
+  const size_t workers_count =
+      std::min(targets.size(), static_cast<size_t>(std::max<uint64_t>(config.uptane.download_parallelism, 1U)));
+  if (workers_count <= 1) {
+    download_worker();
+  } else {
+    LOG_INFO << "Downloading " << targets.size() << " targets with up to " << workers_count << " parallel downloads";
+    std::vector<std::future<void>> workers;
+    for (size_t k = 0; k < workers_count; ++k) {
+      workers.push_back(std::async(std::launch::async, download_worker));
+    }
+    for (auto &w : workers) {
+      w.get();
+    }
+  }
+
+  for (size_t k = 0; k < targets.size(); ++k) {
+    if (succeeded[k] != 0) {
+      downloaded_targets.push_back(targets[k]);
     }
   }
 
@@ -753,15 +886,15 @@ std::pair<bool, Uptane::Target> SotaUptaneClient::downloadImage(const Uptane::Ta
     KeyManager keys(storage, config.keymanagerConfig());
     keys.loadKeys();
     auto prog_cb = [this](const Uptane::Target &t, const std::string &description, unsigned int progress) {
-      report_progress_cb(events_channel.get(), t, description, progress);
+      sendEvent<event::DownloadProgressReport>(t, description, progress);
     };
 
     const Uptane::EcuSerial &primary_ecu_serial = primaryEcuSerial();
 
     if (target.IsForEcu(primary_ecu_serial) || !target.IsOstree()) {
-      const int max_tries = 3;
-      int tries = 0;
-      std::chrono::milliseconds wait(500);
+      const uint64_t max_tries = std::max<uint64_t>(config.uptane.download_max_tries, 1U);
+      uint64_t tries = 0;
+      std::chrono::milliseconds wait(config.uptane.download_retry_wait_ms);
 
       for (; tries < max_tries; tries++) {
         success = package_manager_->fetchTarget(target, *uptane_fetcher, keys, prog_cb, flow_control_);
@@ -770,7 +903,7 @@ std::pair<bool, Uptane::Target> SotaUptaneClient::downloadImage(const Uptane::Ta
         if (success || (flow_control_ != nullptr && flow_control_->hasAborted())) {
           break;
         } else if (tries < max_tries - 1) {
-          std::this_thread::sleep_for(wait);
+          std::this_thread::sleep_for(retryWaitWithJitter(wait));
           wait *= 2;
         }
       }
@@ -787,6 +920,7 @@ std::pair<bool, Uptane::Target> SotaUptaneClient::downloadImage(const Uptane::Ta
     }
   } catch (const std::exception &e) {
     LOG_ERROR << "Error downloading image: " << e.what();
+    std::lock_guard<std::mutex> guard(last_exception_mutex);
     last_exception = std::current_exception();
   }
 
@@ -902,6 +1036,7 @@ result::UpdateCheck SotaUptaneClient::checkUpdates() {
   try {
     uptaneIteration(&updates, &ecus_count);
   } catch (const std::exception &e) {
+    std::lock_guard<std::mutex> guard(last_exception_mutex);
     last_exception = std::current_exception();
     result = result::UpdateCheck({}, 0, result::UpdateStatus::kError, Json::nullValue, "Could not update metadata.");
     return result;
@@ -939,6 +1074,7 @@ result::UpdateCheck SotaUptaneClient::checkUpdates() {
       }
     }
   } catch (const std::exception &e) {
+    std::lock_guard<std::mutex> guard(last_exception_mutex);
     last_exception = std::current_exception();
     LOG_ERROR << e.what();
     result = result::UpdateCheck({}, 0, result::UpdateStatus::kError, Utils::parseJSON(director_targets),
@@ -1024,6 +1160,7 @@ result::Install SotaUptaneClient::uptaneInstall(const std::vector<Uptane::Target
     try {
       update_status = checkUpdatesOffline(updates);
     } catch (const std::exception &e) {
+      std::lock_guard<std::mutex> guard(last_exception_mutex);
       last_exception = std::current_exception();
       update_status = result::UpdateStatus::kError;
     }
@@ -1116,6 +1253,9 @@ result::Install SotaUptaneClient::uptaneInstall(const std::vector<Uptane::Target
   }();
 
   storage->storeDeviceInstallationResult(r.dev_report, raw_report, correlation_id);
+  // The application may reboot as soon as it gets the event, the reports of
+  // the installation have to be stored by then.
+  report_queue->flush();
 
   sendEvent<event::AllInstallsComplete>(r);
 
@@ -1249,6 +1389,11 @@ bool SotaUptaneClient::waitSecondariesReachable(const std::vector<Uptane::Target
 
     for (auto sec_it = targeted_secondaries.begin(); sec_it != targeted_secondaries.end();) {
       bool connected = false;
+      if (secondaryBusy(sec_it->first)) {
+        LOG_DEBUG << "Secondary with serial " << sec_it->first << " is still busy with a manifest request";
+        ++sec_it;
+        continue;
+      }
       try {
         connected = sec_it->second->ping();
       } catch (const std::exception &ex) {
@@ -1365,6 +1510,11 @@ void SotaUptaneClient::sendMetadataToEcus(const std::vector<Uptane::Target> &tar
 
       data::InstallationResult local_result{data::ResultCode::Numeric::kOk, ""};
       do {
+        if (secondaryBusy(ecu_serial)) {
+          local_result = data::InstallationResult(data::ResultCode::Numeric::kInternalError,
+                                                  "Secondary is still busy with an earlier request");
+          break;
+        }
         /* Root rotation if necessary */
         local_result = rotateSecondaryRoot(Uptane::RepositoryType::Director(), *(sec->second));
         if (!local_result.isSuccess()) {
@@ -1423,6 +1573,7 @@ std::future<data::InstallationResult> SotaUptaneClient::sendFirmwareAsync(Second
     } catch (const std::exception &ex) {
       result = data::InstallationResult(data::ResultCode::Numeric::kInternalError, ex.what());
     }
+    secondary_provider_->releaseTargetFile(target, secondary.getSerial());
 
     if (result.result_code == data::ResultCode::Numeric::kNeedCompletion) {
       report_queue->enqueue(std_::make_unique<EcuInstallationAppliedReport>(secondary.getSerial(), correlation_id));
@@ -1444,6 +1595,7 @@ std::vector<result::Install::EcuReport> SotaUptaneClient::sendImagesToEcus(const
 
   const Uptane::EcuSerial &primary_ecu_serial = primaryEcuSerial();
   // target images should already have been downloaded to metadata_path/targets/
+  std::vector<std::pair<SecondaryInterface *, const Uptane::Target *>> sends;
   for (auto targets_it = targets.cbegin(); targets_it != targets.cend(); ++targets_it) {
     for (auto ecus_it = targets_it->ecus().cbegin(); ecus_it != targets_it->ecus().cend(); ++ecus_it) {
       const Uptane::EcuSerial &ecu_serial = ecus_it->first;
@@ -1457,11 +1609,38 @@ std::vector<result::Install::EcuReport> SotaUptaneClient::sendImagesToEcus(const
         LOG_ERROR << "Target " << *targets_it << " has an unknown ECU serial";
         continue;
       }
+      if (secondaryBusy(ecu_serial)) {
+        LOG_ERROR << "Secondary " << ecu_serial << " is still busy with an earlier request";
+        result::Install::EcuReport report(*targets_it, ecu_serial,
+                                          data::InstallationResult(data::ResultCode::Numeric::kInternalError,
+                                                                   "Secondary is still busy with an earlier request"));
+        storage->saveEcuInstallationResult(report.serial, report.install_res);
+        reports.push_back(report);
+        continue;
+      }
+      sends.emplace_back(f->second.get(), &*targets_it);
+    }
+  }
 
-      SecondaryInterface &sec = *f->second;
-      firmwareFutures.emplace_back(result::Install::EcuReport(*targets_it, ecu_serial, data::InstallationResult()),
-                                   sendFirmwareAsync(sec, *targets_it));
+  // Secondaries that get the same image share a single read of it.
+  std::map<std::string, std::pair<const Uptane::Target *, std::vector<Uptane::EcuSerial>>> images;
+  for (const auto &send : sends) {
+    const std::string key = Hash::encodeVector(send.second->hashes());
+    if (key.empty()) {
+      continue;
     }
+    auto &image = images[key];
+    image.first = send.second;
+    image.second.push_back(send.first->getSerial());
+  }
+  for (const auto &image : images) {
+    secondary_provider_->shareTargetFile(*image.second.first, image.second.second);
+  }
+
+  for (const auto &send : sends) {
+    firmwareFutures.emplace_back(
+        result::Install::EcuReport(*send.second, send.first->getSerial(), data::InstallationResult()),
+        sendFirmwareAsync(*send.first, *send.second));
   }
 
   for (auto &f : firmwareFutures) {
@@ -1493,6 +1672,10 @@ void SotaUptaneClient::checkAndUpdatePendingSecondaries() {
     if (primaryEcuSerial() == pending_ecu.first) {
       continue;
     }
+    if (secondaryBusy(pending_ecu.first)) {
+      LOG_DEBUG << "Secondary with serial " << pending_ecu.first << " is still busy with a manifest request";
+      continue;
+    }
     auto &sec = secondaries[pending_ecu.first];
     Uptane::Manifest manifest;
     try {
@@ -1,6 +1,7 @@
 #ifndef SOTA_UPTANE_CLIENT_H_
 #define SOTA_UPTANE_CLIENT_H_
 
+#include <future>
 #include <map>
 #include <memory>
 #include <string>
@@ -20,6 +21,7 @@
 #include "libaktualizr/secondaryinterface.h"
 
 #include "bootloader/bootloader.h"
+#include "eventbus.h"
 #include "http/httpclient.h"
 #include "primary/secondary_provider_builder.h"
 #include "provisioner.h"
@@ -84,6 +86,9 @@ class SotaUptaneClient {
   void campaignDecline(const std::string &campaign_id);
   void campaignPostpone(const std::string &campaign_id);
   bool hasPendingUpdates() const;
+  // The delay that the server last asked for, see HttpInterface::takeRetryAfter()
+  std::chrono::seconds takeRetryAfter() { return http->takeRetryAfter(); }
+  uint64_t connectionsOpened() const { return http->connectionsOpened(); }
   bool isInstallCompletionRequired();
   void completeInstall();
   std::vector<Uptane::Target> getStoredTargets() const { return package_manager_->getTargetFiles(); }
@@ -105,6 +110,9 @@ class SotaUptaneClient {
   FRIEND_TEST(Aktualizr, DownloadNonOstreeBin);
   FRIEND_TEST(Uptane, AssembleManifestGood);
   FRIEND_TEST(Uptane, AssembleManifestBad);
+  FRIEND_TEST(Uptane, AssembleManifestSlowSecondary);
+  FRIEND_TEST(Uptane, BusySecondaryIsUnavailable);
+  FRIEND_TEST(Uptane, SendImagesSha512Only);
   FRIEND_TEST(Uptane, InstallFakeGood);
   FRIEND_TEST(Uptane, restoreVerify);
   FRIEND_TEST(Uptane, PutManifest);
@@ -144,8 +152,21 @@ class SotaUptaneClient {
   void uptaneOfflineIteration(std::vector<Uptane::Target> *targets, unsigned int *ecus_count);
   result::UpdateCheck checkUpdates();
   result::UpdateStatus checkUpdatesOffline(const std::vector<Uptane::Target> &targets);
+  struct SecondaryManifest {
+    Uptane::Manifest manifest;
+    bool verified{false};
+  };
   Json::Value AssembleManifest();
-  std::exception_ptr getLastException() const { return last_exception; }
+  static SecondaryManifest requestSecondaryManifest(const SecondaryInterface::Ptr &secondary);
+  // Whether the Secondary is still busy with a manifest request that missed
+  // the deadline of AssembleManifest(). It is treated as unavailable until that
+  // request is done, so that no other request runs concurrently with it.
+  bool secondaryBusy(const Uptane::EcuSerial &serial) const;
+  static bool verifySecondaryManifest(const SecondaryInterface &secondary, const Uptane::Manifest &manifest);
+  std::exception_ptr getLastException() const {
+    std::lock_guard<std::mutex> guard(last_exception_mutex);
+    return last_exception;
+  }
   Uptane::Target getCurrent() const { return package_manager_->getCurrent(); }
 
   static std::vector<Uptane::Target> findForEcu(const std::vector<Uptane::Target> &targets,
@@ -153,6 +174,7 @@ class SotaUptaneClient {
   data::InstallationResult PackageInstallSetResult(const Uptane::Target &target,
                                                    const Uptane::CorrelationId &correlation_id);
   void finalizeAfterReboot();
+  std::vector<Uptane::Target> storedDirectorTargets();
   // Part of sendDeviceData()
   void reportHwInfo();
   // Part of sendDeviceData()
@@ -180,7 +202,10 @@ class SotaUptaneClient {
   std::unique_ptr<Uptane::Target> findTargetInDelegationTree(const Uptane::Target &target, bool offline);
   std::unique_ptr<Uptane::Target> findTargetHelper(const Uptane::Targets &cur_targets,
                                                    const Uptane::Target &queried_target, int level, bool terminating,
-                                                   bool offline);
+                                                   bool offline, const std::vector<std::string> &path);
+  std::shared_ptr<const Uptane::Targets> trustedDelegation(const std::vector<std::string> &path,
+                                                           const Uptane::Targets &parent_targets, bool offline);
+  void clearDelegationCache();
   Uptane::LazyTargetsList allTargets() const;
   void checkAndUpdatePendingSecondaries();
   Uptane::EcuSerial primaryEcuSerial() { return provisioner_.PrimaryEcuSerial(); }
@@ -190,7 +215,7 @@ class SotaUptaneClient {
   void sendEvent(Args &&...args) {
     std::shared_ptr<event::BaseEvent> event = std::make_shared<T>(std::forward<Args>(args)...);
     if (events_channel) {
-      (*events_channel)(std::move(event));
+      event_bus_->post(std::move(event));
     } else if (!event->isTypeOf<event::DownloadProgressReport>()) {
       LOG_INFO << "got " << event->variant << " event";
     }
@@ -199,6 +224,14 @@ class SotaUptaneClient {
   Config &config;
   Uptane::DirectorRepository director_repo;
   Uptane::ImageRepository image_repo;
+  // Delegations verified since the Image repo metadata was last loaded, keyed
+  // by the names of the delegated roles leading to them from the top-level
+  // Targets. Guarded by delegation_cache_mutex_, which is not held while a
+  // delegation is fetched.
+  std::map<std::vector<std::string>, std::shared_ptr<const Uptane::Targets>> delegation_cache_;
+  // Incremented whenever the cache is cleared.
+  uint64_t delegation_cache_generation_{0};
+  std::mutex delegation_cache_mutex_;
   Uptane::ManifestIssuer::Ptr uptane_manifest;
   std::shared_ptr<INvStorage> storage;
   std::shared_ptr<HttpInterface> http;
@@ -209,12 +242,20 @@ class SotaUptaneClient {
   std::shared_ptr<SecondaryProvider> secondary_provider_;
   std::shared_ptr<event::Channel> events_channel;
   std::exception_ptr last_exception;
+  mutable std::mutex last_exception_mutex;
   // ecu_serial => secondary*
   std::map<Uptane::EcuSerial, SecondaryInterface::Ptr> secondaries;
+  // Manifest requests that missed the deadline of AssembleManifest() are kept
+  // here until they finish, so that there is never more than one per
+  // Secondary. Declared after secondaries so that it is joined first.
+  std::map<Uptane::EcuSerial, std::future<SecondaryManifest>> secondary_manifest_requests_;
   std::mutex download_mutex;
   Provisioner provisioner_;
   Json::Value custom_hardware_info_{Json::nullValue};
   const api::FlowControlToken *flow_control_;
+  // Last, so that the remaining events are delivered before anything else is
+  // destroyed.
+  std::unique_ptr<EventBus> event_bus_;
 };
 
 #endif  // SOTA_UPTANE_CLIENT_H_
@@ -36,6 +36,38 @@ struct MisconfiguredEcu {
 
 enum class InstalledVersionUpdateMode { kNone, kCurrent, kPending };
 
+// Hasher state of a partially downloaded Target after its first `offset` bytes.
+struct TargetHasherCheckpoint {
+  Hash::Type type{Hash::Type::kUnknownAlgorithm};
+  uint64_t offset{0};
+  std::string state;
+};
+
+// Identity of a downloaded Target file at the time its hash was last verified.
+struct VerifiedTargetFile {
+  uint64_t size{0};
+  int64_t mtime_ns{0};
+  uint64_t inode{0};
+  Hash hash{Hash::Type::kUnknownAlgorithm, ""};
+};
+
+// A downloaded Target file as recorded in the index of images_path. The size
+// and time of last use (in seconds since the epoch) are 0 until recorded.
+struct StoredTargetFile {
+  std::string targetname;
+  std::string filename;
+  uint64_t size{0};
+  int64_t last_used{0};
+};
+
+// A metadata file as last received from a server, with the validators of the
+// response (RFC 7232) to request it again only if it changed.
+struct CachedMeta {
+  std::string data;
+  std::string etag;
+  std::string last_modified;
+};
+
 // Functions loading/storing multiple pieces of data are supposed to do so
 // atomically as far as implementation makes it possible.
 //
@@ -80,6 +112,10 @@ class INvStorage {
   virtual bool loadNonRoot(std::string* data, Uptane::RepositoryType repo, Uptane::Role role) const = 0;
   virtual void clearNonRootMeta(Uptane::RepositoryType repo) = 0;
   virtual void clearMetadata() = 0;
+  // Cached responses are dropped along with the non-Root metadata of their
+  // repository.
+  virtual void storeCachedMeta(const CachedMeta& meta, Uptane::RepositoryType repo, Uptane::Role role) = 0;
+  virtual bool loadCachedMeta(CachedMeta* meta, Uptane::RepositoryType repo, Uptane::Role role) const = 0;
   virtual void storeDelegation(const std::string& data, Uptane::Role role) = 0;
   virtual bool loadDelegation(std::string* data, Uptane::Role role) const = 0;
   virtual bool loadAllDelegations(std::vector<std::pair<Uptane::Role, std::string>>& data) const = 0;
@@ -136,7 +172,12 @@ class INvStorage {
   virtual bool loadEcuReportCounter(std::vector<std::pair<Uptane::EcuSerial, int64_t>>* results) const = 0;
 
   virtual void saveReportEvent(const Json::Value& json_value) = 0;
+  // Saves all events in one transaction. They are assigned consecutive ids
+  // ending with `id_max`.
+  virtual bool saveReportEvents(const std::vector<Json::Value>& events, int64_t* id_max) = 0;
   virtual bool loadReportEvents(Json::Value* report_array, int64_t* id_max, int limit) const = 0;
+  // Loads at most `limit` events (all if negative) in id order.
+  virtual bool loadPendingReportEvents(std::vector<std::pair<int64_t, Json::Value>>* events, int limit) const = 0;
   virtual void deleteReportEvents(int64_t id_max) = 0;
 
   virtual void storeDeviceDataHash(const std::string& data_type, const std::string& hash) = 0;
@@ -147,7 +188,22 @@ class INvStorage {
   virtual void storeTargetFilename(const std::string& targetname, const std::string& filename) const = 0;
   virtual std::string getTargetFilename(const std::string& targetname) const = 0;
   virtual std::vector<std::string> getAllTargetNames() const = 0;
+  virtual std::vector<StoredTargetFile> loadTargetFileIndex() const = 0;
+  virtual void storeTargetFileUsage(const std::string& targetname, uint64_t size, int64_t last_used) const = 0;
   virtual void deleteTargetInfo(const std::string& targetname) const = 0;
+  // Checkpoints and verification records are dropped whenever the filename
+  // of the Target is stored again or its info is deleted.
+  virtual void storeTargetHasherCheckpoint(const std::string& targetname,
+                                           const TargetHasherCheckpoint& checkpoint) const = 0;
+  virtual bool loadTargetHasherCheckpoint(const std::string& targetname, TargetHasherCheckpoint* checkpoint) const = 0;
+  virtual void storeVerifiedTargetFile(const std::string& targetname, const VerifiedTargetFile& file) const = 0;
+  virtual bool loadVerifiedTargetFile(const std::string& targetname, VerifiedTargetFile* file) const = 0;
+  // While a Target file is written out of order, only its first `size` bytes
+  // are known to be downloaded and the rest may have gaps. Dropped like the
+  // checkpoints.
+  virtual void storeTargetFilePrefix(const std::string& targetname, uint64_t size) const = 0;
+  virtual bool loadTargetFilePrefix(const std::string& targetname, uint64_t* size) const = 0;
+  virtual void clearTargetFilePrefix(const std::string& targetname) const = 0;
 
   // Special constructors and utilities
   static std::shared_ptr<INvStorage> newStorage(const StorageConfig& config, bool readonly = false);
@@ -0,0 +1,127 @@
+#include "sql_utils.h"
+
+SQLiteStatementCache::~SQLiteStatementCache() {
+  for (auto& entry : statements_) {
+    sqlite3_finalize(entry.second);
+  }
+}
+
+sqlite3_stmt* SQLiteStatementCache::take(const std::string& sql) {
+  auto it = statements_.find(sql);
+  if (it == statements_.end()) {
+    return nullptr;
+  }
+  sqlite3_stmt* statement = it->second;
+  statements_.erase(it);
+  return statement;
+}
+
+void SQLiteStatementCache::put(const std::string& sql, sqlite3_stmt* statement) {
+  sqlite3_reset(statement);
+  sqlite3_clear_bindings(statement);
+  if (!statements_.emplace(sql, statement).second) {
+    sqlite3_finalize(statement);
+  }
+}
+
+int SQLiteOpen(const char* path, bool readonly, sqlite3** handle) {
+  if (sqlite3_threadsafe() == 0) {
+    throw SQLInternalException("sqlite3 has been compiled without multitheading support");
+  }
+  int rc;
+  if (readonly) {
+    rc = sqlite3_open_v2(path, handle, SQLITE_OPEN_READONLY, nullptr);
+  } else {
+    rc = sqlite3_open_v2(path, handle, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX, nullptr);
+  }
+
+  /* retry operations for 2 seconds before returning SQLITE_BUSY */
+  sqlite3_busy_timeout(*handle, 2000);
+  return rc;
+}
+
+void SQLiteSetWalProfile(sqlite3* handle, bool readonly) {
+  if (!readonly && sqlite3_exec(handle, "PRAGMA journal_mode=WAL;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+    LOG_WARNING << "Could not enable write-ahead logging: " << sqlite3_errmsg(handle);
+  }
+  sqlite3_exec(handle, "PRAGMA synchronous=NORMAL;", nullptr, nullptr, nullptr);
+}
+
+SQLiteConnection::SQLiteConnection(const boost::filesystem::path& path, bool readonly, bool wal)
+    : handle_(nullptr, sqlite3_close) {
+  sqlite3* h = nullptr;
+  const int rc = SQLiteOpen(path.c_str(), readonly, &h);
+  handle_.reset(h);
+  if (rc != SQLITE_OK) {
+    throw SQLInternalException(std::string("Can't open database: ") + sqlite3_errmsg(h));
+  }
+  if (wal) {
+    SQLiteSetWalProfile(h, readonly);
+  }
+}
+
+SQLiteConnectionPool::SQLiteConnectionPool(boost::filesystem::path path, bool readonly, size_t size, bool wal)
+    : path_(std::move(path)), readonly_(readonly), size_(size), wal_(wal) {}
+
+std::unique_ptr<SQLiteConnection> SQLiteConnectionPool::acquire() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this] { return !idle_.empty() || opened_ < size_; });
+  if (!idle_.empty()) {
+    auto connection = std::move(idle_.back());
+    idle_.pop_back();
+    return connection;
+  }
+  ++opened_;
+  lock.unlock();
+  try {
+    return std::unique_ptr<SQLiteConnection>(new SQLiteConnection(path_, readonly_, wal_));
+  } catch (...) {
+    lock.lock();
+    --opened_;
+    cv_.notify_one();
+    throw;
+  }
+}
+
+void SQLiteConnectionPool::release(std::unique_ptr<SQLiteConnection> connection) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    idle_.push_back(std::move(connection));
+  }
+  cv_.notify_one();
+}
+
+SQLite3Guard::SQLite3Guard(std::shared_ptr<SQLiteConnectionPool> pool)
+    : handle_(nullptr, keepOpen), rc_(SQLITE_OK), pool_(std::move(pool)) {
+  connection_ = pool_->acquire();
+  handle_.reset(connection_->get());
+}
+
+SQLite3Guard::~SQLite3Guard() {
+  if (connection_) {
+    // Closing a connection rolls back an unfinished transaction, a pooled
+    // connection has to do that explicitly.
+    if (sqlite3_get_autocommit(connection_->get()) == 0) {
+      exec("ROLLBACK TRANSACTION;", nullptr, nullptr);
+    }
+    pool_->release(std::move(connection_));
+  }
+  if (m_) {
+    m_->unlock();
+  }
+}
+
+int SQLite3Guard::keepOpen(sqlite3* handle) {
+  (void)handle;
+  return SQLITE_OK;
+}
+
+// Pooled connections are not serialized by a mutex. Their transactions take
+// the write lock right away, so that two of them never both hold a read lock
+// that they need to upgrade, which SQLite can only resolve by failing one.
+const char* SQLite3Guard::beginStatement() const {
+  if (connection_ && sqlite3_db_readonly(handle_.get(), "main") != 1) {
+    return "BEGIN IMMEDIATE TRANSACTION;";
+  }
+  return "BEGIN TRANSACTION;";
+}
@@ -1,11 +1,15 @@
 #ifndef SQL_UTILS_H_
 #define SQL_UTILS_H_
 
+#include <condition_variable>
 #include <list>
 #include <memory>
 #include <mutex>
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <boost/filesystem/path.hpp>
 #include <boost/optional.hpp>
@@ -31,14 +35,38 @@ class SQLInternalException : public SQLException {
   explicit SQLInternalException(const std::string& what = "SQL internal error") : SQLException(what) {}
 };
 
+// Prepared statements of a long-lived connection, keyed by their SQL text.
+// A statement is taken out of the cache while it is in use, so that the same
+// SQL can still be prepared again if it is needed twice at the same time.
+class SQLiteStatementCache {
+ public:
+  SQLiteStatementCache() = default;
+  ~SQLiteStatementCache();
+  SQLiteStatementCache(const SQLiteStatementCache&) = delete;
+  SQLiteStatementCache(SQLiteStatementCache&&) = delete;
+  SQLiteStatementCache& operator=(const SQLiteStatementCache&) = delete;
+  SQLiteStatementCache& operator=(SQLiteStatementCache&&) = delete;
+
+  sqlite3_stmt* take(const std::string& sql);
+  void put(const std::string& sql, sqlite3_stmt* statement);
+  size_t size() const { return statements_.size(); }
+
+ private:
+  std::unordered_map<std::string, sqlite3_stmt*> statements_;
+};
+
 class SQLiteStatement {
  public:
   template <typename... Types>
   SQLiteStatement(sqlite3* db, const std::string& zSql, const Types&... args)
-      : db_(db), stmt_(nullptr, sqlite3_finalize), bind_cnt_(1) {
-    sqlite3_stmt* statement;
+      : SQLiteStatement(db, static_cast<SQLiteStatementCache*>(nullptr), zSql, args...) {}
+
+  template <typename... Types>
+  SQLiteStatement(sqlite3* db, SQLiteStatementCache* cache, const std::string& zSql, const Types&... args)
+      : db_(db), stmt_(nullptr, Release{cache, cache != nullptr ? zSql : std::string()}), bind_cnt_(1) {
+    sqlite3_stmt* statement = cache != nullptr ? cache->take(zSql) : nullptr;
 
-    if (sqlite3_prepare_v2(db_, zSql.c_str(), -1, &statement, nullptr) != SQLITE_OK) {
+    if (statement == nullptr && sqlite3_prepare_v2(db_, zSql.c_str(), -1, &statement, nullptr) != SQLITE_OK) {
       LOG_ERROR << "Could not prepare statement: " << sqlite3_errmsg(db_);
       throw SQLInternalException(std::string("Could not prepare statement: ") + sqlite3_errmsg(db_));
     }
@@ -118,14 +146,72 @@ class SQLiteStatement {
     bindArguments(args...);
   }
 
+  // Hands cached statements back to their cache instead of finalizing them.
+  struct Release {
+    SQLiteStatementCache* cache;
+    std::string sql;
+    void operator()(sqlite3_stmt* statement) const {
+      if (cache != nullptr) {
+        cache->put(sql, statement);
+      } else {
+        sqlite3_finalize(statement);
+      }
+    }
+  };
+
   sqlite3* db_;
-  std::unique_ptr<sqlite3_stmt, int (*)(sqlite3_stmt*)> stmt_;
+  std::unique_ptr<sqlite3_stmt, Release> stmt_;
   int bind_cnt_;  // NOLINT
   // copies of data that need to persist for the object duration
   // (avoid vector because of resizing issues)
   std::list<std::string> owned_data_;
 };
 
+int SQLiteOpen(const char* path, bool readonly, sqlite3** handle);
+
+// Write-ahead logging with fewer fsync() calls: a power loss may lose the
+// last transactions, but does not corrupt the database.
+void SQLiteSetWalProfile(sqlite3* handle, bool readonly);
+
+// A connection that stays open between operations, with its prepared
+// statements.
+class SQLiteConnection {
+ public:
+  SQLiteConnection(const boost::filesystem::path& path, bool readonly, bool wal);
+
+  sqlite3* get() { return handle_.get(); }
+  SQLiteStatementCache& statements() { return statements_; }
+
+ private:
+  std::unique_ptr<sqlite3, int (*)(sqlite3*)> handle_;
+  // Declared after handle_, so that the statements are finalized first.
+  SQLiteStatementCache statements_;
+};
+
+// Up to `size` connections to one database, opened on demand and kept open
+// for the lifetime of the pool. A connection is used by one SQLite3Guard at a
+// time, so that is all the locking it needs: guards on different connections
+// run concurrently, and SQLite's own file locking and busy timeout order
+// their writes.
+class SQLiteConnectionPool {
+ public:
+  SQLiteConnectionPool(boost::filesystem::path path, bool readonly, size_t size, bool wal);
+
+  // Blocks until a connection is available.
+  std::unique_ptr<SQLiteConnection> acquire();
+  void release(std::unique_ptr<SQLiteConnection> connection);
+
+ private:
+  const boost::filesystem::path path_;
+  const bool readonly_;
+  const size_t size_;
+  const bool wal_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<std::unique_ptr<SQLiteConnection>> idle_;
+  size_t opened_{0};
+};
+
 // Unique ownership SQLite3 connection
 const extern std::mutex sql_mutex;
 class SQLite3Guard {
@@ -138,31 +224,25 @@ class SQLite3Guard {
     if (m_) {
       m_->lock();
     }
-    if (sqlite3_threadsafe() == 0) {
-      throw SQLInternalException("sqlite3 has been compiled without multitheading support");
-    }
     sqlite3* h;
-    if (readonly) {
-      rc_ = sqlite3_open_v2(path, &h, SQLITE_OPEN_READONLY, nullptr);
-    } else {
-      rc_ = sqlite3_open_v2(path, &h, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX, nullptr);
-    }
-
-    /* retry operations for 2 seconds before returning SQLITE_BUSY */
-    sqlite3_busy_timeout(h, 2000);
-
+    rc_ = SQLiteOpen(path, readonly, &h);
     handle_.reset(h);
   }
 
   explicit SQLite3Guard(const boost::filesystem::path& path, bool readonly = false,
                         std::shared_ptr<std::mutex> mutex = nullptr)
       : SQLite3Guard(path.c_str(), readonly, std::move(mutex)) {}
-  SQLite3Guard(SQLite3Guard&& guard) noexcept : handle_(std::move(guard.handle_)), rc_(guard.rc_) {}
-  ~SQLite3Guard() {
-    if (m_) {
-      m_->unlock();
-    }
-  }
+
+  // Borrow a connection from a pool for the lifetime of the guard.
+  explicit SQLite3Guard(std::shared_ptr<SQLiteConnectionPool> pool);
+
+  SQLite3Guard(SQLite3Guard&& guard) noexcept
+      : handle_(std::move(guard.handle_)),
+        rc_(guard.rc_),
+        m_(std::move(guard.m_)),
+        pool_(std::move(guard.pool_)),
+        connection_(std::move(guard.connection_)) {}
+  ~SQLite3Guard();
   SQLite3Guard(const SQLite3Guard& guard) = delete;
   SQLite3Guard& operator=(const SQLite3Guard& guard) = delete;
   SQLite3Guard& operator=(SQLite3Guard&&) = delete;
@@ -177,7 +257,7 @@ class SQLite3Guard {
 
   template <typename... Types>
   SQLiteStatement prepareStatement(const std::string& zSql, const Types&... args) {
-    return SQLiteStatement(handle_.get(), zSql, args...);
+    return SQLiteStatement(handle_.get(), connection_ ? &connection_->statements() : nullptr, zSql, args...);
   }
 
   std::string errmsg() const { return sqlite3_errmsg(handle_.get()); }
@@ -193,7 +273,7 @@ class SQLite3Guard {
   void beginTransaction() {
     // Note: transaction cannot be nested and this will fail if another
     // transaction was open on the same connection
-    if (exec("BEGIN TRANSACTION;", nullptr, nullptr) != SQLITE_OK) {
+    if (exec(beginStatement(), nullptr, nullptr) != SQLITE_OK) {
       LOG_ERROR << "Can't begin transaction: " << errmsg();
       throw SQLInternalException(std::string("Can't begin transaction: ") + errmsg());
     }
@@ -214,9 +294,14 @@ class SQLite3Guard {
   }
 
  private:
+  static int keepOpen(sqlite3* handle);
+  const char* beginStatement() const;
+
   std::unique_ptr<sqlite3, int (*)(sqlite3*)> handle_;
   int rc_;
   std::shared_ptr<std::mutex> m_ = nullptr;
+  std::shared_ptr<SQLiteConnectionPool> pool_;
+  std::unique_ptr<SQLiteConnection> connection_;
 };
 
 #endif  // SQL_UTILS_H_
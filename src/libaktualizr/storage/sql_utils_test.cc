@@ -16,6 +16,53 @@ TEST(sql_utils, PrepareRvalue) {
   EXPECT_EQ(statement.step(), SQLITE_DONE);
 }
 
+/* Statements of a pooled connection are prepared once and reused. */
+TEST(sql_utils, PooledStatementCache) {
+  TemporaryDirectory temp_dir;
+  auto pool = std::make_shared<SQLiteConnectionPool>(temp_dir.Path() / "test.db", false, 1, false);
+  {
+    SQLite3Guard db(pool);
+    db.exec("CREATE TABLE example(ex1 TEXT);", nullptr, nullptr);
+  }
+
+  sqlite3_stmt* prepared = nullptr;
+  for (int ii = 0; ii < 3; ++ii) {
+    SQLite3Guard db(pool);
+    auto statement = db.prepareStatement<std::string>("INSERT INTO example(ex1) VALUES (?);", std::to_string(ii));
+    EXPECT_EQ(statement.step(), SQLITE_DONE);
+    if (prepared == nullptr) {
+      prepared = statement.get();
+    }
+    EXPECT_EQ(statement.get(), prepared);
+  }
+
+  SQLite3Guard db(pool);
+  auto count = db.prepareStatement("SELECT count(*) FROM example;");
+  ASSERT_EQ(count.step(), SQLITE_ROW);
+  EXPECT_EQ(count.get_result_col_int(0), 3);
+}
+
+/* A pooled connection must not keep a transaction that was not committed. */
+TEST(sql_utils, PooledRollback) {
+  TemporaryDirectory temp_dir;
+  auto pool = std::make_shared<SQLiteConnectionPool>(temp_dir.Path() / "test.db", false, 1, true);
+  {
+    SQLite3Guard db(pool);
+    db.exec("CREATE TABLE example(ex1 TEXT);", nullptr, nullptr);
+  }
+  {
+    SQLite3Guard db(pool);
+    db.beginTransaction();
+    auto statement = db.prepareStatement("INSERT INTO example(ex1) VALUES ('lost');");
+    EXPECT_EQ(statement.step(), SQLITE_DONE);
+  }
+
+  SQLite3Guard db(pool);
+  auto count = db.prepareStatement("SELECT count(*) FROM example;");
+  ASSERT_EQ(count.step(), SQLITE_ROW);
+  EXPECT_EQ(count.get_result_col_int(0), 0);
+}
+
 #ifndef __NO_MAIN__
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
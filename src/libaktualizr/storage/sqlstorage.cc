@@ -61,7 +61,8 @@ void SQLStorage::cleanMetaVersion(Uptane::RepositoryType repo, const Uptane::Rol
 SQLStorage::SQLStorage(const StorageConfig& config, bool readonly)
     : SQLStorageBase(config.sqldb_path.get(config.path), readonly, libaktualizr_schema_migrations,
                      libaktualizr_schema_rollback_migrations, libaktualizr_current_schema,
-                     libaktualizr_current_schema_version),
+                     libaktualizr_current_schema_version, static_cast<size_t>(config.sqldb_pool_size),
+                     config.sqldb_wal),
       INvStorage(config) {
   try {
     cleanMetaVersion(Uptane::RepositoryType::Director(), Uptane::Role::Root());
@@ -637,6 +638,12 @@ void SQLStorage::clearNonRootMeta(Uptane::RepositoryType repo) {
   if (del_statement.step() != SQLITE_DONE) {
     LOG_ERROR << "Failed to clear metadata: " << db.errmsg();
   }
+
+  auto del_cached_statement = db.prepareStatement<int>("DELETE FROM cached_meta WHERE repo=?;", static_cast<int>(repo));
+
+  if (del_cached_statement.step() != SQLITE_DONE) {
+    LOG_ERROR << "Failed to clear cached metadata: " << db.errmsg();
+  }
 }
 
 void SQLStorage::clearMetadata() {
@@ -646,6 +653,46 @@ void SQLStorage::clearMetadata() {
     LOG_ERROR << "Failed to clear metadata: " << db.errmsg();
     return;
   }
+  if (db.exec("DELETE FROM cached_meta;", nullptr, nullptr) != SQLITE_OK) {
+    LOG_ERROR << "Failed to clear cached metadata: " << db.errmsg();
+    return;
+  }
+}
+
+void SQLStorage::storeCachedMeta(const CachedMeta& meta, Uptane::RepositoryType repo, const Uptane::Role role) {
+  SQLite3Guard db = dbConnection();
+
+  auto statement = db.prepareStatement<int, int, SQLBlob, std::string, std::string>(
+      "INSERT OR REPLACE INTO cached_meta(repo, meta_type, meta, etag, last_modified) VALUES (?, ?, ?, ?, ?);",
+      static_cast<int>(repo), role.ToInt(), SQLBlob(meta.data), meta.etag, meta.last_modified);
+
+  if (statement.step() != SQLITE_DONE) {
+    LOG_ERROR << "Failed to store cached " << role << " metadata: " << db.errmsg();
+    return;
+  }
+}
+
+bool SQLStorage::loadCachedMeta(CachedMeta* meta, Uptane::RepositoryType repo, const Uptane::Role role) const {
+  SQLite3Guard db = dbConnection();
+
+  auto statement = db.prepareStatement<int, int>(
+      "SELECT meta, etag, last_modified FROM cached_meta WHERE (repo=? AND meta_type=?);", static_cast<int>(repo),
+      role.ToInt());
+  int result = statement.step();
+
+  if (result == SQLITE_DONE) {
+    return false;
+  } else if (result != SQLITE_ROW) {
+    LOG_ERROR << "Failed to get cached " << role << " metadata: " << db.errmsg();
+    return false;
+  }
+  if (meta != nullptr) {
+    meta->data = statement.get_result_col_blob(0).value_or("");
+    meta->etag = statement.get_result_col_str(1).value();
+    meta->last_modified = statement.get_result_col_str(2).value();
+  }
+
+  return true;
 }
 
 void SQLStorage::storeDelegation(const std::string& data, const Uptane::Role role) {
@@ -1578,6 +1625,38 @@ void SQLStorage::saveReportEvent(const Json::Value& json_value) {
   }
 }
 
+bool SQLStorage::saveReportEvents(const std::vector<Json::Value>& events, int64_t* id_max) {
+  SQLite3Guard db = dbConnection();
+  db.beginTransaction();
+
+  int64_t id = 0;
+  {
+    auto statement = db.prepareStatement("SELECT IFNULL(MAX(id), 0) FROM report_events;");
+    if (statement.step() != SQLITE_ROW) {
+      LOG_ERROR << "Failed to get report event id: " << db.errmsg();
+      db.rollbackTransaction();
+      return false;
+    }
+    id = statement.get_result_col_int(0);
+  }
+
+  for (const auto& event : events) {
+    auto statement = db.prepareStatement<int64_t, std::string>("INSERT INTO report_events VALUES (?, ?);", ++id,
+                                                               Utils::jsonToCanonicalStr(event));
+    if (statement.step() != SQLITE_DONE) {
+      LOG_ERROR << "Failed to save report events: " << db.errmsg();
+      db.rollbackTransaction();
+      return false;
+    }
+  }
+
+  db.commitTransaction();
+  if (id_max != nullptr) {
+    *id_max = id;
+  }
+  return true;
+}
+
 bool SQLStorage::loadReportEvents(Json::Value* report_array, int64_t* id_max, int limit) const {
   SQLite3Guard db = dbConnection();
   auto statement = db.prepareStatement<int>("SELECT id, json_string FROM report_events LIMIT ?;", limit);
@@ -1612,6 +1691,35 @@ bool SQLStorage::loadReportEvents(Json::Value* report_array, int64_t* id_max, in
   return true;
 }
 
+bool SQLStorage::loadPendingReportEvents(std::vector<std::pair<int64_t, Json::Value>>* events, int limit) const {
+  SQLite3Guard db = dbConnection();
+  auto statement =
+      db.prepareStatement<int>("SELECT id, json_string FROM report_events ORDER BY id LIMIT ?;", limit);
+  int statement_result = statement.step();
+  if (statement_result != SQLITE_DONE && statement_result != SQLITE_ROW) {
+    LOG_ERROR << "Failed to get report events: " << db.errmsg();
+    return false;
+  }
+  for (; statement_result == SQLITE_ROW; statement_result = statement.step()) {
+    try {
+      int64_t id = statement.get_result_col_int(0);
+      std::string json_string = statement.get_result_col_str(1).value();
+      std::istringstream jss(json_string);
+      Json::Value event_json;
+      std::string errs;
+      if (Json::parseFromStream(Json::CharReaderBuilder(), jss, &event_json, &errs)) {
+        events->emplace_back(id, std::move(event_json));
+      } else {
+        LOG_ERROR << "Unable to parse event data: " << errs;
+      }
+    } catch (const boost::bad_optional_access&) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
 void SQLStorage::deleteReportEvents(int64_t id_max) {
   SQLite3Guard db = dbConnection();
 
@@ -1683,6 +1791,8 @@ void SQLStorage::clearDeviceData() {
 
 void SQLStorage::storeTargetFilename(const std::string& targetname, const std::string& filename) const {
   SQLite3Guard db = dbConnection();
+  db.beginTransaction();
+
   auto statement = db.prepareStatement<std::string, std::string>(
       "INSERT OR REPLACE INTO target_images (targetname, filename) VALUES (?, ?);", targetname, filename);
 
@@ -1690,6 +1800,11 @@ void SQLStorage::storeTargetFilename(const std::string& targetname, const std::s
     LOG_ERROR << "Failed to store Target filename: " << db.errmsg();
     throw SQLException(std::string("Failed to store Target filename: ") + db.errmsg());
   }
+
+  // The file is (re)created from scratch, so anything known about its content is stale.
+  clearTargetFileState(db, targetname);
+
+  db.commitTransaction();
 }
 
 std::string SQLStorage::getTargetFilename(const std::string& targetname) const {
@@ -1727,8 +1842,46 @@ std::vector<std::string> SQLStorage::getAllTargetNames() const {
   return names;
 }
 
+std::vector<StoredTargetFile> SQLStorage::loadTargetFileIndex() const {
+  SQLite3Guard db = dbConnection();
+
+  auto statement = db.prepareStatement<>("SELECT targetname, filename, real_size, last_used FROM target_images;");
+
+  std::vector<StoredTargetFile> files;
+
+  int result = statement.step();
+  while (result != SQLITE_DONE) {
+    if (result != SQLITE_ROW) {
+      LOG_ERROR << "Failed to load Target file index: " << db.errmsg();
+      throw SQLException(std::string("Failed to load Target file index: ") + db.errmsg());
+    }
+    StoredTargetFile file;
+    file.targetname = statement.get_result_col_str(0).value();
+    file.filename = statement.get_result_col_str(1).value();
+    file.size = static_cast<uint64_t>(statement.get_result_col_int(2));
+    file.last_used = statement.get_result_col_int(3);
+    files.push_back(std::move(file));
+    result = statement.step();
+  }
+  return files;
+}
+
+void SQLStorage::storeTargetFileUsage(const std::string& targetname, uint64_t size, int64_t last_used) const {
+  SQLite3Guard db = dbConnection();
+
+  auto statement = db.prepareStatement<int64_t, int64_t, std::string>(
+      "UPDATE target_images SET real_size = ?, last_used = ? WHERE targetname = ?;", static_cast<int64_t>(size),
+      last_used, targetname);
+
+  if (statement.step() != SQLITE_DONE) {
+    LOG_ERROR << "Failed to store Target file usage: " << db.errmsg();
+    throw SQLException(std::string("Failed to store Target file usage: ") + db.errmsg());
+  }
+}
+
 void SQLStorage::deleteTargetInfo(const std::string& targetname) const {
   SQLite3Guard db = dbConnection();
+  db.beginTransaction();
 
   auto statement = db.prepareStatement<std::string>("DELETE FROM target_images WHERE targetname=?;", targetname);
 
@@ -1736,4 +1889,156 @@ void SQLStorage::deleteTargetInfo(const std::string& targetname) const {
     LOG_ERROR << "Failed to clear Target filenames: " << db.errmsg();
     throw SQLException(std::string("Failed to clear Target filenames: ") + db.errmsg());
   }
+
+  clearTargetFileState(db, targetname);
+
+  db.commitTransaction();
+}
+
+void SQLStorage::clearTargetFileState(SQLite3Guard& db, const std::string& targetname) {
+  auto statement =
+      db.prepareStatement<std::string>("DELETE FROM target_hasher_checkpoints WHERE targetname=?;", targetname);
+  if (statement.step() != SQLITE_DONE) {
+    LOG_ERROR << "Failed to clear Target hasher checkpoint: " << db.errmsg();
+    throw SQLException(std::string("Failed to clear Target hasher checkpoint: ") + db.errmsg());
+  }
+
+  statement = db.prepareStatement<std::string>("DELETE FROM verified_target_files WHERE targetname=?;", targetname);
+  if (statement.step() != SQLITE_DONE) {
+    LOG_ERROR << "Failed to clear verified Target file: " << db.errmsg();
+    throw SQLException(std::string("Failed to clear verified Target file: ") + db.errmsg());
+  }
+
+  statement = db.prepareStatement<std::string>("DELETE FROM target_file_prefixes WHERE targetname=?;", targetname);
+  if (statement.step() != SQLITE_DONE) {
+    LOG_ERROR << "Failed to clear Target file prefix: " << db.errmsg();
+    throw SQLException(std::string("Failed to clear Target file prefix: ") + db.errmsg());
+  }
+}
+
+void SQLStorage::storeTargetHasherCheckpoint(const std::string& targetname,
+                                             const TargetHasherCheckpoint& checkpoint) const {
+  SQLite3Guard db = dbConnection();
+
+  auto statement = db.prepareStatement<std::string, std::string, int64_t, SQLBlob>(
+      "INSERT OR REPLACE INTO target_hasher_checkpoints (targetname, hash_type, hashed_size, state) "
+      "VALUES (?, ?, ?, ?);",
+      targetname, Hash::TypeString(checkpoint.type), static_cast<int64_t>(checkpoint.offset),
+      SQLBlob(checkpoint.state));
+
+  if (statement.step() != SQLITE_DONE) {
+    LOG_ERROR << "Failed to store Target hasher checkpoint: " << db.errmsg();
+    throw SQLException(std::string("Failed to store Target hasher checkpoint: ") + db.errmsg());
+  }
+}
+
+bool SQLStorage::loadTargetHasherCheckpoint(const std::string& targetname,
+                                            TargetHasherCheckpoint* checkpoint) const {
+  SQLite3Guard db = dbConnection();
+
+  auto statement = db.prepareStatement<std::string>(
+      "SELECT hash_type, hashed_size, state FROM target_hasher_checkpoints WHERE targetname = ?;", targetname);
+
+  switch (statement.step()) {
+    case SQLITE_ROW:
+      break;
+    case SQLITE_DONE:
+      return false;
+    default:
+      LOG_ERROR << "Failed to load Target hasher checkpoint: " << db.errmsg();
+      return false;
+  }
+
+  if (checkpoint != nullptr) {
+    checkpoint->type = Hash(statement.get_result_col_str(0).value(), "").type();
+    checkpoint->offset = static_cast<uint64_t>(statement.get_result_col_int(1));
+    checkpoint->state = statement.get_result_col_blob(2).value_or("");
+  }
+  return true;
+}
+
+void SQLStorage::storeVerifiedTargetFile(const std::string& targetname, const VerifiedTargetFile& file) const {
+  SQLite3Guard db = dbConnection();
+
+  auto statement = db.prepareStatement<std::string, int64_t, int64_t, int64_t, std::string, std::string>(
+      "INSERT OR REPLACE INTO verified_target_files (targetname, size, mtime_ns, inode, hash_type, hash) "
+      "VALUES (?, ?, ?, ?, ?, ?);",
+      targetname, static_cast<int64_t>(file.size), file.mtime_ns, static_cast<int64_t>(file.inode),
+      Hash::TypeString(file.hash.type()), file.hash.HashString());
+
+  if (statement.step() != SQLITE_DONE) {
+    LOG_ERROR << "Failed to store verified Target file: " << db.errmsg();
+    throw SQLException(std::string("Failed to store verified Target file: ") + db.errmsg());
+  }
+}
+
+bool SQLStorage::loadVerifiedTargetFile(const std::string& targetname, VerifiedTargetFile* file) const {
+  SQLite3Guard db = dbConnection();
+
+  auto statement = db.prepareStatement<std::string>(
+      "SELECT size, mtime_ns, inode, hash_type, hash FROM verified_target_files WHERE targetname = ?;", targetname);
+
+  switch (statement.step()) {
+    case SQLITE_ROW:
+      break;
+    case SQLITE_DONE:
+      return false;
+    default:
+      LOG_ERROR << "Failed to load verified Target file: " << db.errmsg();
+      return false;
+  }
+
+  if (file != nullptr) {
+    file->size = static_cast<uint64_t>(statement.get_result_col_int(0));
+    file->mtime_ns = statement.get_result_col_int(1);
+    file->inode = static_cast<uint64_t>(statement.get_result_col_int(2));
+    file->hash = Hash(statement.get_result_col_str(3).value(), statement.get_result_col_str(4).value());
+  }
+  return true;
+}
+
+void SQLStorage::storeTargetFilePrefix(const std::string& targetname, const uint64_t size) const {
+  SQLite3Guard db = dbConnection();
+
+  auto statement = db.prepareStatement<std::string, int64_t>(
+      "INSERT OR REPLACE INTO target_file_prefixes (targetname, size) VALUES (?, ?);", targetname,
+      static_cast<int64_t>(size));
+
+  if (statement.step() != SQLITE_DONE) {
+    LOG_ERROR << "Failed to store Target file prefix: " << db.errmsg();
+    throw SQLException(std::string("Failed to store Target file prefix: ") + db.errmsg());
+  }
+}
+
+bool SQLStorage::loadTargetFilePrefix(const std::string& targetname, uint64_t* size) const {
+  SQLite3Guard db = dbConnection();
+
+  auto statement =
+      db.prepareStatement<std::string>("SELECT size FROM target_file_prefixes WHERE targetname = ?;", targetname);
+
+  switch (statement.step()) {
+    case SQLITE_ROW:
+      break;
+    case SQLITE_DONE:
+      return false;
+    default:
+      LOG_ERROR << "Failed to load Target file prefix: " << db.errmsg();
+      return false;
+  }
+
+  if (size != nullptr) {
+    *size = static_cast<uint64_t>(statement.get_result_col_int(0));
+  }
+  return true;
+}
+
+void SQLStorage::clearTargetFilePrefix(const std::string& targetname) const {
+  SQLite3Guard db = dbConnection();
+
+  auto statement =
+      db.prepareStatement<std::string>("DELETE FROM target_file_prefixes WHERE targetname=?;", targetname);
+  if (statement.step() != SQLITE_DONE) {
+    LOG_ERROR << "Failed to clear Target file prefix: " << db.errmsg();
+    throw SQLException(std::string("Failed to clear Target file prefix: ") + db.errmsg());
+  }
 }
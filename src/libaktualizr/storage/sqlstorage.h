@@ -52,6 +52,8 @@ class SQLStorage : public SQLStorageBase, public INvStorage {
   bool loadNonRoot(std::string* data, Uptane::RepositoryType repo, Uptane::Role role) const override;
   void clearNonRootMeta(Uptane::RepositoryType repo) override;
   void clearMetadata() override;
+  void storeCachedMeta(const CachedMeta& meta, Uptane::RepositoryType repo, Uptane::Role role) override;
+  bool loadCachedMeta(CachedMeta* meta, Uptane::RepositoryType repo, Uptane::Role role) const override;
   void storeDelegation(const std::string& data, Uptane::Role role) override;
   bool loadDelegation(std::string* data, Uptane::Role role) const override;
   bool loadAllDelegations(std::vector<std::pair<Uptane::Role, std::string>>& data) const override;
@@ -98,7 +100,9 @@ class SQLStorage : public SQLStorageBase, public INvStorage {
   void saveEcuReportCounter(const Uptane::EcuSerial& ecu_serial, int64_t counter) override;
   bool loadEcuReportCounter(std::vector<std::pair<Uptane::EcuSerial, int64_t>>* results) const override;
   void saveReportEvent(const Json::Value& json_value) override;
+  bool saveReportEvents(const std::vector<Json::Value>& events, int64_t* id_max) override;
   bool loadReportEvents(Json::Value* report_array, int64_t* id_max, int limit) const override;
+  bool loadPendingReportEvents(std::vector<std::pair<int64_t, Json::Value>>* events, int limit) const override;
   void deleteReportEvents(int64_t id_max) override;
   void clearInstallationResults() override;
 
@@ -109,12 +113,23 @@ class SQLStorage : public SQLStorageBase, public INvStorage {
   void storeTargetFilename(const std::string& targetname, const std::string& filename) const override;
   std::string getTargetFilename(const std::string& targetname) const override;
   std::vector<std::string> getAllTargetNames() const override;
+  std::vector<StoredTargetFile> loadTargetFileIndex() const override;
+  void storeTargetFileUsage(const std::string& targetname, uint64_t size, int64_t last_used) const override;
   void deleteTargetInfo(const std::string& targetname) const override;
+  void storeTargetHasherCheckpoint(const std::string& targetname,
+                                   const TargetHasherCheckpoint& checkpoint) const override;
+  bool loadTargetHasherCheckpoint(const std::string& targetname, TargetHasherCheckpoint* checkpoint) const override;
+  void storeVerifiedTargetFile(const std::string& targetname, const VerifiedTargetFile& file) const override;
+  bool loadVerifiedTargetFile(const std::string& targetname, VerifiedTargetFile* file) const override;
+  void storeTargetFilePrefix(const std::string& targetname, uint64_t size) const override;
+  bool loadTargetFilePrefix(const std::string& targetname, uint64_t* size) const override;
+  void clearTargetFilePrefix(const std::string& targetname) const override;
 
   StorageType type() override { return StorageType::kSqlite; };
 
  private:
   void cleanMetaVersion(Uptane::RepositoryType repo, const Uptane::Role& role);
+  static void clearTargetFileState(SQLite3Guard& db, const std::string& targetname);
 };
 
 #endif  // SQLSTORAGE_H_
@@ -33,10 +33,11 @@ StorageLock::~StorageLock() {
 SQLStorageBase::SQLStorageBase(boost::filesystem::path sqldb_path, bool readonly,
                                std::vector<std::string> schema_migrations,
                                std::vector<std::string> schema_rollback_migrations, std::string current_schema,
-                               int current_schema_version)
+                               int current_schema_version, size_t pool_size, bool wal)
     : sqldb_path_(std::move(sqldb_path)),
       readonly_(readonly),
       mutex_(new std::mutex()),
+      wal_(wal),
       schema_migrations_(std::move(schema_migrations)),
       schema_rollback_migrations_(std::move(schema_rollback_migrations)),
       current_schema_(std::move(current_schema)),
@@ -73,16 +74,27 @@ SQLStorageBase::SQLStorageBase(boost::filesystem::path sqldb_path, bool readonly
     }
   }
 
+  if (pool_size > 0) {
+    pool_ = std::make_shared<SQLiteConnectionPool>(dbPath(), readonly_, pool_size, wal_);
+  }
+
   if (!dbMigrate()) {
     throw StorageException("SQLite database migration failed");
   }
 }
 
 SQLite3Guard SQLStorageBase::dbConnection() const {
+  if (pool_) {
+    return SQLite3Guard(pool_);
+  }
+
   SQLite3Guard db(dbPath(), readonly_, mutex_);
   if (db.get_rc() != SQLITE_OK) {
     throw SQLInternalException(std::string("Can't open database: ") + db.errmsg());
   }
+  if (wal_) {
+    SQLiteSetWalProfile(db.get(), readonly_);
+  }
   return db;
 }
 
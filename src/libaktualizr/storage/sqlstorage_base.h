@@ -34,7 +34,7 @@ class SQLStorageBase {
  public:
   explicit SQLStorageBase(boost::filesystem::path sqldb_path, bool readonly, std::vector<std::string> schema_migrations,
                           std::vector<std::string> schema_rollback_migrations, std::string current_schema,
-                          int current_schema_version);
+                          int current_schema_version, size_t pool_size = 0, bool wal = false);
   std::string getTableSchemaFromDb(const std::string &tablename);
   bool dbMigrateForward(int version_from, int version_to = 0);
   bool dbMigrateBackward(int version_from, int version_to = 0);
@@ -48,6 +48,10 @@ class SQLStorageBase {
 
   StorageLock lock;
   std::shared_ptr<std::mutex> mutex_;
+  // Connections kept open between operations; if null, every operation opens
+  // its own connection, serialized on mutex_.
+  std::shared_ptr<SQLiteConnectionPool> pool_;
+  bool wal_{false};
 
   const std::vector<std::string> schema_migrations_;
   std::vector<std::string> schema_rollback_migrations_;
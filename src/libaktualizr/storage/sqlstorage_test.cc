@@ -1,5 +1,9 @@
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <chrono>
+#include <thread>
+
 #include <boost/filesystem.hpp>
 #include <boost/tokenizer.hpp>
 
@@ -543,6 +547,96 @@ TEST(sqlstorage, store_and_load_report_events) {
   }
 }
 
+TEST(sqlstorage, store_report_events_batch) {
+  TemporaryDirectory temp_dir;
+  StorageConfig config;
+  config.path = temp_dir.Path();
+  auto storage = INvStorage::newStorage(config);
+
+  storage->saveReportEvent(Utils::parseJSON(R"({"id": "0"})"));
+  const std::vector<Json::Value> batch{Utils::parseJSON(R"({"id": "1"})"), Utils::parseJSON(R"({"id": "2"})")};
+  int64_t max_id = 0;
+  EXPECT_TRUE(storage->saveReportEvents(batch, &max_id));
+  EXPECT_EQ(max_id, 3);
+
+  storage->deleteReportEvents(1);
+  std::vector<std::pair<int64_t, Json::Value>> events;
+  EXPECT_TRUE(storage->loadPendingReportEvents(&events, -1));
+  ASSERT_EQ(events.size(), 2);
+  EXPECT_EQ(events[0].first, 2);
+  EXPECT_EQ(events[0].second["id"], "1");
+  EXPECT_EQ(events[1].first, 3);
+  EXPECT_EQ(events[1].second["id"], "2");
+
+  events.clear();
+  EXPECT_TRUE(storage->loadPendingReportEvents(&events, 1));
+  ASSERT_EQ(events.size(), 1);
+  EXPECT_EQ(events[0].first, 2);
+}
+
+/* Storage operations from several threads run concurrently on pooled
+ * connections, and none of them fails on a database that is locked by
+ * another connection. */
+TEST(sqlstorage, connection_pool_threads) {
+  for (const bool wal : {false, true}) {
+    TemporaryDirectory temp_dir;
+    StorageConfig config;
+    config.path = temp_dir.Path();
+    config.sqldb_pool_size = 2;
+    config.sqldb_wal = wal;
+    SQLStorage storage(config, false);
+
+    std::vector<std::thread> threads;
+    std::atomic<int> failures{0};
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([&storage, &failures, t] {
+        const std::string key = "key" + std::to_string(t);
+        for (int ii = 0; ii < 50; ++ii) {
+          storage.storeDeviceDataHash(key, std::to_string(ii));
+          std::string hash;
+          if (!storage.loadDeviceDataHash(key, &hash) || hash != std::to_string(ii)) {
+            ++failures;
+          }
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    EXPECT_EQ(failures, 0);
+  }
+}
+
+/* Compare store/load latency with a connection per operation, with pooled
+ * connections and with pooled connections in WAL mode. The figures are only
+ * logged. */
+TEST(sqlstorage, DISABLED_BenchmarkConnectionLatency) {
+  struct Mode {
+    const char* name;
+    uint64_t pool_size;
+    bool wal;
+  };
+  const int iterations = 200;
+  for (const auto& mode : {Mode{"per operation", 0, false}, Mode{"pooled", 1, false}, Mode{"pooled + WAL", 1, true}}) {
+    TemporaryDirectory temp_dir;
+    StorageConfig config;
+    config.path = temp_dir.Path();
+    config.sqldb_pool_size = mode.pool_size;
+    config.sqldb_wal = mode.wal;
+    SQLStorage storage(config, false);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int ii = 0; ii < iterations; ++ii) {
+      const Uptane::EcuSerial serial("ecu" + std::to_string(ii % 4));
+      storage.saveEcuReportCounter(serial, ii);
+      std::vector<std::pair<Uptane::EcuSerial, int64_t>> counters;
+      EXPECT_TRUE(storage.loadEcuReportCounter(&counters));
+    }
+    const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    LOG_INFO << "Store + load with " << mode.name << " connections: " << elapsed.count() / iterations << " us";
+  }
+}
+
 #ifndef __NO_MAIN__
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
@@ -483,6 +483,47 @@ TEST(StorageCommon, DownloadedFilesInfo) {
   ASSERT_EQ(names.at(0), "target2");
 }
 
+TEST(StorageCommon, DownloadedFilesState) {
+  TemporaryDirectory temp_dir;
+  std::unique_ptr<INvStorage> storage = Storage(temp_dir.Path());
+
+  storage->storeTargetFilename("target1", "file1");
+  EXPECT_FALSE(storage->loadTargetHasherCheckpoint("target1", nullptr));
+  EXPECT_FALSE(storage->loadVerifiedTargetFile("target1", nullptr));
+
+  const std::string state("\x01\x00\x02", 3);
+  storage->storeTargetHasherCheckpoint("target1", {Hash::Type::kSha256, 1024, state});
+  TargetHasherCheckpoint checkpoint;
+  ASSERT_TRUE(storage->loadTargetHasherCheckpoint("target1", &checkpoint));
+  EXPECT_EQ(checkpoint.type, Hash::Type::kSha256);
+  EXPECT_EQ(checkpoint.offset, 1024);
+  EXPECT_EQ(checkpoint.state, state);
+
+  VerifiedTargetFile file;
+  file.size = 2048;
+  file.mtime_ns = 1234567890123456789;
+  file.inode = 42;
+  file.hash = Hash(Hash::Type::kSha256, "abcd");
+  storage->storeVerifiedTargetFile("target1", file);
+  VerifiedTargetFile loaded;
+  ASSERT_TRUE(storage->loadVerifiedTargetFile("target1", &loaded));
+  EXPECT_EQ(loaded.size, file.size);
+  EXPECT_EQ(loaded.mtime_ns, file.mtime_ns);
+  EXPECT_EQ(loaded.inode, file.inode);
+  EXPECT_EQ(loaded.hash, file.hash);
+
+  // Recreating the file invalidates everything known about its content.
+  storage->storeTargetFilename("target1", "file1");
+  EXPECT_FALSE(storage->loadTargetHasherCheckpoint("target1", nullptr));
+  EXPECT_FALSE(storage->loadVerifiedTargetFile("target1", nullptr));
+
+  storage->storeTargetHasherCheckpoint("target1", {Hash::Type::kSha256, 1024, state});
+  storage->storeVerifiedTargetFile("target1", file);
+  storage->deleteTargetInfo("target1");
+  EXPECT_FALSE(storage->loadTargetHasherCheckpoint("target1", nullptr));
+  EXPECT_FALSE(storage->loadVerifiedTargetFile("target1", nullptr));
+}
+
 TEST(StorageCommon, LoadStoreSecondaryInfo) {
   TemporaryDirectory temp_dir;
   std::unique_ptr<INvStorage> storage = Storage(temp_dir.Path());
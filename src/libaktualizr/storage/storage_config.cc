@@ -5,6 +5,8 @@ void StorageConfig::updateFromPropertyTree(const boost::property_tree::ptree& pt
   CopyFromConfig(type, "type", pt);
   CopyFromConfig(path, "path", pt);
   CopyFromConfig(sqldb_path, "sqldb_path", pt);
+  CopyFromConfig(sqldb_pool_size, "sqldb_pool_size", pt);
+  CopyFromConfig(sqldb_wal, "sqldb_wal", pt);
   CopyFromConfig(uptane_metadata_path, "uptane_metadata_path", pt);
   CopyFromConfig(uptane_private_key_path, "uptane_private_key_path", pt);
   CopyFromConfig(uptane_public_key_path, "uptane_public_key_path", pt);
@@ -17,6 +19,8 @@ void StorageConfig::writeToStream(std::ostream& out_stream) const {
   writeOption(out_stream, type, "type");
   writeOption(out_stream, path, "path");
   writeOption(out_stream, sqldb_path.get(""), "sqldb_path");
+  writeOption(out_stream, sqldb_pool_size, "sqldb_pool_size");
+  writeOption(out_stream, sqldb_wal, "sqldb_wal");
   writeOption(out_stream, uptane_metadata_path.get(""), "uptane_metadata_path");
   writeOption(out_stream, uptane_private_key_path.get(""), "uptane_private_key_path");
   writeOption(out_stream, uptane_public_key_path.get(""), "uptane_public_key_path");
@@ -0,0 +1,169 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/process.hpp>
+
+#include "directorrepository.h"
+#include "fetcher.h"
+#include "http/httpclient.h"
+#include "imagerepository.h"
+#include "logging/logging.h"
+#include "storage/invstorage.h"
+#include "test_utils.h"
+#include "utilities/utils.h"
+
+boost::filesystem::path uptane_generator_path;
+
+namespace Uptane {
+
+/* Record the metadata requests and how many of them were answered with 304. */
+class RecordingHttpClient : public HttpClient {
+ public:
+  HttpResponse get(const std::string &url, int64_t maxsize, const api::FlowControlToken *flow_control) override {
+    requests.push_back(url);
+    return HttpClient::get(url, maxsize, flow_control);
+  }
+
+  HttpResponse getIfModified(const std::string &url, int64_t maxsize, const api::FlowControlToken *flow_control,
+                             const HttpValidators &validators) override {
+    requests.push_back(url);
+    HttpResponse response = HttpClient::getIfModified(url, maxsize, flow_control, validators);
+    if (response.http_status_code == 304) {
+      ++not_modified;
+    }
+    return response;
+  }
+
+  bool requested(const std::string &suffix) const {
+    return std::any_of(requests.begin(), requests.end(),
+                       [&suffix](const std::string &url) { return boost::algorithm::ends_with(url, suffix); });
+  }
+
+  std::vector<std::string> requests;
+  int not_modified{0};
+};
+
+class ConditionalFetch : public ::testing::Test {
+ protected:
+  ConditionalFetch()
+      : port_(TestUtils::getFreePort()),
+        server_("http://127.0.0.1:" + port_),
+        server_process_("tests/fake_http_server/fake_test_server.py", port_, "-m", meta_dir_.Path()),
+        uptane_gen_(uptane_generator_path.string()),
+        http_(std::make_shared<RecordingHttpClient>()),
+        fetcher_(server_ + "/repo", server_ + "/director", http_) {
+    TestUtils::waitForServer(server_ + "/");
+    uptane_gen_.run({"generate", "--path", meta_dir_.PathString(), "--correlationid", "cid1"});
+  }
+
+  void addTarget() {
+    uptane_gen_.run({"image", "--path", meta_dir_.PathString(), "--filename", "tests/test_data/firmware.txt",
+                     "--targetname", "firmware.txt", "--hwid", "primary_hw"});
+    uptane_gen_.run({"addtarget", "--path", meta_dir_.PathString(), "--targetname", "firmware.txt", "--hwid",
+                     "primary_hw", "--serial", "CA:FE:A6:D2:84:9D"});
+    uptane_gen_.run({"signtargets", "--path", meta_dir_.PathString()});
+  }
+
+  // Update the metadata of both repositories as a freshly started client would.
+  void updateMeta(INvStorage &storage) {
+    http_->requests.clear();
+    http_->not_modified = 0;
+    DirectorRepository director;
+    ImageRepository image;
+    director.updateMeta(storage, fetcher_, nullptr);
+    image.updateMeta(storage, fetcher_, nullptr);
+  }
+
+  TemporaryDirectory meta_dir_;
+  std::string port_;
+  std::string server_;
+  boost::process::child server_process_;
+  Process uptane_gen_;
+  std::shared_ptr<RecordingHttpClient> http_;
+  Fetcher fetcher_;
+};
+
+/*
+ * The server answers with 304 to a request with the validators of the latest
+ * response, until the metadata changes.
+ */
+TEST_F(ConditionalFetch, Fetcher) {
+  std::string result;
+  HttpValidators validators;
+  EXPECT_TRUE(fetcher_.fetchLatestRoleIfModified(&result, kMaxDirectorTargetsSize, RepositoryType::Director(),
+                                                 Role::Targets(), &validators, nullptr));
+  EXPECT_EQ(result, Utils::readFile(meta_dir_.Path() / "repo/director/targets.json"));
+  EXPECT_FALSE(validators.etag.empty());
+  EXPECT_FALSE(validators.last_modified.empty());
+
+  const HttpValidators first = validators;
+  result.clear();
+  EXPECT_FALSE(fetcher_.fetchLatestRoleIfModified(&result, kMaxDirectorTargetsSize, RepositoryType::Director(),
+                                                  Role::Targets(), &validators, nullptr));
+  EXPECT_TRUE(result.empty());
+  EXPECT_EQ(validators.etag, first.etag);
+
+  addTarget();
+  EXPECT_TRUE(fetcher_.fetchLatestRoleIfModified(&result, kMaxDirectorTargetsSize, RepositoryType::Director(),
+                                                 Role::Targets(), &validators, nullptr));
+  EXPECT_EQ(result, Utils::readFile(meta_dir_.Path() / "repo/director/targets.json"));
+  EXPECT_NE(validators.etag, first.etag);
+}
+
+/*
+ * Unchanged Director Targets and Image repo Timestamp metadata is not
+ * downloaded again, and neither are the Image repo Snapshot and Targets.
+ */
+TEST_F(ConditionalFetch, Repositories) {
+  TemporaryDirectory temp_dir;
+  StorageConfig storage_config;
+  storage_config.path = temp_dir.Path();
+  auto storage = INvStorage::newStorage(storage_config);
+
+  updateMeta(*storage);
+  EXPECT_EQ(http_->not_modified, 0);
+  EXPECT_TRUE(http_->requested("/repo/snapshot.json"));
+
+  updateMeta(*storage);
+  EXPECT_EQ(http_->not_modified, 2);
+  EXPECT_FALSE(http_->requested("/repo/snapshot.json"));
+  EXPECT_FALSE(http_->requested("/repo/targets.json"));
+
+  addTarget();
+  updateMeta(*storage);
+  EXPECT_EQ(http_->not_modified, 0);
+  std::string stored;
+  EXPECT_TRUE(storage->loadNonRoot(&stored, RepositoryType::Director(), Role::Targets()));
+  EXPECT_EQ(stored, Utils::readFile(meta_dir_.Path() / "repo/director/targets.json"));
+
+  // The validators go away along with the metadata.
+  storage->clearNonRootMeta(RepositoryType::Director());
+  CachedMeta cached;
+  EXPECT_FALSE(storage->loadCachedMeta(&cached, RepositoryType::Director(), Role::Targets()));
+  EXPECT_TRUE(storage->loadCachedMeta(&cached, RepositoryType::Image(), Role::Timestamp()));
+}
+
+}  // namespace Uptane
+
+#ifndef __NO_MAIN__
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  if (argc != 2) {
+    std::cerr << "Error: " << argv[0] << " requires the path to the uptane-generator utility\n";
+    return EXIT_FAILURE;
+  }
+  uptane_generator_path = argv[1];
+
+  logger_init();
+  logger_set_threshold(boost::log::trivial::trace);
+
+  return RUN_ALL_TESTS();
+}
+#endif
+
+// vim: set tabstop=2 shiftwidth=2 expandtab:
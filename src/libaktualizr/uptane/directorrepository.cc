@@ -110,18 +110,14 @@ void DirectorRepository::updateMeta(INvStorage& storage, const IMetadataFetcher&
 
   // Update Director Targets Metadata
   {
-    std::string director_targets;
-
-    fetcher.fetchLatestRole(&director_targets, kMaxDirectorTargetsSize, RepositoryType::Director(), Role::Targets(),
-                            flow_control);
-    int remote_version = extractVersionUntrusted(director_targets);
-
     int local_version;
+    bool stored_verified = false;
     std::string director_targets_stored;
     if (storage.loadNonRoot(&director_targets_stored, RepositoryType::Director(), Role::Targets())) {
       local_version = extractVersionUntrusted(director_targets_stored);
       try {
         verifyTargets(director_targets_stored);
+        stored_verified = true;
       } catch (const std::exception& e) {
         LOG_WARNING << "Unable to verify stored Director Targets metadata.";
       }
@@ -129,16 +125,25 @@ void DirectorRepository::updateMeta(INvStorage& storage, const IMetadataFetcher&
       local_version = -1;
     }
 
-    verifyTargets(director_targets);
+    auto verify = [&](const std::string& director_targets) {
+      int remote_version = extractVersionUntrusted(director_targets);
 
-    // TODO(OTA-4940): check if versions are equal but content is different. In
-    // that case, the member variable targets is updated, but it isn't stored in
-    // the database, which can cause some minor confusion.
-    if (local_version > remote_version) {
-      throw Uptane::SecurityException(RepositoryType::DIRECTOR, "Rollback attempt");
-    } else if (local_version < remote_version && !usePreviousTargets()) {
-      storage.storeNonRoot(director_targets, RepositoryType::Director(), Role::Targets());
-    }
+      // An unchanged copy of the stored metadata was just verified.
+      if (!stored_verified || director_targets != director_targets_stored) {
+        verifyTargets(director_targets);
+      }
+
+      // TODO(OTA-4940): check if versions are equal but content is different. In
+      // that case, the member variable targets is updated, but it isn't stored in
+      // the database, which can cause some minor confusion.
+      if (local_version > remote_version) {
+        throw Uptane::SecurityException(RepositoryType::DIRECTOR, "Rollback attempt");
+      } else if (local_version < remote_version && !usePreviousTargets()) {
+        storage.storeNonRoot(director_targets, RepositoryType::Director(), Role::Targets());
+      }
+    };
+    fetchLatestRoleCached(storage, fetcher, RepositoryType::Director(), Role::Targets(), kMaxDirectorTargetsSize,
+                          verify, flow_control);
 
     checkTargetsExpired();
 
@@ -4,14 +4,17 @@
 
 namespace Uptane {
 
-void Fetcher::fetchRole(std::string* result, int64_t maxsize, RepositoryType repo, const Uptane::Role& role,
-                        Version version, const api::FlowControlToken* flow_control) const {
+std::string Fetcher::roleUrl(RepositoryType repo, const Uptane::Role& role, Version version) const {
   std::string url = (repo == RepositoryType::Director()) ? director_server : repo_server;
   if (role.IsDelegation()) {
     url += "/delegations";
   }
-  url += "/" + version.RoleFileName(role);
-  HttpResponse response = http->get(url, maxsize, flow_control);
+  return url + "/" + version.RoleFileName(role);
+}
+
+void Fetcher::fetchRole(std::string* result, int64_t maxsize, RepositoryType repo, const Uptane::Role& role,
+                        Version version, const api::FlowControlToken* flow_control) const {
+  HttpResponse response = http->get(roleUrl(repo, role, version), maxsize, flow_control);
   if (flow_control != nullptr && flow_control->hasAborted()) {
     throw Uptane::LocallyAborted(repo);
   }
@@ -21,4 +24,22 @@ void Fetcher::fetchRole(std::string* result, int64_t maxsize, RepositoryType rep
   *result = response.body;
 }
 
+bool Fetcher::fetchLatestRoleIfModified(std::string* result, int64_t maxsize, RepositoryType repo,
+                                        const Uptane::Role& role, HttpValidators* validators,
+                                        const api::FlowControlToken* flow_control) const {
+  HttpResponse response = http->getIfModified(roleUrl(repo, role, Version()), maxsize, flow_control, *validators);
+  if (flow_control != nullptr && flow_control->hasAborted()) {
+    throw Uptane::LocallyAborted(repo);
+  }
+  if (response.http_status_code == 304 && !validators->empty()) {
+    return false;
+  }
+  if (!response.isOk() || response.http_status_code == 304) {
+    throw Uptane::MetadataFetchFailure(repo.ToString(), role.ToString());
+  }
+  *result = response.body;
+  *validators = response.validators;
+  return true;
+}
+
 }  // namespace Uptane
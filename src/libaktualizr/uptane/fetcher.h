@@ -47,6 +47,24 @@ class IMetadataFetcher {
     fetchRole(result, maxsize, repo, role, Version(), flow_control);
   }
 
+  /**
+   * Fetch the latest version of a role, unless it is unchanged since a
+   * response with `validators` was received.
+   *
+   * By default the role is always fetched, without validators.
+   * @param validators Validators of an earlier response, if not empty. Set to
+   *                   those of the new response if there is one.
+   * @return false if the role is unchanged, in which case `result` is not set
+   * @throws Same as fetchRole()
+   */
+  virtual bool fetchLatestRoleIfModified(std::string* result, int64_t maxsize, RepositoryType repo,
+                                         const Uptane::Role& role, HttpValidators* validators,
+                                         const api::FlowControlToken* flow_control) const {
+    fetchLatestRole(result, maxsize, repo, role, flow_control);
+    *validators = HttpValidators();
+    return true;
+  }
+
  protected:
   IMetadataFetcher() = default;
   IMetadataFetcher(IMetadataFetcher&&) = default;
@@ -62,10 +80,14 @@ class Fetcher : public IMetadataFetcher {
         director_server(std::move(director_server_in)) {}
   void fetchRole(std::string* result, int64_t maxsize, RepositoryType repo, const Uptane::Role& role, Version version,
                  const api::FlowControlToken* flow_control) const override;
+  bool fetchLatestRoleIfModified(std::string* result, int64_t maxsize, RepositoryType repo, const Uptane::Role& role,
+                                 HttpValidators* validators, const api::FlowControlToken* flow_control) const override;
 
   std::string getRepoServer() const { return repo_server; }
 
  private:
+  std::string roleUrl(RepositoryType repo, const Uptane::Role& role, Version version) const;
+
   std::shared_ptr<HttpInterface> http;
   std::string repo_server;
   std::string director_server;
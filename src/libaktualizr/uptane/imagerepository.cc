@@ -34,10 +34,11 @@ void ImageRepository::checkTimestampExpired() {
 
 void ImageRepository::fetchSnapshot(INvStorage& storage, const IMetadataFetcher& fetcher, const int local_version,
                                     const api::FlowControlToken* flow_control) {
-  std::string image_snapshot;
+  std::string image_snapshot_raw;
   const int64_t snapshot_size = (snapshotSize() > 0) ? snapshotSize() : kMaxSnapshotSize;
-  fetcher.fetchLatestRole(&image_snapshot, snapshot_size, RepositoryType::Image(), Role::Snapshot(), flow_control);
-  const int remote_version = extractVersionUntrusted(image_snapshot);
+  fetcher.fetchLatestRole(&image_snapshot_raw, snapshot_size, RepositoryType::Image(), Role::Snapshot(), flow_control);
+  const ParsedMetadata image_snapshot(std::move(image_snapshot_raw));
+  const int remote_version = image_snapshot.versionUntrusted();
 
   // 6. Check that each Targets metadata filename listed in the previous Snapshot metadata file is also listed in this
   // Snapshot metadata file. If this condition is not met, discard the new Snapshot metadata file, abort the update
@@ -50,26 +51,17 @@ void ImageRepository::fetchSnapshot(INvStorage& storage, const IMetadataFetcher&
   if (local_version > remote_version) {
     throw Uptane::SecurityException(RepositoryType::IMAGE, "Rollback attempt");
   } else {
-    storage.storeNonRoot(image_snapshot, RepositoryType::Image(), Role::Snapshot());
+    storage.storeNonRoot(image_snapshot.raw(), RepositoryType::Image(), Role::Snapshot());
   }
 }
 
-void ImageRepository::verifySnapshot(const std::string& snapshot_raw, bool prefetch) {
-  const std::string canonical = Utils::jsonToCanonicalStr(Utils::parseJSON(snapshot_raw));
+void ImageRepository::verifySnapshot(const ParsedMetadata& snapshot_meta, bool prefetch) {
   bool hash_exists = false;
   for (const auto& it : timestamp.snapshot_hashes()) {
     switch (it.type()) {
       case Hash::Type::kSha256:
-        if (Hash(Hash::Type::kSha256, Crypto::sha256digestHex(canonical)) != it) {
-          if (!prefetch) {
-            LOG_ERROR << "Hash verification for Snapshot metadata failed";
-          }
-          throw Uptane::SecurityException(RepositoryType::IMAGE, "Snapshot metadata hash verification failed");
-        }
-        hash_exists = true;
-        break;
       case Hash::Type::kSha512:
-        if (Hash(Hash::Type::kSha512, Crypto::sha512digestHex(canonical)) != it) {
+        if (snapshot_meta.hash(it.type()) != it) {
           if (!prefetch) {
             LOG_ERROR << "Hash verification for Snapshot metadata failed";
           }
@@ -89,7 +81,7 @@ void ImageRepository::verifySnapshot(const std::string& snapshot_raw, bool prefe
 
   try {
     // Verify the signature:
-    snapshot = Snapshot(RepositoryType::Image(), Utils::parseJSON(snapshot_raw), std::make_shared<MetaWithKeys>(root));
+    snapshot = Snapshot(RepositoryType::Image(), snapshot_meta, std::make_shared<MetaWithKeys>(root));
   } catch (const Exception& e) {
     LOG_ERROR << "Signature verification for Snapshot metadata failed";
     throw;
@@ -108,7 +100,7 @@ void ImageRepository::checkSnapshotExpired() {
 
 void ImageRepository::fetchTargets(INvStorage& storage, const IMetadataFetcher& fetcher, const int local_version,
                                    const api::FlowControlToken* flow_control) {
-  std::string image_targets;
+  std::string image_targets_raw;
   const Role targets_role = Role::Targets();
 
   auto targets_size = getRoleSize(Role::Targets());
@@ -116,27 +108,29 @@ void ImageRepository::fetchTargets(INvStorage& storage, const IMetadataFetcher&
     targets_size = kMaxImageTargetsSize;
   }
 
-  fetcher.fetchLatestRole(&image_targets, targets_size, RepositoryType::Image(), targets_role, flow_control);
+  fetcher.fetchLatestRole(&image_targets_raw, targets_size, RepositoryType::Image(), targets_role, flow_control);
+  const ParsedMetadata image_targets(std::move(image_targets_raw));
 
-  const int remote_version = extractVersionUntrusted(image_targets);
+  const int remote_version = image_targets.versionUntrusted();
 
   verifyTargets(image_targets, false);
 
   if (local_version > remote_version) {
     throw Uptane::SecurityException(RepositoryType::IMAGE, "Rollback attempt");
   } else {
-    storage.storeNonRoot(image_targets, RepositoryType::Image(), targets_role);
+    storage.storeNonRoot(image_targets.raw(), RepositoryType::Image(), targets_role);
   }
 }
 
-void ImageRepository::verifyRoleHashes(const std::string& role_data, const Uptane::Role& role, bool prefetch) const {
-  const std::string canonical = Utils::jsonToCanonicalStr(Utils::parseJSON(role_data));
+void ImageRepository::verifyRoleHashes(const ParsedMetadata& role_meta, const Uptane::Role& role,
+                                       bool prefetch) const {
   // Hashes are not required in snapshot metadata. If present, however, we may as well check them.
   // This provides no security benefit, but may help with fault detection.
   for (const auto& it : snapshot.role_hashes(role)) {
     switch (it.type()) {
       case Hash::Type::kSha256:
-        if (Hash(Hash::Type::kSha256, Crypto::sha256digestHex(canonical)) != it) {
+      case Hash::Type::kSha512:
+        if (role_meta.hash(it.type()) != it) {
           // If prefetch is true, it means we're checking a local copy of the metadata.
           // Failures in that case just indicate we need to refresh it from the server, so
           // we only actually log the error if the metadata comes directly from the server.
@@ -147,15 +141,6 @@ void ImageRepository::verifyRoleHashes(const std::string& role_data, const Uptan
                                           "Snapshot hash mismatch for " + role.ToString() + " metadata");
         }
         break;
-      case Hash::Type::kSha512:
-        if (Hash(Hash::Type::kSha512, Crypto::sha512digestHex(canonical)) != it) {
-          if (!prefetch) {
-            LOG_ERROR << "Hash verification for " << role << " metadata failed";
-          }
-          throw Uptane::SecurityException(RepositoryType::IMAGE,
-                                          "Snapshot hash mismatch for " + role.ToString() + " metadata");
-        }
-        break;
       default:
         break;
     }
@@ -166,16 +151,13 @@ int ImageRepository::getRoleVersion(const Uptane::Role& role) const { return sna
 
 int64_t ImageRepository::getRoleSize(const Uptane::Role& role) const { return snapshot.role_size(role); }
 
-void ImageRepository::verifyTargets(const std::string& targets_raw, bool prefetch) {
+void ImageRepository::verifyTargets(const ParsedMetadata& targets_meta, bool prefetch) {
   try {
-    verifyRoleHashes(targets_raw, Uptane::Role::Targets(), prefetch);
-
-    auto targets_json = Utils::parseJSON(targets_raw);
+    verifyRoleHashes(targets_meta, Uptane::Role::Targets(), prefetch);
 
     // Verify the signature:
     auto signer = std::make_shared<MetaWithKeys>(root);
-    targets = std::make_shared<Uptane::Targets>(
-        Targets(RepositoryType::Image(), Uptane::Role::Targets(), targets_json, signer));
+    targets = std::make_shared<Uptane::Targets>(RepositoryType::Image(), Uptane::Role::Targets(), targets_meta, signer);
 
     if (targets->version() != snapshot.role_version(Uptane::Role::Targets())) {
       throw Uptane::VersionMismatch(RepositoryType::IMAGE, Uptane::Role::TARGETS);
@@ -190,16 +172,13 @@ void ImageRepository::verifyTargets(const std::string& targets_raw, bool prefetc
   }
 }
 
-std::shared_ptr<Uptane::Targets> ImageRepository::verifyDelegation(const std::string& delegation_raw,
+std::shared_ptr<Uptane::Targets> ImageRepository::verifyDelegation(const ParsedMetadata& delegation_meta,
                                                                    const Uptane::Role& role,
                                                                    const Targets& parent_target) {
   try {
-    const Json::Value delegation_json = Utils::parseJSON(delegation_raw);
-    const std::string canonical = Utils::jsonToCanonicalStr(delegation_json);
-
     // Verify the signature:
     auto signer = std::make_shared<MetaWithKeys>(parent_target);
-    return std::make_shared<Uptane::Targets>(Targets(RepositoryType::Image(), role, delegation_json, signer));
+    return std::make_shared<Uptane::Targets>(RepositoryType::Image(), role, delegation_meta, signer);
   } catch (const Exception& e) {
     LOG_ERROR << "Signature verification for Image repo delegated Targets metadata failed";
     throw;
@@ -222,11 +201,6 @@ void ImageRepository::updateMeta(INvStorage& storage, const IMetadataFetcher& fe
 
   // Update Image repo Timestamp metadata
   {
-    std::string image_timestamp;
-
-    fetcher.fetchLatestRole(&image_timestamp, kMaxTimestampSize, RepositoryType::Image(), Role::Timestamp());
-    int remote_version = extractVersionUntrusted(image_timestamp);
-
     int local_version;
     std::string image_timestamp_stored;
     if (storage.loadNonRoot(&image_timestamp_stored, RepositoryType::Image(), Role::Timestamp())) {
@@ -235,17 +209,25 @@ void ImageRepository::updateMeta(INvStorage& storage, const IMetadataFetcher& fe
       local_version = -1;
     }
 
-    const auto timestamp_stored_signature{timestamp.isInitialized() ? timestamp.signature() : ""};
-    verifyTimestamp(image_timestamp);
-
-    if (local_version > remote_version) {
-      throw Uptane::SecurityException(RepositoryType::IMAGE, "Rollback attempt");
-    } else if (local_version < remote_version || timestamp_stored_signature != timestamp.signature()) {
-      // If local and remote versions are the same but their content actually differ then store/update the metadata in
-      // DB We assume that the metadata contains just one signature, otherwise the comparison might not always work
-      // correctly.
-      storage.storeNonRoot(image_timestamp, RepositoryType::Image(), Role::Timestamp());
-    }
+    // An unchanged Timestamp means that the stored Snapshot and Targets are
+    // current too, so they are not fetched below.
+    auto verify = [&](const std::string& image_timestamp) {
+      int remote_version = extractVersionUntrusted(image_timestamp);
+
+      const auto timestamp_stored_signature{timestamp.isInitialized() ? timestamp.signature() : ""};
+      verifyTimestamp(image_timestamp);
+
+      if (local_version > remote_version) {
+        throw Uptane::SecurityException(RepositoryType::IMAGE, "Rollback attempt");
+      } else if (local_version < remote_version || timestamp_stored_signature != timestamp.signature()) {
+        // If local and remote versions are the same but their content actually differ then store/update the metadata
+        // in DB We assume that the metadata contains just one signature, otherwise the comparison might not always
+        // work correctly.
+        storage.storeNonRoot(image_timestamp, RepositoryType::Image(), Role::Timestamp());
+      }
+    };
+    fetchLatestRoleCached(storage, fetcher, RepositoryType::Image(), Role::Timestamp(), kMaxTimestampSize, verify,
+                          nullptr);
 
     checkTimestampExpired();
   }
@@ -259,7 +241,7 @@ void ImageRepository::updateMeta(INvStorage& storage, const IMetadataFetcher& fe
     std::string image_snapshot_stored;
     if (storage.loadNonRoot(&image_snapshot_stored, RepositoryType::Image(), Role::Snapshot())) {
       try {
-        verifySnapshot(image_snapshot_stored, true);
+        verifySnapshot(ParsedMetadata(std::move(image_snapshot_stored)), true);
         fetch_snapshot = false;
         LOG_DEBUG << "Skipping Image repo Snapshot download; stored version is still current.";
       } catch (const Uptane::Exception& e) {
@@ -288,7 +270,7 @@ void ImageRepository::updateMeta(INvStorage& storage, const IMetadataFetcher& fe
     std::string image_targets_stored;
     if (storage.loadNonRoot(&image_targets_stored, RepositoryType::Image(), Role::Targets())) {
       try {
-        verifyTargets(image_targets_stored, true);
+        verifyTargets(ParsedMetadata(std::move(image_targets_stored)), true);
         fetch_targets = false;
         LOG_DEBUG << "Skipping Image repo Targets download; stored version is still current.";
       } catch (const std::exception& e) {
@@ -345,7 +327,7 @@ void ImageRepository::checkMetaOffline(INvStorage& storage) {
       throw Uptane::SecurityException(RepositoryType::IMAGE, "Could not load Snapshot role");
     }
 
-    verifySnapshot(image_snapshot, false);
+    verifySnapshot(ParsedMetadata(std::move(image_snapshot)), false);
 
     checkSnapshotExpired();
   }
@@ -358,7 +340,7 @@ void ImageRepository::checkMetaOffline(INvStorage& storage) {
       throw Uptane::SecurityException(RepositoryType::IMAGE, "Could not load Image role");
     }
 
-    verifyTargets(image_targets, false);
+    verifyTargets(ParsedMetadata(std::move(image_targets)), false);
 
     checkTargetsExpired();
   }
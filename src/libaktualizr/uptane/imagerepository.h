@@ -16,17 +16,17 @@ class ImageRepository : public RepositoryCommon {
 
   void resetMeta();
 
-  void verifyTargets(const std::string& targets_raw, bool prefetch);
+  void verifyTargets(const ParsedMetadata& targets_meta, bool prefetch);
 
   void verifyTimestamp(const std::string& timestamp_raw);
 
-  void verifySnapshot(const std::string& snapshot_raw, bool prefetch);
+  void verifySnapshot(const ParsedMetadata& snapshot_meta, bool prefetch);
 
-  static std::shared_ptr<Uptane::Targets> verifyDelegation(const std::string& delegation_raw, const Uptane::Role& role,
-                                                           const Targets& parent_target);
+  static std::shared_ptr<Uptane::Targets> verifyDelegation(const ParsedMetadata& delegation_meta,
+                                                           const Uptane::Role& role, const Targets& parent_target);
   std::shared_ptr<const Uptane::Targets> getTargets() const { return targets; }
 
-  void verifyRoleHashes(const std::string& role_data, const Uptane::Role& role, bool prefetch) const;
+  void verifyRoleHashes(const ParsedMetadata& role_meta, const Uptane::Role& role, bool prefetch) const;
   int getRoleVersion(const Uptane::Role& role) const;
   int64_t getRoleSize(const Uptane::Role& role) const;
 
@@ -1,50 +1,57 @@
 #include "iterator.h"
 
+#include <memory>
+
 #include "storage/invstorage.h"
 #include "uptane/exceptions.h"
+#include "utilities/utils.h"
 
 namespace Uptane {
 
 Targets getTrustedDelegation(const Role &delegate_role, const Targets &parent_targets,
                              const ImageRepository &image_repo, INvStorage &storage, IMetadataFetcher &fetcher,
                              const bool offline, const api::FlowControlToken *flow_control) {
-  std::string delegation_meta;
+  std::string delegation_raw;
+  std::unique_ptr<ParsedMetadata> delegation_meta;
   auto version_in_snapshot = image_repo.getRoleVersion(delegate_role);
 
-  if (storage.loadDelegation(&delegation_meta, delegate_role)) {
-    auto version = extractVersionUntrusted(delegation_meta);
+  if (storage.loadDelegation(&delegation_raw, delegate_role)) {
+    delegation_meta = std_::make_unique<ParsedMetadata>(std::move(delegation_raw));
+    auto version = delegation_meta->versionUntrusted();
 
     if (version > version_in_snapshot) {
       throw SecurityException("image", "Rollback attempt on delegated targets");
     } else if (version < version_in_snapshot) {
-      delegation_meta.clear();
+      delegation_meta.reset();
       storage.deleteDelegation(delegate_role);
     }
   }
 
-  bool delegation_remote = delegation_meta.empty();
+  bool delegation_remote = delegation_meta == nullptr;
   if (delegation_remote) {
     // Don't fetch anything remote if we are supposed to already have it.
     if (offline) {
       throw Uptane::DelegationMissing(delegate_role.ToString());
     }
+    delegation_raw.clear();
     try {
-      fetcher.fetchLatestRole(&delegation_meta, Uptane::kMaxImageTargetsSize, RepositoryType::Image(), delegate_role,
+      fetcher.fetchLatestRole(&delegation_raw, Uptane::kMaxImageTargetsSize, RepositoryType::Image(), delegate_role,
                               flow_control);
     } catch (const std::exception &e) {
       LOG_ERROR << "Fetch role error: " << e.what();
       throw Uptane::DelegationMissing(delegate_role.ToString());
     }
+    delegation_meta = std_::make_unique<ParsedMetadata>(std::move(delegation_raw));
   }
 
   try {
-    image_repo.verifyRoleHashes(delegation_meta, delegate_role, false);
+    image_repo.verifyRoleHashes(*delegation_meta, delegate_role, false);
   } catch (const std::exception &e) {
     LOG_ERROR << "Role hashes error: " << e.what();
     throw Uptane::DelegationHashMismatch(delegate_role.ToString());
   }
 
-  auto delegation = ImageRepository::verifyDelegation(delegation_meta, delegate_role, parent_targets);
+  auto delegation = ImageRepository::verifyDelegation(*delegation_meta, delegate_role, parent_targets);
   if (delegation == nullptr) {
     throw SecurityException("image", "Delegation verification failed");
   }
@@ -53,7 +60,7 @@ Targets getTrustedDelegation(const Role &delegate_role, const Targets &parent_ta
     if (delegation->version() != version_in_snapshot) {
       throw VersionMismatch("image", delegate_role.ToString());
     }
-    storage.storeDelegation(delegation_meta, delegate_role);
+    storage.storeDelegation(delegation_meta->raw(), delegate_role);
   }
 
   return *delegation;
@@ -12,6 +12,9 @@ MetaWithKeys::MetaWithKeys(const Json::Value &json) : BaseMeta(json) {}
 MetaWithKeys::MetaWithKeys(RepositoryType repo, const Role &role, const Json::Value &json,
                            const std::shared_ptr<MetaWithKeys> &signer)
     : BaseMeta(repo, role, json, signer) {}
+MetaWithKeys::MetaWithKeys(RepositoryType repo, const Role &role, const ParsedMetadata &meta,
+                           const std::shared_ptr<MetaWithKeys> &signer)
+    : BaseMeta(repo, role, meta, signer) {}
 
 void Uptane::MetaWithKeys::ParseKeys(const RepositoryType repo, const Json::Value &keys) {
   for (auto it = keys.begin(); it != keys.end(); ++it) {
@@ -61,6 +64,11 @@ void Uptane::MetaWithKeys::ParseRole(const RepositoryType repo, const Json::Valu
 
 void Uptane::MetaWithKeys::UnpackSignedObject(const RepositoryType repo, const Role &role,
                                               const Json::Value &signed_object) {
+  UnpackSignedObject(repo, role, signed_object, Utils::jsonToCanonicalStr(signed_object["signed"]));
+}
+
+void Uptane::MetaWithKeys::UnpackSignedObject(const RepositoryType repo, const Role &role,
+                                              const Json::Value &signed_object, const std::string &canonical) {
   const std::string repository = repo;
 
   const Uptane::Role type(signed_object["signed"]["_type"].asString());
@@ -75,7 +83,6 @@ void Uptane::MetaWithKeys::UnpackSignedObject(const RepositoryType repo, const R
                             "Metadata type " + type.ToString() + " does not match expected role " + role.ToString());
   }
 
-  const std::string canonical = Utils::jsonToCanonicalStr(signed_object["signed"]);
   // NOLINTNEXTLINE(performance-unnecessary-copy-initialization)
   const Json::Value signatures = signed_object["signatures"];
   int valid_signatures = 0;
@@ -1,12 +1,14 @@
 #include "logging/logging.h"
 #include "uptane/exceptions.h"
 #include "uptane/tuf.h"
+#include "utilities/utils.h"
 
 using Uptane::Root;
 
 Root::Root(const RepositoryType repo, const Json::Value &json, Root &root) : Root(repo, json) {
-  root.UnpackSignedObject(repo, Role::Root(), json);
-  this->Root::UnpackSignedObject(repo, Role::Root(), json);
+  const std::string canonical = Utils::jsonToCanonicalStr(json["signed"]);
+  root.UnpackSignedObject(repo, Role::Root(), json, canonical);
+  this->Root::UnpackSignedObject(repo, Role::Root(), json, canonical);
 }
 
 Root::Root(const RepositoryType repo, const Json::Value &json) : MetaWithKeys(json), policy_(Policy::kCheck) {
@@ -26,7 +28,8 @@ Root::Root(const RepositoryType repo, const Json::Value &json) : MetaWithKeys(js
   }
 }
 
-void Uptane::Root::UnpackSignedObject(const RepositoryType repo, const Role &role, const Json::Value &signed_object) {
+void Uptane::Root::UnpackSignedObject(const RepositoryType repo, const Role &role, const Json::Value &signed_object,
+                                      const std::string &canonical_signed) {
   const std::string repository = repo;
 
   if (policy_ == Policy::kAcceptAll) {
@@ -37,5 +40,5 @@ void Uptane::Root::UnpackSignedObject(const RepositoryType repo, const Role &rol
   }
   assert(policy_ == Policy::kCheck);
 
-  Uptane::MetaWithKeys::UnpackSignedObject(repo, role, signed_object);
+  Uptane::MetaWithKeys::UnpackSignedObject(repo, role, signed_object, canonical_signed);
 }
@@ -1,5 +1,6 @@
 #include "uptane/tuf.h"
 
+#include <fnmatch.h>
 #include <ctime>
 #include <ostream>
 #include <sstream>
@@ -314,6 +315,17 @@ Uptane::BaseMeta::BaseMeta(RepositoryType repo, const Role &role, const Json::Va
   init(json);
 }
 
+Uptane::BaseMeta::BaseMeta(RepositoryType repo, const Role &role, const ParsedMetadata &meta,
+                           const std::shared_ptr<MetaWithKeys> &signer) {
+  if (!meta.json().isObject() || !meta.json().isMember("signed")) {
+    throw Uptane::InvalidMetadata("", "", "invalid metadata json");
+  }
+
+  signer->UnpackSignedObject(repo, role, meta.json(), meta.canonicalSigned());
+
+  init(meta.json());
+}
+
 std::string Uptane::BaseMeta::signature() const {
   if (!original_object_.isMember("signatures")) {
     throw Uptane::InvalidMetadata("", "", "invalid metadata json, missing signatures");
@@ -341,9 +353,11 @@ void Uptane::Targets::init(const Json::Value &json) {
   }
 
   const Json::Value target_list = json["signed"]["targets"];
+  targets.reserve(target_list.size());
+  target_index_.reserve(target_list.size());
   for (auto t_it = target_list.begin(); t_it != target_list.end(); t_it++) {
-    Target t(t_it.key().asString(), *t_it);
-    targets.push_back(t);
+    target_index_.emplace(t_it.key().asString(), targets.size());
+    targets.emplace_back(t_it.key().asString(), *t_it);
   }
 
   if (json["signed"]["delegations"].isObject()) {
@@ -362,6 +376,7 @@ void Uptane::Targets::init(const Json::Value &json) {
       for (auto p_it = paths_list.begin(); p_it != paths_list.end(); p_it++) {
         paths.emplace_back((*p_it).asString());
       }
+      path_matchers_[role] = DelegationPathMatcher(paths);
       paths_for_role_[role] = paths;
 
       terminating_role_[role] = (*it)["terminating"].asBool();
@@ -375,6 +390,52 @@ void Uptane::Targets::init(const Json::Value &json) {
   }
 }
 
+const Uptane::Target *Uptane::Targets::findTarget(const Uptane::Target &queried) const {
+  const auto it = target_index_.find(queried.filename());
+  if (it == target_index_.end() || !targets[it->second].MatchTarget(queried)) {
+    return nullptr;
+  }
+  return &targets[it->second];
+}
+
+bool Uptane::Targets::matchesDelegationPaths(const Role &role, const std::string &filename) const {
+  const auto it = path_matchers_.find(role);
+  return it != path_matchers_.end() && it->second.matches(filename);
+}
+
+Uptane::DelegationPathMatcher::DelegationPathMatcher(const std::vector<std::string> &patterns) {
+  for (const auto &pattern : patterns) {
+    const auto special = pattern.find_first_of("*?[\\");
+    if (special == std::string::npos) {
+      exact_.insert(pattern);
+    } else if (pattern == "*") {
+      match_all_ = true;
+    } else if (special == pattern.size() - 1 && pattern.back() == '*') {
+      // Without FNM_PATHNAME a trailing '*' also matches '/'.
+      prefixes_.push_back(pattern.substr(0, special));
+    } else {
+      globs_.push_back(pattern);
+    }
+  }
+}
+
+bool Uptane::DelegationPathMatcher::matches(const std::string &filename) const {
+  if (match_all_ || exact_.count(filename) != 0) {
+    return true;
+  }
+  for (const auto &prefix : prefixes_) {
+    if (filename.compare(0, prefix.size(), prefix) == 0) {
+      return true;
+    }
+  }
+  for (const auto &glob : globs_) {
+    if (fnmatch(glob.c_str(), filename.c_str(), 0) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
 Uptane::Targets::Targets(const Json::Value &json) : MetaWithKeys(json) { init(json); }
 
 Uptane::Targets::Targets(RepositoryType repo, const Role &role, const Json::Value &json,
@@ -383,6 +444,12 @@ Uptane::Targets::Targets(RepositoryType repo, const Role &role, const Json::Valu
   init(json);
 }
 
+Uptane::Targets::Targets(RepositoryType repo, const Role &role, const ParsedMetadata &meta,
+                         const std::shared_ptr<MetaWithKeys> &signer)
+    : MetaWithKeys(repo, role, meta, signer), name_(role.ToString()) {
+  init(meta.json());
+}
+
 void Uptane::TimestampMeta::init(const Json::Value &json) {
   Json::Value hashes_list = json["signed"]["meta"]["snapshot.json"]["hashes"];
   Json::Value meta_size = json["signed"]["meta"]["snapshot.json"]["length"];
@@ -456,6 +523,11 @@ Uptane::Snapshot::Snapshot(RepositoryType repo, const Json::Value &json, const s
   init(json);
 }
 
+Uptane::Snapshot::Snapshot(RepositoryType repo, const ParsedMetadata &meta, const std::shared_ptr<MetaWithKeys> &signer)
+    : BaseMeta(repo, Role::Snapshot(), meta, signer) {
+  init(meta.json());
+}
+
 std::vector<Hash> Uptane::Snapshot::role_hashes(const Uptane::Role &role) const {
   auto hashes = role_hashes_.find(role);
   if (hashes == role_hashes_.end()) {
@@ -483,6 +555,39 @@ int Uptane::Snapshot::role_version(const Uptane::Role &role) const {
   }
 };
 
+Uptane::ParsedMetadata::ParsedMetadata(std::string raw) : raw_(std::move(raw)), json_(Utils::parseJSON(raw_)) {}
+
+int Uptane::ParsedMetadata::versionUntrusted() const {
+  const Json::Value &version_json = json_["signed"]["version"];
+  if (!version_json.isIntegral()) {
+    return -1;
+  } else {
+    return version_json.asInt();
+  }
+}
+
+const std::string &Uptane::ParsedMetadata::canonical() const {
+  if (canonical_.empty()) {
+    canonical_ = Utils::jsonToCanonicalStr(json_);
+  }
+  return canonical_;
+}
+
+const std::string &Uptane::ParsedMetadata::canonicalSigned() const {
+  if (canonical_signed_.empty()) {
+    canonical_signed_ = Utils::jsonToCanonicalStr(json_["signed"]);
+  }
+  return canonical_signed_;
+}
+
+Hash Uptane::ParsedMetadata::hash(Hash::Type type) const {
+  auto it = hashes_.find(type);
+  if (it == hashes_.end()) {
+    it = hashes_.emplace(type, Hash::generate(type, canonical())).first;
+  }
+  return it->second;
+}
+
 int Uptane::extractVersionUntrusted(const std::string &meta) {
   auto version_json = Utils::parseJSON(meta)["signed"]["version"];
   if (!version_json.isIntegral()) {
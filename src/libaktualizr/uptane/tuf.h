@@ -9,6 +9,8 @@
 #include <map>
 #include <ostream>
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "libaktualizr/types.h"
@@ -139,6 +141,34 @@ class Version {
 
 std::ostream &operator<<(std::ostream &os, const Version &v);
 
+/**
+ * Raw metadata that is parsed once. The canonical serializations and their
+ * hashes are computed on first use, so that the hash checks, the signature
+ * checks and storing the metadata all work on the same data.
+ */
+class ParsedMetadata {
+ public:
+  explicit ParsedMetadata(std::string raw);
+
+  const std::string &raw() const { return raw_; }
+  const Json::Value &json() const { return json_; }
+  /** The version claimed by the metadata, not verified. Negative if missing. */
+  int versionUntrusted() const;
+  /** Canonical form of the whole object, as covered by the Snapshot and Timestamp hashes. */
+  const std::string &canonical() const;
+  /** Canonical form of the 'signed' portion, as covered by the signatures. */
+  const std::string &canonicalSigned() const;
+  /** Hash of canonical() */
+  Hash hash(Hash::Type type) const;
+
+ private:
+  std::string raw_;
+  Json::Value json_;
+  mutable std::string canonical_;
+  mutable std::string canonical_signed_;
+  mutable std::map<Hash::Type, Hash> hashes_;
+};
+
 /* Metadata objects */
 class MetaWithKeys;
 class BaseMeta {
@@ -146,6 +176,8 @@ class BaseMeta {
   BaseMeta() = default;
   explicit BaseMeta(const Json::Value &json);
   BaseMeta(RepositoryType repo, const Role &role, const Json::Value &json, const std::shared_ptr<MetaWithKeys> &signer);
+  BaseMeta(RepositoryType repo, const Role &role, const ParsedMetadata &meta,
+           const std::shared_ptr<MetaWithKeys> &signer);
   int version() const { return version_; }
   TimeStamp expiry() const { return expiry_; }
   bool isExpired(const TimeStamp &now) const { return expiry_.IsExpiredAt(now); }
@@ -184,6 +216,8 @@ class MetaWithKeys : public BaseMeta {
   explicit MetaWithKeys(const Json::Value &json);
   MetaWithKeys(RepositoryType repo, const Role &role, const Json::Value &json,
                const std::shared_ptr<MetaWithKeys> &signer);
+  MetaWithKeys(RepositoryType repo, const Role &role, const ParsedMetadata &meta,
+               const std::shared_ptr<MetaWithKeys> &signer);
 
   virtual ~MetaWithKeys() = default;
   MetaWithKeys(const MetaWithKeys &guard) = default;
@@ -208,7 +242,13 @@ class MetaWithKeys : public BaseMeta {
    * @param signed_object
    * @return
    */
-  virtual void UnpackSignedObject(RepositoryType repo, const Role &role, const Json::Value &signed_object);
+  void UnpackSignedObject(RepositoryType repo, const Role &role, const Json::Value &signed_object);
+  /**
+   * Same as above, with the canonical form of the 'signed' portion already
+   * computed by the caller.
+   */
+  virtual void UnpackSignedObject(RepositoryType repo, const Role &role, const Json::Value &signed_object,
+                                  const std::string &canonical_signed);
 
   bool operator==(const MetaWithKeys &rhs) const {
     return version_ == rhs.version_ && expiry_ == rhs.expiry_ && keys_ == rhs.keys_ &&
@@ -257,7 +297,9 @@ class Root : public MetaWithKeys {
    * @param signed_object
    * @return
    */
-  void UnpackSignedObject(RepositoryType repo, const Role &role, const Json::Value &signed_object) override;
+  using MetaWithKeys::UnpackSignedObject;
+  void UnpackSignedObject(RepositoryType repo, const Role &role, const Json::Value &signed_object,
+                          const std::string &canonical_signed) override;
 
   bool operator==(const Root &rhs) const {
     return version_ == rhs.version_ && expiry_ == rhs.expiry_ && keys_ == rhs.keys_ &&
@@ -281,11 +323,31 @@ static bool MatchTargetVector(const std::vector<Uptane::Target> &v1, const std::
   return true;
 }
 
+/**
+ * The path patterns of a delegated role, sorted by kind so that exact names,
+ * prefixes (a single trailing '*') and "*" are matched without calling
+ * fnmatch.
+ */
+class DelegationPathMatcher {
+ public:
+  DelegationPathMatcher() = default;
+  explicit DelegationPathMatcher(const std::vector<std::string> &patterns);
+  bool matches(const std::string &filename) const;
+
+ private:
+  bool match_all_{false};
+  std::unordered_set<std::string> exact_;
+  std::vector<std::string> prefixes_;
+  std::vector<std::string> globs_;
+};
+
 // Also used for delegated targets.
 class Targets : public MetaWithKeys {
  public:
   explicit Targets(const Json::Value &json);
   Targets(RepositoryType repo, const Role &role, const Json::Value &json, const std::shared_ptr<MetaWithKeys> &signer);
+  Targets(RepositoryType repo, const Role &role, const ParsedMetadata &meta,
+          const std::shared_ptr<MetaWithKeys> &signer);
   Targets() = default;
 
   bool operator==(const Targets &rhs) const {
@@ -306,8 +368,19 @@ class Targets : public MetaWithKeys {
     delegated_role_names_.clear();
     paths_for_role_.clear();
     terminating_role_.clear();
+    target_index_.clear();
+    path_matchers_.clear();
   }
 
+  /**
+   * Look up a target by its filename and return it if it matches the queried
+   * one (see Target::MatchTarget).
+   * @return the matching target or nullptr
+   */
+  const Uptane::Target *findTarget(const Uptane::Target &queried) const;
+  /** Whether the filename matches one of the path patterns of a delegated role. */
+  bool matchesDelegationPaths(const Role &role, const std::string &filename) const;
+
   // Only makes sense for Targets from the Director repo; the Image repo doesn't
   // specify ECU serials.
   std::vector<Uptane::Target> getTargets(const Uptane::EcuSerial &ecu_id,
@@ -336,6 +409,9 @@ class Targets : public MetaWithKeys {
 
   std::string name_;
   std::string correlation_id_;  // custom non-tuf
+  // Built once on initialization.
+  std::unordered_map<std::string, size_t> target_index_;  // filename -> position in targets
+  std::map<Role, DelegationPathMatcher> path_matchers_;
 };
 
 class TimestampMeta : public BaseMeta {
@@ -359,6 +435,7 @@ class Snapshot : public BaseMeta {
  public:
   explicit Snapshot(const Json::Value &json);
   Snapshot(RepositoryType repo, const Json::Value &json, const std::shared_ptr<MetaWithKeys> &signer);
+  Snapshot(RepositoryType repo, const ParsedMetadata &meta, const std::shared_ptr<MetaWithKeys> &signer);
   Snapshot() = default;
   std::vector<Hash> role_hashes(const Uptane::Role &role) const;
   int64_t role_size(const Uptane::Role &role) const;
@@ -1,12 +1,15 @@
 #include <gtest/gtest.h>
 
+#include <chrono>
 #include <map>
 #include <vector>
 
 #include <json/json.h>
 
+#include "crypto/crypto.h"
 #include "logging/logging.h"
 #include "uptane/exceptions.h"
+#include "uptane/imagerepository.h"
 #include "uptane/tuf.h"
 #include "utilities/utils.h"
 
@@ -283,6 +286,272 @@ TEST(Target, HashMismatch) {
   EXPECT_FALSE(target2.MatchTarget(target1));
 }
 
+// Delegating Targets metadata with `num_keys` keys, and delegated metadata
+// with `num_targets` targets signed by all of them.
+struct SignedDelegation {
+  std::shared_ptr<Uptane::Targets> signer;
+  Json::Value delegated;
+  std::string canonical;
+  std::vector<std::string> public_keys;
+};
+
+static SignedDelegation makeSignedDelegation(const std::string& name, KeyType key_type, int num_keys,
+                                             int num_targets) {
+  SignedDelegation result;
+  Json::Value role;
+  role["name"] = name;
+  role["threshold"] = num_keys;
+  role["paths"].append("*");
+  role["terminating"] = false;
+  Json::Value parent;
+  parent["signed"]["_type"] = "Targets";
+  parent["signed"]["version"] = 1;
+  parent["signed"]["expires"] = "2038-01-19T03:14:06Z";
+  parent["signed"]["targets"] = Json::objectValue;
+
+  std::vector<std::string> private_keys;
+  for (int i = 0; i < num_keys; ++i) {
+    std::string public_key;
+    std::string private_key;
+    EXPECT_TRUE(Crypto::generateRSAKeyPair(key_type, &public_key, &private_key));
+    const PublicKey key(public_key, key_type);
+    parent["signed"]["delegations"]["keys"][key.KeyId()] = key.ToUptane();
+    role["keyids"].append(key.KeyId());
+    result.public_keys.push_back(public_key);
+    private_keys.push_back(private_key);
+  }
+  parent["signed"]["delegations"]["roles"].append(role);
+  result.signer = std::make_shared<Uptane::Targets>(parent);
+
+  result.delegated["signed"]["_type"] = "Targets";
+  result.delegated["signed"]["version"] = 1;
+  result.delegated["signed"]["expires"] = "2038-01-19T03:14:06Z";
+  for (int i = 0; i < num_targets; ++i) {
+    const std::string target_name = "target-" + std::to_string(i);
+    result.delegated["signed"]["targets"][target_name] = generateTarget(Crypto::sha256digestHex(target_name), i);
+  }
+  result.canonical = Utils::jsonToCanonicalStr(result.delegated["signed"]);
+  for (int i = 0; i < num_keys; ++i) {
+    Json::Value signature;
+    signature["keyid"] = role["keyids"][i];
+    signature["method"] = "rsassa-pss";
+    signature["sig"] = Utils::toBase64(Crypto::RSAPSSSign(nullptr, private_keys[i], result.canonical));
+    result.delegated["signatures"].append(signature);
+  }
+  return result;
+}
+
+/* Delegated metadata is verified with the keys of the delegating metadata as
+ * often as needed, and by copies of those keys. */
+TEST(Targets, VerifyManySignatures) {
+  const int num_keys = 4;
+  const int num_targets = 100;
+  const int iterations = 5;
+  auto delegation = makeSignedDelegation("many-signatures", KeyType::kRSA2048, num_keys, num_targets);
+
+  for (int i = 0; i < iterations; ++i) {
+    Uptane::Targets targets(Uptane::RepositoryType::Image(), Uptane::Role::Delegation("many-signatures"),
+                            delegation.delegated, delegation.signer);
+    EXPECT_EQ(targets.targets.size(), static_cast<size_t>(num_targets));
+  }
+
+  const PublicKey key(delegation.public_keys[0], KeyType::kRSA2048);
+  const std::string signature = delegation.delegated["signatures"][0]["sig"].asString();
+  for (int i = 0; i < iterations; ++i) {
+    const PublicKey copy = key;
+    EXPECT_TRUE(copy.VerifySignature(signature, delegation.canonical));
+    EXPECT_FALSE(copy.VerifySignature(signature, delegation.canonical + " "));
+  }
+  EXPECT_TRUE(Crypto::RSAPSSVerify(delegation.public_keys[0], Utils::fromBase64(signature), delegation.canonical));
+
+  // A key that does not match its signature is still rejected.
+  delegation.delegated["signatures"][num_keys - 1]["sig"] = signature;
+  EXPECT_THROW(Uptane::Targets(Uptane::RepositoryType::Image(), Uptane::Role::Delegation("many-signatures"),
+                               delegation.delegated, delegation.signer),
+               Uptane::Exception);
+}
+
+/* Verify a large delegated targets metadata signed with many RSA-4096 keys,
+ * and compare single signature checks with keys parsed once and keys parsed
+ * for every check. The figures are only logged. */
+TEST(Targets, DISABLED_BenchmarkVerifyManySignatures) {
+  const int num_keys = 8;
+  const int num_targets = 5000;
+  const int iterations = 5;
+  const auto delegation = makeSignedDelegation("benchmark", KeyType::kRSA4096, num_keys, num_targets);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    Uptane::Targets targets(Uptane::RepositoryType::Image(), Uptane::Role::Delegation("benchmark"),
+                            delegation.delegated, delegation.signer);
+    EXPECT_EQ(targets.targets.size(), static_cast<size_t>(num_targets));
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+  LOG_INFO << "Verified " << num_targets << " targets with " << num_keys << " signatures in "
+           << elapsed.count() / iterations / 1000.0 << " ms";
+
+  const PublicKey key(delegation.public_keys[0], KeyType::kRSA4096);
+  const std::string signature = delegation.delegated["signatures"][0]["sig"].asString();
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations * num_keys; ++i) {
+    EXPECT_TRUE(key.VerifySignature(signature, delegation.canonical));
+  }
+  const auto parsed_once =
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations * num_keys; ++i) {
+    EXPECT_TRUE(Crypto::RSAPSSVerify(delegation.public_keys[0], Utils::fromBase64(signature), delegation.canonical));
+  }
+  const auto parsed_each =
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+  LOG_INFO << "Single signature check: " << parsed_once.count() / (iterations * num_keys)
+           << " us with the key parsed once, " << parsed_each.count() / (iterations * num_keys)
+           << " us with the key parsed every time";
+}
+
+Json::Value signMetadata(const Json::Value& signed_part, const std::string& private_key, const std::string& keyid) {
+  Json::Value meta;
+  meta["signed"] = signed_part;
+  Json::Value signature;
+  signature["keyid"] = keyid;
+  signature["method"] = "rsassa-pss";
+  signature["sig"] = Utils::toBase64(Crypto::RSAPSSSign(nullptr, private_key, Utils::jsonToCanonicalStr(signed_part)));
+  meta["signatures"].append(signature);
+  return meta;
+}
+
+// Signed metadata of an Image repository with `num_targets` targets, all
+// signed by one RSA key.
+struct SignedImageRepo {
+  std::string private_key;
+  std::string keyid;
+  Json::Value targets;
+  std::string root_raw;
+  std::string timestamp_raw;
+  std::string snapshot_raw;
+  std::string targets_raw;
+};
+
+static SignedImageRepo makeSignedImageRepo(int num_targets) {
+  const std::string expires = "2038-01-19T03:14:06Z";
+  SignedImageRepo result;
+
+  std::string public_key;
+  EXPECT_TRUE(Crypto::generateRSAKeyPair(KeyType::kRSA2048, &public_key, &result.private_key));
+  const PublicKey key(public_key, KeyType::kRSA2048);
+  result.keyid = key.KeyId();
+
+  Json::Value root;
+  root["_type"] = "Root";
+  root["version"] = 1;
+  root["expires"] = expires;
+  root["keys"][result.keyid] = key.ToUptane();
+  for (const auto& role : {"root", "snapshot", "targets", "timestamp"}) {
+    root["roles"][role]["keyids"].append(result.keyid);
+    root["roles"][role]["threshold"] = 1;
+  }
+  result.root_raw = Utils::jsonToCanonicalStr(signMetadata(root, result.private_key, result.keyid));
+
+  result.targets["_type"] = "Targets";
+  result.targets["version"] = 1;
+  result.targets["expires"] = expires;
+  for (int i = 0; i < num_targets; ++i) {
+    const std::string name = "target-" + std::to_string(i);
+    result.targets["targets"][name] =
+        generateImageTarget(Crypto::sha256digestHex(name), i, {Uptane::HardwareIdentifier("hw")});
+  }
+  result.targets_raw = Utils::jsonToCanonicalStr(signMetadata(result.targets, result.private_key, result.keyid));
+
+  Json::Value snapshot;
+  snapshot["_type"] = "Snapshot";
+  snapshot["version"] = 1;
+  snapshot["expires"] = expires;
+  snapshot["meta"]["targets.json"]["version"] = 1;
+  snapshot["meta"]["targets.json"]["hashes"]["sha256"] = Crypto::sha256digestHex(result.targets_raw);
+  result.snapshot_raw = Utils::jsonToCanonicalStr(signMetadata(snapshot, result.private_key, result.keyid));
+
+  Json::Value timestamp;
+  timestamp["_type"] = "Timestamp";
+  timestamp["version"] = 1;
+  timestamp["expires"] = expires;
+  timestamp["meta"]["snapshot.json"]["version"] = 1;
+  timestamp["meta"]["snapshot.json"]["length"] = static_cast<Json::UInt64>(result.snapshot_raw.size());
+  timestamp["meta"]["snapshot.json"]["hashes"]["sha256"] = Crypto::sha256digestHex(result.snapshot_raw);
+  result.timestamp_raw = Utils::jsonToCanonicalStr(signMetadata(timestamp, result.private_key, result.keyid));
+  return result;
+}
+
+/* The serializations and hashes of parsed metadata match those computed from
+ * the raw metadata. */
+TEST(ParsedMetadata, Serializations) {
+  const auto signed_repo = makeSignedImageRepo(10);
+  const Uptane::ParsedMetadata meta(signed_repo.targets_raw);
+  const Json::Value json = Utils::parseJSON(signed_repo.targets_raw);
+
+  EXPECT_EQ(meta.raw(), signed_repo.targets_raw);
+  EXPECT_EQ(meta.versionUntrusted(), 1);
+  EXPECT_EQ(meta.canonical(), Utils::jsonToCanonicalStr(json));
+  EXPECT_EQ(meta.canonicalSigned(), Utils::jsonToCanonicalStr(json["signed"]));
+  EXPECT_EQ(meta.hash(Hash::Type::kSha256), Hash::generate(Hash::Type::kSha256, Utils::jsonToCanonicalStr(json)));
+  EXPECT_EQ(meta.hash(Hash::Type::kSha512), Hash::generate(Hash::Type::kSha512, Utils::jsonToCanonicalStr(json)));
+}
+
+/* The same parsed Snapshot and Targets metadata can be verified repeatedly,
+ * and Targets not matching the Snapshot hash are still rejected. */
+TEST(ImageRepository, VerifyParsedMetadata) {
+  const int num_targets = 1000;
+  auto signed_repo = makeSignedImageRepo(num_targets);
+
+  Uptane::ImageRepository repo;
+  repo.initRoot(Uptane::RepositoryType::Image(), signed_repo.root_raw);
+  repo.verifyTimestamp(signed_repo.timestamp_raw);
+
+  const Uptane::ParsedMetadata snapshot_meta(signed_repo.snapshot_raw);
+  const Uptane::ParsedMetadata targets_meta(signed_repo.targets_raw);
+  for (int i = 0; i < 2; ++i) {
+    repo.verifySnapshot(snapshot_meta, false);
+    repo.verifyTargets(targets_meta, false);
+    ASSERT_NE(repo.getTargets(), nullptr);
+    EXPECT_EQ(repo.getTargets()->targets.size(), static_cast<size_t>(num_targets));
+  }
+
+  signed_repo.targets["version"] = 2;
+  const Uptane::ParsedMetadata changed_meta(
+      Utils::jsonToCanonicalStr(signMetadata(signed_repo.targets, signed_repo.private_key, signed_repo.keyid)));
+  EXPECT_THROW(repo.verifyTargets(changed_meta, false), Uptane::Exception);
+}
+
+/* Verify the Snapshot and Targets metadata of a synthetic Image repository
+ * with 10k targets. The figures are only logged. */
+TEST(ImageRepository, DISABLED_BenchmarkVerifyLargeRepo) {
+  const int num_targets = 10000;
+  const int iterations = 5;
+  const auto signed_repo = makeSignedImageRepo(num_targets);
+
+  Uptane::ImageRepository repo;
+  repo.initRoot(Uptane::RepositoryType::Image(), signed_repo.root_raw);
+  repo.verifyTimestamp(signed_repo.timestamp_raw);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    repo.verifySnapshot(Uptane::ParsedMetadata(signed_repo.snapshot_raw), false);
+    repo.verifyTargets(Uptane::ParsedMetadata(signed_repo.targets_raw), false);
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+  ASSERT_NE(repo.getTargets(), nullptr);
+  EXPECT_EQ(repo.getTargets()->targets.size(), static_cast<size_t>(num_targets));
+
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    Utils::jsonToCanonicalStr(Utils::parseJSON(signed_repo.targets_raw));
+  }
+  const auto single_pass =
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+  LOG_INFO << "Verified " << num_targets << " targets (" << signed_repo.targets_raw.size() << " bytes) in "
+           << elapsed.count() / iterations / 1000.0 << " ms, a single parse and canonicalization pass takes "
+           << single_pass.count() / iterations / 1000.0 << " ms";
+}
+
 #ifndef __NO_MAIN__
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
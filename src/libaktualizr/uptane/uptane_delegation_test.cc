@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <chrono>
 #include <string>
 
 #include <boost/filesystem.hpp>
@@ -9,7 +11,9 @@
 #include "libaktualizr/config.h"
 #include "libaktualizr/events.h"
 
+#include "crypto/crypto.h"
 #include "httpfake.h"
+#include "uptane/tuf.h"
 #include "uptane_test_common.h"
 
 boost::filesystem::path uptane_generator_path;
@@ -237,6 +241,112 @@ TEST(Delegation, IterateAll) {
   EXPECT_TRUE(expected_target_names.empty());
 }
 
+// Targets metadata with `num_targets` targets spread over `num_delegations`
+// directories, each delegated by a prefix pattern and an exact name.
+static Json::Value makeLookupTargets(int num_targets, int num_delegations) {
+  Json::Value json;
+  json["signed"]["_type"] = "Targets";
+  json["signed"]["version"] = 1;
+  json["signed"]["expires"] = "2038-01-19T03:14:06Z";
+  for (int i = 0; i < num_targets; ++i) {
+    Json::Value target;
+    target["hashes"]["sha256"] = Crypto::sha256digestHex(std::to_string(i));
+    target["length"] = i;
+    target["custom"]["hardwareIds"].append("hw");
+    json["signed"]["targets"]["dir" + std::to_string(i % num_delegations) + "/target-" + std::to_string(i)] = target;
+  }
+  for (int i = 0; i < num_delegations; ++i) {
+    Json::Value role;
+    role["name"] = "role" + std::to_string(i);
+    role["keyids"] = Json::arrayValue;
+    role["threshold"] = 1;
+    role["terminating"] = false;
+    role["paths"].append("dir" + std::to_string(i) + "/*");
+    role["paths"].append("exact-" + std::to_string(i));
+    json["signed"]["delegations"]["roles"].append(role);
+  }
+  json["signed"]["delegations"]["keys"] = Json::objectValue;
+  return json;
+}
+
+/* Every target of Targets metadata of growing size is found through the
+ * filename index, and matches the paths of exactly one of many delegations,
+ * given either as a prefix pattern or as an exact name. */
+TEST(Delegation, LookupScaling) {
+  const int num_delegations = 100;
+  for (const int num_targets : {1000, 10000}) {
+    const Uptane::Targets targets(makeLookupTargets(num_targets, num_delegations));
+    ASSERT_EQ(targets.targets.size(), static_cast<size_t>(num_targets));
+
+    for (const auto& target : targets.targets) {
+      const Uptane::Target* found = targets.findTarget(target);
+      ASSERT_NE(found, nullptr);
+      EXPECT_EQ(found->filename(), target.filename());
+
+      size_t matched = 0;
+      for (const auto& role_name : targets.delegated_role_names_) {
+        if (targets.matchesDelegationPaths(Uptane::Role::Delegation(role_name), target.filename())) {
+          ++matched;
+        }
+      }
+      EXPECT_EQ(matched, 1U);
+    }
+
+    for (int i = 0; i < num_delegations; ++i) {
+      const auto role = Uptane::Role::Delegation("role" + std::to_string(i));
+      EXPECT_TRUE(targets.matchesDelegationPaths(role, "exact-" + std::to_string(i)));
+      EXPECT_FALSE(targets.matchesDelegationPaths(role, "exact-" + std::to_string(i) + "-suffix"));
+    }
+  }
+}
+
+/* Look up every target of Targets metadata of growing size, directly and
+ * through delegation path patterns. The lookup time per target should stay
+ * flat; the figures are only logged. */
+TEST(Delegation, DISABLED_BenchmarkLookupScaling) {
+  const int num_delegations = 100;
+  for (const int num_targets : {1000, 10000, 50000}) {
+    const Uptane::Targets targets(makeLookupTargets(num_targets, num_delegations));
+    ASSERT_EQ(targets.targets.size(), static_cast<size_t>(num_targets));
+
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& target : targets.targets) {
+      EXPECT_NE(targets.findTarget(target), nullptr);
+    }
+    const auto indexed =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+    // The previous linear search, on a sample to keep the run time bounded.
+    const int sample = 1000;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < sample; ++i) {
+      const auto& queried = targets.targets[static_cast<size_t>(i * (num_targets / sample))];
+      const auto it = std::find_if(targets.targets.cbegin(), targets.targets.cend(),
+                                   [&queried](const Uptane::Target& t) { return t.MatchTarget(queried); });
+      EXPECT_NE(it, targets.targets.cend());
+    }
+    const auto linear =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (const auto& target : targets.targets) {
+      size_t matched = 0;
+      for (const auto& role_name : targets.delegated_role_names_) {
+        if (targets.matchesDelegationPaths(Uptane::Role::Delegation(role_name), target.filename())) {
+          ++matched;
+        }
+      }
+      EXPECT_EQ(matched, 1U);
+    }
+    const auto delegation_match =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+    LOG_INFO << num_targets << " targets: indexed lookup " << indexed / num_targets << " ns, linear lookup "
+             << linear / sample << " ns, matching " << num_delegations << " delegations "
+             << delegation_match / num_targets << " ns per target";
+  }
+}
+
 #ifndef __NO_MAIN__
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
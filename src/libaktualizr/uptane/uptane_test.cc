@@ -4,10 +4,14 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <boost/filesystem.hpp>
@@ -668,6 +672,205 @@ TEST(Uptane, SendMetadataToSecondary) {
   EXPECT_TRUE(EcuInstallationStartedReportGot);
 }
 
+class SlowSecondaryMock : public SecondaryInterfaceMock {
+ public:
+  explicit SlowSecondaryMock(Primary::VirtualSecondaryConfig &sconfig_in) : SecondaryInterfaceMock(sconfig_in) {}
+  Uptane::Manifest getManifest() const override {
+    ++requests_;
+    const int running = ++running_;
+    max_running_ = std::max(max_running_.load(), running);
+    std::this_thread::sleep_for(delay_.load());
+    --running_;
+    return manifest_;
+  }
+
+  std::atomic<std::chrono::milliseconds> delay_{std::chrono::milliseconds(0)};
+  mutable std::atomic<int> requests_{0};
+  mutable std::atomic<int> running_{0};
+  mutable std::atomic<int> max_running_{0};
+};
+
+/* A Secondary that does not respond in time does not hold up the manifest;
+ * its last known manifest is sent instead. It is not asked again while the
+ * late request is still running, and that request is finished before the
+ * client is destroyed. */
+TEST(Uptane, AssembleManifestSlowSecondary) {
+  Config conf("tests/config/basic.toml");
+  TemporaryDirectory temp_dir;
+  auto http = std::make_shared<HttpFake>(temp_dir.Path(), "hasupdates");
+  conf.provision.primary_ecu_serial = "CA:FE:A6:D2:84:9D";
+  conf.provision.primary_ecu_hardware_id = "primary_hw";
+  conf.uptane.director_server = http->tls_server + "/director";
+  conf.uptane.repo_server = http->tls_server + "/repo";
+  conf.uptane.secondary_manifest_timeout_ms = 100;
+  conf.pacman.images_path = temp_dir.Path() / "images";
+  conf.storage.path = temp_dir.Path();
+  conf.tls.server = http->tls_server;
+
+  Primary::VirtualSecondaryConfig ecu_config;
+  ecu_config.partial_verifying = false;
+  ecu_config.full_client_dir = temp_dir.Path();
+  ecu_config.ecu_serial = "secondary_ecu_serial";
+  ecu_config.ecu_hardware_id = "secondary_hw";
+  ecu_config.ecu_private_key = "sec.priv";
+  ecu_config.ecu_public_key = "sec.pub";
+  ecu_config.firmware_path = temp_dir / "firmware.txt";
+  ecu_config.target_name_path = temp_dir / "firmware_name.txt";
+  ecu_config.metadata_path = temp_dir / "secondary_metadata";
+
+  auto sec = std::make_shared<SlowSecondaryMock>(ecu_config);
+  auto storage = INvStorage::newStorage(conf.storage);
+  auto up = std_::make_unique<UptaneTestCommon::TestUptaneClient>(conf, storage, http);
+  up->addSecondary(sec);
+  EXPECT_NO_THROW(up->initialize());
+
+  Json::Value manifest = up->AssembleManifest()["ecu_version_manifests"];
+  EXPECT_EQ(manifest["secondary_ecu_serial"], sec->manifest_);
+
+  sec->delay_ = std::chrono::milliseconds(1000);
+  const auto start = std::chrono::steady_clock::now();
+  manifest = up->AssembleManifest()["ecu_version_manifests"];
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(1000));
+  EXPECT_TRUE(manifest.isMember(conf.provision.primary_ecu_serial));
+  EXPECT_EQ(manifest["secondary_ecu_serial"], sec->manifest_);
+
+  manifest = up->AssembleManifest()["ecu_version_manifests"];
+  EXPECT_EQ(manifest["secondary_ecu_serial"], sec->manifest_);
+  EXPECT_EQ(sec->requests_, 2);
+
+  up.reset();
+  EXPECT_EQ(sec->running_, 0);
+  EXPECT_EQ(sec->max_running_, 1);
+}
+
+/* A Secondary that is still busy with a late manifest request is not sent
+ * anything else until that request is done. */
+TEST(Uptane, BusySecondaryIsUnavailable) {
+  Config conf("tests/config/basic.toml");
+  TemporaryDirectory temp_dir;
+  auto http = std::make_shared<HttpFake>(temp_dir.Path(), "hasupdates");
+  conf.provision.primary_ecu_serial = "CA:FE:A6:D2:84:9D";
+  conf.provision.primary_ecu_hardware_id = "primary_hw";
+  conf.uptane.director_server = http->tls_server + "/director";
+  conf.uptane.repo_server = http->tls_server + "/repo";
+  conf.uptane.secondary_manifest_timeout_ms = 100;
+  conf.uptane.secondary_preinstall_wait_sec = 1;
+  conf.pacman.images_path = temp_dir.Path() / "images";
+  conf.storage.path = temp_dir.Path();
+  conf.tls.server = http->tls_server;
+
+  Primary::VirtualSecondaryConfig ecu_config;
+  ecu_config.partial_verifying = false;
+  ecu_config.full_client_dir = temp_dir.Path();
+  ecu_config.ecu_serial = "secondary_ecu_serial";
+  ecu_config.ecu_hardware_id = "secondary_hw";
+  ecu_config.ecu_private_key = "sec.priv";
+  ecu_config.ecu_public_key = "sec.pub";
+  ecu_config.firmware_path = temp_dir / "firmware.txt";
+  ecu_config.target_name_path = temp_dir / "firmware_name.txt";
+  ecu_config.metadata_path = temp_dir / "secondary_metadata";
+
+  auto sec = std::make_shared<SlowSecondaryMock>(ecu_config);
+  auto storage = INvStorage::newStorage(conf.storage);
+  auto up = std_::make_unique<UptaneTestCommon::TestUptaneClient>(conf, storage, http);
+  up->addSecondary(sec);
+  EXPECT_NO_THROW(up->initialize());
+  result::UpdateCheck update_result = up->fetchMeta();
+  ASSERT_EQ(update_result.status, result::UpdateStatus::kUpdatesAvailable);
+
+  const Uptane::EcuSerial serial("secondary_ecu_serial");
+  sec->delay_ = std::chrono::milliseconds(3000);
+  up->AssembleManifest();
+  EXPECT_TRUE(up->secondaryBusy(serial));
+  EXPECT_FALSE(up->waitSecondariesReachable(update_result.updates));
+
+  EXPECT_CALL(*sec, putMetadataMock(::testing::_)).Times(0);
+  data::InstallationResult result;
+  std::string raw_report;
+  up->sendMetadataToEcus(update_result.updates, &result, &raw_report);
+  EXPECT_FALSE(result.isSuccess());
+  testing::Mock::VerifyAndClearExpectations(sec.get());
+
+  while (up->secondaryBusy(serial)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_TRUE(up->waitSecondariesReachable(update_result.updates));
+  EXPECT_CALL(*sec, putMetadataMock(::testing::_)).Times(1);
+  up->sendMetadataToEcus(update_result.updates, &result, &raw_report);
+  EXPECT_TRUE(result.isSuccess());
+  EXPECT_EQ(sec->max_running_, 1);
+}
+
+class ReadingSecondaryMock : public SecondaryInterfaceMock {
+ public:
+  explicit ReadingSecondaryMock(Primary::VirtualSecondaryConfig &sconfig_in) : SecondaryInterfaceMock(sconfig_in) {}
+  data::InstallationResult sendFirmware(const Uptane::Target &target, const api::FlowControlToken *) override {
+    auto image = secondary_provider_->openTargetFile(target, getSerial());
+    std::stringstream received;
+    received << image->rdbuf();
+    received_ = received.str();
+    return data::InstallationResult(data::ResultCode::Numeric::kOk, "");
+  }
+
+  std::string received_;
+};
+
+/* Images that only have a SHA512 hash are told apart when they are shared
+ * between Secondaries, and each Secondary gets its own. */
+TEST(Uptane, SendImagesSha512Only) {
+  Config conf("tests/config/basic.toml");
+  TemporaryDirectory temp_dir;
+  auto http = std::make_shared<HttpFake>(temp_dir.Path(), "noupdates");
+  conf.provision.primary_ecu_serial = "CA:FE:A6:D2:84:9D";
+  conf.provision.primary_ecu_hardware_id = "primary_hw";
+  conf.uptane.director_server = http->tls_server + "/director";
+  conf.uptane.repo_server = http->tls_server + "/repo";
+  conf.pacman.images_path = temp_dir.Path() / "images";
+  conf.storage.path = temp_dir.Path();
+  conf.tls.server = http->tls_server;
+
+  auto storage = INvStorage::newStorage(conf.storage);
+  auto up = std_::make_unique<UptaneTestCommon::TestUptaneClient>(conf, storage, http);
+  std::vector<std::shared_ptr<ReadingSecondaryMock>> secs;
+  for (int i = 0; i < 4; ++i) {
+    Primary::VirtualSecondaryConfig ecu_config;
+    ecu_config.partial_verifying = false;
+    ecu_config.full_client_dir = temp_dir.Path();
+    ecu_config.ecu_serial = "secondary_ecu_serial" + std::to_string(i);
+    ecu_config.ecu_hardware_id = "secondary_hw";
+    secs.push_back(std::make_shared<ReadingSecondaryMock>(ecu_config));
+    up->addSecondary(secs.back());
+  }
+  EXPECT_NO_THROW(up->initialize());
+
+  // Two images of more than one chunk, each for two of the Secondaries.
+  std::vector<Uptane::Target> targets;
+  std::vector<std::string> images;
+  for (int i = 0; i < 2; ++i) {
+    images.emplace_back(300 * 1024, static_cast<char>('a' + i));
+    const Hash hash = Hash::generate(Hash::Type::kSha512, images.back());
+    boost::filesystem::create_directories(conf.pacman.images_path);
+    Utils::writeFile(conf.pacman.images_path / hash.HashString(), images.back());
+    const std::string name = "image" + std::to_string(i) + ".bin";
+    storage->storeTargetFilename(name, hash.HashString());
+
+    Uptane::EcuMap ecus;
+    ecus.emplace(secs[2 * i]->getSerial(), secs[2 * i]->getHwId());
+    ecus.emplace(secs[2 * i + 1]->getSerial(), secs[2 * i + 1]->getHwId());
+    targets.emplace_back(name, ecus, std::vector<Hash>{hash}, images.back().size());
+    EXPECT_TRUE(targets.back().sha256Hash().empty());
+  }
+
+  const auto reports = up->sendImagesToEcus(targets);
+  ASSERT_EQ(reports.size(), 4U);
+  for (const auto &report : reports) {
+    EXPECT_TRUE(report.install_res.isSuccess());
+  }
+  for (size_t i = 0; i < secs.size(); ++i) {
+    EXPECT_EQ(secs[i]->received_, images[i / 2]);
+  }
+}
+
 /* Register Secondary ECUs with Director. */
 TEST(Uptane, UptaneSecondaryAdd) {
   TemporaryDirectory temp_dir;
@@ -88,4 +88,37 @@ void RepositoryCommon::updateRoot(INvStorage& storage, const IMetadataFetcher& f
   }
 }
 
+void RepositoryCommon::fetchLatestRoleCached(INvStorage& storage, const IMetadataFetcher& fetcher,
+                                             const RepositoryType repo_type, const Role& role, const int64_t maxsize,
+                                             const std::function<void(const std::string&)>& verify,
+                                             const api::FlowControlToken* flow_control) {
+  CachedMeta cached;
+  HttpValidators validators;
+  if (storage.loadCachedMeta(&cached, repo_type, role)) {
+    validators.etag = cached.etag;
+    validators.last_modified = cached.last_modified;
+  }
+  const bool had_validators = !validators.empty();
+
+  std::string raw;
+  if (!fetcher.fetchLatestRoleIfModified(&raw, maxsize, repo_type, role, &validators, flow_control)) {
+    try {
+      verify(cached.data);
+      LOG_DEBUG << repo_type << " " << role << " metadata is unchanged";
+      return;
+    } catch (const Uptane::Exception& e) {
+      LOG_INFO << "Fetching " << repo_type << " " << role
+               << " metadata again because the cached copy is no longer valid: " << e.what();
+    }
+    validators = HttpValidators();
+    fetcher.fetchLatestRoleIfModified(&raw, maxsize, repo_type, role, &validators, flow_control);
+  }
+
+  verify(raw);
+  // A response without validators only needs to replace outdated ones.
+  if (!validators.empty() || had_validators) {
+    storage.storeCachedMeta({raw, validators.etag, validators.last_modified}, repo_type, role);
+  }
+}
+
 }  // namespace Uptane
@@ -2,6 +2,7 @@
 #define UPTANE_REPOSITORY_H_
 
 #include <cstdint>               // for int64_t
+#include <functional>            // for function
 #include <string>                // for string
 #include "libaktualizr/types.h"  // for TimeStamp
 #include "uptane/tuf.h"          // for Root, RepositoryType
@@ -37,6 +38,16 @@ class RepositoryCommon {
  protected:
   void resetRoot();
   void updateRoot(INvStorage &storage, const IMetadataFetcher &fetcher, RepositoryType repo_type);
+  /**
+   * Fetch the latest version of a non-Root role and pass it to `verify`, which
+   * throws if it is not acceptable. If a response for the role is cached, the
+   * request is conditional and an unchanged cached copy is passed instead. It
+   * is fetched again if it doesn't pass anymore. Responses that pass are cached.
+   */
+  static void fetchLatestRoleCached(INvStorage &storage, const IMetadataFetcher &fetcher, RepositoryType repo_type,
+                                    const Role &role, int64_t maxsize,
+                                    const std::function<void(const std::string &)> &verify,
+                                    const api::FlowControlToken *flow_control);
 
   static const int64_t kMaxRotations = 1000;
 
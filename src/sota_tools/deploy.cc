@@ -24,7 +24,8 @@ bool CheckPoolState(const OSTreeObject::ptr &root_object, const RequestPool &req
 }
 
 bool UploadToTreehub(const OSTreeRepo::ptr &src_repo, TreehubServer &push_server, const OSTreeHash &ostree_commit,
-                     const RunMode mode, const int max_curl_requests, const bool fsck_on_upload) {
+                     const RunMode mode, const int max_curl_requests, const bool fsck_on_upload,
+                     PresenceCache *presence_cache, const PushPlan *plan, const CongestionAlgorithm algorithm) {
   assert(max_curl_requests > 0);
 
   OSTreeObject::ptr root_object;
@@ -35,7 +36,13 @@ bool UploadToTreehub(const OSTreeRepo::ptr &src_repo, TreehubServer &push_server
     return false;
   }
 
-  RequestPool request_pool(push_server, max_curl_requests, mode, fsck_on_upload);
+  if (plan != nullptr && plan->has_base()) {
+    LOG_INFO << plan->base_objects() << " objects of the base commit are already on the server, pushing the other "
+             << plan->objects() << " objects";
+    plan->Apply();
+  }
+
+  RequestPool request_pool(push_server, max_curl_requests, mode, fsck_on_upload, presence_cache, algorithm);
 
   // Add commit object to the queue.
   request_pool.AddQuery(root_object);
@@ -53,8 +60,14 @@ bool UploadToTreehub(const OSTreeRepo::ptr &src_repo, TreehubServer &push_server
       LOG_INFO << "Upload to Treehub complete after " << request_pool.head_requests_made() << " HEAD requests and "
                << request_pool.put_requests_made() << " PUT requests.";
       LOG_INFO << "Total size of uploaded objects: " << request_pool.total_object_size() << " bytes.";
+      if (presence_cache != nullptr) {
+        LOG_INFO << request_pool.cache_hits() << " objects were not queried because of the presence cache.";
+      }
     } else {
       LOG_INFO << "Dry run. No objects uploaded.";
+      if (plan != nullptr) {
+        LOG_INFO << "Planned upload: at most " << plan->objects() << " objects, " << plan->bytes() << " bytes.";
+      }
     }
   } else {
     LOG_ERROR << "One or more errors while pushing";
@@ -107,6 +120,22 @@ bool OfflineSignRepo(const ServerCredentials &push_credentials, const std::strin
   return true;
 }
 
+bool CheckCommitOnServer(const TreehubServer &push_server, const OSTreeHash &commit) {
+  CurlEasyWrapper easy_handle;
+  curlEasySetoptWrapper(easy_handle.get(), CURLOPT_VERBOSE, get_curlopt_verbose());
+  const auto path = OSTreeRepo::GetPathForHash(commit, OstreeObjectType::OSTREE_OBJECT_TYPE_COMMIT);
+  push_server.InjectIntoCurl("objects/" + path.string(), easy_handle.get());
+  curlEasySetoptWrapper(easy_handle.get(), CURLOPT_NOBODY, 1L);  // HEAD
+  CURLcode err = curl_easy_perform(easy_handle.get());
+  if (err != 0U) {
+    LOG_WARNING << "Error checking for commit " << commit << ": " << curl_easy_strerror(err);
+    return false;
+  }
+  long rescode;  // NOLINT(google-runtime-int)
+  curl_easy_getinfo(easy_handle.get(), CURLINFO_RESPONSE_CODE, &rescode);
+  return rescode == 200;
+}
+
 bool PushRootRef(const TreehubServer &push_server, const OSTreeRef &ref) {
   CurlEasyWrapper easy_handle;
   curlEasySetoptWrapper(easy_handle.get(), CURLOPT_VERBOSE, get_curlopt_verbose());
@@ -6,6 +6,9 @@
 #include "garage_common.h"
 #include "ostree_ref.h"
 #include "ostree_repo.h"
+#include "presence_cache.h"
+#include "push_plan.h"
+#include "rate_controller.h"
 #include "server_credentials.h"
 
 /*
@@ -26,9 +29,15 @@ bool CheckPoolState(const OSTreeObject::ptr& root_object, const RequestPool& req
  * \param mode
  * \param max_curl_requests
  * \param fsck_on_upload Validate objects on disk before uploading them
+ * \param presence_cache Objects known to be on push_server, or nullptr
+ * \param plan The objects of ostree_commit to push, or nullptr to find out
+ *             from the server alone
+ * \param algorithm How the number of parallel requests grows
  */
 bool UploadToTreehub(const OSTreeRepo::ptr& src_repo, TreehubServer& push_server, const OSTreeHash& ostree_commit,
-                     RunMode mode, int max_curl_requests, bool fsck_on_upload);
+                     RunMode mode, int max_curl_requests, bool fsck_on_upload,
+                     PresenceCache* presence_cache = nullptr, const PushPlan* plan = nullptr,
+                     CongestionAlgorithm algorithm = CongestionAlgorithm::kAimd);
 
 /**
  * Use the garage-sign tool and the Image repo targets.json keys in credentials.zip
@@ -37,6 +46,12 @@ bool UploadToTreehub(const OSTreeRepo::ptr& src_repo, TreehubServer& push_server
 bool OfflineSignRepo(const ServerCredentials& push_credentials, const std::string& name, const OSTreeHash& hash,
                      const std::string& hardwareids);
 
+/**
+ * Check whether Treehub has a commit object. Treehub only gets the commit
+ * object once all the other objects of the commit are there.
+ */
+bool CheckCommitOnServer(const TreehubServer& push_server, const OSTreeHash& commit);
+
 /**
  * Update the ref on Treehub to the new commit.
  */
@@ -0,0 +1,123 @@
+#include "fsck_pool.h"
+
+#include <glib.h>
+#include <ostree.h>
+#include <algorithm>
+
+#include "logging/logging.h"
+
+namespace {
+
+OstreeRepo *OpenRepo(const std::string &root) {
+  GFile *repo_path_file = g_file_new_for_path(root.c_str());  // Never fails
+  OstreeRepo *repo = ostree_repo_new(repo_path_file);
+  g_object_unref(repo_path_file);
+  GError *err = nullptr;
+  if (ostree_repo_open(repo, nullptr, &err) == FALSE) {
+    LOG_ERROR << "ostree_repo_open failed";
+    if (err != nullptr) {
+      LOG_ERROR << "err:" << err->message;
+      g_error_free(err);
+    }
+    g_object_unref(repo);
+    return nullptr;
+  }
+  return repo;
+}
+
+}  // namespace
+
+FsckPool::FsckPool(const unsigned int workers)
+    : max_workers_(workers > 0 ? workers : std::max(1U, std::thread::hardware_concurrency())) {}
+
+FsckPool::~FsckPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_);
+    shutdown_ = true;
+    jobs_.clear();
+  }
+  cv_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+void FsckPool::Add(const OSTreeObject::ptr &object) {
+  if (!pending_.emplace(object.get(), object).second) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_);
+    jobs_.push_back(Job{object.get(), object->RepoRoot().string()});
+    // Start another worker unless an idle one can take the job.
+    if (workers_.size() < max_workers_ && jobs_.size() + busy_ > workers_.size()) {
+      workers_.emplace_back(&FsckPool::Run, this);
+    }
+  }
+  cv_.notify_one();
+}
+
+std::vector<std::pair<OSTreeObject::ptr, bool>> FsckPool::TakeResults() {
+  std::vector<std::pair<OSTreeObject *, bool>> results;
+  {
+    std::lock_guard<std::mutex> lock(m_);
+    results.swap(results_);
+  }
+  std::vector<std::pair<OSTreeObject::ptr, bool>> checked;
+  for (const auto &result : results) {
+    auto it = pending_.find(result.first);
+    checked.emplace_back(it->second, result.second);
+    pending_.erase(it);
+  }
+  return checked;
+}
+
+void FsckPool::WaitForResults(const std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> lock(m_);
+  cv_.wait_for(lock, timeout, [this] { return !results_.empty(); });
+}
+
+void FsckPool::Cancel() {
+  std::unique_lock<std::mutex> lock(m_);
+  jobs_.clear();
+  cv_.wait(lock, [this] { return busy_ == 0; });
+  results_.clear();
+  pending_.clear();
+}
+
+void FsckPool::Run() {
+  // Opening a repo is much more expensive than checking an object in it.
+  std::map<std::string, OstreeRepo *> repos;
+
+  std::unique_lock<std::mutex> lock(m_);
+  while (true) {
+    cv_.wait(lock, [this] { return !jobs_.empty() || shutdown_; });
+    if (shutdown_) {
+      break;
+    }
+    const Job job = jobs_.front();
+    jobs_.pop_front();
+    ++busy_;
+    lock.unlock();
+
+    auto repo = repos.find(job.repo_root);
+    if (repo == repos.end()) {
+      repo = repos.emplace(job.repo_root, OpenRepo(job.repo_root)).first;
+    }
+    const bool ok = repo->second != nullptr && job.object->Fsck(repo->second);
+
+    lock.lock();
+    --busy_;
+    results_.emplace_back(job.object, ok);
+    cv_.notify_all();
+  }
+  lock.unlock();
+
+  for (auto &repo : repos) {
+    if (repo.second != nullptr) {
+      g_object_unref(repo.second);
+    }
+  }
+}
+
+// vim: set tabstop=2 shiftwidth=2 expandtab:
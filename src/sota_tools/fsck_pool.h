@@ -0,0 +1,67 @@
+#ifndef SOTA_CLIENT_TOOLS_FSCK_POOL_H_
+#define SOTA_CLIENT_TOOLS_FSCK_POOL_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ostree_object.h"
+
+/**
+ * Checks the integrity of objects on a pool of worker threads, so that
+ * RequestPool can keep the network busy meanwhile. Each worker opens each
+ * source repo once and keeps it open.
+ *
+ * OSTreeObject is not thread-safe, so everything but the check itself happens
+ * on the thread that owns the pool: it holds the references to the objects
+ * being checked and picks up the results with TakeResults().
+ */
+class FsckPool {
+ public:
+  /** `workers` 0 means one per CPU. Workers are started on the first Add(). */
+  explicit FsckPool(unsigned int workers = 0);
+  ~FsckPool();
+  FsckPool(const FsckPool&) = delete;
+  FsckPool(FsckPool&&) = delete;
+  FsckPool& operator=(const FsckPool&) = delete;
+  FsckPool& operator=(FsckPool&&) = delete;
+
+  void Add(const OSTreeObject::ptr& object);
+  /** The objects checked since the last call, and whether they are intact. */
+  std::vector<std::pair<OSTreeObject::ptr, bool>> TakeResults();
+  /** Wait until there are results to take, for no longer than `timeout`. */
+  void WaitForResults(std::chrono::milliseconds timeout);
+  /** Drop the checks that have not started, wait for the others and forget all the objects. */
+  void Cancel();
+  /** The number of objects added and not taken back yet. */
+  size_t pending() const { return pending_.size(); }
+
+ private:
+  struct Job {
+    OSTreeObject* object;
+    std::string repo_root;
+  };
+
+  void Run();
+
+  const unsigned int max_workers_;
+  std::vector<std::thread> workers_;
+  // Only used by the owning thread.
+  std::map<OSTreeObject*, OSTreeObject::ptr> pending_;
+
+  std::mutex m_;
+  std::condition_variable cv_;
+  std::deque<Job> jobs_;
+  std::vector<std::pair<OSTreeObject*, bool>> results_;
+  unsigned int busy_{0};
+  bool shutdown_{false};
+};
+
+// vim: set tabstop=2 shiftwidth=2 expandtab:
+#endif  // SOTA_CLIENT_TOOLS_FSCK_POOL_H_
@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <map>
+
+#include "fsck_pool.h"
+#include "ostree_dir_repo.h"
+#include "ostree_object.h"
+
+static const char *kRepoPath = "tests/sota_tools/corrupt-repo";
+static const char *kGoodObject = "2ee758031340b51db1c0229bddd8f64bca4b131728d2bfb20c0c8671b1259a38";
+static const char *kCorruptObject = "4145b1a9bade30efb28ff921f7a555ff82ba7d3b7b83b968084436167912fa83";
+
+/* Objects are checked on the workers and handed back with the result. */
+TEST(FsckPool, Check) {
+  OSTreeDirRepo repo(kRepoPath);
+  auto good_object = repo.GetObject(OSTreeHash::Parse(kGoodObject), OstreeObjectType::OSTREE_OBJECT_TYPE_FILE);
+  auto corrupt_object = repo.GetObject(OSTreeHash::Parse(kCorruptObject), OstreeObjectType::OSTREE_OBJECT_TYPE_FILE);
+
+  FsckPool pool(2);
+  pool.Add(good_object);
+  pool.Add(corrupt_object);
+  pool.Add(good_object);
+  EXPECT_EQ(pool.pending(), 2U);
+
+  std::map<OSTreeObject::ptr, bool> results;
+  for (int i = 0; i < 100 && pool.pending() > 0; ++i) {
+    pool.WaitForResults(std::chrono::milliseconds(100));
+    for (const auto &result : pool.TakeResults()) {
+      EXPECT_EQ(results.count(result.first), 0U);
+      results.emplace(result);
+    }
+  }
+  EXPECT_EQ(pool.pending(), 0U);
+  ASSERT_EQ(results.size(), 2U);
+  EXPECT_TRUE(results[good_object]);
+  EXPECT_FALSE(results[corrupt_object]);
+}
+
+/* Cancelled checks are forgotten. */
+TEST(FsckPool, Cancel) {
+  OSTreeDirRepo repo(kRepoPath);
+  auto good_object = repo.GetObject(OSTreeHash::Parse(kGoodObject), OstreeObjectType::OSTREE_OBJECT_TYPE_FILE);
+
+  FsckPool pool(1);
+  pool.Add(good_object);
+  pool.Cancel();
+  EXPECT_EQ(pool.pending(), 0U);
+  EXPECT_TRUE(pool.TakeResults().empty());
+}
+
+#ifndef __NO_MAIN__
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+#endif
+
+// vim: set tabstop=2 shiftwidth=2 expandtab:
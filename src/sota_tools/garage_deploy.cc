@@ -1,4 +1,5 @@
 #include <chrono>
+#include <stdexcept>
 #include <string>
 
 #include <boost/filesystem.hpp>
@@ -11,6 +12,7 @@
 #include "garage_tools_version.h"
 #include "logging/logging.h"
 #include "ostree_http_repo.h"
+#include "rate_controller.h"
 
 namespace po = boost::program_options;
 
@@ -26,6 +28,7 @@ int main(int argc, char **argv) {
   std::string hardwareids;
   std::string cacerts;
   int max_curl_requests;
+  std::string congestion_control;
   RunMode mode = RunMode::kDefault;
   po::options_description desc("garage-deploy command line options");
   // clang-format off
@@ -42,6 +45,7 @@ int main(int argc, char **argv) {
     ("hardwareids,h", po::value<std::string>(&hardwareids)->required(), "list of hardware ids")
     ("cacert", po::value<std::string>(&cacerts), "override path to CA root certificates, in the same format as curl --cacert")
     ("jobs", po::value<int>(&max_curl_requests)->default_value(30), "maximum number of parallel requests")
+    ("congestion-control", po::value<std::string>(&congestion_control)->default_value("aimd"), "how to adjust the number of parallel requests: aimd (by server errors) or delay (by server latency)")
     ("dry-run,n", "check arguments and authenticate but don't upload")
     ("disable-integrity-checks", "Don't validate the checksums of objects before uploading them");
   // clang-format on
@@ -95,6 +99,13 @@ int main(int argc, char **argv) {
     LOG_FATAL << "--jobs must be greater than 0";
     return EXIT_FAILURE;
   }
+  CongestionAlgorithm algorithm;
+  try {
+    algorithm = CongestionAlgorithmFromString(congestion_control);
+  } catch (const std::invalid_argument &e) {
+    LOG_FATAL << e.what();
+    return EXIT_FAILURE;
+  }
 
   ServerCredentials fetch_credentials(fetch_cred);
   TreehubServer fetch_server;
@@ -110,14 +121,14 @@ int main(int argc, char **argv) {
     return EXIT_FAILURE;
   }
 
-  OSTreeRepo::ptr src_repo = std::make_shared<OSTreeHttpRepo>(&fetch_server);
+  // Objects are fetched in the background while others are being uploaded,
+  // with as many parallel requests to each server.
+  OSTreeRepo::ptr src_repo = std::make_shared<OSTreeHttpRepo>(&fetch_server, "", max_curl_requests, algorithm);
   try {
     OSTreeHash commit(OSTreeHash::Parse(ostree_commit));
     bool fsck = vm.count("disable-integrity-checks") == 0;
-    // Since the fetches happen on a single thread in OSTreeHttpRepo, there
-    // isn't much reason to upload in parallel, but why hold the system back if
-    // the fetching is faster than the uploading?
-    if (!UploadToTreehub(src_repo, push_server, commit, mode, max_curl_requests, fsck)) {
+    if (!UploadToTreehub(src_repo, push_server, commit, mode, max_curl_requests, fsck, nullptr, nullptr,
+                         algorithm)) {
       LOG_FATAL << "Upload to treehub failed";
       return EXIT_FAILURE;
     }
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <stdexcept>
 #include <string>
 
 #include <boost/filesystem.hpp>
@@ -10,6 +12,9 @@
 #include "logging/logging.h"
 #include "ostree_dir_repo.h"
 #include "ostree_repo.h"
+#include "presence_cache.h"
+#include "push_plan.h"
+#include "rate_controller.h"
 #include "utilities/xml2json.h"
 
 namespace po = boost::program_options;
@@ -23,6 +28,10 @@ int main(int argc, char **argv) {
   std::string cacerts;
   boost::filesystem::path manifest_path;
   int max_curl_requests;
+  std::string congestion_control;
+  boost::filesystem::path presence_cache_path;
+  unsigned int presence_cache_verify;
+  std::string base_commit;
   RunMode mode = RunMode::kDefault;
   po::options_description desc("garage-push command line options");
   // clang-format off
@@ -38,9 +47,13 @@ int main(int argc, char **argv) {
     ("cacert", po::value<std::string>(&cacerts), "override path to CA root certificates, in the same format as curl --cacert")
     ("repo-manifest", po::value<boost::filesystem::path>(&manifest_path), "manifest describing repository branches used in the image, to be sent as attached metadata")
     ("jobs", po::value<int>(&max_curl_requests)->default_value(30), "maximum number of parallel requests")
+    ("congestion-control", po::value<std::string>(&congestion_control)->default_value("aimd"), "how to adjust the number of parallel requests: aimd (by server errors) or delay (by server latency)")
     ("dry-run,n", "check arguments and authenticate but don't upload")
     ("walk-tree,w", "walk entire tree and upload all missing objects")
-    ("disable-integrity-checks", "Don't validate the checksums of objects before uploading them");
+    ("base-commit", po::value<std::string>(&base_commit), "commit refhash already on the server, only objects that are not part of it are pushed (default: the commit the ref points to on the server)")
+    ("disable-integrity-checks", "Don't validate the checksums of objects before uploading them")
+    ("presence-cache", po::value<boost::filesystem::path>(&presence_cache_path), "file to remember which objects are on the server in, so that later pushes don't query them again")
+    ("presence-cache-verify", po::value<unsigned int>(&presence_cache_verify)->default_value(1), "percentage of the objects found in the presence cache to query anyway, to detect a stale cache");
   // clang-format on
 
   po::variables_map vm;
@@ -107,6 +120,13 @@ int main(int argc, char **argv) {
     LOG_FATAL << "--jobs must be greater than 0";
     return EXIT_FAILURE;
   }
+  CongestionAlgorithm algorithm;
+  try {
+    algorithm = CongestionAlgorithmFromString(congestion_control);
+  } catch (const std::invalid_argument &e) {
+    LOG_FATAL << e.what();
+    return EXIT_FAILURE;
+  }
 
   OSTreeRepo::ptr src_repo = std::make_shared<OSTreeDirRepo>(repo_path);
   if (!src_repo->LooksValid()) {
@@ -136,8 +156,48 @@ int main(int argc, char **argv) {
       LOG_FATAL << "Authentication with push server failed";
       return EXIT_FAILURE;
     }
+    std::unique_ptr<PresenceCache> presence_cache;
+    if (!presence_cache_path.empty()) {
+      try {
+        presence_cache = std_::make_unique<PresenceCache>(presence_cache_path, push_server.root_url(),
+                                                          std::min(presence_cache_verify, 100U));
+      } catch (const std::exception &e) {
+        LOG_WARNING << "Could not open presence cache " << presence_cache_path << ": " << e.what();
+      }
+    }
+    std::unique_ptr<PushPlan> plan;
+    if (mode == RunMode::kDefault || mode == RunMode::kDryRun) {
+      std::unique_ptr<OSTreeHash> base;
+      try {
+        if (!base_commit.empty()) {
+          base = std_::make_unique<OSTreeHash>(OSTreeHash::Parse(base_commit));
+        } else if (is_ref) {
+          OSTreeRef server_ref(push_server, ref);
+          if (server_ref.IsValid()) {
+            base = std_::make_unique<OSTreeHash>(server_ref.GetHash());
+          }
+        }
+      } catch (const OSTreeCommitParseError &e) {
+        LOG_WARNING << "Base commit is not a valid refhash, pushing without a base";
+      }
+      if (base && !CheckCommitOnServer(push_server, *base)) {
+        LOG_INFO << "Base commit " << *base << " is not on the server, pushing without a base";
+        base.reset();
+      }
+      // Without a base, the plan only serves to report the size of a dry run.
+      // Walking a big commit up front would just slow down a real push.
+      if (base || mode == RunMode::kDryRun) {
+        try {
+          plan = std_::make_unique<PushPlan>(*src_repo, *commit, base.get());
+        } catch (const OSTreeObjectMissing &error) {
+          LOG_WARNING << "Source OSTree repo does not contain object " << error.missing_object()
+                      << ", pushing without a plan";
+        }
+      }
+    }
     bool fsck = vm.count("disable-integrity-checks") == 0;
-    if (!UploadToTreehub(src_repo, push_server, *commit, mode, max_curl_requests, fsck)) {
+    if (!UploadToTreehub(src_repo, push_server, *commit, mode, max_curl_requests, fsck, presence_cache.get(),
+                         plan.get(), algorithm)) {
       LOG_FATAL << "Upload to treehub failed";
       return EXIT_FAILURE;
     }
@@ -0,0 +1,206 @@
+#include "object_fetcher.h"
+
+#include <cassert>
+
+#include <boost/filesystem.hpp>
+
+#include "logging/logging.h"
+
+// How long the fetching thread waits for transfers before looking for new work.
+static const int kPollTimeMs = 10;
+
+ObjectFetcher::ObjectFetcher(const TreehubServer &server, boost::filesystem::path root, const int max_curl_requests,
+                             const CongestionAlgorithm algorithm)
+    : server_(server),
+      root_(std::move(root)),
+      rate_controller_(max_curl_requests, MakeCongestionControl(algorithm)) {
+  // Keep curl initialized for the fetching thread, whatever else cleans it up
+  // in the meantime, such as a RequestPool that is done.
+  curl_global_init(CURL_GLOBAL_DEFAULT);
+}
+
+ObjectFetcher::~ObjectFetcher() {
+  {
+    std::lock_guard<std::mutex> lock(m_);
+    shutdown_ = true;
+  }
+  cv_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  curl_global_cleanup();
+}
+
+bool ObjectFetcher::Fetch(const std::vector<boost::filesystem::path> &paths) {
+  bool done = true;
+  bool added = false;
+  {
+    std::lock_guard<std::mutex> lock(m_);
+    const bool paused = server_failed_ || RateController::clock::now() < paused_until_;
+    for (const auto &path : paths) {
+      const std::string name = path.string();
+      if (fetching_.count(name) != 0) {
+        done = false;
+      } else if (!paused && failed_.count(name) == 0 && fetched_.count(name) == 0 &&
+                 !boost::filesystem::is_regular_file(root_ / path)) {
+        queue_.push_back(name);
+        fetching_.insert(name);
+        added = true;
+        done = false;
+      }
+    }
+    if (added && !thread_.joinable()) {
+      thread_ = std::thread(&ObjectFetcher::Run, this);
+    }
+  }
+  if (added) {
+    cv_.notify_all();
+  }
+  return done;
+}
+
+void ObjectFetcher::Wait(const boost::filesystem::path &path) {
+  const std::string name = path.string();
+  std::unique_lock<std::mutex> lock(m_);
+  cv_.wait(lock, [this, &name] { return fetching_.count(name) == 0; });
+}
+
+void ObjectFetcher::Run() {
+  CURLM *multi = curl_multi_init();
+  std::map<CURL *, Transfer> transfers;
+
+  std::unique_lock<std::mutex> lock(m_);
+  while (!shutdown_) {
+    std::vector<std::string> launch;
+    while (!queue_.empty() &&
+           transfers.size() + launch.size() < static_cast<size_t>(rate_controller_.MaxConcurrency())) {
+      launch.push_back(queue_.front());
+      queue_.pop_front();
+    }
+    if (transfers.empty() && launch.empty()) {
+      cv_.wait(lock, [this] { return !queue_.empty() || shutdown_; });
+      continue;
+    }
+    lock.unlock();
+
+    // Paths that are not being fetched any more, and whether they were fetched.
+    std::vector<std::pair<std::string, bool>> finished;
+    bool congested = false;
+    for (const auto &path : launch) {
+      if (!Start(multi, path, &transfers)) {
+        finished.emplace_back(path, false);
+      }
+    }
+
+    curl_multi_wait(multi, nullptr, 0, kPollTimeMs, nullptr);
+    int running;
+    curl_multi_perform(multi, &running);
+    int msgs_in_queue;
+    CURLMsg *msg;
+    while ((msg = curl_multi_info_read(multi, &msgs_in_queue)) != nullptr) {
+      if (msg->msg != CURLMSG_DONE) {
+        continue;
+      }
+      auto it = transfers.find(msg->easy_handle);
+      assert(it != transfers.end());
+      long rescode = 0;  // NOLINT(google-runtime-int)
+      curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &rescode);
+      const bool fetched = msg->data.result == CURLE_OK;
+      if (!fetched) {
+        LOG_DEBUG << "Prefetching " << it->second.path << " failed: " << curl_easy_strerror(msg->data.result);
+      }
+      // A missing object is a perfectly good answer as far as congestion goes.
+      const bool server_responded_ok = fetched || (rescode >= 400 && rescode < 500);
+      const long bytes = ftell(it->second.file);  // NOLINT(google-runtime-int)
+      rate_controller_.RequestCompleted(it->second.start_time, RateController::clock::now(), server_responded_ok,
+                                        bytes > 0 ? static_cast<uintmax_t>(bytes) : 0);
+      congested = congested || !server_responded_ok;
+      finished.emplace_back(it->second.path, Finish(it->second, fetched));
+      curl_multi_remove_handle(multi, msg->easy_handle);
+      curl_easy_cleanup(msg->easy_handle);
+      transfers.erase(it);
+    }
+
+    lock.lock();
+    for (const auto &result : finished) {
+      fetching_.erase(result.first);
+      if (result.second) {
+        fetched_.insert(result.first);
+      } else {
+        failed_.insert(result.first);
+      }
+    }
+    const auto sleep_time = rate_controller_.GetSleepTime();
+    congested = congested && sleep_time > RateController::clock::duration(0);
+    if (congested) {
+      // Back off by handing the queued paths back to the caller, rather than
+      // holding them up.
+      LOG_DEBUG << "Pausing prefetching due to server congestion.";
+      server_failed_ = rate_controller_.ServerHasFailed();
+      paused_until_ = RateController::clock::now() + sleep_time;
+      for (const auto &path : queue_) {
+        fetching_.erase(path);
+      }
+      queue_.clear();
+    }
+    if (!finished.empty() || congested) {
+      cv_.notify_all();
+    }
+  }
+  lock.unlock();
+
+  for (const auto &transfer : transfers) {
+    curl_multi_remove_handle(multi, transfer.first);
+    curl_easy_cleanup(transfer.first);
+    Finish(transfer.second, false);
+  }
+  curl_multi_cleanup(multi);
+}
+
+bool ObjectFetcher::Start(CURLM *multi, const std::string &path, std::map<CURL *, Transfer> *transfers) const {
+  const boost::filesystem::path part = root_ / (path + ".part");
+  boost::system::error_code ec;
+  boost::filesystem::create_directories(part.parent_path(), ec);
+  FILE *file = fopen(part.c_str(), "wb");
+  if (file == nullptr) {
+    LOG_WARNING << "Failed to open file: " << part.string();
+    return false;
+  }
+  CURL *handle = curl_easy_init();
+  try {
+    if (handle == nullptr) {
+      throw std::runtime_error("Could not initialize curl handle");
+    }
+    server_.InjectIntoCurl(path, handle);
+    curlEasySetoptWrapper(handle, CURLOPT_VERBOSE, get_curlopt_verbose());
+    curlEasySetoptWrapper(handle, CURLOPT_FAILONERROR, true);
+    curlEasySetoptWrapper(handle, CURLOPT_WRITEDATA, file);
+    const CURLMcode err = curl_multi_add_handle(multi, handle);
+    if (err != CURLM_OK) {
+      throw std::runtime_error(std::string("curl_multi_add_handle error: ") + curl_multi_strerror(err));
+    }
+  } catch (const std::exception &ex) {
+    LOG_WARNING << "Could not prefetch " << path << ": " << ex.what();
+    curl_easy_cleanup(handle);
+    Finish(Transfer{path, file, {}}, false);
+    return false;
+  }
+  transfers->emplace(handle, Transfer{path, file, RateController::clock::now()});
+  return true;
+}
+
+bool ObjectFetcher::Finish(const Transfer &transfer, const bool fetched) const {
+  const bool written = fclose(transfer.file) == 0;
+  const boost::filesystem::path part = root_ / (transfer.path + ".part");
+  boost::system::error_code ec;
+  if (fetched && written) {
+    boost::filesystem::rename(part, root_ / transfer.path, ec);
+    if (!ec) {
+      return true;
+    }
+  }
+  boost::filesystem::remove(part, ec);
+  return false;
+}
+
+// vim: set tabstop=2 shiftwidth=2 expandtab:
@@ -0,0 +1,84 @@
+#ifndef SOTA_CLIENT_TOOLS_OBJECT_FETCHER_H_
+#define SOTA_CLIENT_TOOLS_OBJECT_FETCHER_H_
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <curl/curl.h>
+#include <boost/filesystem/path.hpp>
+
+#include "rate_controller.h"
+#include "treehub_server.h"
+
+/**
+ * Fetches files from a Treehub server into a local directory on a background
+ * thread, several at a time. The number of parallel requests follows the
+ * same RateController logic as the uploads in RequestPool.
+ *
+ * Files appear in the directory only once they have been fetched completely.
+ * Fetching is best effort: a file that could not be fetched is just left out,
+ * and while the server is struggling no new fetches are started at all. The
+ * caller is expected to fetch whatever is missing by itself.
+ */
+class ObjectFetcher {
+ public:
+  ObjectFetcher(const TreehubServer& server, boost::filesystem::path root, int max_curl_requests,
+                CongestionAlgorithm algorithm = CongestionAlgorithm::kAimd);
+  ~ObjectFetcher();
+  ObjectFetcher(const ObjectFetcher&) = delete;
+  ObjectFetcher(ObjectFetcher&&) = delete;
+  ObjectFetcher& operator=(const ObjectFetcher&) = delete;
+  ObjectFetcher& operator=(ObjectFetcher&&) = delete;
+
+  /**
+   * Start fetching the files at `paths` (relative to the server and the local
+   * directory) that aren't there yet.
+   * @return true if none of them is being fetched any more
+   */
+  bool Fetch(const std::vector<boost::filesystem::path>& paths);
+  /** Wait until the file at `path` is not being fetched. */
+  void Wait(const boost::filesystem::path& path);
+
+ private:
+  struct Transfer {
+    std::string path;
+    FILE* file;
+    RateController::clock::time_point start_time;
+  };
+
+  void Run();
+  /* Add a transfer of `path` to `multi`. Returns false if it could not be started. */
+  bool Start(CURLM* multi, const std::string& path, std::map<CURL*, Transfer>* transfers) const;
+  /* Close a finished transfer, and move the file into place if it succeeded.
+   * Returns whether the file is there. */
+  bool Finish(const Transfer& transfer, bool fetched) const;
+
+  const TreehubServer& server_;
+  const boost::filesystem::path root_;
+  // Only used by the fetching thread.
+  RateController rate_controller_;
+
+  std::mutex m_;
+  std::condition_variable cv_;
+  std::deque<std::string> queue_;
+  // Queued or being fetched.
+  std::set<std::string> fetching_;
+  // Given up on, never tried again.
+  std::set<std::string> failed_;
+  // Fetched into the directory, so that asking again costs no stat().
+  std::set<std::string> fetched_;
+  RateController::clock::time_point paused_until_;
+  bool server_failed_{false};
+  bool shutdown_{false};
+  std::thread thread_;
+};
+
+// vim: set tabstop=2 shiftwidth=2 expandtab:
+#endif  // SOTA_CLIENT_TOOLS_OBJECT_FETCHER_H_
@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+#include <boost/filesystem.hpp>
+#include <boost/process.hpp>
+
+#include "object_fetcher.h"
+#include "test_utils.h"
+#include "treehub_server.h"
+
+std::string port;
+
+static const boost::filesystem::path kDirMeta(
+    "objects/44/6a0ef11b7cc167f3b603e585c7eeeeb675faa412d5ec73f62988eb0b6c5488.dirmeta");
+static const boost::filesystem::path kCommit(
+    "objects/b9/ac1e45f9227df8ee191b6e51e09417bd36c6ebbeff999431e3073ac50f0563.commit");
+static const boost::filesystem::path kMissing(
+    "objects/00/28dac42b76c2015ee3c41cc4183bb8b5c790fd21fa5cfa0802c6e11fd0edbe.dirmeta");
+
+/* Files are fetched in the background, and files that can't be fetched are
+ * given up on. */
+TEST(ObjectFetcher, Fetch) {
+  TemporaryDirectory temp_dir;
+  TreehubServer server;
+  server.root_url("http://localhost:" + port);
+  ObjectFetcher fetcher(server, temp_dir.Path(), 4);
+
+  const std::vector<boost::filesystem::path> paths{kDirMeta, kMissing};
+  EXPECT_FALSE(fetcher.Fetch(paths));
+  for (int i = 0; i < 100 && !fetcher.Fetch(paths); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  EXPECT_TRUE(fetcher.Fetch(paths));
+  EXPECT_TRUE(boost::filesystem::is_regular_file(temp_dir.Path() / kDirMeta));
+  EXPECT_FALSE(boost::filesystem::exists(temp_dir.Path() / kMissing));
+  EXPECT_FALSE(boost::filesystem::exists(temp_dir.Path() / (kMissing.string() + ".part")));
+}
+
+/* Waiting for a file returns once it has been fetched. */
+TEST(ObjectFetcher, Wait) {
+  TemporaryDirectory temp_dir;
+  TreehubServer server;
+  server.root_url("http://localhost:" + port);
+  ObjectFetcher fetcher(server, temp_dir.Path(), 4);
+
+  fetcher.Fetch({kCommit});
+  fetcher.Wait(kCommit);
+  EXPECT_TRUE(boost::filesystem::is_regular_file(temp_dir.Path() / kCommit));
+  EXPECT_TRUE(fetcher.Fetch({kCommit}));
+}
+
+#ifndef __NO_MAIN__
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+
+  std::string server = "tests/sota_tools/treehub_server.py";
+  port = TestUtils::getFreePort();
+
+  boost::process::child server_process(server, std::string("-p"), port, std::string("--create"));
+  TestUtils::waitForServer("http://localhost:" + port + "/");
+
+  return RUN_ALL_TESTS();
+}
+#endif
+
+// vim: set tabstop=2 shiftwidth=2 expandtab:
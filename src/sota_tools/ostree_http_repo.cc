@@ -33,7 +33,31 @@ bool OSTreeHttpRepo::LooksValid() const {
 
 OSTreeRef OSTreeHttpRepo::GetRef(const std::string &refname) const { return OSTreeRef(*server_, refname); }
 
+bool OSTreeHttpRepo::FetchChildren(const OSTreeObject &object) const {
+  auto it = child_paths_.find(object.hash());
+  if (it == child_paths_.end()) {
+    const auto children = OSTreeObject::ParseChildren(
+        root_ / "objects" / GetPathForHash(object.hash(), object.type()), object.type());
+    std::vector<boost::filesystem::path> paths;
+    for (const auto &child : children) {
+      paths.push_back(boost::filesystem::path("objects") / GetPathForHash(child.first, child.second));
+    }
+    it = child_paths_.emplace(object.hash(), std::move(paths)).first;
+  }
+  if (!fetcher_->Fetch(it->second)) {
+    return false;
+  }
+  child_paths_.erase(it);
+  return true;
+}
+
 bool OSTreeHttpRepo::FetchObject(const boost::filesystem::path &path) const {
+  // Objects that have been prefetched don't need to be fetched again.
+  fetcher_->Wait(path);
+  if (boost::filesystem::is_regular_file(root_ / path)) {
+    return true;
+  }
+
   CURLcode err = CURLE_OK;
   server_->InjectIntoCurl(path.string(), easy_handle_.get());
   boost::filesystem::create_directories((root_ / path).parent_path());
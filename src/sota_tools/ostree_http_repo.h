@@ -1,9 +1,14 @@
 #ifndef SOTA_CLIENT_TOOLS_OSTREE_HTTP_REPO_H_
 #define SOTA_CLIENT_TOOLS_OSTREE_HTTP_REPO_H_
 
+#include <map>
+#include <memory>
+#include <vector>
+
 #include <boost/filesystem/path.hpp>
 
 #include "logging/logging.h"
+#include "object_fetcher.h"
 #include "ostree_ref.h"
 #include "ostree_repo.h"
 #include "treehub_server.h"
@@ -11,11 +16,13 @@
 
 class OSTreeHttpRepo : public OSTreeRepo {
  public:
-  explicit OSTreeHttpRepo(TreehubServer* server, boost::filesystem::path root_in = "")
+  explicit OSTreeHttpRepo(TreehubServer* server, boost::filesystem::path root_in = "", int max_curl_requests = 30,
+                          CongestionAlgorithm algorithm = CongestionAlgorithm::kAimd)
       : server_(server), root_(std::move(root_in)) {
     if (root_.empty()) {
       root_ = root_tmp_.Path();
     }
+    fetcher_ = std_::make_unique<ObjectFetcher>(*server_, root_, max_curl_requests, algorithm);
     curlEasySetoptWrapper(easy_handle_.get(), CURLOPT_VERBOSE, get_curlopt_verbose());
     curlEasySetoptWrapper(easy_handle_.get(), CURLOPT_WRITEFUNCTION, &OSTreeHttpRepo::curl_handle_write);
     curlEasySetoptWrapper(easy_handle_.get(), CURLOPT_FAILONERROR, true);
@@ -24,6 +31,7 @@ class OSTreeHttpRepo : public OSTreeRepo {
   bool LooksValid() const override;
   OSTreeRef GetRef(const std::string& refname) const override;
   boost::filesystem::path root() const override { return root_; }
+  bool FetchChildren(const OSTreeObject& object) const override;
 
  private:
   bool FetchObject(const boost::filesystem::path& path) const override;
@@ -33,6 +41,11 @@ class OSTreeHttpRepo : public OSTreeRepo {
   boost::filesystem::path root_;
   const TemporaryDirectory root_tmp_;
   mutable CurlEasyWrapper easy_handle_;
+  // The paths of the children of objects that are waiting for them, so that
+  // polling FetchChildren() doesn't parse the objects again.
+  mutable std::map<OSTreeHash, std::vector<boost::filesystem::path>> child_paths_;
+  // Declared last so that it is stopped before anything it uses goes away.
+  std::unique_ptr<ObjectFetcher> fetcher_;
 };
 
 // vim: set tabstop=2 shiftwidth=2 expandtab:
@@ -72,23 +72,38 @@ void OSTreeObject::AppendChild(const OSTreeObject::ptr &child) {
   child->AddParent(this, last);
 }
 
-// Can throw OSTreeObjectMissing if the repo is corrupt
 void OSTreeObject::PopulateChildren() {
+  for (const OSTreeObject::ptr &child : Children()) {
+    AppendChild(child);
+  }
+}
+
+// Can throw OSTreeObjectMissing if the repo is corrupt
+std::vector<OSTreeObject::ptr> OSTreeObject::Children() const {
+  std::vector<OSTreeObject::ptr> children;
+  for (const auto &child : ParseChildren(PathOnDisk(), type_)) {
+    children.push_back(repo_.GetObject(child.first, child.second));
+  }
+  return children;
+}
+
+std::vector<std::pair<OSTreeHash, OstreeObjectType>> OSTreeObject::ParseChildren(
+    const boost::filesystem::path &file_path, const OstreeObjectType type) {
+  std::vector<std::pair<OSTreeHash, OstreeObjectType>> children;
   const GVariantType *content_type;
   bool is_commit;
 
-  if (type_ == OSTREE_OBJECT_TYPE_COMMIT) {
+  if (type == OSTREE_OBJECT_TYPE_COMMIT) {
     content_type = OSTREE_COMMIT_GVARIANT_FORMAT;
     is_commit = true;
-  } else if (type_ == OSTREE_OBJECT_TYPE_DIR_TREE) {
+  } else if (type == OSTREE_OBJECT_TYPE_DIR_TREE) {
     content_type = OSTREE_TREE_GVARIANT_FORMAT;
     is_commit = false;
   } else {
-    return;
+    return children;
   }
 
   GError *gerror = nullptr;
-  auto file_path = PathOnDisk();
   GMappedFile *mfile = g_mapped_file_new(file_path.c_str(), FALSE, &gerror);
 
   if (mfile == nullptr) {
@@ -108,14 +123,14 @@ void OSTreeObject::PopulateChildren() {
     gsize n_elts;
     const auto *csum = static_cast<const uint8_t *>(g_variant_get_fixed_array(content_csum_variant, &n_elts, 1));
     assert(n_elts == 32);
-    AppendChild(repo_.GetObject(csum, OstreeObjectType::OSTREE_OBJECT_TYPE_DIR_TREE));
+    children.emplace_back(OSTreeHash(csum), OstreeObjectType::OSTREE_OBJECT_TYPE_DIR_TREE);
 
     // * - ay - Root tree metadata
     GVariant *meta_csum_variant = nullptr;
     g_variant_get_child(contents, 7, "@ay", &meta_csum_variant);
     csum = static_cast<const uint8_t *>(g_variant_get_fixed_array(meta_csum_variant, &n_elts, 1));
     assert(n_elts == 32);
-    AppendChild(repo_.GetObject(csum, OstreeObjectType::OSTREE_OBJECT_TYPE_DIR_META));
+    children.emplace_back(OSTreeHash(csum), OstreeObjectType::OSTREE_OBJECT_TYPE_DIR_META);
 
     g_variant_unref(meta_csum_variant);
     g_variant_unref(content_csum_variant);
@@ -138,7 +153,7 @@ void OSTreeObject::PopulateChildren() {
       gsize n_elts;
       const auto *csum = static_cast<const uint8_t *>(g_variant_get_fixed_array(csum_variant, &n_elts, 1));
       assert(n_elts == 32);
-      AppendChild(repo_.GetObject(csum, OstreeObjectType::OSTREE_OBJECT_TYPE_FILE));
+      children.emplace_back(OSTreeHash(csum), OstreeObjectType::OSTREE_OBJECT_TYPE_FILE);
 
       g_variant_unref(csum_variant);
     }
@@ -153,12 +168,12 @@ void OSTreeObject::PopulateChildren() {
       // First the .dirtree:
       const auto *csum = static_cast<const uint8_t *>(g_variant_get_fixed_array(content_csum_variant, &n_elts, 1));
       assert(n_elts == 32);
-      AppendChild(repo_.GetObject(csum, OstreeObjectType::OSTREE_OBJECT_TYPE_DIR_TREE));
+      children.emplace_back(OSTreeHash(csum), OstreeObjectType::OSTREE_OBJECT_TYPE_DIR_TREE);
 
       // Then the .dirmeta:
       csum = static_cast<const uint8_t *>(g_variant_get_fixed_array(meta_csum_variant, &n_elts, 1));
       assert(n_elts == 32);
-      AppendChild(repo_.GetObject(csum, OstreeObjectType::OSTREE_OBJECT_TYPE_DIR_META));
+      children.emplace_back(OSTreeHash(csum), OstreeObjectType::OSTREE_OBJECT_TYPE_DIR_META);
 
       g_variant_unref(meta_csum_variant);
       g_variant_unref(content_csum_variant);
@@ -168,6 +183,7 @@ void OSTreeObject::PopulateChildren() {
     g_variant_unref(files_variant);
   }
   g_variant_unref(contents);
+  return children;
 }
 
 void OSTreeObject::QueryChildren(RequestPool &pool) {
@@ -193,6 +209,8 @@ boost::filesystem::path OSTreeObject::PathOnDisk() const {
 
 uintmax_t OSTreeObject::GetSize() const { return boost::filesystem::file_size(PathOnDisk()); }
 
+boost::filesystem::path OSTreeObject::RepoRoot() const { return repo_.root(); }
+
 void OSTreeObject::MakeTestRequest(const TreehubServer &push_target, CURLM *curl_multi_handle) {
   assert(!curl_handle_);
   curl_handle_ = curl_easy_init();
@@ -268,6 +286,10 @@ void OSTreeObject::Upload(TreehubServer &push_target, CURLM *curl_multi_handle,
 
 void OSTreeObject::CheckChildren(RequestPool &pool, const long rescode) {  // NOLINT(google-runtime-int)
   try {
+    if (!repo_.FetchChildren(*this)) {
+      pool.AwaitChildren(this);
+      return;
+    }
     PopulateChildren();
     LOG_TRACE << "Children of " << *this << ": " << children_.size();
     if (children_ready()) {
@@ -283,6 +305,25 @@ void OSTreeObject::CheckChildren(RequestPool &pool, const long rescode) {  // NO
   }
 }
 
+void OSTreeObject::Present(RequestPool &pool) {
+  is_on_server_ = PresenceOnServer::kObjectPresent;
+  last_operation_result_ = ServerResponse::kOk;
+  if (pool.run_mode() == RunMode::kWalkTree || pool.run_mode() == RunMode::kPushTree) {
+    CheckChildren(pool, 200);
+  } else {
+    NotifyParents(pool);
+  }
+}
+
+void OSTreeObject::ChildrenFetched(RequestPool &pool) {
+  CheckChildren(pool, is_on_server_ == PresenceOnServer::kObjectPresent ? 200 : 404);
+}
+
+void OSTreeObject::PresentInCache(RequestPool &pool) {
+  LOG_DEBUG << "Known to be present: " << *this;
+  Present(pool);
+}
+
 void OSTreeObject::PresenceError(RequestPool &pool, const int64_t rescode) {
   is_on_server_ = PresenceOnServer::kObjectStateUnknown;
   LOG_WARNING << "OSTree query reported an error code: " << rescode << " retrying...";
@@ -317,16 +358,12 @@ void OSTreeObject::CurlDone(CURLM *curl_multi_handle, RequestPool &pool) {
       PresenceError(pool, rescode);
     } else if (rescode == 200) {
       LOG_INFO << "Already present: " << *this;
-      is_on_server_ = PresenceOnServer::kObjectPresent;
-      last_operation_result_ = ServerResponse::kOk;
-      if (pool.run_mode() == RunMode::kWalkTree || pool.run_mode() == RunMode::kPushTree) {
-        CheckChildren(pool, rescode);
-      } else {
-        NotifyParents(pool);
-      }
+      pool.ObjectPresent(*this);
+      Present(pool);
     } else if (rescode == 404) {
       is_on_server_ = PresenceOnServer::kObjectMissing;
       last_operation_result_ = ServerResponse::kOk;
+      pool.ObjectMissing(*this);
       CheckChildren(pool, rescode);
     } else {
       PresenceError(pool, rescode);
@@ -342,11 +379,13 @@ void OSTreeObject::CurlDone(CURLM *curl_multi_handle, RequestPool &pool) {
       LOG_TRACE << "OSTree upload successful";
       is_on_server_ = PresenceOnServer::kObjectPresent;
       last_operation_result_ = ServerResponse::kOk;
+      pool.ObjectPresent(*this);
       NotifyParents(pool);
     } else if (rescode == 409) {
       LOG_DEBUG << "OSTree upload reported a 409 Conflict, possibly due to concurrent uploads";
       is_on_server_ = PresenceOnServer::kObjectPresent;
       last_operation_result_ = ServerResponse::kOk;
+      pool.ObjectPresent(*this);
       NotifyParents(pool);
     } else {
       UploadError(pool, rescode);
@@ -392,10 +431,16 @@ bool OSTreeObject::Fsck() const {
     return false;
   }
 
-  ok = ostree_repo_fsck_object(repo, type_, hash_.string().c_str(), nullptr, &err);
+  const bool intact = Fsck(repo);
 
   g_object_unref(repo_path_file);
   g_object_unref(repo);
+  return intact;
+}
+
+bool OSTreeObject::Fsck(OstreeRepo *repo) const {
+  GError *err = nullptr;
+  auto ok = ostree_repo_fsck_object(repo, type_, hash_.string().c_str(), nullptr, &err);
 
   if (ok == FALSE) {
     LOG_WARNING << "Object " << *this << " is corrupt";
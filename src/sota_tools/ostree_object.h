@@ -4,6 +4,8 @@
 #include <chrono>
 #include <iostream>
 #include <sstream>
+#include <utility>
+#include <vector>
 
 #include <curl/curl.h>
 #include <boost/filesystem/path.hpp>
@@ -60,16 +62,40 @@ class OSTreeObject {
   /* Process a completed curl transaction (presence check or upload). */
   void CurlDone(CURLM* curl_multi_handle, RequestPool& pool);
 
+  /* Carry on after the source repo has fetched the children of this object,
+   * which CheckChildren() had to wait for. */
+  void ChildrenFetched(RequestPool& pool);
+
+  /* Carry on as if a presence check found this object on the server, because
+   * it is already known to be there. */
+  void PresentInCache(RequestPool& pool);
+
   uintmax_t GetSize() const;
+  const OSTreeHash& hash() const { return hash_; }
+  OstreeObjectType type() const { return type_; }
 
   PresenceOnServer is_on_server() const { return is_on_server_; }
   CurrentOp operation() const { return current_operation_; }
   bool children_ready() const { return children_.empty(); }
   void LaunchNotify() { is_on_server_ = PresenceOnServer::kObjectInProgress; }
+  /* Treat this object as present on the server without asking, because it is
+   * part of a commit the server is known to have. */
+  void AssumePresent() { is_on_server_ = PresenceOnServer::kObjectPresent; }
   std::chrono::steady_clock::time_point RequestStartTime() const { return request_start_time_; }
   ServerResponse LastOperationResult() const { return last_operation_result_; }
 
+  /* Parse this object for children. Only commits and dirtrees have any. */
+  std::vector<OSTreeObject::ptr> Children() const;
+  /* Parse the commit or dirtree in `file_path` for the hashes and types of
+   * its children, without looking them up in a repo. */
+  static std::vector<std::pair<OSTreeHash, OstreeObjectType>> ParseChildren(const boost::filesystem::path& file_path,
+                                                                            OstreeObjectType type);
+
   bool Fsck() const;
+  /* Check this object in `repo`, which must be already open. Safe to call from
+   * any thread as long as the object is kept alive. */
+  bool Fsck(OstreeRepo* repo) const;
+  boost::filesystem::path RepoRoot() const;
 
  private:
   using childiter = std::list<OSTreeObject::ptr>::iterator;
@@ -85,7 +111,7 @@ class OSTreeObject {
    * of children and add this object as the parent of the new child. */
   void AppendChild(const OSTreeObject::ptr& child);
 
-  /* Parse this object for children. */
+  /* Append all the children of this object. */
   void PopulateChildren();
 
   /* Add queries to the queue for any children whose presence on the server is
@@ -98,6 +124,9 @@ class OSTreeObject {
    * upload it. If any children are missing, query them. */
   void CheckChildren(RequestPool& pool, long rescode);  // NOLINT(google-runtime-int)
 
+  /* Handle a presence check that found this object on the server. */
+  void Present(RequestPool& pool);
+
   /* Handle an error from a presence check. */
   void PresenceError(RequestPool& pool, int64_t rescode);
 
@@ -37,6 +37,16 @@ class OSTreeRepo {
 
   static boost::filesystem::path GetPathForHash(OSTreeHash hash, OstreeObjectType type);
 
+  /**
+   * Make the children of `object` available to GetObject() without waiting.
+   * Repos that fetch objects from a server start fetching them in the
+   * background, and return false until that is over (successfully or not).
+   */
+  virtual bool FetchChildren(const OSTreeObject& object) const {
+    (void)object;
+    return true;
+  }
+
  protected:
   /**
    * Look for an object with a given path, downloading it if necessary and
@@ -0,0 +1,92 @@
+#include "presence_cache.h"
+
+#include "logging/logging.h"
+#include "ostree_repo.h"
+
+// Objects added are written to disk in transactions of this many.
+static const size_t kFlushBatch = 1000;
+
+PresenceCache::PresenceCache(const boost::filesystem::path &path, std::string server,
+                             const unsigned int verify_percent, const uint64_t seed)
+    : db_(path, false, true), server_(std::move(server)), verify_percent_(verify_percent), rng_(seed) {
+  if (sqlite3_exec(db_.get(),
+                   "CREATE TABLE IF NOT EXISTS presence(server TEXT NOT NULL, object TEXT NOT NULL, "
+                   "PRIMARY KEY(server, object)) WITHOUT ROWID;",
+                   nullptr, nullptr, nullptr) != SQLITE_OK) {
+    throw SQLException(std::string("Can't create presence cache: ") + sqlite3_errmsg(db_.get()));
+  }
+
+  SQLiteStatement statement(db_.get(), "SELECT object FROM presence WHERE server = ?;", server_);
+  int result;
+  while ((result = statement.step()) == SQLITE_ROW) {
+    objects_.insert(statement.get_result_col_str(0).value_or(""));
+  }
+  if (result != SQLITE_DONE) {
+    throw SQLException(std::string("Can't read presence cache: ") + sqlite3_errmsg(db_.get()));
+  }
+  LOG_INFO << "Presence cache knows of " << objects_.size() << " objects on " << server_;
+}
+
+PresenceCache::~PresenceCache() {
+  try {
+    Flush();
+  } catch (const std::exception &ex) {
+    LOG_WARNING << "Could not save presence cache: " << ex.what();
+  }
+}
+
+bool PresenceCache::Contains(const OSTreeObject &object) const { return objects_.count(Key(object)) != 0; }
+
+bool PresenceCache::ShouldVerify() {
+  return std::uniform_int_distribution<unsigned int>(0, 99)(rng_) < verify_percent_;
+}
+
+void PresenceCache::Add(const OSTreeObject &object) {
+  std::string key = Key(object);
+  if (objects_.insert(key).second) {
+    unsaved_.push_back(std::move(key));
+  }
+  if (unsaved_.size() >= kFlushBatch) {
+    Flush();
+  }
+}
+
+void PresenceCache::Clear() {
+  objects_.clear();
+  unsaved_.clear();
+  SQLiteStatement statement(db_.get(), "DELETE FROM presence WHERE server = ?;", server_);
+  if (statement.step() != SQLITE_DONE) {
+    LOG_WARNING << "Could not clear presence cache: " << sqlite3_errmsg(db_.get());
+  }
+}
+
+void PresenceCache::Flush() {
+  // Objects that fail to be saved are not retried, they will be checked with the server again next time.
+  std::vector<std::string> unsaved;
+  unsaved.swap(unsaved_);
+  if (unsaved.empty()) {
+    return;
+  }
+  if (sqlite3_exec(db_.get(), "BEGIN TRANSACTION;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+    LOG_WARNING << "Could not update presence cache: " << sqlite3_errmsg(db_.get());
+    return;
+  }
+  for (const auto &key : unsaved) {
+    SQLiteStatement statement(db_.get(), &db_.statements(), "INSERT OR IGNORE INTO presence VALUES (?, ?);",
+                              server_, key);
+    if (statement.step() != SQLITE_DONE) {
+      LOG_WARNING << "Could not update presence cache: " << sqlite3_errmsg(db_.get());
+      sqlite3_exec(db_.get(), "ROLLBACK TRANSACTION;", nullptr, nullptr, nullptr);
+      return;
+    }
+  }
+  if (sqlite3_exec(db_.get(), "COMMIT TRANSACTION;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+    LOG_WARNING << "Could not update presence cache: " << sqlite3_errmsg(db_.get());
+  }
+}
+
+std::string PresenceCache::Key(const OSTreeObject &object) {
+  return OSTreeRepo::GetPathForHash(object.hash(), object.type()).string();
+}
+
+// vim: set tabstop=2 shiftwidth=2 expandtab:
@@ -0,0 +1,57 @@
+#ifndef SOTA_CLIENT_TOOLS_PRESENCE_CACHE_H_
+#define SOTA_CLIENT_TOOLS_PRESENCE_CACHE_H_
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+#include "ostree_object.h"
+#include "storage/sql_utils.h"
+
+/**
+ * Objects known to be on a Treehub server, remembered between runs in an
+ * SQLite database so that repeated pushes of similar commits don't have to
+ * ask the server about every object again.
+ *
+ * Entries are never expired: a small share of the objects found in the cache
+ * are still checked with the server (`verify_percent`), and a stale entry
+ * means that the whole cache for that server can't be trusted any more.
+ */
+class PresenceCache {
+ public:
+  PresenceCache(const boost::filesystem::path& path, std::string server, unsigned int verify_percent,
+                uint64_t seed = std::random_device{}());
+  ~PresenceCache();
+  PresenceCache(const PresenceCache&) = delete;
+  PresenceCache(PresenceCache&&) = delete;
+  PresenceCache& operator=(const PresenceCache&) = delete;
+  PresenceCache& operator=(PresenceCache&&) = delete;
+
+  bool Contains(const OSTreeObject& object) const;
+  /** Whether an object found in the cache should be checked with the server anyway. */
+  bool ShouldVerify();
+  void Add(const OSTreeObject& object);
+  /** Forget all the objects of this server. */
+  void Clear();
+  /** Write the added objects to disk. Also done when destroyed. */
+  void Flush();
+
+  size_t size() const { return objects_.size(); }
+
+ private:
+  static std::string Key(const OSTreeObject& object);
+
+  SQLiteConnection db_;
+  const std::string server_;
+  const unsigned int verify_percent_;
+  std::mt19937_64 rng_;
+  std::unordered_set<std::string> objects_;
+  std::vector<std::string> unsaved_;
+};
+
+// vim: set tabstop=2 shiftwidth=2 expandtab:
+#endif  // SOTA_CLIENT_TOOLS_PRESENCE_CACHE_H_
@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+
+#include "ostree_dir_repo.h"
+#include "ostree_object.h"
+#include "presence_cache.h"
+#include "utilities/utils.h"
+
+static const char *kRepoPath = "tests/sota_tools/corrupt-repo";
+static const char *kObject1 = "2ee758031340b51db1c0229bddd8f64bca4b131728d2bfb20c0c8671b1259a38";
+static const char *kObject2 = "4145b1a9bade30efb28ff921f7a555ff82ba7d3b7b83b968084436167912fa83";
+
+/* Objects are remembered between runs, separately for each server. */
+TEST(PresenceCache, Persist) {
+  TemporaryDirectory temp_dir;
+  const auto path = temp_dir.Path() / "presence.db";
+  OSTreeDirRepo repo(kRepoPath);
+  auto object1 = repo.GetObject(OSTreeHash::Parse(kObject1), OstreeObjectType::OSTREE_OBJECT_TYPE_FILE);
+  auto object2 = repo.GetObject(OSTreeHash::Parse(kObject2), OstreeObjectType::OSTREE_OBJECT_TYPE_FILE);
+
+  {
+    PresenceCache cache(path, "https://treehub-a", 0);
+    EXPECT_FALSE(cache.Contains(*object1));
+    cache.Add(*object1);
+    EXPECT_TRUE(cache.Contains(*object1));
+    EXPECT_FALSE(cache.Contains(*object2));
+  }
+  {
+    PresenceCache cache(path, "https://treehub-a", 0);
+    EXPECT_EQ(cache.size(), 1U);
+    EXPECT_TRUE(cache.Contains(*object1));
+    cache.Add(*object2);
+    cache.Flush();
+  }
+  {
+    PresenceCache cache(path, "https://treehub-b", 0);
+    EXPECT_FALSE(cache.Contains(*object1));
+    cache.Add(*object1);
+  }
+  {
+    PresenceCache cache(path, "https://treehub-a", 0);
+    EXPECT_EQ(cache.size(), 2U);
+    cache.Clear();
+    EXPECT_FALSE(cache.Contains(*object1));
+  }
+  {
+    PresenceCache cache_a(path, "https://treehub-a", 0);
+    EXPECT_EQ(cache_a.size(), 0U);
+    PresenceCache cache_b(path, "https://treehub-b", 0);
+    EXPECT_TRUE(cache_b.Contains(*object1));
+  }
+}
+
+/* About verify_percent of the objects found are checked with the server anyway. */
+TEST(PresenceCache, Verify) {
+  TemporaryDirectory temp_dir;
+  const auto path = temp_dir.Path() / "presence.db";
+
+  PresenceCache never(path, "https://treehub", 0);
+  PresenceCache always(path, "https://treehub", 100);
+  PresenceCache sometimes(path, "https://treehub", 10, 42);
+  int verified = 0;
+  for (int i = 0; i < 10000; ++i) {
+    EXPECT_FALSE(never.ShouldVerify());
+    EXPECT_TRUE(always.ShouldVerify());
+    verified += sometimes.ShouldVerify() ? 1 : 0;
+  }
+  EXPECT_GT(verified, 800);
+  EXPECT_LT(verified, 1200);
+}
+
+#ifndef __NO_MAIN__
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+#endif
+
+// vim: set tabstop=2 shiftwidth=2 expandtab:
@@ -0,0 +1,47 @@
+#include "push_plan.h"
+
+#include <vector>
+
+#include "logging/logging.h"
+
+PushPlan::PushPlan(const OSTreeRepo &repo, const OSTreeHash &commit, const OSTreeHash *base) {
+  if (base != nullptr) {
+    try {
+      Walk(repo.GetObject(*base, OstreeObjectType::OSTREE_OBJECT_TYPE_COMMIT), ObjectSet(), &base_);
+    } catch (const OSTreeObjectMissing &error) {
+      LOG_WARNING << "Base commit " << *base << " is not complete in the local repo, planning the whole commit";
+      base_.clear();
+    }
+  }
+  Walk(repo.GetObject(commit, OstreeObjectType::OSTREE_OBJECT_TYPE_COMMIT), base_, &objects_);
+}
+
+void PushPlan::Apply() const {
+  for (const auto &object : base_) {
+    object.second->AssumePresent();
+  }
+}
+
+uintmax_t PushPlan::bytes() const {
+  uintmax_t total = 0;
+  for (const auto &object : objects_) {
+    total += object.second->GetSize();
+  }
+  return total;
+}
+
+void PushPlan::Walk(const OSTreeObject::ptr &root, const ObjectSet &skip, ObjectSet *objects) {
+  std::vector<OSTreeObject::ptr> stack{root};
+  while (!stack.empty()) {
+    OSTreeObject::ptr object = stack.back();
+    stack.pop_back();
+    if (skip.count(object->hash()) != 0 || !objects->emplace(object->hash(), object).second) {
+      continue;
+    }
+    for (const OSTreeObject::ptr &child : object->Children()) {
+      stack.push_back(child);
+    }
+  }
+}
+
+// vim: set tabstop=2 shiftwidth=2 expandtab:
@@ -0,0 +1,49 @@
+#ifndef SOTA_CLIENT_TOOLS_PUSH_PLAN_H_
+#define SOTA_CLIENT_TOOLS_PUSH_PLAN_H_
+
+#include <map>
+
+#include "ostree_hash.h"
+#include "ostree_object.h"
+#include "ostree_repo.h"
+
+/**
+ * The objects of a commit that may have to be uploaded, worked out from the
+ * local repo before talking to the server.
+ *
+ * With a base commit that the server already has completely (usually the one
+ * its copy of the ref points to), everything reachable from the base is left
+ * out: only the difference between the two commits is queried and uploaded.
+ * The base has to be in the local repo too, otherwise the whole commit is
+ * planned as without a base.
+ */
+class PushPlan {
+ public:
+  /* Can throw OSTreeObjectMissing if the commit is not complete in `repo`. */
+  PushPlan(const OSTreeRepo& repo, const OSTreeHash& commit, const OSTreeHash* base = nullptr);
+
+  /* Mark the objects of the base commit as present on the server, so that
+   * pushing the commit never asks about them. */
+  void Apply() const;
+
+  bool has_base() const { return !base_.empty(); }
+  /** The number of objects left out because they are in the base commit. */
+  size_t base_objects() const { return base_.size(); }
+  /** The number of objects to query, and upload if they turn out to be missing. */
+  size_t objects() const { return objects_.size(); }
+  /** The total size of those objects. */
+  uintmax_t bytes() const;
+
+ private:
+  using ObjectSet = std::map<OSTreeHash, OSTreeObject::ptr>;
+
+  /* Add every object reachable from `root` to `objects`, except for those in
+   * `skip` and their children. */
+  static void Walk(const OSTreeObject::ptr& root, const ObjectSet& skip, ObjectSet* objects);
+
+  ObjectSet base_;
+  ObjectSet objects_;
+};
+
+// vim: set tabstop=2 shiftwidth=2 expandtab:
+#endif  // SOTA_CLIENT_TOOLS_PUSH_PLAN_H_
@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/filesystem.hpp>
+
+#include "ostree_dir_repo.h"
+#include "ostree_object.h"
+#include "push_plan.h"
+#include "utilities/utils.h"
+
+static const char *kRepoPath = "tests/sota_tools/bigger_repo";
+static const char *kCommit = "863de625f305413dc3be306afab7c3f39d8713045cfff812b3af83f9722851f0";
+static const char *kNotInRepo = "16ef2f2629dc9263fdf3c0f032563a2d757623bbc11cf99df25c3c3f258dccbe";
+
+/* Without a base, every object of the commit is planned. */
+TEST(PushPlan, WholeCommit) {
+  OSTreeDirRepo repo(kRepoPath);
+  PushPlan plan(repo, OSTreeHash::Parse(kCommit));
+  EXPECT_FALSE(plan.has_base());
+  EXPECT_EQ(plan.objects(), 66U);
+  EXPECT_EQ(plan.bytes(), 5666U);
+}
+
+/* Nothing is left to push when the base is the commit itself. */
+TEST(PushPlan, SameBase) {
+  OSTreeDirRepo repo(kRepoPath);
+  const OSTreeHash commit = OSTreeHash::Parse(kCommit);
+  PushPlan plan(repo, commit, &commit);
+  EXPECT_TRUE(plan.has_base());
+  EXPECT_EQ(plan.base_objects(), 66U);
+  EXPECT_EQ(plan.objects(), 0U);
+  EXPECT_EQ(plan.bytes(), 0U);
+
+  auto root = repo.GetObject(commit, OstreeObjectType::OSTREE_OBJECT_TYPE_COMMIT);
+  EXPECT_EQ(root->is_on_server(), PresenceOnServer::kObjectStateUnknown);
+  plan.Apply();
+  EXPECT_EQ(root->is_on_server(), PresenceOnServer::kObjectPresent);
+}
+
+/* A base that isn't in the local repo is ignored. */
+TEST(PushPlan, MissingBase) {
+  OSTreeDirRepo repo(kRepoPath);
+  const OSTreeHash base = OSTreeHash::Parse(kNotInRepo);
+  PushPlan plan(repo, OSTreeHash::Parse(kCommit), &base);
+  EXPECT_FALSE(plan.has_base());
+  EXPECT_EQ(plan.objects(), 66U);
+
+  plan.Apply();
+  auto root = repo.GetObject(OSTreeHash::Parse(kCommit), OstreeObjectType::OSTREE_OBJECT_TYPE_COMMIT);
+  EXPECT_EQ(root->is_on_server(), PresenceOnServer::kObjectStateUnknown);
+}
+
+static void WriteFile(const boost::filesystem::path &path, const std::string &content) {
+  Utils::writeFile(path, content);
+  boost::filesystem::permissions(path, boost::filesystem::perms(0644));
+}
+
+/* Commit `tree` to a branch of its own in the archive repo `repo`, with fixed
+ * ownership so that equal directories end up as equal objects. */
+static OSTreeHash Commit(const boost::filesystem::path &repo, const boost::filesystem::path &tree,
+                         const std::string &branch) {
+  std::string output;
+  const int result = Utils::shell("ostree --repo=" + repo.string() + " commit --branch=" + branch +
+                                      " --owner-uid=0 --owner-gid=0 --no-xattrs " + tree.string(),
+                                  &output);
+  EXPECT_EQ(result, 0) << output;
+  return OSTreeHash::Parse(boost::algorithm::trim_copy(output));
+}
+
+static OSTreeObject::ptr ChildOfType(const OSTreeObject::ptr &object, OstreeObjectType type) {
+  for (const auto &child : object->Children()) {
+    if (child->type() == type) {
+      return child;
+    }
+  }
+  return nullptr;
+}
+
+/* Only what a commit doesn't share with its base is planned. Applying the plan
+ * marks the shared subtree as present, so that it is never queried. */
+TEST(PushPlan, PartlySharedTree) {
+  TemporaryDirectory temp_dir;
+  const boost::filesystem::path repo_path = temp_dir / "repo";
+  const boost::filesystem::path tree = temp_dir / "tree";
+  std::string output;
+  ASSERT_EQ(Utils::shell("ostree init --mode=archive-z2 --repo=" + repo_path.string(), &output, true), 0) << output;
+
+  boost::filesystem::create_directories(tree / "shared");
+  boost::filesystem::permissions(tree, boost::filesystem::perms(0755));
+  boost::filesystem::permissions(tree / "shared", boost::filesystem::perms(0755));
+  WriteFile(tree / "shared" / "a", "shared file a");
+  WriteFile(tree / "shared" / "b", "shared file b");
+  WriteFile(tree / "x", "old version of x");
+  const OSTreeHash base = Commit(repo_path, tree, "base");
+  WriteFile(tree / "x", "new version of x");
+  const OSTreeHash commit = Commit(repo_path, tree, "new");
+
+  OSTreeDirRepo repo(repo_path);
+  PushPlan plan(repo, commit, &base);
+  EXPECT_TRUE(plan.has_base());
+  // The commit, the root dirtree, a single dirmeta for both directories, the
+  // shared dirtree and the three files.
+  EXPECT_EQ(plan.base_objects(), 7U);
+  // The new commit, its root dirtree and the new x.
+  EXPECT_EQ(plan.objects(), 3U);
+
+  auto root = repo.GetObject(commit, OstreeObjectType::OSTREE_OBJECT_TYPE_COMMIT);
+  auto root_tree = ChildOfType(root, OstreeObjectType::OSTREE_OBJECT_TYPE_DIR_TREE);
+  ASSERT_NE(root_tree, nullptr);
+  auto shared_tree = ChildOfType(root_tree, OstreeObjectType::OSTREE_OBJECT_TYPE_DIR_TREE);
+  auto new_file = ChildOfType(root_tree, OstreeObjectType::OSTREE_OBJECT_TYPE_FILE);
+  ASSERT_NE(shared_tree, nullptr);
+  ASSERT_NE(new_file, nullptr);
+
+  plan.Apply();
+  EXPECT_EQ(shared_tree->is_on_server(), PresenceOnServer::kObjectPresent);
+  for (const auto &child : shared_tree->Children()) {
+    EXPECT_EQ(child->is_on_server(), PresenceOnServer::kObjectPresent);
+  }
+  EXPECT_EQ(root->is_on_server(), PresenceOnServer::kObjectStateUnknown);
+  EXPECT_EQ(root_tree->is_on_server(), PresenceOnServer::kObjectStateUnknown);
+  EXPECT_EQ(new_file->is_on_server(), PresenceOnServer::kObjectStateUnknown);
+}
+
+#ifndef __NO_MAIN__
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+#endif
+
+// vim: set tabstop=2 shiftwidth=2 expandtab:
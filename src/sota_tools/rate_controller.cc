@@ -2,6 +2,7 @@
 
 #include <algorithm>  // min
 #include <cassert>
+#include <stdexcept>
 
 #include "logging/logging.h"
 
@@ -9,26 +10,110 @@ const RateController::clock::duration RateController::kMaxSleepTime = std::chron
 
 const RateController::clock::duration RateController::kInitialSleepTime = std::chrono::seconds(1);
 
-RateController::RateController(const int concurrency_cap) : concurrency_cap_(concurrency_cap) { CheckInvariants(); }
+const double DelayControl::kAlpha = 1.0;
+const double DelayControl::kBeta = 3.0;
+const double DelayControl::kGain = 0.25;
+const DelayControl::clock::duration DelayControl::kBaseWindow = std::chrono::seconds(5);
+
+int AimdControl::Succeeded(const int concurrency, const clock::time_point start_time,
+                           const clock::time_point end_time, const uintmax_t bytes, const bool fresh) {
+  (void)start_time;
+  (void)end_time;
+  (void)bytes;
+  return fresh ? concurrency + 1 : concurrency;
+}
+
+int DelayControl::Succeeded(const int concurrency, const clock::time_point start_time,
+                            const clock::time_point end_time, const uintmax_t bytes, const bool fresh) {
+  const clock::duration latency = end_time - start_time;
+  if (latency > clock::duration(0)) {
+    size_t size_class = 0;
+    for (uintmax_t rest = bytes; rest != 0; rest >>= 1) {
+      ++size_class;
+    }
+    Base &base = base_[size_class];
+    if (base.latency == clock::duration(0) || latency <= base.latency || end_time - base.seen > kBaseWindow) {
+      base.latency = latency;
+      base.seen = end_time;
+    }
+    const double ratio =
+        std::chrono::duration<double>(base.latency).count() / std::chrono::duration<double>(latency).count();
+    ratio_ = ratio_ < 0 ? ratio : ratio_ + kGain * (ratio - ratio_);
+  }
+  if (!fresh || ratio_ < 0) {
+    return concurrency;
+  }
+
+  // Vegas' (expected rate - actual rate) * base latency, in requests.
+  const double waiting = concurrency * (1.0 - ratio_);
+  if (slow_start_) {
+    if (waiting < kAlpha) {
+      return concurrency * 2;
+    }
+    slow_start_ = false;
+  }
+  if (waiting < kAlpha) {
+    return concurrency + 1;
+  }
+  if (waiting > kBeta) {
+    return concurrency - 1;
+  }
+  return concurrency;
+}
+
+CongestionAlgorithm CongestionAlgorithmFromString(const std::string &name) {
+  if (name == "aimd") {
+    return CongestionAlgorithm::kAimd;
+  }
+  if (name == "delay") {
+    return CongestionAlgorithm::kDelay;
+  }
+  throw std::invalid_argument("Unknown congestion control algorithm: " + name);
+}
+
+std::unique_ptr<CongestionControl> MakeCongestionControl(const CongestionAlgorithm algorithm) {
+  switch (algorithm) {
+    case CongestionAlgorithm::kDelay:
+      return std::unique_ptr<CongestionControl>(new DelayControl());
+    case CongestionAlgorithm::kAimd:
+    default:
+      return std::unique_ptr<CongestionControl>(new AimdControl());
+  }
+}
+
+RateController::RateController(const int concurrency_cap, std::unique_ptr<CongestionControl> control)
+    : concurrency_cap_(concurrency_cap),
+      control_(control ? std::move(control) : MakeCongestionControl(CongestionAlgorithm::kAimd)) {
+  CheckInvariants();
+}
 
 void RateController::RequestCompleted(const clock::time_point start_time, const clock::time_point end_time,
-                                      const bool succeeded) {
-  if (last_concurrency_update_ < start_time) {
-    const int prev_concurrency = max_concurrency_;
-    last_concurrency_update_ = end_time;
-    if (succeeded) {
-      max_concurrency_ = std::min(max_concurrency_ + 1, concurrency_cap_);
+                                      const bool succeeded, const uintmax_t bytes) {
+  // Only requests that started after the last change tell how the change worked out.
+  const bool fresh = last_concurrency_update_ < start_time;
+  const int prev_concurrency = max_concurrency_;
+  if (succeeded) {
+    if (fresh) {
       sleep_time_ = clock::duration(0);
-    } else {
-      if (max_concurrency_ >= 2) {
-        max_concurrency_ = max_concurrency_ / 2;
-      } else {
-        sleep_time_ = std::max(sleep_time_ * 2, kInitialSleepTime);
-      }
     }
-    if (prev_concurrency != max_concurrency_) {
-      LOG_DEBUG << "Concurrency limit is now: " << max_concurrency_;
+    const int concurrency = control_->Succeeded(max_concurrency_, start_time, end_time, bytes, fresh);
+    // Still backing off after a failure with a single request in flight.
+    if (sleep_time_ == clock::duration(0)) {
+      max_concurrency_ = std::max(1, std::min(concurrency, concurrency_cap_));
+    }
+  } else if (fresh) {
+    if (max_concurrency_ >= 2) {
+      max_concurrency_ = max_concurrency_ / 2;
+    } else {
+      sleep_time_ = std::max(sleep_time_ * 2, kInitialSleepTime);
     }
+    control_->Failed();
+  }
+  if (fresh || prev_concurrency != max_concurrency_) {
+    last_concurrency_update_ = end_time;
+  }
+  if (prev_concurrency != max_concurrency_) {
+    LOG_DEBUG << "Concurrency limit is now: " << max_concurrency_;
   }
   CheckInvariants();
 }
@@ -1,29 +1,122 @@
 #ifndef SOTA_CLIENT_TOOLS_RATE_CONTROLLER_H_
 #define SOTA_CLIENT_TOOLS_RATE_CONTROLLER_H_
 
+#include <array>
 #include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/**
+ * The part of RateController that decides how many requests to keep in
+ * flight while requests succeed. Failures are handled by RateController the
+ * same way for all algorithms.
+ */
+class CongestionControl {
+ public:
+  using clock = std::chrono::steady_clock;
+  CongestionControl() = default;
+  virtual ~CongestionControl() = default;
+  CongestionControl(const CongestionControl&) = delete;
+  CongestionControl(CongestionControl&&) = delete;
+  CongestionControl& operator=(const CongestionControl&) = delete;
+  CongestionControl& operator=(CongestionControl&&) = delete;
+
+  /**
+   * A request that transferred `bytes` succeeded. `fresh` is true if the
+   * request started after the concurrency was last changed, i.e. it is the
+   * first result of the current setting.
+   * @return The concurrency to use from now on
+   */
+  virtual int Succeeded(int concurrency, clock::time_point start_time, clock::time_point end_time, uintmax_t bytes,
+                        bool fresh) = 0;
+
+  /** A request failed, and RateController has cut the concurrency. */
+  virtual void Failed() {}
+};
+
+/**
+ * One more request in flight per round trip, as long as requests succeed.
+ * Combined with the multiplicative decrease on failure in RateController
+ * this is the original TCP AIMD scheme.
+ */
+class AimdControl : public CongestionControl {
+ public:
+  int Succeeded(int concurrency, clock::time_point start_time, clock::time_point end_time, uintmax_t bytes,
+                bool fresh) override;
+};
+
+/**
+ * Delay based control, loosely after TCP Vegas.
+ *
+ * The latency of each request is compared to the lowest latency seen
+ * recently for requests of about the same size. From the ratio between the
+ * two, the number of requests waiting at the server (or at the bottleneck
+ * link) is estimated. Once per round trip the concurrency is raised while
+ * fewer than kAlpha requests are waiting and lowered when more than kBeta are,
+ * so that the server is kept busy without its queue growing until it starts
+ * failing. At the start the concurrency doubles every round trip until
+ * requests start waiting, like TCP slow start.
+ */
+class DelayControl : public CongestionControl {
+ public:
+  int Succeeded(int concurrency, clock::time_point start_time, clock::time_point end_time, uintmax_t bytes,
+                bool fresh) override;
+  void Failed() override { slow_start_ = false; }
+
+ private:
+  static const double kAlpha;
+  static const double kBeta;
+  /** Weight of a new sample in the average latency ratio. */
+  static const double kGain;
+  /** The lowest latency is forgotten after this long, in case the route or server changes. */
+  static const clock::duration kBaseWindow;
+
+  struct Base {
+    clock::duration latency{0};
+    clock::time_point seen;
+  };
+
+  /** Requests are grouped by the number of bits needed for their size. */
+  std::array<Base, 65> base_{};
+  double ratio_{-1.0};
+  bool slow_start_{true};
+};
+
+enum class CongestionAlgorithm {
+  kAimd,
+  kDelay,
+};
+
+/** Parse "aimd" or "delay". Throws std::invalid_argument for anything else. */
+CongestionAlgorithm CongestionAlgorithmFromString(const std::string& name);
+
+std::unique_ptr<CongestionControl> MakeCongestionControl(CongestionAlgorithm algorithm);
 
 /**
  * Control the rate of outgoing requests.
- * This receives signals from the network layer when a request finishes of the form (start time, end time, success).
+ * This receives signals from the network layer when a request finishes of the form (start time, end time, success,
+ * bytes transferred).
  * It generates controls for the network layer in the form of:
  *    MaxConcurrency - The current estimate of the number of parallel requests that can be opened
  *    Sleep() - The number of seconds to sleep before sending the next request. 0.0 if MaxConcurrency is > 1
  *    Failed() - A boolean indicating that the server is broken, and to report an error up to the user.
- * The congestion control is loosely based on the original TCP AIMD scheme. Better performance might be available by
- * Stealing ideas from the later TCP conjection control algorithms
+ * How the concurrency grows while requests succeed is up to a CongestionControl algorithm. On failure the
+ * concurrency is halved, and once it is down to 1 requests are spaced out by exponentially growing sleeps.
  */
 class RateController {
  public:
   using clock = std::chrono::steady_clock;
-  explicit RateController(int concurrency_cap = 30);
+  /** Without a `control`, use AimdControl. */
+  explicit RateController(int concurrency_cap = 30, std::unique_ptr<CongestionControl> control = nullptr);
   ~RateController() = default;
   RateController(const RateController&) = delete;
   RateController(RateController&&) = delete;
   RateController operator=(const RateController&) = delete;
   RateController operator=(RateController&&) = delete;
 
-  void RequestCompleted(clock::time_point start_time, clock::time_point end_time, bool succeeded);
+  void RequestCompleted(clock::time_point start_time, clock::time_point end_time, bool succeeded,
+                        uintmax_t bytes = 0);
 
   int MaxConcurrency() const;
 
@@ -45,6 +138,7 @@ class RateController {
   static const clock::duration kInitialSleepTime;
 
   const int concurrency_cap_;
+  const std::unique_ptr<CongestionControl> control_;
   /**
    * After making a change to the system, we wait a full round-trip time to
    * see any effects of the change. This is the last time that an change was
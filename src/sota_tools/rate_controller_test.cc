@@ -1,5 +1,13 @@
 #include <gtest/gtest.h>
 
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "logging/logging.h"
 #include "rate_controller.h"
 
 /* Initial rate controller status is good. */
@@ -48,6 +56,199 @@ TEST(control, good_results_improve_concurrency) {
   EXPECT_GT(dut.MaxConcurrency(), initial_concurrency);
 }
 
+/* The delay based algorithm backs off when latency grows. */
+TEST(control, delay_backs_off_on_latency) {
+  RateController dut(30, MakeCongestionControl(CongestionAlgorithm::kDelay));
+  RateController::clock::time_point t = RateController::clock::now();
+  for (int i = 0; i < 10; i++) {
+    dut.RequestCompleted(t, t + std::chrono::milliseconds(100), true, 1000);
+    t += std::chrono::milliseconds(100);
+  }
+  const int fast_concurrency = dut.MaxConcurrency();
+  EXPECT_EQ(fast_concurrency, 30);
+  for (int i = 0; i < 20; i++) {
+    dut.RequestCompleted(t, t + std::chrono::milliseconds(400), true, 1000);
+    t += std::chrono::milliseconds(400);
+  }
+  EXPECT_LT(dut.MaxConcurrency(), fast_concurrency);
+  EXPECT_GT(dut.MaxConcurrency(), 1);
+}
+
+/* Only the known algorithms can be chosen. */
+TEST(control, algorithm_names) {
+  EXPECT_EQ(CongestionAlgorithmFromString("aimd"), CongestionAlgorithm::kAimd);
+  EXPECT_EQ(CongestionAlgorithmFromString("delay"), CongestionAlgorithm::kDelay);
+  EXPECT_THROW(CongestionAlgorithmFromString("cubic"), std::invalid_argument);
+}
+
+namespace {
+
+using clock = RateController::clock;
+
+/*
+ * A simulated Treehub. It serves `workers` requests at a time and keeps up to
+ * `queue_limit` more waiting. Requests beyond that fail straight away with a
+ * 500. Serving a request takes the latency at the time plus its size over the
+ * bandwidth of a worker.
+ */
+struct SimServer {
+  int workers;
+  size_t queue_limit;
+  double bytes_per_second;
+  std::function<clock::duration(clock::duration)> latency;  // by time since the start of the push
+};
+
+struct SimResult {
+  clock::duration push_time;
+  int failures;
+  bool server_failed;
+};
+
+/* Object sizes of a push: a presence check with no payload for every upload. */
+std::vector<uintmax_t> SimObjects(const int count) {
+  std::mt19937 gen(42);  // NOLINT(cert-msc32-c, cert-msc51-cpp)
+  std::vector<uintmax_t> sizes;
+  for (int i = 0; i < count; i++) {
+    sizes.push_back(0);
+    sizes.push_back((uintmax_t{1} << (gen() % 20)) + gen() % 1024);
+  }
+  return sizes;
+}
+
+/*
+ * Push objects of `sizes` to `server` the way RequestPool does: as many
+ * requests in flight as the RateController allows, failed requests retried
+ * later and nothing sent while the RateController says to sleep. Everything
+ * runs on simulated time, so the result is the same on every run.
+ */
+SimResult SimulatePush(const SimServer &server, const std::vector<uintmax_t> &sizes,
+                       const CongestionAlgorithm algorithm) {
+  struct Request {
+    size_t object;
+    clock::time_point start_time;
+    bool ok;
+  };
+
+  RateController controller(30, MakeCongestionControl(algorithm));
+  const clock::time_point t0 = clock::time_point() + std::chrono::hours(1);
+  clock::time_point now = t0;
+  clock::time_point resume = t0;
+  const auto serve_time = [&](const size_t object, const clock::time_point t) {
+    return server.latency(t - t0) + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(
+                                        static_cast<double>(sizes[object]) / server.bytes_per_second));
+  };
+
+  std::deque<size_t> todo;
+  for (size_t i = 0; i < sizes.size(); i++) {
+    todo.push_back(i);
+  }
+  std::multimap<clock::time_point, Request> completions;
+  std::deque<Request> server_queue;
+  int busy_workers = 0;
+  int in_flight = 0;
+  SimResult result{clock::duration(0), 0, false};
+
+  while (!todo.empty() || in_flight > 0) {
+    if (now >= resume) {
+      while (!todo.empty() && in_flight < controller.MaxConcurrency()) {
+        const Request request{todo.front(), now, true};
+        todo.pop_front();
+        in_flight++;
+        if (busy_workers < server.workers) {
+          busy_workers++;
+          completions.emplace(now + serve_time(request.object, now), request);
+        } else if (server_queue.size() < server.queue_limit) {
+          server_queue.push_back(request);
+        } else {
+          completions.emplace(now + server.latency(now - t0), Request{request.object, now, false});
+        }
+      }
+    }
+    auto next = completions.begin();
+    if (next == completions.end() || (resume > now && resume < next->first)) {
+      now = resume;
+      continue;
+    }
+    now = next->first;
+    const Request request = next->second;
+    completions.erase(next);
+
+    if (request.ok) {
+      if (server_queue.empty()) {
+        busy_workers--;
+      } else {
+        completions.emplace(now + serve_time(server_queue.front().object, now), server_queue.front());
+        server_queue.pop_front();
+      }
+    }
+    in_flight--;
+    controller.RequestCompleted(request.start_time, now, request.ok, request.ok ? sizes[request.object] : 0);
+    if (!request.ok) {
+      result.failures++;
+      todo.push_back(request.object);
+    }
+    if (controller.ServerHasFailed()) {
+      result.server_failed = true;
+      break;
+    }
+    resume = std::max(resume, now + controller.GetSleepTime());
+  }
+  result.push_time = now - t0;
+  return result;
+}
+
+void ComparePush(const SimServer &server, SimResult *aimd, SimResult *delay) {
+  const auto sizes = SimObjects(2000);
+  *aimd = SimulatePush(server, sizes, CongestionAlgorithm::kAimd);
+  *delay = SimulatePush(server, sizes, CongestionAlgorithm::kDelay);
+  const auto seconds = [](const SimResult &r) { return std::chrono::duration<double>(r.push_time).count(); };
+  LOG_DEBUG << "aimd: " << seconds(*aimd) << " s, " << aimd->failures << " failures; delay: " << seconds(*delay)
+            << " s, " << delay->failures << " failures";
+  EXPECT_FALSE(aimd->server_failed);
+  EXPECT_FALSE(delay->server_failed);
+}
+
+std::function<clock::duration(clock::duration)> Constant(const clock::duration latency) {
+  return [latency](const clock::duration /*since_start*/) { return latency; };
+}
+
+}  // namespace
+
+/* A server with plenty of capacity far away: get to full speed quickly. */
+TEST(simulation, fast_server) {
+  const SimServer server{100, 1000, 10e6, Constant(std::chrono::milliseconds(100))};
+  SimResult aimd{};
+  SimResult delay{};
+  ComparePush(server, &aimd, &delay);
+  EXPECT_EQ(delay.failures, 0);
+  EXPECT_LT(delay.push_time, aimd.push_time);
+}
+
+/* A server that can only take a few requests at a time: don't drive it into errors. */
+TEST(simulation, slow_server) {
+  const SimServer server{4, 4, 1e6, Constant(std::chrono::milliseconds(50))};
+  SimResult aimd{};
+  SimResult delay{};
+  ComparePush(server, &aimd, &delay);
+  EXPECT_LT(delay.failures, aimd.failures);
+  EXPECT_LE(delay.push_time, aimd.push_time);
+}
+
+/* The server gets slower halfway through, and then recovers. */
+TEST(simulation, latency_step) {
+  const SimServer server{16, 16, 2e6, [](const clock::duration since_start) {
+                           const bool slow = since_start > std::chrono::seconds(5) &&
+                                             since_start < std::chrono::seconds(15);
+                           return clock::duration(slow ? std::chrono::milliseconds(300)
+                                                       : std::chrono::milliseconds(30));
+                         }};
+  SimResult aimd{};
+  SimResult delay{};
+  ComparePush(server, &aimd, &delay);
+  EXPECT_LE(delay.failures, aimd.failures);
+  EXPECT_LE(delay.push_time, aimd.push_time);
+}
+
 #ifndef __NO_MAIN__
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
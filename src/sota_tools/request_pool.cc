@@ -7,12 +7,17 @@
 
 #include "logging/logging.h"
 
-RequestPool::RequestPool(TreehubServer& server, const int max_curl_requests, const RunMode mode, bool fsck_on_upload)
-    : rate_controller_(max_curl_requests),
+static const std::chrono::milliseconds kFsckWaitTime{100};
+static const std::chrono::milliseconds kPollTime{10};
+
+RequestPool::RequestPool(TreehubServer& server, const int max_curl_requests, const RunMode mode, bool fsck_on_upload,
+                         PresenceCache* presence_cache, const CongestionAlgorithm algorithm)
+    : rate_controller_(max_curl_requests, MakeCongestionControl(algorithm)),
       running_requests_(0),
       server_(server),
       mode_(mode),
-      fsck_on_upload_(fsck_on_upload),
+      fsck_pool_(fsck_on_upload ? new FsckPool() : nullptr),
+      presence_cache_(presence_cache),
       stopped_(false) {
   curl_global_init(CURL_GLOBAL_DEFAULT);
   multi_ = curl_multi_init();
@@ -40,19 +45,89 @@ RequestPool::~RequestPool() {
 
 void RequestPool::AddQuery(const OSTreeObject::ptr& request) {
   request->LaunchNotify();
-  if (!stopped_) {
+  if (stopped_) {
+    return;
+  }
+  // Objects in the cache are only queried now and then, to catch stale entries.
+  if (presence_cache_ != nullptr && presence_cache_->Contains(*request) && !presence_cache_->ShouldVerify()) {
+    cached_queue_.push_back(request);
+  } else {
     query_queue_.push_back(request);
   }
 }
 
+void RequestPool::ObjectPresent(const OSTreeObject& object) {
+  // Once aborted, the cache may just have been cleared as untrustworthy.
+  if (presence_cache_ != nullptr && !stopped_) {
+    presence_cache_->Add(object);
+  }
+}
+
+void RequestPool::ObjectMissing(const OSTreeObject& object) {
+  if (presence_cache_ != nullptr && presence_cache_->Contains(object)) {
+    // Objects that were skipped because of the cache may be missing too.
+    LOG_ERROR << "Object " << object << " is in the presence cache but not on the server. Clearing the cache; "
+              << "please push again.";
+    presence_cache_->Clear();
+    Abort();
+  }
+}
+
 void RequestPool::AddUpload(const OSTreeObject::ptr& request) {
   request->LaunchNotify();
-  if (!stopped_) {
+  if (stopped_) {
+    return;
+  }
+  // Check object's integrity before uploading them, but after we know they
+  // are not present on the server
+  if (fsck_pool_) {
+    fsck_pool_->Add(request);
+  } else {
     upload_queue_.push_back(request);
   }
 }
 
+void RequestPool::AwaitChildren(const OSTreeObject::ptr& request) {
+  if (!stopped_) {
+    awaiting_children_.push_back(request);
+  }
+}
+
+void RequestPool::CollectFetched() {
+  std::list<OSTreeObject::ptr> awaiting;
+  awaiting.swap(awaiting_children_);
+  for (const auto& object : awaiting) {
+    // Objects whose children are still not there come back to awaiting_children_.
+    object->ChildrenFetched(*this);
+  }
+}
+
+void RequestPool::CollectChecked() {
+  if (!fsck_pool_) {
+    return;
+  }
+  for (const auto& checked : fsck_pool_->TakeResults()) {
+    if (!checked.second) {
+      LOG_ERROR << "Local object " << checked.first << " is corrupt. Aborting upload.";
+      Abort();
+      return;
+    }
+    if (!stopped_) {
+      upload_queue_.push_back(checked.first);
+    }
+  }
+}
+
 void RequestPool::LoopLaunch() {
+  CollectChecked();
+  CollectFetched();
+  // Handled here rather than in AddQuery(), which is called while the parents are being processed.
+  while (!cached_queue_.empty()) {
+    OSTreeObject::ptr cur = cached_queue_.front();
+    cached_queue_.pop_front();
+    cur->PresentInCache(*this);
+    cache_hits_++;
+  }
   while (running_requests_ < rate_controller_.MaxConcurrency() && (!query_queue_.empty() || !upload_queue_.empty())) {
     OSTreeObject::ptr cur;
 
@@ -61,15 +136,6 @@ void RequestPool::LoopLaunch() {
       // Uploads
       cur = upload_queue_.front();
       upload_queue_.pop_front();
-      // Check object's integrity before uploading them, but after we know they
-      // are not present on the server
-      if (fsck_on_upload_) {
-        if (!cur->Fsck()) {
-          LOG_ERROR << "Local object " << cur << " is corrupt. Aborting upload.";
-          Abort();
-          continue;
-        }
-      }
       cur->Upload(server_, multi_, mode_);
       put_requests_made_++;
       total_object_size_ += cur->GetSize();
@@ -91,6 +157,19 @@ void RequestPool::LoopLaunch() {
 }
 
 void RequestPool::LoopListen() {
+  const bool checking = fsck_pool_ && fsck_pool_->pending() > 0;
+  const bool fetching = !awaiting_children_.empty();
+  if ((checking || fetching) && running_requests_ == 0) {
+    // Nothing to listen to until an object passes its integrity check or gets
+    // its children.
+    if (checking) {
+      fsck_pool_->WaitForResults(fetching ? kPollTime : kFsckWaitTime);
+    } else {
+      std::this_thread::sleep_for(kPollTime);
+    }
+    return;
+  }
+
   // For more information about the timeout logic, read these:
   // https://curl.haxx.se/libcurl/c/curl_multi_timeout.html
   // https://curl.haxx.se/libcurl/c/curl_multi_fdset.html
@@ -127,6 +206,13 @@ void RequestPool::LoopListen() {
         timeout.tv_sec = timeoutms / 1000;
         timeout.tv_usec = 1000 * (timeoutms % 1000);
       }
+      // Wake up regularly to carry on with the objects that have been checked
+      // or fetched.
+      const auto poll_us = std::chrono::duration_cast<std::chrono::microseconds>(kPollTime).count();
+      if ((checking || fetching) && (timeout.tv_sec > 0 || timeout.tv_usec > poll_us)) {
+        timeout.tv_sec = 0;
+        timeout.tv_usec = poll_us;
+      }
       if (select(maxfd + 1, &fdread, &fdwrite, &fdexcept, &timeout) < 0) {
         throw std::runtime_error(std::string("select failed with error: ") + std::strerror(errno));
       }
@@ -159,7 +245,9 @@ void RequestPool::LoopListen() {
       auto start_time = completed_object->RequestStartTime();
       auto end_time = RateController::clock::now();
       bool server_responded_ok = completed_object->LastOperationResult() == ServerResponse::kOk;
-      rate_controller_.RequestCompleted(start_time, end_time, server_responded_ok);
+      const uintmax_t bytes =
+          completed_object->operation() == CurrentOp::kOstreeObjectUploading ? completed_object->GetSize() : 0;
+      rate_controller_.RequestCompleted(start_time, end_time, server_responded_ok, bytes);
 
       if (rate_controller_.ServerHasFailed()) {
         Abort();
@@ -2,16 +2,20 @@
 #define SOTA_CLIENT_TOOLS_REQUEST_POOL_H_
 
 #include <list>
+#include <memory>
 
 #include <curl/curl.h>
 
+#include "fsck_pool.h"
 #include "garage_common.h"
 #include "ostree_object.h"
+#include "presence_cache.h"
 #include "rate_controller.h"
 
 class RequestPool {
  public:
-  RequestPool(TreehubServer& server, int max_curl_requests, RunMode mode, bool fsck_on_upload);
+  RequestPool(TreehubServer& server, int max_curl_requests, RunMode mode, bool fsck_on_upload,
+              PresenceCache* presence_cache = nullptr, CongestionAlgorithm algorithm = CongestionAlgorithm::kAimd);
   ~RequestPool();
   // Non-Copyable, Non-Movable
   RequestPool(const RequestPool&) = delete;
@@ -21,15 +25,30 @@ class RequestPool {
 
   void AddQuery(const OSTreeObject::ptr& request);
   void AddUpload(const OSTreeObject::ptr& request);
+  /* Hold on to an object until the source repo has fetched its children. */
+  void AwaitChildren(const OSTreeObject::ptr& request);
   void Abort() {
     stopped_ = true;
     query_queue_.clear();
+    cached_queue_.clear();
     upload_queue_.clear();
+    awaiting_children_.clear();
+    if (fsck_pool_) {
+      fsck_pool_->Cancel();
+    }
   };
-  bool is_idle() const { return query_queue_.empty() && upload_queue_.empty() && running_requests_ == 0; }
+  bool is_idle() const {
+    return query_queue_.empty() && cached_queue_.empty() && upload_queue_.empty() && awaiting_children_.empty() &&
+           running_requests_ == 0 && (!fsck_pool_ || fsck_pool_->pending() == 0);
+  }
   bool is_stopped() const { return stopped_; }
   RunMode run_mode() const { return mode_; }
 
+  /* The server has the object. */
+  void ObjectPresent(const OSTreeObject& object);
+  /* The server doesn't have the object. */
+  void ObjectMissing(const OSTreeObject& object);
+
   /**
    * One iteration of request-listen loop, launches multiple requests, then
    * listens for the result.
@@ -41,23 +60,34 @@ class RequestPool {
    */
   int put_requests_made() const { return put_requests_made_; }
   int head_requests_made() const { return head_requests_made_; }
+  /** The number of objects that were not queried because they are in the presence cache. */
+  int cache_hits() const { return cache_hits_; }
   uintmax_t total_object_size() const { return total_object_size_; }
 
  private:
-  void LoopLaunch();  // launches multiple requests from the queues
+  void CollectChecked();  // queues the uploads of objects that passed the integrity check
+  void CollectFetched();  // carries on with the objects whose children have been fetched
+  void LoopLaunch();      // launches multiple requests from the queues
   void LoopListen();  // listens to the result of launched requests
 
   RateController rate_controller_;
   int running_requests_;
   int head_requests_made_{0};
   int put_requests_made_{0};
+  int cache_hits_{0};
   uintmax_t total_object_size_{0};
   TreehubServer& server_;
   CURLM* multi_;
   std::list<OSTreeObject::ptr> query_queue_;
+  // Objects known to be present from the presence cache, handled without a query.
+  std::list<OSTreeObject::ptr> cached_queue_;
   std::list<OSTreeObject::ptr> upload_queue_;
+  // Objects whose children the source repo is still fetching.
+  std::list<OSTreeObject::ptr> awaiting_children_;
   RunMode mode_;
-  bool fsck_on_upload_;
+  // Checks the integrity of objects before they are queued for upload.
+  std::unique_ptr<FsckPool> fsck_pool_;
+  PresenceCache* presence_cache_;
   bool stopped_;
 };
 // vim: set tabstop=2 shiftwidth=2 expandtab:
@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/process.hpp>
+
+#include "deploy.h"
+#include "ostree_dir_repo.h"
+#include "presence_cache.h"
+#include "request_pool.h"
+#include "test_utils.h"
+#include "treehub_server.h"
+
+static const char *kRepoPath = "tests/sota_tools/repo";
+
+std::string port;
+TemporaryDirectory server_dir;
+
+struct PushResult {
+  bool stopped{false};
+  int head_requests{0};
+  int put_requests{0};
+  int cache_hits{0};
+};
+
+/* Push the master commit of kRepoPath like UploadToTreehub() does. */
+static PushResult Push(RunMode mode, PresenceCache *cache) {
+  TreehubServer push_server;
+  push_server.root_url("http://localhost:" + port);
+  OSTreeRepo::ptr src_repo = std::make_shared<OSTreeDirRepo>(kRepoPath);
+  OSTreeObject::ptr root_object =
+      src_repo->GetObject(src_repo->GetRef("master").GetHash(), OstreeObjectType::OSTREE_OBJECT_TYPE_COMMIT);
+
+  RequestPool request_pool(push_server, 4, mode, false, cache);
+  request_pool.AddQuery(root_object);
+  do {
+    request_pool.Loop();
+  } while (CheckPoolState(root_object, request_pool));
+
+  PushResult result;
+  result.stopped = request_pool.is_stopped();
+  result.head_requests = request_pool.head_requests_made();
+  result.put_requests = request_pool.put_requests_made();
+  result.cache_hits = request_pool.cache_hits();
+  return result;
+}
+
+/* Make sure that the server has all the objects and fill `cache` with them. */
+static void Populate(PresenceCache &cache) {
+  const PushResult result = Push(RunMode::kPushTree, &cache);
+  EXPECT_FALSE(result.stopped);
+  EXPECT_EQ(result.cache_hits, 0);
+  EXPECT_EQ(static_cast<size_t>(result.head_requests), cache.size());
+}
+
+/* Objects in the presence cache are not queried. */
+TEST(RequestPool, CachedObjectsAreNotQueried) {
+  TemporaryDirectory temp_dir;
+  const auto path = temp_dir.Path() / "presence.db";
+  size_t objects;
+  {
+    PresenceCache cache(path, "http://localhost:" + port, 0);
+    Populate(cache);
+    objects = cache.size();
+    EXPECT_GT(objects, 1U);
+  }
+
+  PresenceCache cache(path, "http://localhost:" + port, 0);
+  PushResult result = Push(RunMode::kPushTree, &cache);
+  EXPECT_FALSE(result.stopped);
+  EXPECT_EQ(result.head_requests, 0);
+  EXPECT_EQ(result.put_requests, 0);
+  EXPECT_EQ(static_cast<size_t>(result.cache_hits), objects);
+
+  // A normal push stops at the commit, which is known to be there.
+  result = Push(RunMode::kDefault, &cache);
+  EXPECT_FALSE(result.stopped);
+  EXPECT_EQ(result.head_requests, 0);
+  EXPECT_EQ(result.cache_hits, 1);
+}
+
+/* A cached object that turns out to be missing clears the cache and aborts the push. */
+TEST(RequestPool, StaleCacheEntryAborts) {
+  TemporaryDirectory temp_dir;
+  const auto path = temp_dir.Path() / "presence.db";
+  {
+    PresenceCache cache(path, "http://localhost:" + port, 0);
+    Populate(cache);
+  }
+
+  boost::filesystem::path removed;
+  for (const auto &entry : boost::filesystem::recursive_directory_iterator(server_dir.Path() / "objects")) {
+    if (entry.path().extension() == ".filez") {
+      removed = entry.path();
+      break;
+    }
+  }
+  ASSERT_FALSE(removed.empty());
+  boost::filesystem::remove(removed);
+
+  {
+    // Check every cached object with the server.
+    PresenceCache cache(path, "http://localhost:" + port, 100);
+    const PushResult result = Push(RunMode::kPushTree, &cache);
+    EXPECT_TRUE(result.stopped);
+    EXPECT_EQ(result.cache_hits, 0);
+    EXPECT_EQ(cache.size(), 0U);
+  }
+  PresenceCache cache(path, "http://localhost:" + port, 0);
+  EXPECT_EQ(cache.size(), 0U);
+
+  // The next push finds the missing object with the server and uploads it again.
+  Populate(cache);
+  EXPECT_TRUE(boost::filesystem::exists(removed));
+}
+
+#ifndef __NO_MAIN__
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+
+  std::string server = "tests/sota_tools/treehub_server.py";
+  port = TestUtils::getFreePort();
+  boost::process::child server_process(server, std::string("-p"), port, std::string("-d"), server_dir.PathString());
+  TestUtils::waitForServer("http://localhost:" + port + "/");
+
+  return RUN_ALL_TESTS();
+}
+#endif
+
+// vim: set tabstop=2 shiftwidth=2 expandtab:
@@ -3,6 +3,8 @@
 #include <boost/filesystem.hpp>
 
 #include "crypto/crypto.h"
+#include "package_manager/bindelta.h"
+#include "package_manager/compression.h"
 #include "utilities/utils.h"
 
 void ImageRepo::addImage(const std::string &name, Json::Value &target, const std::string &hardware_id,
@@ -53,6 +55,41 @@ void ImageRepo::addBinaryImage(const boost::filesystem::path &image_path, const
   addImage(targetname.string(), target, hardware_id, delegation);
 }
 
+Json::Value ImageRepo::addDeltaPatch(const boost::filesystem::path &base_path,
+                                     const boost::filesystem::path &image_path,
+                                     const boost::filesystem::path &targetname) {
+  const std::string base = Utils::readFile(base_path);
+  const std::string patch = BinaryDelta::create(base, Utils::readFile(image_path));
+
+  const boost::filesystem::path patch_name = targetname.string() + ".delta";
+  const boost::filesystem::path patch_path = path_ / ImageRepo::dir / "targets" / patch_name;
+  boost::filesystem::create_directories(patch_path.parent_path());
+  Utils::writeFile(patch_path, patch);
+
+  Json::Value delta;
+  delta["base_sha256"] = Crypto::sha256digestHex(base);
+  delta["base_sha512"] = Crypto::sha512digestHex(base);
+  delta["name"] = patch_name.string();
+  delta["length"] = Json::UInt64(patch.size());
+  return delta;
+}
+
+Json::Value ImageRepo::addCompressedImage(const boost::filesystem::path &image_path,
+                                          const boost::filesystem::path &targetname, const std::string &encoding) {
+  const std::string compressed = Compression::compress(encoding, Utils::readFile(image_path));
+
+  const boost::filesystem::path compressed_name = targetname.string() + "." + encoding;
+  const boost::filesystem::path compressed_path = path_ / ImageRepo::dir / "targets" / compressed_name;
+  boost::filesystem::create_directories(compressed_path.parent_path());
+  Utils::writeFile(compressed_path, compressed);
+
+  Json::Value variant;
+  variant["encoding"] = encoding;
+  variant["name"] = compressed_name.string();
+  variant["length"] = Json::UInt64(compressed.size());
+  return variant;
+}
+
 void ImageRepo::addCustomImage(const std::string &name, const Hash &hash, const uint64_t length,
                                const std::string &hardware_id, const std::string &url, const int32_t custom_version,
                                const Delegation &delegation, const Json::Value &custom) {
@@ -13,6 +13,14 @@ class ImageRepo : public Repo {
   void addCustomImage(const std::string &name, const Hash &hash, uint64_t length, const std::string &hardware_id,
                       const std::string &url = "", int32_t custom_version = 0, const Delegation &delegation = {},
                       const Json::Value &custom = {});
+  // Store a patch from the image at `base_path` to the one at `image_path` next
+  // to the Targets, and return the custom metadata that points clients to it.
+  Json::Value addDeltaPatch(const boost::filesystem::path &base_path, const boost::filesystem::path &image_path,
+                            const boost::filesystem::path &targetname);
+  // Store a compressed copy of the image next to the Targets, and return the
+  // custom metadata that points clients to it.
+  Json::Value addCompressedImage(const boost::filesystem::path &image_path, const boost::filesystem::path &targetname,
+                                 const std::string &encoding);
   void addDelegation(const Uptane::Role &name, const Uptane::Role &parent_role, const std::string &path,
                      bool terminating, KeyType key_type);
   void revokeDelegation(const Uptane::Role &name);
@@ -55,6 +55,8 @@ int main(int argc, char **argv) {
     ("hwid", po::value<std::string>(), "target hardware identifier")
     ("targetformat", po::value<std::string>(), "format of target for 'image' command")
     ("targetcustom", po::value<boost::filesystem::path>(), "path to custom JSON for 'image' command")
+    ("compress", po::value<std::string>(), "also publish the image compressed with xz for 'image' command")
+    ("deltafrom", po::value<boost::filesystem::path>(), "older image to publish a delta patch from for 'image' command")
     ("serial", po::value<std::string>(), "target ECU serial")
     ("expires", po::value<std::string>(), "expiration time")
     ("keyname", po::value<std::string>(), "name of key's role")
@@ -150,6 +152,22 @@ int main(int argc, char **argv) {
           custom = Json::Value();
           custom["targetFormat"] = vm["targetformat"].as<std::string>();
         }
+        if (vm.count("deltafrom") > 0) {
+          if (vm.count("filename") == 0) {
+            std::cerr << "--deltafrom requires --filename\n";
+            exit(EXIT_FAILURE);
+          }
+          custom["delta"] = repo.addDeltaPatch(vm["deltafrom"].as<boost::filesystem::path>(),
+                                               vm["filename"].as<boost::filesystem::path>(), targetname);
+        }
+        if (vm.count("compress") > 0) {
+          if (vm.count("filename") == 0) {
+            std::cerr << "--compress requires --filename\n";
+            exit(EXIT_FAILURE);
+          }
+          custom["compressed"] = repo.addCompressedImage(vm["filename"].as<boost::filesystem::path>(), targetname,
+                                                         vm["compress"].as<std::string>());
+        }
         if (vm.count("filename") > 0) {
           repo.addImage(vm["filename"].as<boost::filesystem::path>(), targetname, hwid, url, custom_version, delegation,
                         custom);
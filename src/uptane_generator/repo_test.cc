@@ -223,6 +223,29 @@ TEST(uptane_generator, image_custom_version) {
   check_repo(temp_dir);
 }
 
+/*
+ * Add an image to the Image repo together with a compressed copy.
+ */
+TEST(uptane_generator, image_compressed) {
+  TemporaryDirectory temp_dir;
+  UptaneRepo repo(temp_dir.Path(), "", "");
+  repo.generateRepo(key_type);
+  const std::string image(100000, 'x');
+  Utils::writeFile(temp_dir / "image", image);
+  Json::Value custom;
+  custom["compressed"] = repo.addCompressedImage(temp_dir / "image", "image", "xz");
+  repo.addImage(temp_dir / "image", "image", "test-hw", "", 0, Delegation(), custom);
+  Json::Value image_targets = Utils::parseJSONFile(temp_dir.Path() / ImageRepo::dir / "targets.json");
+  const Json::Value compressed = image_targets["signed"]["targets"]["image"]["custom"]["compressed"];
+  EXPECT_EQ(compressed["encoding"], "xz");
+  EXPECT_EQ(compressed["name"], "image.xz");
+  EXPECT_EQ(Utils::readFile(temp_dir.Path() / ImageRepo::dir / "targets/image"), image);
+  const std::string data = Utils::readFile(temp_dir.Path() / ImageRepo::dir / "targets/image.xz");
+  EXPECT_EQ(compressed["length"].asUInt64(), data.size());
+  EXPECT_THROW(repo.addCompressedImage(temp_dir / "image", "image", "rar"), std::runtime_error);
+  check_repo(temp_dir);
+}
+
 /*
  * Add simple delegation.
  * Add image with delegation.
@@ -435,6 +458,46 @@ TEST(uptane_generator, image_custom) {
   check_repo(temp_dir);
 }
 
+/*
+ * Add an image with a delta patch from an older one.
+ */
+TEST(uptane_generator, image_delta) {
+  TemporaryDirectory temp_dir;
+  std::ostringstream keytype_stream;
+  keytype_stream << key_type;
+  std::string cmd = generate_repo_exec + " generate " + temp_dir.Path().string() + " --keytype " + keytype_stream.str();
+  std::string output;
+  int retval = Utils::shell(cmd, &output);
+  if (retval) {
+    FAIL() << "'" << cmd << "' exited with error code " << retval << "\n";
+  }
+  std::string base;
+  while (base.size() < 100000) {
+    base += Utils::randomUuid();
+  }
+  std::string image = base;
+  image.replace(5000, 7, "changed");
+  Utils::writeFile(temp_dir / "v1.img", base);
+  Utils::writeFile(temp_dir / "v2.img", image);
+  cmd = generate_repo_exec + " image " + temp_dir.Path().string() + " --filename " + (temp_dir / "v2.img").string() +
+        " --targetname firmware-v2 --deltafrom " + (temp_dir / "v1.img").string() + " --hwid primary_hw";
+  retval = Utils::shell(cmd, &output);
+  if (retval) {
+    FAIL() << "'" << cmd << "' exited with error code " << retval << "\n";
+  }
+
+  Json::Value image_targets = Utils::parseJSONFile(temp_dir.Path() / ImageRepo::dir / "targets.json");
+  const Json::Value custom = image_targets["signed"]["targets"]["firmware-v2"]["custom"];
+  EXPECT_EQ(custom["targetFormat"], "BINARY");
+  EXPECT_EQ(custom["delta"]["base_sha256"], Crypto::sha256digestHex(base));
+  EXPECT_EQ(custom["delta"]["base_sha512"], Crypto::sha512digestHex(base));
+  EXPECT_EQ(custom["delta"]["name"], "firmware-v2.delta");
+  const std::string patch = Utils::readFile(temp_dir.Path() / ImageRepo::dir / "targets/firmware-v2.delta");
+  EXPECT_EQ(custom["delta"]["length"].asUInt64(), patch.size());
+  EXPECT_LT(patch.size(), 1000);
+  check_repo(temp_dir);
+}
+
 /*
  * Clear the staged Director Targets metadata.
  */
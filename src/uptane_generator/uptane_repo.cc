@@ -34,6 +34,15 @@ void UptaneRepo::addImage(const boost::filesystem::path &image_path, const boost
                           const Delegation &delegation, const Json::Value &custom) {
   image_repo_.addBinaryImage(image_path, targetname, hardware_id, url, custom_version, delegation, custom);
 }
+Json::Value UptaneRepo::addDeltaPatch(const boost::filesystem::path &base_path,
+                                      const boost::filesystem::path &image_path,
+                                      const boost::filesystem::path &targetname) {
+  return image_repo_.addDeltaPatch(base_path, image_path, targetname);
+}
+Json::Value UptaneRepo::addCompressedImage(const boost::filesystem::path &image_path,
+                                           const boost::filesystem::path &targetname, const std::string &encoding) {
+  return image_repo_.addCompressedImage(image_path, targetname, encoding);
+}
 void UptaneRepo::addCustomImage(const std::string &name, const Hash &hash, uint64_t length,
                                 const std::string &hardware_id, const std::string &url, const int32_t custom_version,
                                 const Delegation &delegation, const Json::Value &custom) {
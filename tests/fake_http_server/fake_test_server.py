@@ -2,16 +2,19 @@
 
 import argparse
 import contextlib
+import email.utils
+import hashlib
 import multiprocessing
 import logging
 import os
 import sys
 import socket
 import socketserver
+import threading
 
 from http.server import SimpleHTTPRequestHandler, HTTPServer
 from os import path
-from time import sleep
+from time import sleep, time
 
 
 logger = logging.getLogger("fake_test_server")
@@ -49,9 +52,25 @@ class Handler(SimpleHTTPRequestHandler):
             self.send_response(404)
             self.end_headers()
         else:
-            self.send_response(200)
+            # Validators for conditional requests; If-None-Match takes
+            # precedence over If-Modified-Since as in RFC 7232.
+            with open(self.server.meta_path + uri, 'rb') as source:
+                etag = '"%s"' % hashlib.sha256(source.read()).hexdigest()
+            mtime = int(os.path.getmtime(self.server.meta_path + uri))
+            if 'If-None-Match' in self.headers:
+                not_modified = etag in [t.strip() for t in self.headers['If-None-Match'].split(',')]
+            elif 'If-Modified-Since' in self.headers:
+                since = email.utils.parsedate_to_datetime(self.headers['If-Modified-Since'])
+                not_modified = since is not None and since.timestamp() >= mtime
+            else:
+                not_modified = False
+
+            self.send_response(304 if not_modified else 200)
+            self.send_header('ETag', etag)
+            self.send_header('Last-Modified', email.utils.formatdate(mtime, usegmt=True))
             self.end_headers()
-            self._serve_simple(self.server.meta_path + uri)
+            if not not_modified:
+                self._serve_simple(self.server.meta_path + uri)
 
     def serve_target(self, filename):
         if self.server.target_path is None:
@@ -91,11 +110,12 @@ class Handler(SimpleHTTPRequestHandler):
             chunk_size = 1 << 20
             response_size = 100 * chunk_size
             if "Range" in self.headers:
-                r = self.headers["Range"]
-                r_from = int(r.split("=")[1].split("-")[0])
+                r = self.headers["Range"].split("=")[1].split("-")
+                r_from = int(r[0])
+                r_to = int(r[1]) if r[1] else response_size - 1
                 self.send_response(206)
-                self.send_header('Content-Range', 'bytes %d-%d/%d' % (r_from, response_size-1, response_size))
-                response_size = response_size - r_from
+                self.send_header('Content-Range', 'bytes %d-%d/%d' % (r_from, r_to, response_size))
+                response_size = r_to + 1 - r_from
             else:
                 self.send_response(200)
             self.send_header('Content-Type', 'application/json')
@@ -118,11 +138,43 @@ class Handler(SimpleHTTPRequestHandler):
                 sleep(1)
         elif self.path == '/campaigner/campaigns':
             self.serve_meta("/campaigns.json")
+        elif self.path == '/keep_alive':
+            # For httpclient_test: the only endpoint that leaves the
+            # connection open for the next request.
+            body = b'{"status": "good"}'
+            self.send_response(200)
+            self.send_header('Connection', 'keep-alive')
+            self.send_header('Content-Length', len(body))
+            self.end_headers()
+            self.wfile.write(body)
+            self.close_connection = False
         elif self.path == '/user_agent':
             user_agent = self.headers.get('user-agent')
             self.send_response(200)
             self.end_headers()
             self.wfile.write(user_agent.encode())
+        elif self.path.startswith('/retry_after'):
+            # For httpclient_test: /retry_after/<s> and /retry_after_date/<s>
+            # always ask to come back in <s> seconds, /retry_after_once/<s>/<id>
+            # only the first time it is requested.
+            parts = self.path.split('/')
+            delay = int(parts[2])
+            if parts[1] == 'retry_after_once':
+                with self.server.lock:
+                    first = self.path not in self.server.retried
+                    self.server.retried.add(self.path)
+                if not first:
+                    self.send_response(200)
+                    self.end_headers()
+                    self.wfile.write(b'{"path": "%b"}' % bytes(self.path, "utf8"))
+                    return
+            self.send_response(503)
+            if parts[1] == 'retry_after_date':
+                self.send_header('Retry-After', email.utils.formatdate(time() + delay, usegmt=True))
+            else:
+                self.send_header('Retry-After', str(delay))
+            self.end_headers()
+            self.wfile.write(b"Service unavailable")
         else:
             if self.server.fail_injector is not None and self.server.fail_injector.fail(self):
                 return
@@ -189,6 +241,8 @@ class FakeTestServer(socketserver.ThreadingMixIn, HTTPServer):
         else:
             self.target_path = None
         self.fail_injector = fail_injector
+        self.lock = threading.Lock()
+        self.retried = set()
         self.srcdir = srcdir if srcdir is not None else os.getcwd()
 
     def server_bind(self):